@@ -0,0 +1,45 @@
+//
+//  BBBPWMBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMBackend_h
+#define BBBPWMBackend_h
+
+/**
+ \brief PWM_Attribute - the three values a BBBPWMBasicDevice hands to its output backend.
+ \details An output backend is any class with the members below, BBBPWMBasicDevice< Backend > calls them directly so
+          the choice is made at compile time and the update path has no virtual dispatch :
+          \code
+          int PWM_Attach( int Block, int Pin );              // find / export the pin, 1 success, 0 failure (reported)
+          static int PWM_AttachAll( const vector< Backend* >& Outputs, const vector< int >& Blocks,
+                                    const vector< int >& Pins, vector< int >& Status ); // many pins, one wait
+          int PWM_Read( PWM_Attribute Attr, int& Value );     // 1 success, 0 not a value, -1 failure
+          int PWM_Write( PWM_Attribute Attr, int Value );     // 1 success, 0 failure (errno set), -1 unable to open
+          void PWM_Close( void );
+          const char* PWM_Describe( PWM_Attribute Attr ) const;
+          void PWM_SetRoot( const string& Root );
+          string PWM_GetRoot( void ) const;
+          void PWM_SetTimeout( int Milliseconds );
+          int PWM_TakeError( PWM_Attribute Attr, int& Value ); // errno of a batched write that failed later, 0 none
+          static int PWM_BatchBegin( void );                  // writer thread, before a pass : failed writes reaped
+          static int PWM_BatchEnd( void );                    // writer thread, after a pass : submits, failed writes reaped
+          static int PWM_BatchFD( void );                     // readable while completions wait to be reaped, -1 none
+          \endcode
+          Backends that write as they go return 0 / -1 from the last four. A batching backend may return 1 from
+          PWM_Write( ) between PWM_BatchBegin( ) and PWM_BatchEnd( ) for a write it has only queued, if that write fails
+          later PWM_TakeError( ) hands the errno back with the value the attribute is left holding.
+          See BBBPWMSysfsBackend, BBBPWMUringBackend, BBBPWMEhrpwmBackend, BBBPWMClassBackend, BBBPWMSimBackend and
+          BBBPWMNullBackend.
+ */
+enum PWM_Attribute {
+    PWM_ATTR_DUTY = 0, //!< Duty in ns.
+    PWM_ATTR_PERIOD = 1, //!< Period in ns.
+    PWM_ATTR_RUN = 2, //!< Run, 0 or 1.
+    PWM_ATTRS = 3, //!< Number of attributes.
+};
+
+#endif /* BBBPWMBackend_h */
@@ -0,0 +1,404 @@
+//
+//  BBBPWMCalibration.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMCalibration.h"
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#define PWM_CAL_SSE2
+#endif
+
+/**
+ \fn static function int PWM_ConvertChannel( const BBBPWMCalTable& PWM_Table, int PWM_Channel, float PWM_Throttle )
+ \brief Scalar conversion of one channel. Every comparison is written the way the vector path's min / max behave, so
+ both give the same duty for the same throttle.
+ \return <int> duty in ns.
+ */
+static inline int PWM_ConvertChannel( const BBBPWMCalTable& PWM_Table, int PWM_Channel, float PWM_Throttle ) {
+    float PWM_X = PWM_Throttle > 0.0f ? PWM_Throttle : 0.0f;
+    PWM_X = PWM_X < 1.0f ? PWM_X : 1.0f;
+    float PWM_T = PWM_X * PWM_Table.PWM_Segments;
+    float PWM_Last = PWM_T < PWM_Table.PWM_LastSegment ? PWM_T : PWM_Table.PWM_LastSegment;
+    int PWM_Segment = ( int ) PWM_Last;
+    float PWM_Fraction = PWM_T - ( float ) PWM_Segment;
+    size_t PWM_At = ( size_t ) PWM_Channel * ( PWM_Table.PWM_Points - 1 ) + PWM_Segment;
+    float PWM_Duty = PWM_Table.PWM_Base[ PWM_At ] + PWM_Table.PWM_Slope[ PWM_At ] * PWM_Fraction;
+    PWM_Duty = PWM_Duty > PWM_Table.PWM_Low[ PWM_Channel ] ? PWM_Duty : PWM_Table.PWM_Low[ PWM_Channel ];
+    PWM_Duty = PWM_Duty < PWM_Table.PWM_High[ PWM_Channel ] ? PWM_Duty : PWM_Table.PWM_High[ PWM_Channel ];
+    return ( int )( PWM_Duty + 0.5f );
+}
+
+/**
+ \fn static function int PWM_ConvertVector( const BBBPWMCalTable& PWM_Table, const float* PWM_Throttles, int* PWM_Duties, int PWM_Count )
+ \brief Converts channels four at a time : throttle clamp, segment and fraction, interpolation, duty clamp and rounding
+ are vector operations, only the segment lookups are scalar loads (SSE2 cannot gather). Other builds, ARM
+ included, convert every channel through PWM_ConvertChannel( ).
+ \return <int> channels converted, a multiple of 4, the rest is left to PWM_ConvertChannel( ).
+ */
+static int PWM_ConvertVector( const BBBPWMCalTable& PWM_Table, const float* PWM_Throttles, int* PWM_Duties, int PWM_Count ) {
+    int PWM_Stride = PWM_Table.PWM_Points - 1;
+    const float* PWM_Base = PWM_Table.PWM_Base.data( );
+    const float* PWM_Slope = PWM_Table.PWM_Slope.data( );
+    int c = 0;
+#if defined( PWM_CAL_SSE2 )
+    __m128 PWM_Zero = _mm_setzero_ps( ), PWM_One = _mm_set1_ps( 1.0f ), PWM_Half = _mm_set1_ps( 0.5f );
+    __m128 PWM_Segments = _mm_set1_ps( PWM_Table.PWM_Segments ), PWM_LastSegment = _mm_set1_ps( PWM_Table.PWM_LastSegment );
+    alignas( 16 ) int32_t PWM_Segment[ 4 ];
+    for( ; c + 4 <= PWM_Count; c += 4 ) {
+        // maxps returns its second operand when either is NaN, so a NaN throttle becomes 0 here.
+        __m128 PWM_X = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( PWM_Throttles + c ), PWM_Zero ), PWM_One );
+        __m128 PWM_T = _mm_mul_ps( PWM_X, PWM_Segments );
+        __m128i PWM_I = _mm_cvttps_epi32( _mm_min_ps( PWM_T, PWM_LastSegment ) );
+        __m128 PWM_Fraction = _mm_sub_ps( PWM_T, _mm_cvtepi32_ps( PWM_I ) );
+        _mm_store_si128( ( __m128i* ) PWM_Segment, PWM_I );
+        size_t PWM_At0 = ( size_t ) c * PWM_Stride + PWM_Segment[ 0 ];
+        size_t PWM_At1 = ( size_t )( c + 1 ) * PWM_Stride + PWM_Segment[ 1 ];
+        size_t PWM_At2 = ( size_t )( c + 2 ) * PWM_Stride + PWM_Segment[ 2 ];
+        size_t PWM_At3 = ( size_t )( c + 3 ) * PWM_Stride + PWM_Segment[ 3 ];
+        __m128 PWM_B = _mm_setr_ps( PWM_Base[ PWM_At0 ], PWM_Base[ PWM_At1 ], PWM_Base[ PWM_At2 ], PWM_Base[ PWM_At3 ] );
+        __m128 PWM_S = _mm_setr_ps( PWM_Slope[ PWM_At0 ], PWM_Slope[ PWM_At1 ], PWM_Slope[ PWM_At2 ], PWM_Slope[ PWM_At3 ] );
+        __m128 PWM_Duty = _mm_add_ps( PWM_B, _mm_mul_ps( PWM_S, PWM_Fraction ) );
+        PWM_Duty = _mm_max_ps( PWM_Duty, _mm_loadu_ps( PWM_Table.PWM_Low.data( ) + c ) );
+        PWM_Duty = _mm_min_ps( PWM_Duty, _mm_loadu_ps( PWM_Table.PWM_High.data( ) + c ) );
+        _mm_storeu_si128( ( __m128i* )( PWM_Duties + c ), _mm_cvttps_epi32( _mm_add_ps( PWM_Duty, PWM_Half ) ) );
+    }
+#else
+    ( void ) PWM_Throttles;
+    ( void ) PWM_Duties;
+    ( void ) PWM_Count;
+    ( void ) PWM_Stride;
+    ( void ) PWM_Base;
+    ( void ) PWM_Slope;
+#endif
+    return c;
+}
+
+/**
+ \brief BBBPWMCalibration : No channels until PWM_Reset( ) or PWM_Load( ).
+ \param <void>
+ */
+BBBPWMCalibration::BBBPWMCalibration( ) {
+    for( int t = 0; t < 2; t++ ) {
+        this->PWM_Tables[ t ].PWM_Channels = 0;
+        this->PWM_Tables[ t ].PWM_Points = 0;
+        this->PWM_Tables[ t ].PWM_Segments = 0.0f;
+        this->PWM_Tables[ t ].PWM_LastSegment = 0.0f;
+        this->PWM_Readers[ t ].store( 0, memory_order_relaxed );
+    }
+    this->PWM_Active.store( 0, memory_order_relaxed );
+    pthread_mutex_init( &this->PWM_SwapLock, NULL );
+}
+
+/**
+ \brief ~BBBPWMCalibration : Must not be called while a conversion is in flight.
+ */
+BBBPWMCalibration::~BBBPWMCalibration( ) {
+    pthread_mutex_destroy( &this->PWM_SwapLock );
+}
+
+/**
+ \fn private function int PWM_Enter( void ) const
+ \brief Registers a conversion on the active table.
+ \param <void>
+ \return <int> index of the table, hand it to PWM_Leave( ).
+ */
+int BBBPWMCalibration::PWM_Enter( void ) const {
+    // seq_cst increment then recheck, paired with PWM_SwapBegin( )'s count load : either the swapper sees us and
+    // waits, or we see that the table stopped being the active one and go to the other.
+    for( ;; ) {
+        int PWM_Table = this->PWM_Active.load( );
+        this->PWM_Readers[ PWM_Table ].fetch_add( 1 );
+        if( this->PWM_Active.load( ) == PWM_Table )
+            return PWM_Table;
+        this->PWM_Readers[ PWM_Table ].fetch_sub( 1, memory_order_release );
+    }
+}
+
+/**
+ \fn private function void PWM_Leave( int PWM_Table ) const
+ \brief Ends a conversion started with PWM_Enter( ).
+ \param <int> PWM_Table
+ \return <void>
+ */
+void BBBPWMCalibration::PWM_Leave( int PWM_Table ) const {
+    this->PWM_Readers[ PWM_Table ].fetch_sub( 1, memory_order_release );
+}
+
+/**
+ \fn private function BBBPWMCalTable& PWM_SwapBegin( void )
+ \brief Takes the swap lock and waits out the conversions still on the inactive table, which is returned for rebuilding.
+ \param <void>
+ \return <BBBPWMCalTable>&
+ */
+BBBPWMCalTable& BBBPWMCalibration::PWM_SwapBegin( void ) {
+    pthread_mutex_lock( &this->PWM_SwapLock );
+    int PWM_Spare = this->PWM_Active.load( memory_order_relaxed ) ^ 1;
+    // Only conversions that started before the last swap can be left on it, each is a few hundred ns.
+    while( this->PWM_Readers[ PWM_Spare ].load( ) != 0 )
+        sched_yield( );
+    return this->PWM_Tables[ PWM_Spare ];
+}
+
+/**
+ \fn private function void PWM_SwapEnd( bool PWM_Publish )
+ \brief Makes the table from PWM_SwapBegin( ) the active one if PWM_Publish, then releases the swap lock.
+ \param <bool> PWM_Publish
+ \return <void>
+ */
+void BBBPWMCalibration::PWM_SwapEnd( bool PWM_Publish ) {
+    if( PWM_Publish )
+        this->PWM_Active.store( this->PWM_Active.load( memory_order_relaxed ) ^ 1 );
+    pthread_mutex_unlock( &this->PWM_SwapLock );
+}
+
+/**
+ \fn private static function int PWM_Build( BBBPWMCalTable& PWM_Table, int PWM_Channels, int PWM_Points, const int32_t* PWM_Records )
+ \brief Fills a table from file-layout records (low, high, points), checking every duty.
+ \return <int> -1 a duty out of range (reported), 1 success.
+ */
+int BBBPWMCalibration::PWM_Build( BBBPWMCalTable& PWM_Table, int PWM_Channels, int PWM_Points, const int32_t* PWM_Records ) {
+    int PWM_Record = PWM_Points + 2;
+    for( int c = 0; c < PWM_Channels; c++ ) {
+        const int32_t* PWM_Values = PWM_Records + ( size_t ) c * PWM_Record;
+        bool PWM_Valid = PWM_Values[ 0 ] <= PWM_Values[ 1 ];
+        for( int p = 0; p < PWM_Record; p++ )
+            PWM_Valid = PWM_Valid && PWM_Values[ p ] >= PWM_DUTY_LOW && PWM_Values[ p ] <= PWM_DUTY_HIGH;
+        if( !PWM_Valid ) {
+            cerr << "Error - calibration of channel " << c << " needs low <= high and every duty between " << PWM_DUTY_LOW << " and " << PWM_DUTY_HIGH << endl;
+            return -1;
+        }
+    }
+
+    int PWM_Stride = PWM_Points - 1;
+    PWM_Table.PWM_Channels = PWM_Channels;
+    PWM_Table.PWM_Points = PWM_Points;
+    PWM_Table.PWM_Segments = ( float ) PWM_Stride;
+    PWM_Table.PWM_LastSegment = ( float )( PWM_Stride - 1 );
+    PWM_Table.PWM_Base.resize( ( size_t ) PWM_Channels * PWM_Stride );
+    PWM_Table.PWM_Slope.resize( ( size_t ) PWM_Channels * PWM_Stride );
+    PWM_Table.PWM_Low.resize( PWM_Channels );
+    PWM_Table.PWM_High.resize( PWM_Channels );
+    PWM_Table.PWM_Records.assign( PWM_Records, PWM_Records + ( size_t ) PWM_Channels * PWM_Record );
+    for( int c = 0; c < PWM_Channels; c++ ) {
+        const int32_t* PWM_Values = PWM_Records + ( size_t ) c * PWM_Record;
+        PWM_Table.PWM_Low[ c ] = ( float ) PWM_Values[ 0 ];
+        PWM_Table.PWM_High[ c ] = ( float ) PWM_Values[ 1 ];
+        for( int s = 0; s < PWM_Stride; s++ ) {
+            PWM_Table.PWM_Base[ ( size_t ) c * PWM_Stride + s ] = ( float ) PWM_Values[ 2 + s ];
+            PWM_Table.PWM_Slope[ ( size_t ) c * PWM_Stride + s ] = ( float )( PWM_Values[ 3 + s ] - PWM_Values[ 2 + s ] );
+        }
+    }
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Reset( int Channels, int Points )
+ \brief Swaps in straight curves from PWM_DUTY_HIGH at throttle 0 to PWM_DUTY_LOW at 1 for Channels channels, clamped to the full range.
+ \param <int> Channels
+ \param <int> Points (0 for PWM_CAL_POINTS)
+ \return <int> -1 Channels or Points out of range, 1 success.
+ */
+int BBBPWMCalibration::PWM_Reset( int Channels, int Points ) {
+    if( Points == 0 )
+        Points = PWM_CAL_POINTS;
+    if( Channels <= 0 || Channels > PWM_CAL_MAX_CHANNELS || Points < 2 || Points > PWM_CAL_MAX_POINTS ) {
+        cerr << "Error - BBBPWMCalibration::PWM_Reset( ) needs 1 to " << PWM_CAL_MAX_CHANNELS << " channels and 2 to " << PWM_CAL_MAX_POINTS << " points" << endl;
+        return -1;
+    }
+    vector< int32_t > PWM_Records( ( size_t ) Channels * ( Points + 2 ) );
+    for( int c = 0; c < Channels; c++ ) {
+        int32_t* PWM_Values = &PWM_Records[ ( size_t ) c * ( Points + 2 ) ];
+        PWM_Values[ 0 ] = PWM_DUTY_LOW;
+        PWM_Values[ 1 ] = PWM_DUTY_HIGH;
+        for( int p = 0; p < Points; p++ )
+            PWM_Values[ 2 + p ] = PWM_DUTY_HIGH - ( int32_t )( ( int64_t )( PWM_DUTY_HIGH - PWM_DUTY_LOW ) * p / ( Points - 1 ) );
+    }
+    int PWM_Result = PWM_Build( this->PWM_SwapBegin( ), Channels, Points, PWM_Records.data( ) );
+    this->PWM_SwapEnd( PWM_Result > 0 );
+    return PWM_Result;
+}
+
+/**
+ \fn public function int PWM_Load( const char* Path )
+ \brief Reads a calibration file and swaps in its curves, the ones in use stay if anything in it is wrong.
+ \param const <char>* Path
+ \return <int> -1 unreadable or invalid file (reported), 1 success.
+ */
+int BBBPWMCalibration::PWM_Load( const char* Path ) {
+    int PWM_FD = open( Path, O_RDONLY | O_CLOEXEC );
+    if( PWM_FD < 0 ) {
+        cerr << "Unable to open calibration : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    BBBPWMCalHeader PWM_Header;
+    vector< int32_t > PWM_Records;
+    bool PWM_Valid = read( PWM_FD, &PWM_Header, sizeof( PWM_Header ) ) == ( ssize_t ) sizeof( PWM_Header )
+        && memcmp( PWM_Header.PWM_Magic, PWM_CAL_MAGIC, sizeof( PWM_Header.PWM_Magic ) ) == 0
+        && PWM_Header.PWM_Channels >= 1 && PWM_Header.PWM_Channels <= PWM_CAL_MAX_CHANNELS
+        && PWM_Header.PWM_Points >= 2 && PWM_Header.PWM_Points <= PWM_CAL_MAX_POINTS;
+    if( PWM_Valid ) {
+        PWM_Records.resize( ( size_t ) PWM_Header.PWM_Channels * ( PWM_Header.PWM_Points + 2 ) );
+        ssize_t PWM_Bytes = PWM_Records.size( ) * sizeof( int32_t );
+        PWM_Valid = read( PWM_FD, PWM_Records.data( ), PWM_Bytes ) == PWM_Bytes;
+    }
+    close( PWM_FD );
+    if( !PWM_Valid ) {
+        cerr << "Not a valid calibration : " << Path << endl;
+        return -1;
+    }
+    int PWM_Result = PWM_Build( this->PWM_SwapBegin( ), PWM_Header.PWM_Channels, PWM_Header.PWM_Points, PWM_Records.data( ) );
+    this->PWM_SwapEnd( PWM_Result > 0 );
+    return PWM_Result;
+}
+
+/**
+ \fn public function int PWM_Save( const char* Path ) const
+ \brief Writes the curves in use to a calibration file PWM_Load( ) reads back.
+ \param const <char>* Path
+ \return <int> -1 failure to write (reported), 1 success.
+ */
+int BBBPWMCalibration::PWM_Save( const char* Path ) const {
+    int PWM_FD = open( Path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if( PWM_FD < 0 ) {
+        cerr << "Unable to create calibration : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    int PWM_Table = this->PWM_Enter( );
+    const BBBPWMCalTable& PWM_Active = this->PWM_Tables[ PWM_Table ];
+    BBBPWMCalHeader PWM_Header;
+    memcpy( PWM_Header.PWM_Magic, PWM_CAL_MAGIC, sizeof( PWM_Header.PWM_Magic ) );
+    PWM_Header.PWM_Channels = PWM_Active.PWM_Channels;
+    PWM_Header.PWM_Points = PWM_Active.PWM_Points;
+    ssize_t PWM_Bytes = PWM_Active.PWM_Records.size( ) * sizeof( int32_t );
+    bool PWM_Written = write( PWM_FD, &PWM_Header, sizeof( PWM_Header ) ) == ( ssize_t ) sizeof( PWM_Header )
+        && write( PWM_FD, PWM_Active.PWM_Records.data( ), PWM_Bytes ) == PWM_Bytes;
+    this->PWM_Leave( PWM_Table );
+    if( close( PWM_FD ) < 0 || !PWM_Written ) {
+        cerr << "Unable to write calibration : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function int PWM_SetCurve( int Channel, const int* Points, int Low, int High )
+ \brief Swaps in a new curve for one channel, the other channels keep theirs.
+ \param <int> Channel
+ \param const <int>* Points (PWM_GetPointCount( ) duties in ns, throttle 0 first)
+ \param <int> Low (lowest duty in ns)
+ \param <int> High (highest duty in ns)
+ \return <int> -1 no such channel or a duty out of range, 1 success.
+ */
+int BBBPWMCalibration::PWM_SetCurve( int Channel, const int* Points, int Low, int High ) {
+    BBBPWMCalTable& PWM_Spare = this->PWM_SwapBegin( );
+    // Swaps are serialised by the lock we hold, so the active table cannot change under us.
+    const BBBPWMCalTable& PWM_Active = this->PWM_Tables[ this->PWM_Active.load( memory_order_relaxed ) ];
+    if( Channel < 0 || Channel >= PWM_Active.PWM_Channels ) {
+        this->PWM_SwapEnd( false );
+        cerr << "Error - BBBPWMCalibration::PWM_SetCurve( ) has no channel " << Channel << endl;
+        return -1;
+    }
+    int PWM_Points = PWM_Active.PWM_Points;
+    vector< int32_t > PWM_Records( PWM_Active.PWM_Records );
+    int32_t* PWM_Values = &PWM_Records[ ( size_t ) Channel * ( PWM_Points + 2 ) ];
+    PWM_Values[ 0 ] = Low;
+    PWM_Values[ 1 ] = High;
+    for( int p = 0; p < PWM_Points; p++ )
+        PWM_Values[ 2 + p ] = Points[ p ];
+    int PWM_Result = PWM_Build( PWM_Spare, PWM_Active.PWM_Channels, PWM_Points, PWM_Records.data( ) );
+    this->PWM_SwapEnd( PWM_Result > 0 );
+    return PWM_Result;
+}
+
+/**
+ \fn public function int PWM_Convert( const float* Throttles, int* Duties, int Count ) const
+ \brief Converts the throttles of channels 0 - Count - 1 to duties in ns, each clamped to its channel's range. A
+ throttle below 0 or NaN counts as 0, one above 1 as 1. Lock-free.
+ \param const <float>* Throttles
+ \param <int>* Duties
+ \param <int> Count
+ \return <int> -1 more throttles than channels, 1 success.
+ */
+int BBBPWMCalibration::PWM_Convert( const float* Throttles, int* Duties, int Count ) const {
+    int PWM_Table = this->PWM_Enter( );
+    const BBBPWMCalTable& PWM_Active = this->PWM_Tables[ PWM_Table ];
+    if( Count < 0 || Count > PWM_Active.PWM_Channels ) {
+        this->PWM_Leave( PWM_Table );
+        cerr << "Error - BBBPWMCalibration::PWM_Convert( ) has curves for " << PWM_Active.PWM_Channels << " channels" << endl;
+        return -1;
+    }
+    for( int c = PWM_ConvertVector( PWM_Active, Throttles, Duties, Count ); c < Count; c++ )
+        Duties[ c ] = PWM_ConvertChannel( PWM_Active, c, Throttles[ c ] );
+    this->PWM_Leave( PWM_Table );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_ConvertScalar( const float* Throttles, int* Duties, int Count ) const
+ \brief PWM_Convert( ) one channel at a time, the path builds without SSE2 take. Lock-free.
+ \param const <float>* Throttles
+ \param <int>* Duties
+ \param <int> Count
+ \return <int> -1 more throttles than channels, 1 success.
+ */
+int BBBPWMCalibration::PWM_ConvertScalar( const float* Throttles, int* Duties, int Count ) const {
+    int PWM_Table = this->PWM_Enter( );
+    const BBBPWMCalTable& PWM_Active = this->PWM_Tables[ PWM_Table ];
+    if( Count < 0 || Count > PWM_Active.PWM_Channels ) {
+        this->PWM_Leave( PWM_Table );
+        cerr << "Error - BBBPWMCalibration::PWM_ConvertScalar( ) has curves for " << PWM_Active.PWM_Channels << " channels" << endl;
+        return -1;
+    }
+    for( int c = 0; c < Count; c++ )
+        Duties[ c ] = PWM_ConvertChannel( PWM_Active, c, Throttles[ c ] );
+    this->PWM_Leave( PWM_Table );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_ConvertOne( int Channel, float Throttle ) const
+ \brief Converts one channel's throttle. Lock-free.
+ \param <int> Channel
+ \param <float> Throttle
+ \return <int> -1 no such channel, otherwise the duty in ns.
+ */
+int BBBPWMCalibration::PWM_ConvertOne( int Channel, float Throttle ) const {
+    int PWM_Table = this->PWM_Enter( );
+    const BBBPWMCalTable& PWM_Active = this->PWM_Tables[ PWM_Table ];
+    int PWM_Duty = Channel >= 0 && Channel < PWM_Active.PWM_Channels ? PWM_ConvertChannel( PWM_Active, Channel, Throttle ) : -1;
+    this->PWM_Leave( PWM_Table );
+    if( PWM_Duty < 0 )
+        cerr << "Error - BBBPWMCalibration::PWM_ConvertOne( ) has no channel " << Channel << endl;
+    return PWM_Duty;
+}
+
+/**
+ \fn public function int PWM_GetChannelCount( void ) const
+ \brief Returns the number of channels with a curve, 0 until one is loaded.
+ \param <void>
+ \return <int> channels
+ */
+int BBBPWMCalibration::PWM_GetChannelCount( void ) const {
+    int PWM_Table = this->PWM_Enter( );
+    int PWM_Channels = this->PWM_Tables[ PWM_Table ].PWM_Channels;
+    this->PWM_Leave( PWM_Table );
+    return PWM_Channels;
+}
+
+/**
+ \fn public function int PWM_GetPointCount( void ) const
+ \brief Returns the number of points per curve.
+ \param <void>
+ \return <int> points
+ */
+int BBBPWMCalibration::PWM_GetPointCount( void ) const {
+    int PWM_Table = this->PWM_Enter( );
+    int PWM_Points = this->PWM_Tables[ PWM_Table ].PWM_Points;
+    this->PWM_Leave( PWM_Table );
+    return PWM_Points;
+}
@@ -0,0 +1,224 @@
+//
+//  BBBPWMCalibration.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMCalibration_h
+#define BBBPWMCalibration_h
+
+#include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "BBBPWMDevice.h"
+
+#define PWM_CAL_MAGIC          "BBBPWMC1" //!< First 8 bytes of every calibration file.
+#define PWM_CAL_POINTS         17 //!< Points per curve PWM_Reset( ) gives, throttle 0, 1/16 ... 1.
+#define PWM_CAL_MAX_POINTS     256 //!< Most points per curve a file may hold.
+#define PWM_CAL_MAX_CHANNELS   1024 //!< Most channels a file may hold.
+
+using namespace std;
+
+/**
+ \brief Calibration file header. Followed by PWM_Channels records of int32_t : the lowest duty allowed in ns, the
+ highest, then PWM_Points duties in ns for evenly spaced throttles from 0 to 1. All fields are little endian.
+ */
+struct BBBPWMCalHeader {
+    char PWM_Magic[ 8 ]; //!< PWM_CAL_MAGIC, not terminated.
+    uint32_t PWM_Channels; //!< Records that follow.
+    uint32_t PWM_Points; //!< Curve points per record, 2 to PWM_CAL_MAX_POINTS.
+};
+
+/**
+ \brief One set of curves, never changed once a converter can see it. Curves are kept as a base and slope per segment
+ so that a conversion is one multiply-add.
+ */
+struct BBBPWMCalTable {
+    int PWM_Channels; //!< Channels with a curve.
+    int PWM_Points; //!< Points per curve.
+    float PWM_Segments; //!< PWM_Points - 1, what a throttle is scaled by.
+    float PWM_LastSegment; //!< PWM_Points - 2, highest segment index.
+    vector< float > PWM_Base; //!< Duty at the start of segment s of channel c, at c * ( PWM_Points - 1 ) + s.
+    vector< float > PWM_Slope; //!< Duty change across that segment.
+    vector< float > PWM_Low; //!< Per channel, lowest duty in ns.
+    vector< float > PWM_High; //!< Per channel, highest duty in ns.
+    vector< int32_t > PWM_Records; //!< The curves as given, in file layout, for PWM_Save( ) and PWM_SetCurve( ).
+};
+
+/*!
+ *  \brief     BBBPWMCalibration turns normalized throttles into duties through a measured curve per ESC.
+ *  \details   Each channel has a curve of evenly spaced points from throttle 0 to 1, interpolated linearly, and a duty
+ *             range its result is clamped to. PWM_Convert( ) converts a whole frame in one pass, four channels at a
+ *             time with SSE2 where the build has it and a scalar loop otherwise. Conversions are lock-free
+ *             and may come from any number of threads. PWM_Load( ), PWM_SetCurve( ) and PWM_Reset( ) build the new
+ *             curves aside and swap them in : a conversion in flight finishes on the curves it started with, and only
+ *             the caller of the next swap may have to wait for it. Throttle 0 is the slow end, so the default curve
+ *             runs from PWM_DUTY_HIGH down to PWM_DUTY_LOW. With a controller :
+ *             \code
+ *             BBBPWMCalibration Escs;
+ *             Escs.PWM_Load( "/etc/bbbpwm/escs.cal" );
+ *             Controller.PWM_SetCalibration( &Escs );
+ *             Controller.PWM_Start( );
+ *             float Throttles[ 4 ] = { 0.25f, 0.25f, 0.3f, 0.3f };
+ *             Controller.PWM_SetFrameThrottle( Throttles, 4 );
+ *             \endcode
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMCalibration {
+public:
+
+    /**
+     \fn public function int PWM_Reset( int Channels, int Points )
+     \brief Swaps in straight curves from PWM_DUTY_HIGH at throttle 0 to PWM_DUTY_LOW at 1 for Channels channels, clamped to the full range.
+     \param <int> Channels
+     \param <int> Points (0 for PWM_CAL_POINTS)
+     \return <int> -1 Channels or Points out of range, 1 success.
+     */
+    int PWM_Reset( int Channels, int Points );
+
+    /**
+     \fn public function int PWM_Load( const char* Path )
+     \brief Reads a calibration file and swaps in its curves, the ones in use stay if anything in it is wrong.
+     \param const <char>* Path
+     \return <int> -1 unreadable or invalid file (reported), 1 success.
+     */
+    int PWM_Load( const char* Path );
+
+    /**
+     \fn public function int PWM_Save( const char* Path ) const
+     \brief Writes the curves in use to a calibration file PWM_Load( ) reads back.
+     \param const <char>* Path
+     \return <int> -1 failure to write (reported), 1 success.
+     */
+    int PWM_Save( const char* Path ) const;
+
+    /**
+     \fn public function int PWM_SetCurve( int Channel, const int* Points, int Low, int High )
+     \brief Swaps in a new curve for one channel, the other channels keep theirs.
+     \param <int> Channel
+     \param const <int>* Points (PWM_GetPointCount( ) duties in ns, throttle 0 first)
+     \param <int> Low (lowest duty in ns)
+     \param <int> High (highest duty in ns)
+     \return <int> -1 no such channel or a duty out of range, 1 success.
+     */
+    int PWM_SetCurve( int Channel, const int* Points, int Low, int High );
+
+    /**
+     \fn public function int PWM_Convert( const float* Throttles, int* Duties, int Count ) const
+     \brief Converts the throttles of channels 0 - Count - 1 to duties in ns, each clamped to its channel's range. A
+     throttle below 0 or NaN counts as 0, one above 1 as 1. Lock-free.
+     \param const <float>* Throttles
+     \param <int>* Duties
+     \param <int> Count
+     \return <int> -1 more throttles than channels, 1 success.
+     */
+    int PWM_Convert( const float* Throttles, int* Duties, int Count ) const;
+
+    /**
+     \fn public function int PWM_ConvertScalar( const float* Throttles, int* Duties, int Count ) const
+     \brief PWM_Convert( ) one channel at a time, the path builds without SSE2 take. Lock-free.
+     \param const <float>* Throttles
+     \param <int>* Duties
+     \param <int> Count
+     \return <int> -1 more throttles than channels, 1 success.
+     */
+    int PWM_ConvertScalar( const float* Throttles, int* Duties, int Count ) const;
+
+    /**
+     \fn public function int PWM_ConvertOne( int Channel, float Throttle ) const
+     \brief Converts one channel's throttle. Lock-free.
+     \param <int> Channel
+     \param <float> Throttle
+     \return <int> -1 no such channel, otherwise the duty in ns.
+     */
+    int PWM_ConvertOne( int Channel, float Throttle ) const;
+
+    /**
+     \fn public function int PWM_GetChannelCount( void ) const
+     \brief Returns the number of channels with a curve, 0 until one is loaded.
+     \param <void>
+     \return <int> channels
+     */
+    int PWM_GetChannelCount( void ) const;
+
+    /**
+     \fn public function int PWM_GetPointCount( void ) const
+     \brief Returns the number of points per curve.
+     \param <void>
+     \return <int> points
+     */
+    int PWM_GetPointCount( void ) const;
+
+    /**
+     \brief BBBPWMCalibration : No channels until PWM_Reset( ) or PWM_Load( ).
+     \param <void>
+     */
+    BBBPWMCalibration( );
+
+    /**
+     \brief ~BBBPWMCalibration : Must not be called while a conversion is in flight.
+     */
+    ~BBBPWMCalibration( );
+
+private:
+
+    // Two tables : converters read the active one, a swap rebuilds the other once its last reader has left.
+    BBBPWMCalTable PWM_Tables[ 2 ]; //!< The tables.
+    alignas( PWM_CACHE_LINE ) atomic< int > PWM_Active; //!< Index of the table converters use.
+    alignas( PWM_CACHE_LINE ) mutable atomic< int > PWM_Readers[ 2 ]; //!< Conversions in flight on each table.
+    pthread_mutex_t PWM_SwapLock; //!< Serialises swaps, never taken by a conversion.
+
+    /**
+     \fn private function int PWM_Enter( void ) const
+     \brief Registers a conversion on the active table.
+     \param <void>
+     \return <int> index of the table, hand it to PWM_Leave( ).
+     */
+    int PWM_Enter( void ) const;
+
+    /**
+     \fn private function void PWM_Leave( int PWM_Table ) const
+     \brief Ends a conversion started with PWM_Enter( ).
+     \param <int> PWM_Table
+     \return <void>
+     */
+    void PWM_Leave( int PWM_Table ) const;
+
+    /**
+     \fn private function BBBPWMCalTable& PWM_SwapBegin( void )
+     \brief Takes the swap lock and waits out the conversions still on the inactive table, which is returned for rebuilding.
+     \param <void>
+     \return <BBBPWMCalTable>&
+     */
+    BBBPWMCalTable& PWM_SwapBegin( void );
+
+    /**
+     \fn private function void PWM_SwapEnd( bool PWM_Publish )
+     \brief Makes the table from PWM_SwapBegin( ) the active one if PWM_Publish, then releases the swap lock.
+     \param <bool> PWM_Publish
+     \return <void>
+     */
+    void PWM_SwapEnd( bool PWM_Publish );
+
+    /**
+     \fn private static function int PWM_Build( BBBPWMCalTable& PWM_Table, int PWM_Channels, int PWM_Points, const int32_t* PWM_Records )
+     \brief Fills a table from file-layout records (low, high, points), checking every duty.
+     \return <int> -1 a duty out of range (reported), 1 success.
+     */
+    static int PWM_Build( BBBPWMCalTable& PWM_Table, int PWM_Channels, int PWM_Points, const int32_t* PWM_Records );
+};
+
+#endif /* BBBPWMCalibration_h */
@@ -0,0 +1,180 @@
+//
+//  BBBPWMChannelTable.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMChannelTable.h"
+
+/**
+ \fn static function size_t PWM_LineBytes( size_t PWM_Bytes )
+ \brief Rounds a size up to whole cache lines so that the next array starts on a line of its own.
+ \param <size_t> PWM_Bytes
+ \return <size_t>
+ */
+static inline size_t PWM_LineBytes( size_t PWM_Bytes ) {
+    return ( PWM_Bytes + PWM_CACHE_LINE - 1 ) / PWM_CACHE_LINE * PWM_CACHE_LINE;
+}
+
+/**
+ \brief BBBPWMChannelTable : No channels until PWM_Resize( ).
+ \param <void>
+ */
+BBBPWMChannelTable::BBBPWMChannelTable( ) {
+    this->PWM_Target = NULL;
+    this->PWM_Duty = NULL;
+    this->PWM_DutySlew = NULL;
+    this->PWM_Dirty = NULL;
+    this->PWM_Stored = NULL;
+    this->PWM_Tripped = NULL;
+    this->PWM_Feeding.store( false, memory_order_relaxed );
+    this->PWM_DirtyWords = 0;
+    this->PWM_Channels = 0;
+    this->PWM_Capacity = 0;
+    this->PWM_Block = NULL;
+}
+
+/**
+ \brief ~BBBPWMChannelTable : Frees the arrays.
+ */
+BBBPWMChannelTable::~BBBPWMChannelTable( ) {
+    free( this->PWM_Block );
+}
+
+/**
+ \fn private function int PWM_Reserve( int PWM_Count )
+ \brief Reallocates the arrays for PWM_Count channels if they have less room, keeping the values of the channels
+ in use. Moves every array : nothing may read or write the table meanwhile.
+ \param <int> PWM_Count
+ \return <int> -1 out of memory (reported), 0 already room for PWM_Count, 1 arrays moved.
+ */
+int BBBPWMChannelTable::PWM_Reserve( int PWM_Count ) {
+    if( PWM_Count <= this->PWM_Capacity && this->PWM_Block != NULL )
+        return 0;
+    size_t PWM_Words = ( PWM_Count + 31 ) / 32;
+    size_t PWM_IntBytes = PWM_LineBytes( PWM_Count * sizeof( atomic< int > ) );
+    size_t PWM_WordBytes = PWM_LineBytes( PWM_Words * sizeof( atomic< uint32_t > ) );
+
+    // One spare line so that an empty table still gets a block of its own.
+    void* PWM_New = NULL;
+    if( posix_memalign( &PWM_New, PWM_CACHE_LINE, 3 * PWM_IntBytes + 3 * PWM_WordBytes + PWM_CACHE_LINE ) != 0 ) {
+        cerr << "Error : Unable to allocate the channel table for " << PWM_Count << " channels" << endl;
+        return -1;
+    }
+
+    // Targets, duties and slews each on lines of their own, the dirty, stored and tripped words after them.
+    char* PWM_At = ( char* ) PWM_New;
+    atomic< int >* PWM_Target = ( atomic< int >* ) PWM_At;
+    atomic< int >* PWM_Duty = ( atomic< int >* )( PWM_At + PWM_IntBytes );
+    atomic< int >* PWM_DutySlew = ( atomic< int >* )( PWM_At + 2 * PWM_IntBytes );
+    atomic< uint32_t >* PWM_Dirty = ( atomic< uint32_t >* )( PWM_At + 3 * PWM_IntBytes );
+    atomic< uint32_t >* PWM_Stored = ( atomic< uint32_t >* )( PWM_At + 3 * PWM_IntBytes + PWM_WordBytes );
+    atomic< uint32_t >* PWM_Tripped = ( atomic< uint32_t >* )( PWM_At + 3 * PWM_IntBytes + 2 * PWM_WordBytes );
+    for( int c = 0; c < PWM_Count; c++ ) {
+        bool PWM_Kept = c < this->PWM_Channels;
+        new( &PWM_Target[ c ] ) atomic< int >( PWM_Kept ? this->PWM_Target[ c ].load( memory_order_relaxed ) : 0 );
+        new( &PWM_Duty[ c ] ) atomic< int >( PWM_Kept ? this->PWM_Duty[ c ].load( memory_order_relaxed ) : 0 );
+        new( &PWM_DutySlew[ c ] ) atomic< int >( PWM_Kept ? this->PWM_DutySlew[ c ].load( memory_order_relaxed ) : 0 );
+    }
+    for( size_t w = 0; w < PWM_Words; w++ ) {
+        new( &PWM_Dirty[ w ] ) atomic< uint32_t >( w < this->PWM_DirtyWords ? this->PWM_Dirty[ w ].load( memory_order_relaxed ) : 0 );
+        new( &PWM_Stored[ w ] ) atomic< uint32_t >( w < this->PWM_DirtyWords ? this->PWM_Stored[ w ].load( memory_order_relaxed ) : 0 );
+        new( &PWM_Tripped[ w ] ) atomic< uint32_t >( w < this->PWM_DirtyWords ? this->PWM_Tripped[ w ].load( memory_order_relaxed ) : 0 );
+    }
+
+    free( this->PWM_Block );
+    this->PWM_Block = PWM_New;
+    this->PWM_Target = PWM_Target;
+    this->PWM_Duty = PWM_Duty;
+    this->PWM_DutySlew = PWM_DutySlew;
+    this->PWM_Dirty = PWM_Dirty;
+    this->PWM_Stored = PWM_Stored;
+    this->PWM_Tripped = PWM_Tripped;
+    this->PWM_Capacity = PWM_Count;
+    return 1;
+}
+
+/**
+ \fn private function int PWM_Resize( int PWM_Count )
+ \brief Sets the number of channels in use, clearing the channels that come into use. Within PWM_Capacity nothing
+ moves, so other threads may keep using the channels below both counts, past it the arrays are reallocated as by
+ PWM_Reserve( ).
+ \param <int> PWM_Count
+ \return <int> -1 out of memory (reported), 0 resized in place, 1 arrays moved.
+ */
+int BBBPWMChannelTable::PWM_Resize( int PWM_Count ) {
+    if( PWM_Count < 0 )
+        PWM_Count = 0;
+    int PWM_Moved = this->PWM_Reserve( PWM_Count );
+    if( PWM_Moved < 0 )
+        return -1;
+    for( int c = this->PWM_Channels; c < PWM_Count; c++ ) {
+        this->PWM_Target[ c ].store( 0, memory_order_relaxed );
+        this->PWM_Duty[ c ].store( 0, memory_order_relaxed );
+        this->PWM_DutySlew[ c ].store( 0, memory_order_relaxed );
+    }
+    // Bits of the channels leaving or coming into use are cleared, those of the channels below both counts are left alone.
+    size_t PWM_Words = ( PWM_Count + 31 ) / 32;
+    int PWM_Low = PWM_Count < this->PWM_Channels ? PWM_Count : this->PWM_Channels;
+    for( size_t w = PWM_Low / 32; w < ( size_t )( this->PWM_Capacity + 31 ) / 32; w++ ) {
+        uint32_t PWM_Keep = w == ( size_t ) PWM_Low / 32 ? ( 1u << ( PWM_Low % 32 ) ) - 1 : 0;
+        this->PWM_Dirty[ w ].fetch_and( PWM_Keep, memory_order_relaxed );
+        this->PWM_Stored[ w ].fetch_and( PWM_Keep, memory_order_relaxed );
+        this->PWM_Tripped[ w ].fetch_and( PWM_Keep, memory_order_relaxed );
+    }
+    this->PWM_DirtyWords = PWM_Words;
+    this->PWM_Channels = PWM_Count;
+    return PWM_Moved;
+}
+
+/**
+ \fn public function int PWM_GetChannelCount( void ) const
+ \brief Returns the number of channels in the table.
+ \param <void>
+ \return <int> channels
+ */
+int BBBPWMChannelTable::PWM_GetChannelCount( void ) const {
+    return this->PWM_Channels;
+}
+
+/**
+ \fn public function int PWM_GetCapacity( void ) const
+ \brief Returns the number of channels the arrays have room for, the table can grow to it without moving.
+ \param <void>
+ \return <int> channels
+ */
+int BBBPWMChannelTable::PWM_GetCapacity( void ) const {
+    return this->PWM_Capacity;
+}
+
+/**
+ \fn public function int PWM_GetDuties( int* Duties, int Count ) const
+ \brief Copies the duty the kernel holds for channels 0 - Count - 1, reading one array front to back. Lock-free.
+ \param <int>* Duties
+ \param <int> Count
+ \return <int> -1 more duties than channels, 1 success.
+ */
+int BBBPWMChannelTable::PWM_GetDuties( int* Duties, int Count ) const {
+    if( Count < 0 || Count > this->PWM_Channels )
+        return -1;
+    for( int c = 0; c < Count; c++ )
+        Duties[ c ] = this->PWM_Duty[ c ].load( memory_order_relaxed );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_GetTargets( int* Targets, int Count ) const
+ \brief Copies the latest requested duty of channels 0 - Count - 1. Lock-free.
+ \param <int>* Targets
+ \param <int> Count
+ \return <int> -1 more targets than channels, 1 success.
+ */
+int BBBPWMChannelTable::PWM_GetTargets( int* Targets, int Count ) const {
+    if( Count < 0 || Count > this->PWM_Channels )
+        return -1;
+    for( int c = 0; c < Count; c++ )
+        Targets[ c ] = this->PWM_Target[ c ].load( memory_order_acquire );
+    return 1;
+}
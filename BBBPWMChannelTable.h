@@ -0,0 +1,131 @@
+//
+//  BBBPWMChannelTable.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMChannelTable_h
+#define BBBPWMChannelTable_h
+
+#include <iostream>
+#include <atomic>
+#include <new>
+#include <cstring>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define PWM_CACHE_LINE         64 //!< Cortex-A8 and x86 L1 line size, keeps state shared between the caller and the writer thread apart.
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMChannelTable holds the hot state of a set of channels as a structure of arrays.
+ *  \details   Every value a target update or a writer pass touches per channel lives here, one array per field, each
+ *             array starting on its own cache line : the requested duty (stored by callers), the duty the kernel holds
+ *             (stored by the writer), the duty slew, one dirty bit per channel, one bit per channel given a new duty target, the failsafe's feed, and one bit per
+ *             channel the failsafe holds tripped. Sixteen channels share a line, so a
+ *             writer pass or a frame over many channels reads a handful of lines instead of a few per BBBPWMDevice,
+ *             and callers never write a line the writer writes. Configuration, paths, descriptors and statistics stay
+ *             in the devices and their backends. A device starts with a table of its own, BBBPWMController::
+ *             PWM_AddDevice( ) moves it into the controller's. The table is shared : a device keeps it alive, so a
+ *             device may outlive its controller.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMChannelTable {
+public:
+
+    /**
+     \fn public function int PWM_GetChannelCount( void ) const
+     \brief Returns the number of channels in the table.
+     \param <void>
+     \return <int> channels
+     */
+    int PWM_GetChannelCount( void ) const;
+
+    /**
+     \fn public function int PWM_GetCapacity( void ) const
+     \brief Returns the number of channels the arrays have room for, the table can grow to it without moving.
+     \param <void>
+     \return <int> channels
+     */
+    int PWM_GetCapacity( void ) const;
+
+    /**
+     \fn public function int PWM_GetDuties( int* Duties, int Count ) const
+     \brief Copies the duty the kernel holds for channels 0 - Count - 1, reading one array front to back. Lock-free.
+     \param <int>* Duties
+     \param <int> Count
+     \return <int> -1 more duties than channels, 1 success.
+     */
+    int PWM_GetDuties( int* Duties, int Count ) const;
+
+    /**
+     \fn public function int PWM_GetTargets( int* Targets, int Count ) const
+     \brief Copies the latest requested duty of channels 0 - Count - 1. Lock-free.
+     \param <int>* Targets
+     \param <int> Count
+     \return <int> -1 more targets than channels, 1 success.
+     */
+    int PWM_GetTargets( int* Targets, int Count ) const;
+
+    /**
+     \brief BBBPWMChannelTable : No channels until PWM_Resize( ).
+     \param <void>
+     */
+    BBBPWMChannelTable( );
+
+    /**
+     \brief ~BBBPWMChannelTable : Frees the arrays.
+     */
+    ~BBBPWMChannelTable( );
+
+protected:
+
+    template< class PWM_Backend > friend class BBBPWMBasicController;
+    template< class PWM_Backend > friend class BBBPWMBasicDevice;
+    template< class PWM_Backend > friend class BBBPWMServer;
+    template< class PWM_Backend > friend class BBBPWMFailsafe;
+
+    atomic< int >* PWM_Target; //!< Per channel, latest requested duty, stored by callers with release ordering.
+    atomic< int >* PWM_Duty; //!< Per channel, last clamped duty handed to the kernel, stored by the writer only.
+    atomic< int >* PWM_DutySlew; //!< Per channel, max duty change per tick in ns, 0 = unlimited.
+    atomic< uint32_t >* PWM_Dirty; //!< One bit per channel with a new target, set by callers and swapped out by the writer.
+    atomic< uint32_t >* PWM_Stored; //!< One bit per channel given a new duty target, only set while PWM_Feeding, swapped out by the failsafe.
+    atomic< uint32_t >* PWM_Tripped; //!< One bit per channel held at its failsafe, stored by the failsafe on the writer thread, read lock-free.
+    atomic< bool > PWM_Feeding; //!< A failsafe watches these channels, set by BBBPWMController::PWM_Start( ).
+    size_t PWM_DirtyWords; //!< Words in PWM_Dirty in use, those of the first PWM_Channels channels.
+    int PWM_Channels; //!< Channels in use.
+    int PWM_Capacity; //!< Channels every array has room for.
+    void* PWM_Block; //!< The single allocation all arrays live in.
+
+    /**
+     \fn private function int PWM_Reserve( int PWM_Count )
+     \brief Reallocates the arrays for PWM_Count channels if they have less room, keeping the values of the channels
+     in use. Moves every array : nothing may read or write the table meanwhile.
+     \param <int> PWM_Count
+     \return <int> -1 out of memory (reported), 0 already room for PWM_Count, 1 arrays moved.
+     */
+    int PWM_Reserve( int PWM_Count );
+
+    /**
+     \fn private function int PWM_Resize( int PWM_Count )
+     \brief Sets the number of channels in use, clearing the channels that come into use. Within PWM_Capacity nothing
+     moves, so other threads may keep using the channels below both counts, past it the arrays are reallocated as by
+     PWM_Reserve( ).
+     \param <int> PWM_Count
+     \return <int> -1 out of memory (reported), 0 resized in place, 1 arrays moved.
+     */
+    int PWM_Resize( int PWM_Count );
+
+private:
+
+    BBBPWMChannelTable( const BBBPWMChannelTable& );
+    BBBPWMChannelTable& operator=( const BBBPWMChannelTable& );
+};
+
+#endif /* BBBPWMChannelTable_h */
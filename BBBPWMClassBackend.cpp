@@ -0,0 +1,477 @@
+//
+//  BBBPWMClassBackend.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMClassBackend.h"
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PWM_CLASS_EPWM_ADDR    0x48300200 //!< ePWM0's registers, the name of its platform device (48300200.pwm).
+#define PWM_CLASS_ECAP_ADDR    0x48300100 //!< eCAP0's registers, the name of its platform device (48300100.pwm).
+#define PWM_CLASS_STRIDE       0x2000 //!< Distance between two PWM subsystems, ePWM1 is 48302200.pwm.
+#define PWM_CLASS_ECAPS        3 //!< Controllers below this index are ePWM modules, the rest eCAP.
+
+static const char* const PWM_AttrFiles[ PWM_ATTRS ] = { "/duty_cycle", "/period", "/enable" }; //!< Indexed by PWM_Attribute.
+
+// pwmchip<N> of each controller, found once per sysfs root and shared by every backend of the process.
+static pthread_mutex_t PWM_ChipLock = PTHREAD_MUTEX_INITIALIZER;
+static int PWM_Chips[ PWM_CLASS_CHIPS ] = { -1, -1, -1, -1, -1, -1 };
+static string PWM_ChipRoot;
+
+/**
+ \brief Milliseconds on the monotonic clock.
+ */
+static int64_t PWM_NowMs( void ) {
+    struct timespec PWM_Now;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+    return ( int64_t ) PWM_Now.tv_sec * 1000 + PWM_Now.tv_nsec / 1000000;
+}
+
+/**
+ \brief BBBPWMClassBackend : Nothing is opened until PWM_Attach( ).
+ \param <void>
+ */
+BBBPWMClassBackend::BBBPWMClassBackend( ) {
+    for( int a = 0; a < PWM_ATTRS; a++ ) {
+        this->PWM_FD[ a ] = -1;
+        this->PWM_Value[ a ] = 0;
+    }
+    this->PWM_WantedDuty = 0;
+    this->PWM_Chip = -1;
+    this->PWM_Channel = 0;
+    this->PWM_TimeoutMs = PWM_CLASS_TIMEOUT_MS;
+    this->PWM_Pin = NULL;
+    this->PWM_SysfsRoot = SYSFS_ROOT;
+}
+
+/**
+ \brief ~BBBPWMClassBackend : Closes the duty_cycle, period and enable files.
+ */
+BBBPWMClassBackend::~BBBPWMClassBackend( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_SetRoot( const string& Root )
+ \brief Sets the sysfs mount point used to build every path, must be called before PWM_Attach( ). Defaults to SYSFS_ROOT.
+ \param const <string>& Root
+ \return <void>
+ */
+void BBBPWMClassBackend::PWM_SetRoot( const string& Root ) {
+    this->PWM_SysfsRoot = Root;
+}
+
+/**
+ \fn public function string PWM_GetRoot( void ) const
+ \brief Returns the sysfs mount point.
+ \param <void>
+ \return <string> this->PWM_SysfsRoot
+ */
+string BBBPWMClassBackend::PWM_GetRoot( void ) const {
+    return this->PWM_SysfsRoot;
+}
+
+/**
+ \fn public function void PWM_SetTimeout( int Milliseconds )
+ \brief Sets how long PWM_Attach( ) waits for an exported channel's attributes to open. Defaults to PWM_CLASS_TIMEOUT_MS.
+ \param <int> Milliseconds
+ \return <void>
+ */
+void BBBPWMClassBackend::PWM_SetTimeout( int Milliseconds ) {
+    this->PWM_TimeoutMs = Milliseconds;
+}
+
+/**
+ \fn public function int PWM_Attach( int Block, int Pin )
+ \brief Finds the pin's pwmchip and channel, exports the channel if it is not yet and opens duty_cycle, period and enable.
+ A channel still at period 0 (never configured) is given PWM_CLASS_PERIOD and PWM_CLASS_DUTY.
+ \param <int> Block
+ \param <int> Pin
+ \return <int> 0 failure (the critical error has been reported), 1 success.
+ */
+int BBBPWMClassBackend::PWM_Attach( int Block, int Pin ) {
+    this->PWM_Close( );
+    this->PWM_Pin = BBBPWMPins::PWM_Find( Block, Pin );
+    if( this->PWM_Pin == NULL ) {
+        cerr << "Critical Error 5 : Unable to setup PWM on your BeagleBone Black, P" << Block << "_" << Pin << " is not a PWM pin." << endl;
+        return 0;
+    }
+
+    // eCAP outputs have a single channel, PWM_Channel holds which eCAP it is.
+    bool PWM_Ecap = this->PWM_Pin->PWM_Module < 0;
+    this->PWM_Chip = PWM_FindChip( this->PWM_SysfsRoot, PWM_Ecap ? PWM_CLASS_ECAPS + this->PWM_Pin->PWM_Channel : this->PWM_Pin->PWM_Module );
+    this->PWM_Channel = PWM_Ecap ? 0 : this->PWM_Pin->PWM_Channel;
+    if( this->PWM_Chip < 0 ) {
+        cerr << "Critical Error 1 : Unable to setup PWM on your BeagleBone Black, no pwmchip drives P" << Block << "_" << Pin << " in " << this->PWM_SysfsRoot << PWM_CLASS_DIR << endl;
+        return 0;
+    }
+
+    this->PWM_SetPinmux( );
+    if( this->PWM_Export( ) < 0 ) {
+        cerr << "Critical Error 3 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export pwm" << this->PWM_Channel << " of " << PWM_CLASS_CHIP << this->PWM_Chip << endl;
+        return 0;
+    }
+
+    int PWM_Now;
+    if( this->PWM_Read( PWM_ATTR_DUTY, PWM_Now ) <= 0 || this->PWM_Read( PWM_ATTR_PERIOD, PWM_Now ) <= 0 || this->PWM_Read( PWM_ATTR_RUN, PWM_Now ) <= 0
+        // A fresh export is period 0 and cannot be enabled, start it like an exported pwm_test_ pin that is not running.
+        || ( this->PWM_Value[ PWM_ATTR_PERIOD ] == 0
+             && ( this->PWM_Store( PWM_ATTR_PERIOD, PWM_CLASS_PERIOD ) <= 0 || this->PWM_Store( PWM_ATTR_DUTY, PWM_CLASS_DUTY ) <= 0 ) ) ) {
+        cerr << "Critical Error 4 : Unable to use PWM on your BeagleBone Black, sys error - unable to load PWM values on initialisation." << endl;
+        this->PWM_Close( );
+        return 0;
+    }
+    this->PWM_WantedDuty = this->PWM_Value[ PWM_ATTR_DUTY ];
+    return 1;
+}
+
+/**
+ \fn public static function int PWM_AttachAll( const vector< BBBPWMClassBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+ \brief Exporting never waits on another pin and the pwmchips are read once either way, each output is attached in turn.
+ \param const <vector<BBBPWMClassBackend*>>& Outputs
+ \param const <vector<int>>& Blocks
+ \param const <vector<int>>& Pins
+ \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+ \return <int> number of outputs attached.
+ */
+int BBBPWMClassBackend::PWM_AttachAll( const vector< BBBPWMClassBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+    Status.assign( Outputs.size( ), 0 );
+    int PWM_Attached = 0;
+    for( size_t d = 0; d < Outputs.size( ); d++ )
+        PWM_Attached += Status[ d ] = Outputs[ d ]->PWM_Attach( Blocks[ d ], Pins[ d ] );
+    return PWM_Attached;
+}
+
+/**
+ \fn private static function int PWM_FindChip( const string& Root, int Controller )
+ \brief Returns the pwmchip number of a PWM controller, reading PWM_CLASS_DIR only when it has not been found before.
+ \param const <string>& Root
+ \param <int> Controller (0 - 2 ePWM0 - 2, 3 - 5 eCAP0 - 2)
+ \return <int> -1 no such pwmchip, >= 0 <N> of pwmchip<N>.
+ */
+int BBBPWMClassBackend::PWM_FindChip( const string& Root, int Controller ) {
+    pthread_mutex_lock( &PWM_ChipLock );
+    if( PWM_ChipRoot != Root ) {
+        for( int c = 0; c < PWM_CLASS_CHIPS; c++ )
+            PWM_Chips[ c ] = -1;
+        PWM_ChipRoot = Root;
+    }
+
+    if( PWM_Chips[ Controller ] < 0 ) {
+        // One pass resolves every controller, pwmchip numbers depend on probe order so the device link is what identifies them.
+        string PWM_ClassDir = Root + PWM_CLASS_DIR;
+        DIR* PWM_Dir = opendir( PWM_ClassDir.c_str( ) );
+        if( PWM_Dir == NULL )
+            cerr << "Unable to read folder : " << PWM_ClassDir << " | Error = " << strerror( errno ) << endl;
+        struct dirent* PWM_Entry;
+        while( PWM_Dir != NULL && ( PWM_Entry = readdir( PWM_Dir ) ) != NULL ) {
+            int PWM_Number;
+            if( strncmp( PWM_Entry->d_name, PWM_CLASS_CHIP, sizeof( PWM_CLASS_CHIP ) - 1 ) != 0
+                || !PWM_ParseDecimal( PWM_Entry->d_name + sizeof( PWM_CLASS_CHIP ) - 1, ( int ) strlen( PWM_Entry->d_name + sizeof( PWM_CLASS_CHIP ) - 1 ), PWM_Number ) )
+                continue;
+            char PWM_Link[ MAX_BUF ];
+            ssize_t PWM_LinkLen = readlink( ( PWM_ClassDir + PWM_Entry->d_name + "/device" ).c_str( ), PWM_Link, sizeof( PWM_Link ) - 1 );
+            if( PWM_LinkLen <= 0 )
+                continue;
+            PWM_Link[ PWM_LinkLen ] = '\0';
+            const char* PWM_Name = strrchr( PWM_Link, '/' );
+            char* PWM_End;
+            unsigned long PWM_Addr = strtoul( PWM_Name == NULL ? PWM_Link : PWM_Name + 1, &PWM_End, 16 );
+            if( *PWM_End != '.' )
+                continue;
+            for( int c = 0; c < PWM_CLASS_CHIPS; c++ ) {
+                unsigned long PWM_Want = c < PWM_CLASS_ECAPS ? PWM_CLASS_EPWM_ADDR + c * PWM_CLASS_STRIDE : PWM_CLASS_ECAP_ADDR + ( c - PWM_CLASS_ECAPS ) * PWM_CLASS_STRIDE;
+                if( PWM_Addr == PWM_Want )
+                    PWM_Chips[ c ] = PWM_Number;
+            }
+        }
+        if( PWM_Dir != NULL )
+            closedir( PWM_Dir );
+    }
+
+    int PWM_Chip = PWM_Chips[ Controller ];
+    pthread_mutex_unlock( &PWM_ChipLock );
+    return PWM_Chip;
+}
+
+/**
+ \fn public static function void PWM_ForgetChips( void )
+ \brief Drops the pwmchip numbers found so far, the next PWM_Attach( ) reads PWM_CLASS_DIR again (e.g. after a driver was reloaded).
+ \param <void>
+ \return <void>
+ */
+void BBBPWMClassBackend::PWM_ForgetChips( void ) {
+    pthread_mutex_lock( &PWM_ChipLock );
+    PWM_ChipRoot.clear( );
+    pthread_mutex_unlock( &PWM_ChipLock );
+}
+
+/**
+ \fn private function void PWM_SetPinmux( void )
+ \brief Switches the pin to its PWM mode through its cape-universal pinmux helper, if the image has one.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMClassBackend::PWM_SetPinmux( void ) {
+    string PWM_State = this->PWM_SysfsRoot + PWM_CLASS_PINMUX_DIR + ( this->PWM_Pin->PWM_Overlay.PWM_Text + sizeof( PWM_PIN_OVERLAY_PREFIX ) - 1 ) + "_pinmux/state";
+    int PWM_StateFD = open( PWM_State.c_str( ), O_WRONLY | O_CLOEXEC );
+    // No helper : the pin is muxed by the device tree (or an overlay loaded at boot) and there is nothing to do.
+    if( PWM_StateFD < 0 )
+        return;
+    if( write( PWM_StateFD, PWM_CLASS_PINMUX_MODE, sizeof( PWM_CLASS_PINMUX_MODE ) - 1 ) != sizeof( PWM_CLASS_PINMUX_MODE ) - 1 )
+        cerr << "Warning : unable to set " << PWM_State << " to " << PWM_CLASS_PINMUX_MODE << ", check the pin with config-pin | Error = " << strerror( errno ) << endl;
+    close( PWM_StateFD );
+}
+
+/**
+ \fn private function int PWM_Export( void )
+ \brief Exports the channel unless its pwm<M> folder exists, then opens the three attributes, retrying until PWM_TimeoutMs.
+ \param <void>
+ \return <int> -1 failed (reported), 1 success.
+ */
+int BBBPWMClassBackend::PWM_Export( void ) {
+    char PWM_Path[ MAX_BUF ];
+    if( this->PWM_BuildPath( true, "", PWM_Path ) < 0 )
+        return -1;
+    if( access( PWM_Path, F_OK ) != 0 ) {
+        char PWM_ChannelBuffer[ PWM_DECIMAL_MAX ];
+        int PWM_ChannelLen = PWM_FormatDecimal( this->PWM_Channel, PWM_ChannelBuffer );
+        this->PWM_BuildPath( false, "/export", PWM_Path );
+        int PWM_ExportFD = open( PWM_Path, O_WRONLY | O_CLOEXEC );
+        // EBUSY : exported in the meantime (another process), which is all we wanted.
+        if( PWM_ExportFD < 0 || ( write( PWM_ExportFD, PWM_ChannelBuffer, PWM_ChannelLen ) != PWM_ChannelLen && errno != EBUSY ) ) {
+            cerr << "Error writing to file : " << PWM_Path << " | Error = " << strerror( errno ) << endl;
+            if( PWM_ExportFD >= 0 )
+                close( PWM_ExportFD );
+            return -1;
+        }
+        close( PWM_ExportFD );
+    }
+
+    // The kernel creates pwm<M> within the export write, udev hands its attributes to the pwm group a little later.
+    int64_t PWM_Deadline = PWM_NowMs( ) + this->PWM_TimeoutMs;
+    for( int a = 0; a < PWM_ATTRS; a++ ) {
+        while( this->PWM_OpenAttr( ( PWM_Attribute ) a ) < 0 ) {
+            if( ( errno != EACCES && errno != ENOENT ) || PWM_NowMs( ) >= PWM_Deadline ) {
+                cerr << "Error opening file : " << this->PWM_Describe( ( PWM_Attribute ) a ) << " | Error = " << strerror( errno ) << endl;
+                this->PWM_Close( );
+                return -1;
+            }
+            usleep( PWM_CLASS_POLL_MS * 1000 );
+        }
+    }
+    return 1;
+}
+
+/**
+ \fn private function int PWM_OpenAttr( PWM_Attribute Attr )
+ \brief Returns the persistent descriptor of an attribute, (re)opening it first if it is closed.
+ \param <PWM_Attribute> Attr
+ \return <int> -1 failed to open (errno set), >= 0 the descriptor.
+ */
+int BBBPWMClassBackend::PWM_OpenAttr( PWM_Attribute Attr ) {
+    int& PWM_FD = this->PWM_FD[ Attr ];
+    if( PWM_FD >= 0 )
+        return PWM_FD;
+    char PWM_Path[ MAX_BUF ];
+    if( this->PWM_BuildPath( true, PWM_AttrFiles[ Attr ], PWM_Path ) >= 0 )
+        PWM_FD = open( PWM_Path, O_RDWR | O_CLOEXEC );
+    return PWM_FD;
+}
+
+/**
+ \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+ \brief Reads a decimal value from one of the persistent descriptors with pread( ).
+ \param <PWM_Attribute> Attr
+ \param <int>& Value (only written on success)
+ \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+ */
+int BBBPWMClassBackend::PWM_Read( PWM_Attribute Attr, int& Value ) {
+    char PWM_ValueBuffer[ 32 ];
+    ssize_t PWM_Len = pread( this->PWM_FD[ Attr ], PWM_ValueBuffer, sizeof( PWM_ValueBuffer ), 0 );
+    if( PWM_Len < 0 ) {
+        cerr << "Unable to read from file : " << this->PWM_Describe( Attr ) << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    if( !PWM_ParseDecimal( PWM_ValueBuffer, ( int ) PWM_Len, Value ) ) {
+        cerr << "Unable to read from file : " << this->PWM_Describe( Attr ) << " | Error = not a decimal value : '" << string( PWM_ValueBuffer, PWM_Len ) << "'" << endl;
+        return 0;
+    }
+    this->PWM_Value[ Attr ] = Value;
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+ \brief Writes a value with pwrite( ), duty_cycle and period in whichever order keeps the duty within the period.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> -1 failed to open, 0 failed to write (errno set, the descriptor is dropped on EBADF or ENODEV), 1 success.
+ */
+int BBBPWMClassBackend::PWM_Write( PWM_Attribute Attr, int Value ) {
+    if( Attr == PWM_ATTR_RUN )
+        return this->PWM_Store( Attr, Value );
+
+    if( Attr == PWM_ATTR_DUTY ) {
+        this->PWM_WantedDuty = Value;
+        // Longer than the period : held until the period that goes with it arrives, the output keeps its last valid duty.
+        if( Value > this->PWM_Value[ PWM_ATTR_PERIOD ] )
+            return 1;
+        return this->PWM_Store( PWM_ATTR_DUTY, Value );
+    }
+
+    // Shorter than the duty in force : the duty has to come down first, to the wanted one if it fits or else to the whole period.
+    int PWM_Ret;
+    if( Value < this->PWM_Value[ PWM_ATTR_DUTY ] ) {
+        if( ( PWM_Ret = this->PWM_Store( PWM_ATTR_DUTY, this->PWM_WantedDuty <= Value ? this->PWM_WantedDuty : Value ) ) <= 0 )
+            return PWM_Ret;
+        return this->PWM_Store( PWM_ATTR_PERIOD, Value );
+    }
+    if( ( PWM_Ret = this->PWM_Store( PWM_ATTR_PERIOD, Value ) ) <= 0 )
+        return PWM_Ret;
+    // A duty held back by the old period now fits.
+    if( this->PWM_WantedDuty != this->PWM_Value[ PWM_ATTR_DUTY ] && this->PWM_WantedDuty <= Value )
+        return this->PWM_Store( PWM_ATTR_DUTY, this->PWM_WantedDuty );
+    return 1;
+}
+
+/**
+ \fn private function int PWM_Store( PWM_Attribute Attr, int Value )
+ \brief Writes one attribute and records the value the kernel now holds.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> -1 failed to open, 0 failed to write (errno set), 1 success.
+ */
+int BBBPWMClassBackend::PWM_Store( PWM_Attribute Attr, int Value ) {
+    int& PWM_FD = this->PWM_FD[ Attr ];
+    if( this->PWM_OpenAttr( Attr ) < 0 ) {
+        cerr << "Error opening file : " << this->PWM_Describe( Attr ) << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    char PWM_ValueBuffer[ PWM_DECIMAL_MAX ];
+    int PWM_ValueLen = PWM_FormatDecimal( Value, PWM_ValueBuffer );
+    ssize_t PWM_Wrote = pwrite( PWM_FD, PWM_ValueBuffer, PWM_ValueLen, 0 );
+    if( PWM_Wrote == PWM_ValueLen ) {
+        this->PWM_Value[ Attr ] = Value;
+        return 1;
+    }
+    if( PWM_Wrote >= 0 )
+        errno = EIO;
+    else if( errno == EBADF || errno == ENODEV ) {
+        // The channel was unexported underneath us, the next write reopens it.
+        int PWM_Errno = errno;
+        close( PWM_FD );
+        PWM_FD = -1;
+        errno = PWM_Errno;
+    }
+    return 0;
+}
+
+/**
+ \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+ \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> 0 no failure.
+ */
+int BBBPWMClassBackend::PWM_TakeError( PWM_Attribute Attr, int& Value ) {
+    ( void ) Attr;
+    ( void ) Value;
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchBegin( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMClassBackend::PWM_BatchBegin( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchEnd( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMClassBackend::PWM_BatchEnd( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchFD( void )
+ \brief No completions to wait for.
+ \param <void>
+ \return <int> -1
+ */
+int BBBPWMClassBackend::PWM_BatchFD( void ) {
+    return -1;
+}
+
+/**
+ \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+ \brief Returns the path of an attribute, for error messages. Built on demand, valid until the next call on the same thread.
+ \param <PWM_Attribute> Attr
+ \return const <char>*
+ */
+const char* BBBPWMClassBackend::PWM_Describe( PWM_Attribute Attr ) const {
+    static thread_local char PWM_Path[ MAX_BUF ];
+    int PWM_Errno = errno;
+    if( this->PWM_BuildPath( true, PWM_AttrFiles[ Attr ], PWM_Path ) < 0 )
+        strcpy( PWM_Path, PWM_AttrFiles[ Attr ] + 1 );
+    // Callers print strerror( errno ) right after.
+    errno = PWM_Errno;
+    return PWM_Path;
+}
+
+/**
+ \fn private function int PWM_BuildPath( bool PWM_InChannel, const char* PWM_Leaf, char* PWM_Path ) const
+ \brief Writes the path of the pin's pwmchip<N> folder, or of its pwm<M> folder, followed by PWM_Leaf (e.g. "/period").
+ \param <bool> PWM_InChannel
+ \param const <char>* PWM_Leaf
+ \param <char>* PWM_Path (MAX_BUF bytes)
+ \return <int> -1 the path does not fit (errno ENAMETOOLONG), >= 0 its length.
+ */
+int BBBPWMClassBackend::PWM_BuildPath( bool PWM_InChannel, const char* PWM_Leaf, char* PWM_Path ) const {
+    size_t PWM_Root = this->PWM_SysfsRoot.size( ), PWM_LeafLen = strlen( PWM_Leaf );
+    // Two decimals, the fixed parts and the terminator.
+    if( PWM_Root + sizeof( PWM_CLASS_DIR PWM_CLASS_CHIP "/pwm" ) + 2 * PWM_DECIMAL_MAX + PWM_LeafLen > MAX_BUF ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char* p = PWM_Path;
+    memcpy( p, this->PWM_SysfsRoot.data( ), PWM_Root );
+    p += PWM_Root;
+    memcpy( p, PWM_CLASS_DIR PWM_CLASS_CHIP, sizeof( PWM_CLASS_DIR PWM_CLASS_CHIP ) - 1 );
+    p += sizeof( PWM_CLASS_DIR PWM_CLASS_CHIP ) - 1;
+    p += PWM_FormatDecimal( this->PWM_Chip, p );
+    if( PWM_InChannel ) {
+        memcpy( p, "/pwm", 4 );
+        p += 4;
+        p += PWM_FormatDecimal( this->PWM_Channel, p );
+    }
+    memcpy( p, PWM_Leaf, PWM_LeafLen + 1 );
+    return ( int )( p - PWM_Path + PWM_LeafLen );
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes the attribute descriptors, the channel stays exported and keeps running.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMClassBackend::PWM_Close( void ) {
+    for( int a = 0; a < PWM_ATTRS; a++ ) {
+        if( this->PWM_FD[ a ] >= 0 ) close( this->PWM_FD[ a ] );
+        this->PWM_FD[ a ] = -1;
+    }
+}
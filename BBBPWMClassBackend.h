@@ -0,0 +1,253 @@
+//
+//  BBBPWMClassBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMClassBackend_h
+#define BBBPWMClassBackend_h
+
+#define PWM_CLASS_DIR          "/class/pwm/" //!< Generic PWM class (relative to the sysfs root), one pwmchip<N> folder per PWM controller.
+#define PWM_CLASS_CHIP         "pwmchip" //!< Beginning of a PWM controller's folder, followed by the number of its first channel.
+#define PWM_CLASS_PINMUX_DIR   "/devices/platform/ocp/ocp:" //!< cape-universal pinmux helpers (relative to the sysfs root), <dir>P9_14_pinmux/state.
+#define PWM_CLASS_PINMUX_MODE  "pwm" //!< Written to a pin's pinmux state, what config-pin P9_14 pwm does.
+#define PWM_CLASS_DUTY         700000 //!< Duty a freshly exported channel starts with (PWM_DUTY_HIGH).
+#define PWM_CLASS_PERIOD       1200000 //!< Period a freshly exported channel starts with (STARTUP).
+#define PWM_CLASS_TIMEOUT_MS   1000 //!< Default time allowed for an exported channel's attributes to become writable (udev sets their group).
+#define PWM_CLASS_POLL_MS      1 //!< Retry interval while waiting for them.
+#define PWM_CLASS_CHIPS        6 //!< ePWM0 - 2 and eCAP0 - 2, the PWM controllers of the BeagleBone Black.
+
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "BBBPWMBackend.h"
+#include "BBBPWMCodec.h"
+#include "BBBPWMPins.h"
+#include "BBBPWMSysfsBackend.h"
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMClassBackend drives one pin through the generic PWM class, /sys/class/pwm/pwmchip<N>/pwm<M>.
+ *  \details   This is the interface of every kernel since 4.x, where bone_capemgr.9, ocp.3 and pwm_test_ no longer
+ *             exist. No overlay is loaded and nothing sleeps : PWM_Attach( ) muxes the pin if a cape-universal pinmux
+ *             helper is there, exports the channel if needed and opens duty_cycle, period and enable once. The pwmchip
+ *             of each ePWM / eCAP module is found from its device link (e.g. ../48302200.pwm for ePWM1) in one pass
+ *             over PWM_CLASS_DIR and kept for the process, so only the first PWM_Attach( ) reads the folder.
+ *             The kernel rejects a duty_cycle above the period, which a device writing its new period and duty one
+ *             at a time would run into. PWM_Write( ) orders the two stores so that every step is valid, and holds back
+ *             a duty the current period cannot take until a period that can is written.
+ *             Use it through BBBPWMClassDevice and BBBPWMClassController.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMClassBackend {
+public:
+
+    /**
+     \fn public function int PWM_Attach( int Block, int Pin )
+     \brief Finds the pin's pwmchip and channel, exports the channel if it is not yet and opens duty_cycle, period and enable.
+     A channel still at period 0 (never configured) is given PWM_CLASS_PERIOD and PWM_CLASS_DUTY.
+     \param <int> Block
+     \param <int> Pin
+     \return <int> 0 failure (the critical error has been reported), 1 success.
+     */
+    int PWM_Attach( int Block, int Pin );
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMClassBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief Exporting never waits on another pin and the pwmchips are read once either way, each output is attached in turn.
+     \param const <vector<BBBPWMClassBackend*>>& Outputs
+     \param const <vector<int>>& Blocks
+     \param const <vector<int>>& Pins
+     \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+     \return <int> number of outputs attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMClassBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Reads a decimal value from one of the persistent descriptors with pread( ).
+     \param <PWM_Attribute> Attr
+     \param <int>& Value (only written on success)
+     \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Writes a value with pwrite( ), duty_cycle and period in whichever order keeps the duty within the period.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> -1 failed to open, 0 failed to write (errno set, the descriptor is dropped on EBADF or ENODEV), 1 success.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes the attribute descriptors, the channel stays exported and keeps running.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+     \brief Returns the path of an attribute, for error messages. Built on demand, valid until the next call on the same thread.
+     \param <PWM_Attribute> Attr
+     \return const <char>*
+     */
+    const char* PWM_Describe( PWM_Attribute Attr ) const;
+
+    /**
+     \fn public function void PWM_SetRoot( const string& Root )
+     \brief Sets the sysfs mount point used to build every path, must be called before PWM_Attach( ). Defaults to SYSFS_ROOT.
+     \param const <string>& Root
+     \return <void>
+     */
+    void PWM_SetRoot( const string& Root );
+
+    /**
+     \fn public function string PWM_GetRoot( void ) const
+     \brief Returns the sysfs mount point.
+     \param <void>
+     \return <string> this->PWM_SysfsRoot
+     */
+    string PWM_GetRoot( void ) const;
+
+    /**
+     \fn public function void PWM_SetTimeout( int Milliseconds )
+     \brief Sets how long PWM_Attach( ) waits for an exported channel's attributes to open. Defaults to PWM_CLASS_TIMEOUT_MS.
+     \param <int> Milliseconds
+     \return <void>
+     */
+    void PWM_SetTimeout( int Milliseconds );
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> 0 no failure.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchBegin( void );
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchEnd( void );
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief No completions to wait for.
+     \param <void>
+     \return <int> -1
+     */
+    static int PWM_BatchFD( void );
+
+    /**
+     \fn public static function void PWM_ForgetChips( void )
+     \brief Drops the pwmchip numbers found so far, the next PWM_Attach( ) reads PWM_CLASS_DIR again (e.g. after a driver was reloaded).
+     \param <void>
+     \return <void>
+     */
+    static void PWM_ForgetChips( void );
+
+    /**
+     \brief BBBPWMClassBackend : Nothing is opened until PWM_Attach( ).
+     \param <void>
+     */
+    BBBPWMClassBackend( );
+
+    /**
+     \brief ~BBBPWMClassBackend : Closes the duty_cycle, period and enable files.
+     */
+    ~BBBPWMClassBackend( );
+
+protected:
+
+    int PWM_FD[ PWM_ATTRS ]; //!< Persistent descriptors for duty_cycle, period and enable, -1 while closed.
+    int PWM_Value[ PWM_ATTRS ]; //!< Values the kernel holds, as last read or written.
+    int PWM_WantedDuty; //!< Duty last asked for, differs from PWM_Value[ PWM_ATTR_DUTY ] while it is held back.
+    int PWM_Chip; //!< <N> of the pin's pwmchip<N>, -1 until PWM_Attach( ).
+    int PWM_Channel; //!< <M> of its pwm<M>.
+    int PWM_TimeoutMs; //!< How long PWM_Attach( ) waits for the attributes.
+    const BBBPWMPinInfo* PWM_Pin; //!< BBBPWMPins entry, NULL until PWM_Attach( ).
+
+    string PWM_SysfsRoot; //!< Stores the sysfs mount point all paths are built from.
+
+    /**
+     \fn private static function int PWM_FindChip( const string& Root, int Controller )
+     \brief Returns the pwmchip number of a PWM controller, reading PWM_CLASS_DIR only when it has not been found before.
+     \param const <string>& Root
+     \param <int> Controller (0 - 2 ePWM0 - 2, 3 - 5 eCAP0 - 2)
+     \return <int> -1 no such pwmchip, >= 0 <N> of pwmchip<N>.
+     */
+    static int PWM_FindChip( const string& Root, int Controller );
+
+    /**
+     \fn private function void PWM_SetPinmux( void )
+     \brief Switches the pin to its PWM mode through its cape-universal pinmux helper, if the image has one.
+     \param <void>
+     \return <void>
+     */
+    void PWM_SetPinmux( void );
+
+    /**
+     \fn private function int PWM_Export( void )
+     \brief Exports the channel unless its pwm<M> folder exists, then opens the three attributes, retrying until PWM_TimeoutMs.
+     \param <void>
+     \return <int> -1 failed (reported), 1 success.
+     */
+    int PWM_Export( void );
+
+    /**
+     \fn private function int PWM_OpenAttr( PWM_Attribute Attr )
+     \brief Returns the persistent descriptor of an attribute, (re)opening it first if it is closed.
+     \param <PWM_Attribute> Attr
+     \return <int> -1 failed to open (errno set), >= 0 the descriptor.
+     */
+    int PWM_OpenAttr( PWM_Attribute Attr );
+
+    /**
+     \fn private function int PWM_Store( PWM_Attribute Attr, int Value )
+     \brief Writes one attribute and records the value the kernel now holds.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> -1 failed to open, 0 failed to write (errno set), 1 success.
+     */
+    int PWM_Store( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn private function int PWM_BuildPath( bool PWM_InChannel, const char* PWM_Leaf, char* PWM_Path ) const
+     \brief Writes the path of the pin's pwmchip<N> folder, or of its pwm<M> folder, followed by PWM_Leaf (e.g. "/period").
+     \param <bool> PWM_InChannel
+     \param const <char>* PWM_Leaf
+     \param <char>* PWM_Path (MAX_BUF bytes)
+     \return <int> -1 the path does not fit (errno ENAMETOOLONG), >= 0 its length.
+     */
+    int PWM_BuildPath( bool PWM_InChannel, const char* PWM_Leaf, char* PWM_Path ) const;
+};
+
+#endif /* BBBPWMClassBackend_h */
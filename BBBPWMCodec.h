@@ -0,0 +1,100 @@
+//  BBBPWMCodec.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMCodec_h
+#define BBBPWMCodec_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define PWM_DECIMAL_MAX        12 //!< Longest decimal an int can format to ("-2147483648" plus a newline), use it to size stack buffers.
+
+/**
+ \brief Two ASCII digits for every value 0 - 99, so formatting emits a digit pair per division.
+ */
+static const char PWM_DigitPairs[ 201 ] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ \fn inline function int PWM_FormatDecimal( int PWM_Value, char* PWM_Buffer )
+ \brief Formats a value as decimal ASCII without snprintf( ), locale or allocation. No terminator is written.
+ \param <int> PWM_Value
+ \param <char>* PWM_Buffer (at least PWM_DECIMAL_MAX bytes)
+ \return <int> number of characters written.
+ */
+inline int PWM_FormatDecimal( int PWM_Value, char* PWM_Buffer ) {
+    char PWM_Digits[ PWM_DECIMAL_MAX ];
+    char* p = PWM_Digits + PWM_DECIMAL_MAX;
+    uint32_t u = PWM_Value < 0 ? 0u - ( uint32_t ) PWM_Value : ( uint32_t ) PWM_Value;
+
+    while( u >= 100 ) {
+        uint32_t q = u / 100;
+        p -= 2;
+        memcpy( p, &PWM_DigitPairs[ ( u - q * 100 ) * 2 ], 2 );
+        u = q;
+    }
+    if( u >= 10 ) {
+        p -= 2;
+        memcpy( p, &PWM_DigitPairs[ u * 2 ], 2 );
+    }
+    else
+        *--p = ( char )( '0' + u );
+    if( PWM_Value < 0 )
+        *--p = '-';
+
+    int PWM_Len = ( int )( PWM_Digits + PWM_DECIMAL_MAX - p );
+    memcpy( PWM_Buffer, p, PWM_Len );
+    return PWM_Len;
+}
+
+/**
+ \fn inline function bool PWM_ParseDecimal( const char* PWM_Buffer, int PWM_Len, int& PWM_Value )
+ \brief Parses a decimal value as read from a sysfs attribute : optional sign, digits, optional trailing whitespace / newline.
+ \param const <char>* PWM_Buffer (need not be terminated)
+ \param <int> PWM_Len
+ \param <int>& PWM_Value (only written on success)
+ \return <bool> false on an empty value, stray characters or overflow.
+ */
+inline bool PWM_ParseDecimal( const char* PWM_Buffer, int PWM_Len, int& PWM_Value ) {
+    const char* p = PWM_Buffer;
+    const char* end = PWM_Buffer + PWM_Len;
+    bool PWM_Negative = p < end && *p == '-';
+    if( PWM_Negative )
+        p++;
+
+    const char* PWM_First = p;
+    int64_t v = 0;
+    // At most 10 digits fit an int, the bound also keeps the 64 bit accumulator from overflowing.
+    while( p < end && ( uint32_t )( *p - '0' ) < 10 && p - PWM_First < 11 ) {
+        v = v * 10 + ( *p - '0' );
+        p++;
+    }
+    if( p == PWM_First )
+        return false;
+    while( p < end && ( *p == '\n' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\0' ) )
+        p++;
+    if( p != end )
+        return false;
+
+    if( PWM_Negative )
+        v = -v;
+    if( v < INT32_MIN || v > INT32_MAX )
+        return false;
+    PWM_Value = ( int ) v;
+    return true;
+}
+
+#endif /* BBBPWMCodec_h */
@@ -0,0 +1,1143 @@
+//
+//  BBBPWMController.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMController.h"
+
+/**
+ \brief BBBPWMController : A single writer thread shared by many PWM devices.
+ \param <void>
+ */
+template< class PWM_Backend >
+BBBPWMBasicController< PWM_Backend >::BBBPWMBasicController( ) {
+    this->PWM_Table = make_shared< BBBPWMChannelTable >( );
+    this->PWM_Reserved = false;
+    // Open for the controller's whole life : setters racing PWM_Stop( ) may still bump it, never a closed descriptor.
+    this->PWM_WakeFD = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+    this->PWM_TickFD = -1;
+    this->PWM_TickNs = PWM_DEFAULT_TICK_NS;
+    this->PWM_CoalesceNs.store( 0 );
+    this->PWM_Running.store( false, memory_order_relaxed );
+    this->PWM_RealtimeOn = false;
+    this->PWM_Realtime.PWM_Priority = 0;
+    this->PWM_Realtime.PWM_Cpu = -1;
+    this->PWM_Realtime.PWM_LockMemory = false;
+    this->PWM_Realtime.PWM_StackBytes = PWM_RT_STACK;
+    this->PWM_Realtime.PWM_PrefaultBytes = PWM_RT_PREFAULT;
+    this->PWM_Sleeping.store( false );
+    this->PWM_StopRequested.store( false );
+    this->PWM_WriteCount.store( 0 );
+    this->PWM_Player.PWM_Attach( this );
+    this->PWM_Scheduler.PWM_Attach( this );
+    this->PWM_Server.PWM_Attach( this );
+    this->PWM_Failsafe.PWM_Attach( this );
+    this->PWM_Calibration = NULL;
+    this->PWM_FrameMailbox.store( 2 );
+    this->PWM_FrameBack = 0;
+    this->PWM_FrameFront = 1;
+    this->PWM_FrameGeneration.store( 0 );
+    this->PWM_FramePublished.store( 0 );
+    this->PWM_FrameDropped.store( 0 );
+    this->PWM_FrameLast.store( 0 );
+    this->PWM_FrameCommitted.store( 0 );
+    this->PWM_FrameMaxCommit.store( 0 );
+    this->PWM_FrameTotalCommit.store( 0 );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        this->PWM_FrameCommit[ b ].store( 0 );
+    for( int h = 0; h < PWM_FRAME_HISTORY; h++ ) {
+        this->PWM_FrameHistory[ h ].PWM_Generation.store( 0 );
+        this->PWM_FrameHistory[ h ].PWM_CommitNs.store( 0 );
+    }
+}
+
+/**
+ \brief ~BBBPWMController : Stops the writer thread.
+ */
+template< class PWM_Backend >
+BBBPWMBasicController< PWM_Backend >::~BBBPWMBasicController( ) {
+    this->PWM_Stop( );
+    if( this->PWM_WakeFD >= 0 )
+        close( this->PWM_WakeFD );
+}
+
+/**
+ \fn public function int PWM_Reserve( int Channels )
+ \brief Sizes the channel table for Channels devices up front, so that PWM_AddDevice( ) never moves it. Call before
+ the first PWM_AddDevice( ), or while no other thread uses a device already added.
+ \param <int> Channels
+ \return <int> -1 controller running, Channels below the devices added or out of memory, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_Reserve( int Channels ) {
+    if( this->PWM_Running.load( memory_order_acquire ) || Channels < ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - the channel table must be reserved before BBBPWMController::PWM_Start( ), for every device added" << endl;
+        return -1;
+    }
+    if( this->PWM_Table->PWM_Reserve( Channels ) < 0 )
+        return -1;
+    this->PWM_Reserved = true;
+    return 1;
+}
+
+/**
+ \fn public function int PWM_AddDevice( BBBPWMBasicDevice< PWM_Backend >* Device )
+ \brief Registers a device with this controller, must be called before PWM_Start( ) and before the device's PWM_Init( ).
+ Within the room made by PWM_Reserve( ) the channel table does not move, and other threads may keep using the devices
+ already added. Without a reservation it is reallocated on every call : the devices already added must not be used
+ meanwhile. Past a reservation it is refused, and so is a device that already belongs to a controller (this one,
+ another one, or its own private one started by PWM_Init( )).
+ \param <BBBPWMBasicDevice<PWM_Backend>>* Device
+ \return <int> -1 controller already running, no device, device already driven, reservation full or out of memory, >= 0 the channel index of the device.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_AddDevice( BBBPWMBasicDevice< PWM_Backend >* Device ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - devices must be added before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    // Its table and controller cannot be swapped under a writer that is already driving it.
+    if( Device == NULL || Device->PWM_Controller != NULL ) {
+        cerr << "Error - BBBPWMController::PWM_AddDevice( ) needs a device not yet added to a controller nor initialised" << endl;
+        return -1;
+    }
+    // The writer is not running yet, but callers may be using the devices already added : moving their arrays
+    // under them would leave them storing into freed memory.
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    int PWM_Channel = this->PWM_Devices.size( );
+    if( this->PWM_Reserved && PWM_Channel >= PWM_Hot.PWM_GetCapacity( ) ) {
+        cerr << "Error - BBBPWMController::PWM_Reserve( ) made room for " << PWM_Hot.PWM_GetCapacity( ) << " channels only" << endl;
+        return -1;
+    }
+    if( PWM_Hot.PWM_Resize( PWM_Channel + 1 ) < 0 )
+        return -1;
+
+    // Carry over what was already set on the device, then move it from its own table into this one.
+    const BBBPWMChannelTable& PWM_Own = *Device->PWM_Table;
+    int PWM_Slot = Device->PWM_Channel;
+    PWM_Hot.PWM_Target[ PWM_Channel ].store( PWM_Own.PWM_Target[ PWM_Slot ].load( memory_order_relaxed ), memory_order_relaxed );
+    PWM_Hot.PWM_Duty[ PWM_Channel ].store( PWM_Own.PWM_Duty[ PWM_Slot ].load( memory_order_relaxed ), memory_order_relaxed );
+    PWM_Hot.PWM_DutySlew[ PWM_Channel ].store( PWM_Own.PWM_DutySlew[ PWM_Slot ].load( memory_order_relaxed ), memory_order_relaxed );
+    Device->PWM_Table = this->PWM_Table;
+    Device->PWM_Controller = this;
+    Device->PWM_Channel = PWM_Channel;
+    this->PWM_Devices.push_back( Device );
+    return PWM_Channel;
+}
+
+/**
+ \fn public function int PWM_InitDevices( vector< int >& Status )
+ \brief Sets up every registered device in one go with BBBPWMDevice::PWM_InitAll( ), instead of PWM_Init( ) on each. Call before PWM_Start( ).
+ \param <vector<int>>& Status (one per channel, 1 ready, 0 unable to attach, -1 unable to load its values)
+ \return <int> number of devices ready.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_InitDevices( vector< int >& Status ) {
+    return BBBPWMBasicDevice< PWM_Backend >::PWM_InitAll( this->PWM_Devices, Status );
+}
+
+/**
+ \fn public function int PWM_Start( void )
+ \brief Starts the shared writer thread.
+ \param <void>
+ \return <int> -1 failure to start the writer thread, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_Start( void ) {
+    if( this->PWM_Running.load( memory_order_acquire ) )
+        return 1;
+    BBBPWMShm* PWM_Shm = this->PWM_Server.PWM_GetSegment( );
+    if( PWM_Shm != NULL && PWM_Shm->PWM_GetChannelCount( ) < ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - the shared memory segment served has fewer slots than BBBPWMController has channels" << endl;
+        return -1;
+    }
+    this->PWM_TickFD = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if( this->PWM_WakeFD < 0 || this->PWM_TickFD < 0 ) {
+        cerr << "Error - unable to create the PWM writer wake and tick descriptors : " << strerror( errno ) << endl;
+        this->PWM_CloseTimers( );
+        return -1;
+    }
+    // Each component reports its own failure.
+    if( this->PWM_Player.PWM_Open( ) < 0 || this->PWM_Scheduler.PWM_Open( ) < 0 || this->PWM_Server.PWM_Open( ) < 0
+        || this->PWM_Failsafe.PWM_Open( ) < 0 ) {
+        this->PWM_CloseTimers( );
+        return -1;
+    }
+    // Wakeups left over from the last run, PWM_Stop( )'s own included.
+    uint64_t PWM_Stale;
+    if( read( this->PWM_WakeFD, &PWM_Stale, sizeof( PWM_Stale ) ) < 0 && errno != EAGAIN )
+        cerr << "Error - unable to clear the PWM writer eventfd : " << strerror( errno ) << endl;
+    this->PWM_Pending.assign( this->PWM_Table->PWM_DirtyWords, 0 );
+    this->PWM_Ramping.assign( this->PWM_Table->PWM_DirtyWords, 0 );
+    this->PWM_FrameBits.assign( this->PWM_Table->PWM_DirtyWords, 0 );
+    for( int f = 0; f < 3; f++ ) {
+        this->PWM_Frames[ f ].PWM_Count = 0;
+        this->PWM_Frames[ f ].PWM_Duty.assign( this->PWM_Devices.size( ), 0 );
+        this->PWM_Frames[ f ].PWM_Period.assign( this->PWM_Devices.size( ), PWM_FRAME_KEEP );
+        this->PWM_Frames[ f ].PWM_Run.assign( this->PWM_Devices.size( ), PWM_FRAME_KEEP );
+    }
+    this->PWM_FrameMailbox.store( 2 );
+    this->PWM_FrameBack = 0;
+    this->PWM_FrameFront = 1;
+    this->PWM_FrameOrder.resize( this->PWM_Devices.size( ) );
+    this->PWM_FrameLatency.resize( this->PWM_Devices.size( ) );
+    this->PWM_FrameSort( );
+    this->PWM_Sleeping.store( false );
+    this->PWM_StopRequested.store( false );
+    this->PWM_WriteCount.store( 0 );
+    this->PWM_Scheduler.PWM_Arm( );
+    this->PWM_Failsafe.PWM_Arm( );
+    this->PWM_Server.PWM_Arm( );
+    if( this->PWM_CreateThread( ) < 0 ) {
+        this->PWM_CloseTimers( );
+        return -1;
+    }
+    // Release : a setter that sees the controller running sees the frame buffers and descriptors set up above.
+    this->PWM_Running.store( true, memory_order_release );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_SetRealtime( const BBBPWMRealtime& Realtime )
+ \brief Runs the writer thread in real-time mode from the next PWM_Start( ) : created SCHED_FIFO at the given
+ priority, pinned to a CPU, on a stack of the given size, with the process memory locked if asked. Before its
+ first pass the writer faults in its stack and takes its trace ring, so that a pass never faults or allocates.
+ PWM_Start( ) fails if the settings cannot be applied (SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO).
+ \param const <BBBPWMRealtime>& Realtime
+ \return <int> -1 controller running or a setting out of range, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_SetRealtime( const BBBPWMRealtime& Realtime ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - real-time mode must be set before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    BBBPWMRealtime PWM_Settings = Realtime;
+    if( PWM_Settings.PWM_StackBytes == 0 )
+        PWM_Settings.PWM_StackBytes = PWM_RT_STACK;
+    if( PWM_Settings.PWM_PrefaultBytes == 0 )
+        PWM_Settings.PWM_PrefaultBytes = PWM_RT_PREFAULT;
+    // Half the stack at most : the frames of the pass itself must still fit below what was touched.
+    if( ( PWM_Settings.PWM_Priority != 0 && ( PWM_Settings.PWM_Priority < sched_get_priority_min( SCHED_FIFO )
+                                            || PWM_Settings.PWM_Priority > sched_get_priority_max( SCHED_FIFO ) ) )
+        || PWM_Settings.PWM_Cpu < -1 || PWM_Settings.PWM_Cpu >= min( ( long ) CPU_SETSIZE, sysconf( _SC_NPROCESSORS_CONF ) )
+        || PWM_Settings.PWM_StackBytes < ( size_t ) PTHREAD_STACK_MIN || PWM_Settings.PWM_PrefaultBytes > PWM_Settings.PWM_StackBytes / 2 ) {
+        cerr << "Error - BBBPWMController::PWM_SetRealtime( ) needs a SCHED_FIFO priority or 0, an existing CPU or -1, and a prefault of at most half the stack" << endl;
+        return -1;
+    }
+    this->PWM_Realtime = PWM_Settings;
+    this->PWM_RealtimeOn = true;
+    return 1;
+}
+
+/**
+ \fn private function int PWM_CreateThread( void )
+ \brief pthread_create( )s the writer, with the real-time attributes and memory lock when PWM_RealtimeOn.
+ \param <void>
+ \return <int> -1 failure (reported), 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_CreateThread( void ) {
+    if( !this->PWM_RealtimeOn ) {
+        int PWM_Ret = pthread_create( &this->PWM_Thread, NULL, BBBPWMBasicController< PWM_Backend >::PWM_Run, this );
+        if( PWM_Ret ) {
+            cerr << "Error - pthread_create() returned code: " << PWM_Ret << endl;
+            return -1;
+        }
+        return 1;
+    }
+    // Everything the writer will touch has been allocated by now, MCL_CURRENT pins it and MCL_FUTURE the writer's stack.
+    if( this->PWM_Realtime.PWM_LockMemory && mlockall( MCL_CURRENT | MCL_FUTURE ) < 0 ) {
+        cerr << "Error - unable to lock the PWM writer's memory : " << strerror( errno ) << endl;
+        return -1;
+    }
+    pthread_attr_t PWM_Attr;
+    pthread_attr_init( &PWM_Attr );
+    pthread_attr_setstacksize( &PWM_Attr, this->PWM_Realtime.PWM_StackBytes );
+    if( this->PWM_Realtime.PWM_Priority > 0 ) {
+        struct sched_param PWM_Param;
+        memset( &PWM_Param, 0, sizeof( PWM_Param ) );
+        PWM_Param.sched_priority = this->PWM_Realtime.PWM_Priority;
+        pthread_attr_setinheritsched( &PWM_Attr, PTHREAD_EXPLICIT_SCHED );
+        pthread_attr_setschedpolicy( &PWM_Attr, SCHED_FIFO );
+        pthread_attr_setschedparam( &PWM_Attr, &PWM_Param );
+    }
+    if( this->PWM_Realtime.PWM_Cpu >= 0 ) {
+        cpu_set_t PWM_Cpus;
+        CPU_ZERO( &PWM_Cpus );
+        CPU_SET( this->PWM_Realtime.PWM_Cpu, &PWM_Cpus );
+        pthread_attr_setaffinity_np( &PWM_Attr, sizeof( PWM_Cpus ), &PWM_Cpus );
+    }
+    int PWM_Ret = pthread_create( &this->PWM_Thread, &PWM_Attr, BBBPWMBasicController< PWM_Backend >::PWM_Run, this );
+    pthread_attr_destroy( &PWM_Attr );
+    if( PWM_Ret ) {
+        cerr << "Error - pthread_create() returned code: " << PWM_Ret << " for the real-time PWM writer"
+             << ( PWM_Ret == EPERM ? " (SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO)" : "" ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn private function void PWM_Prefault( void )
+ \brief Run by the writer before its first pass in real-time mode : touches PWM_PrefaultBytes of its stack and takes its trace ring.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_Prefault( void ) {
+    // alloca( ) moves the stack pointer down past the pages a pass will use, one store per page faults them in. They stay
+    // mapped once this frame is gone.
+    volatile char* PWM_Stack = ( volatile char* ) alloca( this->PWM_Realtime.PWM_PrefaultBytes );
+    size_t PWM_Page = sysconf( _SC_PAGESIZE );
+    for( size_t b = 0; b < this->PWM_Realtime.PWM_PrefaultBytes; b += PWM_Page )
+        PWM_Stack[ b ] = 0;
+    BBBPWMTrace::PWM_Attach( );
+}
+
+/**
+ \fn public function void PWM_Stop( void )
+ \brief Stops the shared writer thread and waits for it to exit. Safe to call more than once. Must be called before any registered device is destroyed.
+ Setters may race it : an update either lands before the writer exits or waits in the dirty set for the next PWM_Start( ),
+ which must not itself race PWM_SetFrame( ) or PWM_SetFrameThrottle( ) since it resets the frame buffers.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_Stop( void ) {
+    if( !this->PWM_Running.load( memory_order_acquire ) )
+        return;
+    this->PWM_StopRequested.store( true );
+    this->PWM_Wake( );
+    pthread_join( this->PWM_Thread, NULL );
+    this->PWM_CloseTimers( );
+    this->PWM_Running.store( false, memory_order_release );
+}
+
+/**
+ \fn private function void PWM_CloseTimers( void )
+ \brief Closes the ramp tick and every component's timerfd, those never opened included. The player drops its playback.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_CloseTimers( void ) {
+    if( this->PWM_TickFD >= 0 )
+        close( this->PWM_TickFD );
+    this->PWM_TickFD = -1;
+    this->PWM_Player.PWM_Close( );
+    this->PWM_Scheduler.PWM_Close( );
+    this->PWM_Server.PWM_Close( );
+    this->PWM_Failsafe.PWM_Close( );
+}
+
+/**
+ \fn public function bool PWM_MarkDirty( int Channel )
+ \brief Adds a channel to the dirty set and wakes the writer thread if it is asleep. Lock-free, callable from any thread.
+ \param <int> Channel
+ \return <bool> false if the channel was already dirty, i.e. this update was coalesced with a pending one.
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_MarkDirty( int Channel ) {
+    // Both this OR and the PWM_Sleeping load are seq_cst, as are the writer's PWM_Sleeping store and PWM_HasDirty( ) load :
+    // either the writer sees our bit before it blocks, or we see it asleep and bump the eventfd.
+    uint32_t PWM_Bit = 1u << ( Channel % 32 );
+    uint32_t PWM_Was = this->PWM_Table->PWM_Dirty[ Channel / 32 ].fetch_or( PWM_Bit );
+    if( this->PWM_Sleeping.load( ) )
+        this->PWM_Wake( );
+    return ( PWM_Was & PWM_Bit ) == 0;
+}
+
+/**
+ \fn public function void PWM_SetCoalesceWindow( long Nanoseconds )
+ \brief After being woken by a new target the writer waits this long before writing, so a burst of updates costs one write per channel. Timers and completions due meanwhile are still served, and end the wait early. Defaults to 0 (write straight away).
+ \param <long> Nanoseconds
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_SetCoalesceWindow( long Nanoseconds ) {
+    this->PWM_CoalesceNs.store( Nanoseconds > 0 ? Nanoseconds : 0, memory_order_relaxed );
+}
+
+/**
+ \fn public function long PWM_GetCoalesceWindow( void ) const
+ \brief Returns the coalescing window in nanoseconds.
+ \param <void>
+ \return <long> this->PWM_CoalesceNs
+ */
+template< class PWM_Backend >
+long BBBPWMBasicController< PWM_Backend >::PWM_GetCoalesceWindow( void ) const {
+    return this->PWM_CoalesceNs.load( memory_order_relaxed );
+}
+
+/**
+ \fn private function bool PWM_HasDirty( void ) const
+ \brief Checks whether any channel is in the dirty set.
+ \param <void>
+ \return <bool> true if at least one dirty bit is set.
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_HasDirty( void ) const {
+    const BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    for( size_t w = 0; w < PWM_Hot.PWM_DirtyWords; w++ )
+        if( PWM_Hot.PWM_Dirty[ w ].load( ) != 0 )
+            return true;
+    return false;
+}
+
+/**
+ \fn private function void PWM_Wake( void )
+ \brief Bumps PWM_WakeFD so that the writer thread runs a pass.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_Wake( void ) {
+    uint64_t PWM_Wakeup = 1;
+    if( write( this->PWM_WakeFD, &PWM_Wakeup, sizeof( PWM_Wakeup ) ) < 0 )
+        cerr << "Error - unable to wake the PWM writer thread : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn public function void PWM_SetTickPeriod( long Nanoseconds )
+ \brief Sets the ramp tick period, must be called before PWM_Start( ). Defaults to PWM_DEFAULT_TICK_NS.
+ \param <long> Nanoseconds
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_SetTickPeriod( long Nanoseconds ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - the tick period must be set before BBBPWMController::PWM_Start( )" << endl;
+        return;
+    }
+    this->PWM_TickNs = Nanoseconds > 0 ? Nanoseconds : PWM_DEFAULT_TICK_NS;
+}
+
+/**
+ \fn public function long PWM_GetTickPeriod( void ) const
+ \brief Returns the ramp tick period in nanoseconds.
+ \param <void>
+ \return <long> this->PWM_TickNs
+ */
+template< class PWM_Backend >
+long BBBPWMBasicController< PWM_Backend >::PWM_GetTickPeriod( void ) const {
+    return this->PWM_TickNs;
+}
+
+/**
+ \fn private function void PWM_ArmTick( bool Armed )
+ \brief Starts or stops the periodic ramp tick.
+ \param <bool> Armed
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_ArmTick( bool Armed ) {
+    struct itimerspec PWM_Tick;
+    memset( &PWM_Tick, 0, sizeof( PWM_Tick ) );
+    if( Armed ) {
+        PWM_Tick.it_interval.tv_sec = this->PWM_TickNs / 1000000000L;
+        PWM_Tick.it_interval.tv_nsec = this->PWM_TickNs % 1000000000L;
+        PWM_Tick.it_value = PWM_Tick.it_interval;
+    }
+    if( timerfd_settime( this->PWM_TickFD, 0, &PWM_Tick, NULL ) < 0 )
+        cerr << "Error - unable to set the PWM ramp tick : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn public function int PWM_GetDeviceCount( void ) const
+ \brief Returns the number of devices registered with this controller.
+ \param <void>
+ \return <int> this->PWM_Devices.size( )
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_GetDeviceCount( void ) const {
+    return this->PWM_Devices.size( );
+}
+
+/**
+ \fn public function const BBBPWMChannelTable& PWM_GetChannelTable( void ) const
+ \brief Returns the table holding every channel's duty target and committed duty, e.g. to read them all in one pass.
+ \param <void>
+ \return <const BBBPWMChannelTable>& *this->PWM_Table
+ */
+template< class PWM_Backend >
+const BBBPWMChannelTable& BBBPWMBasicController< PWM_Backend >::PWM_GetChannelTable( void ) const {
+    return *this->PWM_Table;
+}
+
+/**
+ \fn public function uint64_t PWM_GetWriteCount( void ) const
+ \brief Returns the number of duty values written by the writer thread since PWM_Start( ).
+ \param <void>
+ \return <uint64_t> this->PWM_WriteCount
+ */
+template< class PWM_Backend >
+uint64_t BBBPWMBasicController< PWM_Backend >::PWM_GetWriteCount( void ) const {
+    return this->PWM_WriteCount.load( memory_order_relaxed );
+}
+
+/**
+ \fn public function int PWM_AddControl( int Channel, BBBPWMControlFn Callback, void* Arg )
+ \brief Registers a control callback, run by the writer thread every control period from PWM_Start( ) on. Its return
+ value becomes the channel's target as if passed to PWM_SetTargetSpeed( ), and is written in the same pass. Callbacks
+ run in the order they were added. Must be called before PWM_Start( ).
+ \param <int> Channel
+ \param <BBBPWMControlFn> Callback
+ \param <void>* Arg
+ \return <int> -1 controller running or no such channel, >= 0 the index of the callback.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_AddControl( int Channel, BBBPWMControlFn Callback, void* Arg ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - control loops must be added before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    return this->PWM_Scheduler.PWM_Add( Channel, Callback, Arg );
+}
+
+/**
+ \fn public function void PWM_SetControlPeriod( long Nanoseconds )
+ \brief Sets the control tick period, must be called before PWM_Start( ). Defaults to PWM_DEFAULT_CONTROL_NS.
+ \param <long> Nanoseconds
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_SetControlPeriod( long Nanoseconds ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - the control period must be set before BBBPWMController::PWM_Start( )" << endl;
+        return;
+    }
+    this->PWM_Scheduler.PWM_SetPeriod( Nanoseconds );
+}
+
+/**
+ \fn public function long PWM_GetControlPeriod( void ) const
+ \brief Returns the control tick period in nanoseconds.
+ \param <void>
+ \return <long> this->PWM_Scheduler.PWM_GetPeriod( )
+ */
+template< class PWM_Backend >
+long BBBPWMBasicController< PWM_Backend >::PWM_GetControlPeriod( void ) const {
+    return this->PWM_Scheduler.PWM_GetPeriod( );
+}
+
+/**
+ \fn public function void PWM_GetControlStats( BBBPWMControlStats& Stats ) const
+ \brief Copies the timing of the control ticks since PWM_Start( ). Lock-free.
+ \param <BBBPWMControlStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_GetControlStats( BBBPWMControlStats& Stats ) const {
+    this->PWM_Scheduler.PWM_GetStats( Stats );
+}
+
+/**
+ \fn public function int PWM_Serve( BBBPWMShm* Shm, long PollNs )
+ \brief Takes commands for every channel from a shared memory segment made with BBBPWMShm::PWM_Create( ), polled by
+ the writer thread every PollNs, and publishes each channel's status to it. NULL stops serving. Must be called before
+ PWM_Start( ), the segment must stay mapped while the controller runs.
+ \param <BBBPWMShm>* Shm
+ \param <long> PollNs (0 for PWM_DEFAULT_SERVE_NS)
+ \return <int> -1 controller running or fewer slots than channels, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_Serve( BBBPWMShm* Shm, long PollNs ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - the shared memory segment must be set before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    if( Shm != NULL && Shm->PWM_GetChannelCount( ) < ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - the shared memory segment has fewer slots than BBBPWMController has channels" << endl;
+        return -1;
+    }
+    this->PWM_Server.PWM_Set( Shm, PollNs );
+    return 1;
+}
+
+/**
+ \fn public function int64_t PWM_SetFrame( const int* Duties, int Count, const int* Periods, const int* Runs )
+ \brief Publishes the targets of channels 0 - Count - 1 as one frame : the writer commits all of them in the same
+ pass, channels with the lowest write latency first, and drops a frame replaced by a newer one before it got to it.
+ Periods and Runs may be NULL, or hold PWM_FRAME_KEEP for channels to leave alone. A channel with a slew starts its
+ ramp in that pass. Lock-free, but frames must come from one thread at a time. The controller must be running, a frame
+ published while PWM_Stop( ) runs may be dropped.
+ \param const <int>* Duties
+ \param <int> Count
+ \param const <int>* Periods
+ \param const <int>* Runs
+ \return <int64_t> -1 controller not running or Count out of range, > 0 the frame's generation number.
+ */
+template< class PWM_Backend >
+int64_t BBBPWMBasicController< PWM_Backend >::PWM_SetFrame( const int* Duties, int Count, const int* Periods, const int* Runs ) {
+    if( !this->PWM_Running.load( memory_order_acquire ) || Count <= 0 || Count > ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - BBBPWMController::PWM_SetFrame( ) needs a running controller and 1 to " << this->PWM_Devices.size( ) << " channels" << endl;
+        return -1;
+    }
+    BBBPWMFrame& PWM_Frame = this->PWM_Frames[ this->PWM_FrameBack ];
+    for( int c = 0; c < Count; c++ ) {
+        PWM_Frame.PWM_Duty[ c ] = Duties[ c ];
+        if( Periods != NULL )
+            PWM_Frame.PWM_Period[ c ] = Periods[ c ];
+        if( Runs != NULL )
+            PWM_Frame.PWM_Run[ c ] = Runs[ c ];
+    }
+    return this->PWM_PublishFrame( Count, Periods != NULL, Runs != NULL );
+}
+
+/**
+ \fn private function int64_t PWM_PublishFrame( int PWM_Count, bool PWM_HasPeriod, bool PWM_HasRun )
+ \brief Stamps the frame filled in PWM_FrameBack and hands it to the writer.
+ \param <int> PWM_Count
+ \param <bool> PWM_HasPeriod
+ \param <bool> PWM_HasRun
+ \return <int64_t> the frame's generation number.
+ */
+template< class PWM_Backend >
+int64_t BBBPWMBasicController< PWM_Backend >::PWM_PublishFrame( int PWM_Count, bool PWM_HasPeriod, bool PWM_HasRun ) {
+    BBBPWMFrame& PWM_Frame = this->PWM_Frames[ this->PWM_FrameBack ];
+    int64_t PWM_Generation = this->PWM_FrameGeneration.load( memory_order_relaxed ) + 1;
+    PWM_Frame.PWM_Generation = PWM_Generation;
+    PWM_Frame.PWM_Count = PWM_Count;
+    PWM_Frame.PWM_HasPeriod = PWM_HasPeriod;
+    PWM_Frame.PWM_HasRun = PWM_HasRun;
+    PWM_Frame.PWM_PublishNs = PWM_MonotonicNs( );
+    this->PWM_FrameGeneration.store( PWM_Generation, memory_order_relaxed );
+
+    // Hands the buffer to the writer and takes back the one it gave up (or the unread frame this one replaces). seq_cst
+    // like PWM_MarkDirty( ) : either the writer sees the frame before it blocks, or we see it asleep below.
+    int PWM_Previous = this->PWM_FrameMailbox.exchange( this->PWM_FrameBack | PWM_FRAME_FRESH );
+    this->PWM_FrameBack = PWM_Previous & ~PWM_FRAME_FRESH;
+    if( PWM_Previous & PWM_FRAME_FRESH )
+        this->PWM_FrameDropped.store( this->PWM_FrameDropped.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+    this->PWM_FramePublished.store( this->PWM_FramePublished.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+
+    if( this->PWM_Sleeping.load( ) )
+        this->PWM_Wake( );
+    return PWM_Generation;
+}
+
+/**
+ \fn public function int PWM_SetCalibration( BBBPWMCalibration* Calibration )
+ \brief Sets the curves PWM_SetThrottle( ) and PWM_SetFrameThrottle( ) convert through, NULL for none. Must be called
+ before PWM_Start( ) and stay alive while the controller runs, its curves may be swapped at any time.
+ \param <BBBPWMCalibration>* Calibration
+ \return <int> -1 controller running or fewer curves than channels, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_SetCalibration( BBBPWMCalibration* Calibration ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - the calibration must be set before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    if( Calibration != NULL && Calibration->PWM_GetChannelCount( ) < ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - the calibration has fewer curves than BBBPWMController has channels" << endl;
+        return -1;
+    }
+    this->PWM_Calibration = Calibration;
+    return 1;
+}
+
+/**
+ \fn public function int PWM_SetThrottle( int Channel, float Throttle )
+ \brief Converts a throttle from 0 to 1 through the channel's curve and sets it as the channel's target. Lock-free.
+ \param <int> Channel
+ \param <float> Throttle
+ \return <int> -1 no calibration set or no such channel, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_SetThrottle( int Channel, float Throttle ) {
+    if( this->PWM_Calibration == NULL || Channel < 0 || Channel >= ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - BBBPWMController::PWM_SetThrottle( ) needs a calibration and a registered channel" << endl;
+        return -1;
+    }
+    int PWM_Duty = this->PWM_Calibration->PWM_ConvertOne( Channel, Throttle );
+    if( PWM_Duty < 0 )
+        return -1;
+    this->PWM_Devices[ Channel ]->PWM_SetTargetSpeed( PWM_Duty );
+    return 1;
+}
+
+/**
+ \fn public function int64_t PWM_SetFrameThrottle( const float* Throttles, int Count )
+ \brief PWM_SetFrame( ) with throttles from 0 to 1 : channels 0 - Count - 1 are converted in one vector pass straight
+ into the frame buffer, then published. Same threading rules as PWM_SetFrame( ).
+ \param const <float>* Throttles
+ \param <int> Count
+ \return <int64_t> -1 no calibration set, controller not running or Count out of range, > 0 the frame's generation number.
+ */
+template< class PWM_Backend >
+int64_t BBBPWMBasicController< PWM_Backend >::PWM_SetFrameThrottle( const float* Throttles, int Count ) {
+    if( this->PWM_Calibration == NULL || !this->PWM_Running.load( memory_order_acquire ) || Count <= 0 || Count > ( int ) this->PWM_Devices.size( ) ) {
+        cerr << "Error - BBBPWMController::PWM_SetFrameThrottle( ) needs a calibration, a running controller and 1 to " << this->PWM_Devices.size( ) << " channels" << endl;
+        return -1;
+    }
+    if( this->PWM_Calibration->PWM_Convert( Throttles, this->PWM_Frames[ this->PWM_FrameBack ].PWM_Duty.data( ), Count ) < 0 )
+        return -1;
+    return this->PWM_PublishFrame( Count, false, false );
+}
+
+/**
+ \fn public function int64_t PWM_GetFrameCommit( int64_t Frame ) const
+ \brief Returns the CLOCK_MONOTONIC time a frame's writes were issued. Lock-free.
+ \param <int64_t> Frame (generation returned by PWM_SetFrame( ))
+ \return <int64_t> ns, 0 not committed yet, -1 dropped or older than the last PWM_FRAME_HISTORY commits.
+ */
+template< class PWM_Backend >
+int64_t BBBPWMBasicController< PWM_Backend >::PWM_GetFrameCommit( int64_t Frame ) const {
+    // Frames are committed in order, so one not in the history but no newer than the last commit was dropped.
+    if( Frame > this->PWM_FrameLast.load( memory_order_acquire ) )
+        return 0;
+    const BBBPWMFrameCommit& PWM_Entry = this->PWM_FrameHistory[ Frame & ( PWM_FRAME_HISTORY - 1 ) ];
+    int64_t PWM_Generation = PWM_Entry.PWM_Generation.load( memory_order_acquire );
+    int64_t PWM_CommitNs = PWM_Entry.PWM_CommitNs.load( memory_order_relaxed );
+    atomic_thread_fence( memory_order_acquire );
+    if( PWM_Generation != Frame || PWM_Entry.PWM_Generation.load( memory_order_relaxed ) != Frame )
+        return -1;
+    return PWM_CommitNs;
+}
+
+/**
+ \fn public function void PWM_GetFrameStats( BBBPWMFrameStats& Stats ) const
+ \brief Copies the frame counters and publication to commit times. Lock-free.
+ \param <BBBPWMFrameStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_GetFrameStats( BBBPWMFrameStats& Stats ) const {
+    Stats.PWM_Published = this->PWM_FramePublished.load( memory_order_relaxed );
+    Stats.PWM_Committed = this->PWM_FrameCommitted.load( memory_order_relaxed );
+    Stats.PWM_Dropped = this->PWM_FrameDropped.load( memory_order_relaxed );
+    Stats.PWM_MaxCommitNs = this->PWM_FrameMaxCommit.load( memory_order_relaxed );
+    Stats.PWM_TotalCommitNs = this->PWM_FrameTotalCommit.load( memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        Stats.PWM_Commit[ b ] = this->PWM_FrameCommit[ b ].load( memory_order_relaxed );
+}
+
+/**
+ \fn public function int PWM_SetFailsafe( int Channel, int TimeoutMs, int SafeDuty )
+ \brief Watches a channel from PWM_Start( ) on : if it gets no new target (from any source) for TimeoutMs, the writer
+ sets its target to SafeDuty, or with PWM_FAILSAFE_DISABLE sets its run value to OFF. The next target clears the
+ trip, a channel stopped through run stays stopped until PWM_SetRunVal( ). Ramp cancels and period changes do not
+ count as targets. Costs one relaxed OR per target on the update path, the writer checks every channel on one shared
+ timer. Must be called before PWM_Start( ).
+ \param <int> Channel
+ \param <int> TimeoutMs (0 to stop watching it)
+ \param <int> SafeDuty (ns, or PWM_FAILSAFE_DISABLE)
+ \return <int> -1 controller running, no such channel or duty out of range, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_SetFailsafe( int Channel, int TimeoutMs, int SafeDuty ) {
+    if( this->PWM_Running.load( memory_order_acquire ) ) {
+        cerr << "Error - failsafes must be set before BBBPWMController::PWM_Start( )" << endl;
+        return -1;
+    }
+    return this->PWM_Failsafe.PWM_Set( Channel, TimeoutMs, SafeDuty );
+}
+
+/**
+ \fn public function bool PWM_IsFailsafe( int Channel ) const
+ \brief Checks whether a channel is tripped, i.e. held at its failsafe since its timeout. Lock-free.
+ \param <int> Channel
+ \return <bool> true if tripped.
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_IsFailsafe( int Channel ) const {
+    return this->PWM_Failsafe.PWM_IsTripped( Channel );
+}
+
+/**
+ \fn public function void PWM_GetFailsafeStats( BBBPWMFailsafeStats& Stats ) const
+ \brief Copies the watchdog trips and how late they were written since PWM_Start( ). Lock-free.
+ \param <BBBPWMFailsafeStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_GetFailsafeStats( BBBPWMFailsafeStats& Stats ) const {
+    this->PWM_Failsafe.PWM_GetStats( Stats );
+}
+
+/**
+ \fn public function int PWM_Play( BBBPWMProfile* Profile, long LeadNs )
+ \brief Plays a profile from the writer thread : each record's duty and period are handed to its channel at
+ its scheduled CLOCK_MONOTONIC time, LeadNs after this call, replacing any playback already running. Ordinary
+ PWM_SetTargetSpeed( ) calls still work and interleave with the profile. The controller must be running and
+ Profile must stay open until playback ends.
+ \param <BBBPWMProfile>* Profile
+ \param <long> LeadNs (delay before the profile's time 0)
+ \return <int> -1 controller not running or empty profile, 1 playback scheduled.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_Play( BBBPWMProfile* Profile, long LeadNs ) {
+    if( !this->PWM_Running.load( memory_order_acquire ) || Profile == NULL || Profile->PWM_GetRecordCount( ) == 0 ) {
+        cerr << "Error - BBBPWMController::PWM_Play( ) needs a running controller and a non empty profile" << endl;
+        return -1;
+    }
+    this->PWM_Player.PWM_Request( Profile, PWM_MonotonicNs( ) + ( LeadNs > 0 ? LeadNs : 0 ) );
+    this->PWM_Wake( );
+    return 1;
+}
+
+/**
+ \fn public function void PWM_StopPlayback( void )
+ \brief Stops a running playback, channels keep the last value played.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_StopPlayback( void ) {
+    if( !this->PWM_Running.load( memory_order_acquire ) )
+        return;
+    this->PWM_Player.PWM_Cancel( );
+    this->PWM_Wake( );
+}
+
+/**
+ \fn public function bool PWM_IsPlaying( void ) const
+ \brief Checks whether a playback is scheduled or running.
+ \param <void>
+ \return <bool> this->PWM_Player.PWM_IsPlaying( )
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_IsPlaying( void ) const {
+    return this->PWM_Player.PWM_IsPlaying( );
+}
+
+/**
+ \fn public function void PWM_GetPlaybackStats( BBBPWMPlaybackStats& Stats ) const
+ \brief Copies the timing error of the current (or last) playback, measured from each record's scheduled time until its values were written. Lock-free.
+ \param <BBBPWMPlaybackStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_GetPlaybackStats( BBBPWMPlaybackStats& Stats ) const {
+    this->PWM_Player.PWM_GetStats( Stats );
+}
+
+/**
+ \fn private static function int64_t PWM_MonotonicNs( void )
+ \brief CLOCK_MONOTONIC in nanoseconds, the clock profiles are scheduled against.
+ \param <void>
+ \return <int64_t> ns
+ */
+template< class PWM_Backend >
+int64_t BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( void ) {
+    struct timespec PWM_Now;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+    return ( int64_t ) PWM_Now.tv_sec * 1000000000 + PWM_Now.tv_nsec;
+}
+
+/**
+ \fn private function int PWM_Step( size_t PWM_Channel, uint64_t PWM_Ticks )
+ \brief Writer pass for one channel : PWM_Update( ), then the write count, its ramping bit and its status slot.
+ \param <size_t> PWM_Channel
+ \param <uint64_t> PWM_Ticks (ramp ticks elapsed, 0 between ticks)
+ \return <int> PWM_UpdateFlags of the device.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicController< PWM_Backend >::PWM_Step( size_t PWM_Channel, uint64_t PWM_Ticks ) {
+    int PWM_Flags = this->PWM_Devices[ PWM_Channel ]->PWM_Update( PWM_Ticks );
+    if( PWM_Flags & BBBPWMBasicDevice< PWM_Backend >::PWM_WROTE )
+        this->PWM_WriteCount.store( this->PWM_WriteCount.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+    if( PWM_Flags & BBBPWMBasicDevice< PWM_Backend >::PWM_RAMPING )
+        this->PWM_Ramping[ PWM_Channel / 32 ] |= 1u << ( PWM_Channel % 32 );
+    else
+        this->PWM_Ramping[ PWM_Channel / 32 ] &= ~( 1u << ( PWM_Channel % 32 ) );
+    this->PWM_Server.PWM_Publish( PWM_Channel, PWM_Flags & BBBPWMBasicDevice< PWM_Backend >::PWM_WROTE );
+    return PWM_Flags;
+}
+
+/**
+ \fn private function bool PWM_FrameTake( void )
+ \brief If a frame was published since the last one taken, takes it and hands its values to its channels : they
+ become targets PWM_FrameWrite( ) writes in the same pass.
+ \param <void>
+ \return <bool> true if a frame was taken.
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_FrameTake( void ) {
+    if( !( this->PWM_FrameMailbox.load( memory_order_relaxed ) & PWM_FRAME_FRESH ) )
+        return false;
+    // Only the newest frame is ever in the mailbox, anything published before it was dropped by PWM_SetFrame( ).
+    this->PWM_FrameFront = this->PWM_FrameMailbox.exchange( this->PWM_FrameFront, memory_order_acq_rel ) & ~PWM_FRAME_FRESH;
+    const BBBPWMFrame& PWM_Frame = this->PWM_Frames[ this->PWM_FrameFront ];
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    bool PWM_Tracing = BBBPWMTrace::PWM_IsEnabled( );
+    for( int c = 0; c < PWM_Frame.PWM_Count; c++ ) {
+        // Not marked dirty one by one, the whole frame is below.
+        if( PWM_Frame.PWM_HasPeriod && PWM_Frame.PWM_Period[ c ] != PWM_FRAME_KEEP )
+            this->PWM_Devices[ c ]->PWM_RequestPeriod( PWM_Frame.PWM_Period[ c ] );
+        // PWM_FRAME_KEEP and anything else but ON or OFF leave run alone, as PWM_SetRunVal( ) refuses them.
+        if( PWM_Frame.PWM_HasRun && ( PWM_Frame.PWM_Run[ c ] == BBBPWMDeviceTypes::ON || PWM_Frame.PWM_Run[ c ] == BBBPWMDeviceTypes::OFF ) )
+            this->PWM_Devices[ c ]->PWM_RequestRun( PWM_Frame.PWM_Run[ c ] );
+        // Straight into the table, the device itself is only needed to count or trace the target.
+        int PWM_Duty = PWM_Frame.PWM_Duty[ c ];
+        PWM_Hot.PWM_Target[ c ].store( PWM_Duty, memory_order_release );
+        if( PWM_Tracing || PWM_Duty < PWM_DUTY_LOW || PWM_Duty > PWM_DUTY_HIGH )
+            this->PWM_Devices[ c ]->PWM_NoteTarget( PWM_Duty );
+    }
+    // A word of dirty bits at a time : the frame feeds the watchdog and counts as coalesced like single targets do.
+    for( int w = 0; w * 32 < PWM_Frame.PWM_Count; w++ ) {
+        int PWM_Left = PWM_Frame.PWM_Count - w * 32;
+        uint32_t PWM_Bits = PWM_Left >= 32 ? ~0u : ( 1u << PWM_Left ) - 1;
+        this->PWM_FrameBits[ w ] |= PWM_Bits;
+        if( this->PWM_Failsafe.PWM_IsOn( ) )
+            PWM_Hot.PWM_Stored[ w ].fetch_or( PWM_Bits, memory_order_relaxed );
+        uint32_t PWM_Was = PWM_Hot.PWM_Dirty[ w ].fetch_or( PWM_Bits, memory_order_relaxed ) & PWM_Bits;
+        for( ; PWM_Was != 0; PWM_Was &= PWM_Was - 1 )
+            this->PWM_Devices[ w * 32 + __builtin_ctz( PWM_Was ) ]->PWM_CoalescedCount.fetch_add( 1, memory_order_relaxed );
+    }
+    return true;
+}
+
+/**
+ \fn private function void PWM_FrameWrite( uint64_t PWM_Ticks )
+ \brief Writes the channels of the frame taken by PWM_FrameTake( ) in PWM_FrameOrder, the rest of the pass skips them.
+ \param <uint64_t> PWM_Ticks
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_FrameWrite( uint64_t PWM_Ticks ) {
+    for( size_t i = 0; i < this->PWM_FrameOrder.size( ); i++ ) {
+        int c = this->PWM_FrameOrder[ i ];
+        if( this->PWM_FrameBits[ c / 32 ] & ( 1u << ( c % 32 ) ) )
+            this->PWM_Step( c, PWM_Ticks );
+    }
+}
+
+/**
+ \fn private function void PWM_FrameStamp( void )
+ \brief Once the frame is written : records its commit time and re-sorts PWM_FrameOrder every PWM_FRAME_REORDER frames.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_FrameStamp( void ) {
+    const BBBPWMFrame& PWM_Frame = this->PWM_Frames[ this->PWM_FrameFront ];
+    int64_t PWM_Now = PWM_MonotonicNs( );
+    int64_t PWM_Commit = PWM_Now - PWM_Frame.PWM_PublishNs;
+    if( PWM_Commit > this->PWM_FrameMaxCommit.load( memory_order_relaxed ) )
+        this->PWM_FrameMaxCommit.store( PWM_Commit, memory_order_relaxed );
+    this->PWM_FrameTotalCommit.store( this->PWM_FrameTotalCommit.load( memory_order_relaxed ) + PWM_Commit, memory_order_relaxed );
+    int PWM_Bucket = PWM_LatencyBucket( PWM_Commit > 0 ? PWM_Commit : 0 );
+    this->PWM_FrameCommit[ PWM_Bucket ].store( this->PWM_FrameCommit[ PWM_Bucket ].load( memory_order_relaxed ) + 1, memory_order_relaxed );
+
+    // Seqlock write of the history entry, then the last commit : PWM_GetFrameCommit( ) reads them the other way round.
+    BBBPWMFrameCommit& PWM_Entry = this->PWM_FrameHistory[ PWM_Frame.PWM_Generation & ( PWM_FRAME_HISTORY - 1 ) ];
+    PWM_Entry.PWM_Generation.store( 0, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+    PWM_Entry.PWM_CommitNs.store( PWM_Now, memory_order_relaxed );
+    PWM_Entry.PWM_Generation.store( PWM_Frame.PWM_Generation, memory_order_release );
+    this->PWM_FrameLast.store( PWM_Frame.PWM_Generation, memory_order_release );
+
+    uint64_t PWM_Committed = this->PWM_FrameCommitted.load( memory_order_relaxed ) + 1;
+    this->PWM_FrameCommitted.store( PWM_Committed, memory_order_relaxed );
+    if( PWM_Committed % PWM_FRAME_REORDER == 0 )
+        this->PWM_FrameSort( );
+    for( size_t w = 0; w < this->PWM_FrameBits.size( ); w++ )
+        this->PWM_FrameBits[ w ] = 0;
+}
+
+/**
+ \fn private function void PWM_FrameSort( void )
+ \brief Orders the channels by the median write latency their device has measured, ties by channel.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicController< PWM_Backend >::PWM_FrameSort( void ) {
+    // Devices that do not time their writes all read 0 and keep channel order.
+    BBBPWMMetrics PWM_Metrics;
+    for( size_t c = 0; c < this->PWM_Devices.size( ); c++ ) {
+        this->PWM_Devices[ c ]->PWM_GetMetrics( PWM_Metrics );
+        this->PWM_FrameLatency[ c ] = PWM_LatencyPercentile( PWM_Metrics, 0.50 );
+        this->PWM_FrameOrder[ c ] = c;
+    }
+    const vector< uint64_t >& PWM_Latency = this->PWM_FrameLatency;
+    sort( this->PWM_FrameOrder.begin( ), this->PWM_FrameOrder.end( ), [ &PWM_Latency ]( int A, int B ) {
+        return PWM_Latency[ A ] != PWM_Latency[ B ] ? PWM_Latency[ A ] < PWM_Latency[ B ] : A < B;
+    } );
+}
+
+/**
+ \fn private function bool PWM_Reconcile( void )
+ \brief After the backend reports batched writes that failed, lets every device take back its failures and puts the
+ channels that must rewrite a value on the ramp tick.
+ \param <void>
+ \return <bool> true if at least one channel now has to be retried.
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicController< PWM_Backend >::PWM_Reconcile( void ) {
+    bool PWM_Retry = false;
+    for( size_t c = 0; c < this->PWM_Devices.size( ); c++ ) {
+        if( this->PWM_Devices[ c ]->PWM_Reconcile( ) & BBBPWMBasicDevice< PWM_Backend >::PWM_RAMPING ) {
+            this->PWM_Ramping[ c / 32 ] |= 1u << ( c % 32 );
+            PWM_Retry = true;
+            // The values rolled back and the error count moved.
+            this->PWM_Server.PWM_Publish( c, false );
+        }
+    }
+    return PWM_Retry;
+}
+
+/**
+ \fn private function void* PWM_Run( void *pwm_ctrl )
+ \brief Writer thread : blocks on PWM_WakeFD, PWM_TickFD and the timerfds of PWM_Player, PWM_Scheduler, PWM_Server and PWM_Failsafe, then has the player queue due profile records, the scheduler run the control loops if a tick is due and the server take shared memory commands on a poll, takes the newest frame, has the failsafe trip channels past their timeout on a check, writes every channel in the dirty set and steps every ramping channel on a tick.
+ Each pass is one backend batch (PWM_BatchBegin( ) / PWM_BatchEnd( )), a batching backend's descriptor is waited on as well.
+ \param <BBBPWMController> pwm_ctrl
+ \return <void> 0.
+ */
+template< class PWM_Backend >
+void* BBBPWMBasicController< PWM_Backend >::PWM_Run( void *pwm_ctrl ) {
+    BBBPWMBasicController< PWM_Backend >* PWM_Ctrl = ( BBBPWMBasicController< PWM_Backend >* ) pwm_ctrl;
+    vector< uint32_t >& PWM_Pending = PWM_Ctrl->PWM_Pending;
+    vector< uint32_t >& PWM_Ramping = PWM_Ctrl->PWM_Ramping;
+    BBBPWMPlayer< PWM_Backend >& PWM_Player = PWM_Ctrl->PWM_Player;
+    BBBPWMScheduler< PWM_Backend >& PWM_Scheduler = PWM_Ctrl->PWM_Scheduler;
+    BBBPWMServer< PWM_Backend >& PWM_Server = PWM_Ctrl->PWM_Server;
+    BBBPWMFailsafe< PWM_Backend >& PWM_Failsafe = PWM_Ctrl->PWM_Failsafe;
+    struct pollfd PWM_Wait[ 7 ] = { { PWM_Ctrl->PWM_WakeFD, POLLIN, 0 }, { PWM_Ctrl->PWM_TickFD, POLLIN, 0 }, { PWM_Player.PWM_GetFD( ), POLLIN, 0 },
+                                    { PWM_Scheduler.PWM_GetFD( ), POLLIN, 0 }, { PWM_Server.PWM_GetFD( ), POLLIN, 0 },
+                                    { PWM_Failsafe.PWM_GetFD( ), POLLIN, 0 }, { -1, POLLIN, 0 } };
+    uint64_t PWM_Wakeups;
+    uint64_t PWM_Ticks = 0;
+    bool PWM_TickArmed = false;
+    if( PWM_Ctrl->PWM_RealtimeOn )
+        PWM_Ctrl->PWM_Prefault( );
+
+    while( !PWM_Ctrl->PWM_StopRequested.load( memory_order_relaxed ) ) {
+        // Writes batched by earlier passes that have failed since go back to their channels, to be retried on the tick.
+        if( PWM_Backend::PWM_BatchBegin( ) > 0 )
+            PWM_Ctrl->PWM_Reconcile( );
+        PWM_Wait[ 6 ].fd = PWM_Backend::PWM_BatchFD( );
+
+        // Playback first : records that are due become ordinary targets, so the pass below writes them.
+        int64_t PWM_Scheduled = 0;
+        uint64_t PWM_Played = PWM_Player.PWM_Run( PWM_Scheduled );
+        // Then the control loops : their outputs are written by this same pass, before the next tick can run.
+        int64_t PWM_ControlDue = 0;
+        bool PWM_Controlled = PWM_Scheduler.PWM_Run( PWM_ControlDue );
+        // And commands from other processes on a poll, same again.
+        PWM_Server.PWM_Run( );
+        // The newest frame last, so its values win over anything else handed to the same channels this pass.
+        bool PWM_Framed = PWM_Ctrl->PWM_FrameTake( );
+
+        // Take the whole dirty set in one go, acquire pairs with the callers' OR so their targets are visible.
+        for( size_t w = 0; w < PWM_Pending.size( ); w++ )
+            PWM_Pending[ w ] = PWM_Ctrl->PWM_Table->PWM_Dirty[ w ].exchange( 0, memory_order_acquire );
+        // Every new duty target feeds the watchdog, channels it trips join the set.
+        bool PWM_Tripped = PWM_Failsafe.PWM_Run( );
+
+        // A frame's channels go out first and together, in write latency order.
+        if( PWM_Framed )
+            PWM_Ctrl->PWM_FrameWrite( PWM_Ticks );
+
+        // On a tick every ramping channel steps, otherwise only dirty ones are looked at (and slewed ones just join the ramp).
+        bool PWM_AnyRamping = false;
+        for( size_t w = 0; w < PWM_Pending.size( ); w++ ) {
+            uint32_t PWM_Bits = ( PWM_Pending[ w ] | ( PWM_Ticks ? PWM_Ramping[ w ] : 0 ) ) & ~PWM_Ctrl->PWM_FrameBits[ w ];
+            while( PWM_Bits ) {
+                int PWM_Bit = __builtin_ctz( PWM_Bits );
+                PWM_Bits &= PWM_Bits - 1;
+                PWM_Ctrl->PWM_Step( w * 32 + PWM_Bit, PWM_Ticks );
+            }
+            PWM_AnyRamping |= PWM_Ramping[ w ] != 0;
+        }
+        PWM_Ticks = 0;
+        // Everything the pass wrote goes out here, in one submission for a batching backend.
+        if( PWM_Backend::PWM_BatchEnd( ) > 0 )
+            PWM_AnyRamping |= PWM_Ctrl->PWM_Reconcile( );
+        bool PWM_PlayDue = PWM_Played > 0 && PWM_Player.PWM_Stamp( PWM_Played, PWM_Scheduled );
+        if( PWM_Controlled )
+            PWM_Scheduler.PWM_Stamp( PWM_ControlDue );
+        if( PWM_Framed )
+            PWM_Ctrl->PWM_FrameStamp( );
+        if( PWM_Tripped )
+            PWM_Failsafe.PWM_Stamp( );
+
+        // The tick only runs while something is ramping, so an idle controller costs no wakeups.
+        if( PWM_AnyRamping != PWM_TickArmed ) {
+            PWM_Ctrl->PWM_ArmTick( PWM_AnyRamping );
+            PWM_TickArmed = PWM_AnyRamping;
+        }
+
+        if( PWM_PlayDue )
+            continue;
+
+        // Announce we are about to sleep, then re-check : anything marked after this point will bump the eventfd.
+        PWM_Ctrl->PWM_Sleeping.store( true );
+        if( PWM_Ctrl->PWM_HasDirty( ) || ( PWM_Ctrl->PWM_FrameMailbox.load( ) & PWM_FRAME_FRESH ) || PWM_Ctrl->PWM_StopRequested.load( ) ) {
+            PWM_Ctrl->PWM_Sleeping.store( false, memory_order_relaxed );
+            continue;
+        }
+
+        // Sleep until PWM_MarkDirty( ) or PWM_Stop( ) bumps the eventfd or the tick fires, several bumps collapse into one pass.
+        // A batching backend's descriptor turns readable as its writes complete, the next pass reaps them.
+        // The control tick is only a wakeup here, the scheduler reads it at the top of the next pass.
+        // With a coalescing window a wakeup holds the pass until the window closes, so the rest of a burst lands in the dirty
+        // set : PWM_Sleeping is clear so callers do not pay for a wakeup meanwhile, and any other descriptor ends the hold.
+        int64_t PWM_HoldEnd = 0;
+        bool PWM_Failed = false;
+        for( ;; ) {
+            struct timespec PWM_Left;
+            if( PWM_HoldEnd > 0 ) {
+                int64_t PWM_LeftNs = PWM_HoldEnd - PWM_MonotonicNs( );
+                if( PWM_LeftNs <= 0 )
+                    break;
+                PWM_Left.tv_sec = PWM_LeftNs / 1000000000L;
+                PWM_Left.tv_nsec = PWM_LeftNs % 1000000000L;
+            }
+            int PWM_Ready = ppoll( PWM_Wait, 7, PWM_HoldEnd > 0 ? &PWM_Left : NULL, NULL );
+            PWM_Ctrl->PWM_Sleeping.store( false, memory_order_relaxed );
+            if( PWM_Ready < 0 ) {
+                if( errno != EINTR ) {
+                    cerr << "Error - PWM writer thread unable to wait for updates : " << strerror( errno ) << endl;
+                    PWM_Failed = true;
+                }
+                // Nothing was returned : stale revents from the last wait must not pass for expiries.
+                for( int i = 0; i < 7; i++ )
+                    PWM_Wait[ i ].revents = 0;
+                break;
+            }
+            if( PWM_Wait[ 0 ].revents & POLLIN ) {
+                if( read( PWM_Ctrl->PWM_WakeFD, &PWM_Wakeups, sizeof( PWM_Wakeups ) ) < 0 )
+                    cerr << "Error - PWM writer thread unable to read its eventfd : " << strerror( errno ) << endl;
+            }
+            bool PWM_Other = false;
+            for( int i = 1; i < 7; i++ )
+                PWM_Other |= PWM_Wait[ i ].revents != 0;
+            long PWM_Window = PWM_Ctrl->PWM_CoalesceNs.load( memory_order_relaxed );
+            if( PWM_Ready == 0 || PWM_Other || PWM_Window <= 0 || PWM_Ctrl->PWM_StopRequested.load( memory_order_relaxed ) )
+                break;
+            if( PWM_HoldEnd == 0 )
+                PWM_HoldEnd = PWM_MonotonicNs( ) + PWM_Window;
+        }
+        if( PWM_Failed )
+            break;
+        // The expiration count carries any ticks we were late for, ramps catch up instead of drifting.
+        if( ( PWM_Wait[ 1 ].revents & POLLIN ) && read( PWM_Ctrl->PWM_TickFD, &PWM_Ticks, sizeof( PWM_Ticks ) ) < 0 )
+            PWM_Ticks = 0;
+        if( PWM_Wait[ 2 ].revents & POLLIN )
+            PWM_Player.PWM_Expire( );
+        if( PWM_Wait[ 4 ].revents & POLLIN )
+            PWM_Server.PWM_Expire( );
+        if( PWM_Wait[ 5 ].revents & POLLIN )
+            PWM_Failsafe.PWM_Expire( );
+    }
+    // Failures of the last batches reaped so far go back to their channels too, so values read after PWM_Stop( ) are the kernel's.
+    if( PWM_Backend::PWM_BatchBegin( ) > 0 )
+        PWM_Ctrl->PWM_Reconcile( );
+    PWM_Backend::PWM_BatchEnd( );
+
+    return 0;
+}
+
+template class BBBPWMBasicController< BBBPWMSysfsBackend >;
+template class BBBPWMBasicController< BBBPWMSimBackend >;
+template class BBBPWMBasicController< BBBPWMNullBackend >;
+template class BBBPWMBasicController< BBBPWMUringBackend >;
+template class BBBPWMBasicController< BBBPWMEhrpwmBackend >;
+template class BBBPWMBasicController< BBBPWMClassBackend >;
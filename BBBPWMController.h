@@ -0,0 +1,632 @@
+//  BBBPWMController.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMController_h
+#define BBBPWMController_h
+
+#include "BBBPWMDevice.h"
+#include "BBBPWMPlayer.h"
+#include "BBBPWMScheduler.h"
+#include "BBBPWMServer.h"
+#include "BBBPWMFailsafe.h"
+#include "BBBPWMCalibration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <alloca.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define PWM_DEFAULT_TICK_NS    1000000 //!< Default ramp tick, 1 kHz.
+#define PWM_FRAME_KEEP         -1 //!< Frame period or run entry that leaves the channel's value as it is.
+#define PWM_FRAME_HISTORY      256 //!< Most recent committed frames PWM_GetFrameCommit( ) can give the time of, a power of two.
+#define PWM_FRAME_REORDER      1024 //!< Frames committed between two sorts of the channels by write latency.
+#define PWM_FRAME_FRESH        4 //!< Set in the frame mailbox while it holds a frame the writer has not taken.
+#define PWM_RT_STACK           ( 256 * 1024 ) //!< Writer stack size in real-time mode, unless set.
+#define PWM_RT_PREFAULT        ( 64 * 1024 ) //!< Stack the writer touches before its first pass in real-time mode, unless set.
+
+using namespace std;
+
+/**
+ \brief One buffer of the frame triple buffer, see BBBPWMController::PWM_SetFrame( ).
+ */
+struct BBBPWMFrame {
+    int64_t PWM_Generation; //!< Number PWM_SetFrame( ) returned for it.
+    int64_t PWM_PublishNs; //!< CLOCK_MONOTONIC when it was published.
+    int PWM_Count; //!< It sets channels 0 - PWM_Count - 1.
+    bool PWM_HasPeriod; //!< PWM_Period holds values.
+    bool PWM_HasRun; //!< PWM_Run holds values.
+    vector< int > PWM_Duty; //!< Target duty per channel in ns.
+    vector< int > PWM_Period; //!< Period per channel in ns, or PWM_FRAME_KEEP.
+    vector< int > PWM_Run; //!< Run value per channel, or PWM_FRAME_KEEP.
+};
+
+/**
+ \brief Commit time of one frame, kept in a ring of PWM_FRAME_HISTORY under a seqlock (generation 0 while being written).
+ */
+struct BBBPWMFrameCommit {
+    atomic< int64_t > PWM_Generation; //!< Frame the entry is for.
+    atomic< int64_t > PWM_CommitNs; //!< CLOCK_MONOTONIC when its writes were issued.
+};
+
+/**
+ \brief Frames since the controller was made, filled in by BBBPWMController::PWM_GetFrameStats( ).
+ */
+struct BBBPWMFrameStats {
+    uint64_t PWM_Published; //!< Frames handed to PWM_SetFrame( ).
+    uint64_t PWM_Committed; //!< Frames the writer wrote.
+    uint64_t PWM_Dropped; //!< Frames superseded by a newer one before the writer started them.
+    int64_t PWM_MaxCommitNs; //!< Longest from a frame's publication until its writes were issued.
+    int64_t PWM_TotalCommitNs; //!< Sum of all publication to commit times, PWM_TotalCommitNs / PWM_Committed is the mean.
+    uint64_t PWM_Commit[ PWM_LATENCY_BUCKETS ]; //!< Publication to commit times bucketed like write latencies, see PWM_BucketPercentile( ).
+};
+
+/**
+ \brief Real-time settings of the writer thread, see BBBPWMController::PWM_SetRealtime( ).
+ */
+struct BBBPWMRealtime {
+    int PWM_Priority; //!< SCHED_FIFO priority, 1 - 99, 0 leaves the writer SCHED_OTHER.
+    int PWM_Cpu; //!< CPU the writer is pinned to, -1 for any.
+    bool PWM_LockMemory; //!< mlockall( MCL_CURRENT | MCL_FUTURE ) before the writer starts. Process wide, never undone.
+    size_t PWM_StackBytes; //!< Writer stack size, 0 for PWM_RT_STACK.
+    size_t PWM_PrefaultBytes; //!< Stack the writer touches before its first pass, 0 for PWM_RT_PREFAULT.
+};
+
+/*!
+ *  \brief     BBBPWMController services any number of BBBPWMDevice channels from a single writer thread.
+ *  \details   PWM_SetTargetSpeed( ) on a registered device marks its channel in a dirty set and wakes the writer, which
+ *             then writes only the channels that changed since its last pass. The hand-off is lock-free : callers set a
+ *             bit with an atomic OR and only touch the eventfd when the writer has announced it is about to sleep.
+ *             Channels with a slew set (BBBPWMDevice::PWM_SetDutySlew( )) are stepped on a fixed timerfd tick instead,
+ *             which is only armed while at least one ramp is in flight. The rest of the writer's work is done by
+ *             components it calls on each pass, each owning its own timerfd : a BBBPWMPlayer plays a BBBPWMProfile back
+ *             at each record's absolute time (PWM_Play( )), a BBBPWMScheduler runs the control loops registered with
+ *             PWM_AddControl( ) on a fixed rate tick, their outputs becoming targets in the pass that follows so a
+ *             tick's writes are out before the next tick, a BBBPWMServer lets other processes drive the channels through
+ *             a BBBPWMShm segment it polls (PWM_Serve( )), and a BBBPWMFailsafe watchdog (PWM_SetFailsafe( )) drives a
+ *             channel that has gone without a new target for too long to a safe duty, or stops it. A set of targets
+ *             that must never be seen half applied is published as a frame (PWM_SetFrame( )), which the writer commits
+ *             whole in a single pass. With a BBBPWMCalibration set
+ *             (PWM_SetCalibration( )), targets can be given as throttles from 0 to 1 instead of duties. The writer can
+ *             run SCHED_FIFO, pinned and with its memory locked and prefaulted (PWM_SetRealtime( )). Every channel's duty
+ *             target, committed duty, slew and dirty bit sit in one BBBPWMChannelTable shared with its device, so a
+ *             dirty scan or a frame over many channels walks a few contiguous arrays. BBBPWMController
+ *             drives BBBPWMDevice channels, BBBPWMUringController BBBPWMUringDevice ones (every write of a pass in one
+ *             io_uring submission), BBBPWMEhrpwmController BBBPWMEhrpwmDevice ones (register stores),
+ *             BBBPWMClassController BBBPWMClassDevice ones (/sys/class/pwm), BBBPWMSimController and
+ *             BBBPWMNullController the simulated and null ones. Usage :
+ *             \code
+ *             BBBPWMController Controller;
+ *             Motor.PWM_SetBlockNum( BBBPWMDevice::P9 );
+ *             Motor.PWM_SetPinNum( BBBPWMDevice::PWM42 );
+ *             Controller.PWM_AddDevice( &Motor );   // before PWM_Init( ), so the device does not start its own writer
+ *             Motor.PWM_Init( );
+ *             Controller.PWM_Start( );
+ *             \endcode
+ *             With many devices, PWM_Reserve( ) room for all of them, PWM_AddDevice( ) each and call PWM_InitDevices( )
+ *             instead of their PWM_Init( ) : the channel table is allocated once, the pins are attached together (one
+ *             wait for all the overlays) and a failure is reported per channel.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMBasicController {
+
+public:
+
+    /**
+     \fn public function int PWM_Reserve( int Channels )
+     \brief Sizes the channel table for Channels devices up front, so that PWM_AddDevice( ) never moves it. Call before
+     the first PWM_AddDevice( ), or while no other thread uses a device already added.
+     \param <int> Channels
+     \return <int> -1 controller running, Channels below the devices added or out of memory, 1 success.
+     */
+    int PWM_Reserve( int Channels );
+
+    /**
+     \fn public function int PWM_AddDevice( BBBPWMBasicDevice< PWM_Backend >* Device )
+     \brief Registers a device with this controller, must be called before PWM_Start( ) and before the device's PWM_Init( ).
+     Within the room made by PWM_Reserve( ) the channel table does not move, and other threads may keep using the devices
+     already added. Without a reservation it is reallocated on every call : the devices already added must not be used
+     meanwhile. Past a reservation it is refused, and so is a device that already belongs to a controller (this one,
+     another one, or its own private one started by PWM_Init( )).
+     \param <BBBPWMBasicDevice<PWM_Backend>>* Device
+     \return <int> -1 controller already running, no device, device already driven, reservation full or out of memory, >= 0 the channel index of the device.
+     */
+    int PWM_AddDevice( BBBPWMBasicDevice< PWM_Backend >* Device );
+
+    /**
+     \fn public function int PWM_InitDevices( vector< int >& Status )
+     \brief Sets up every registered device in one go with BBBPWMDevice::PWM_InitAll( ), instead of PWM_Init( ) on each. Call before PWM_Start( ).
+     \param <vector<int>>& Status (one per channel, 1 ready, 0 unable to attach, -1 unable to load its values)
+     \return <int> number of devices ready.
+     */
+    int PWM_InitDevices( vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Start( void )
+     \brief Starts the shared writer thread.
+     \param <void>
+     \return <int> -1 failure to start the writer thread, 1 success.
+     */
+    int PWM_Start( void );
+
+    /**
+     \fn public function int PWM_SetRealtime( const BBBPWMRealtime& Realtime )
+     \brief Runs the writer thread in real-time mode from the next PWM_Start( ) : created SCHED_FIFO at the given
+     priority, pinned to a CPU, on a stack of the given size, with the process memory locked if asked. Before its
+     first pass the writer faults in its stack and takes its trace ring, so that a pass never faults or allocates.
+     PWM_Start( ) fails if the settings cannot be applied (SCHED_FIFO needs CAP_SYS_NICE or an RLIMIT_RTPRIO).
+     \param const <BBBPWMRealtime>& Realtime
+     \return <int> -1 controller running or a setting out of range, 1 success.
+     */
+    int PWM_SetRealtime( const BBBPWMRealtime& Realtime );
+
+    /**
+     \fn public function void PWM_Stop( void )
+     \brief Stops the shared writer thread and waits for it to exit. Safe to call more than once. Must be called before any registered device is destroyed.
+     Setters may race it : an update either lands before the writer exits or waits in the dirty set for the next PWM_Start( ),
+     which must not itself race PWM_SetFrame( ) or PWM_SetFrameThrottle( ) since it resets the frame buffers.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Stop( void );
+
+    /**
+     \fn public function bool PWM_MarkDirty( int Channel )
+     \brief Adds a channel to the dirty set and wakes the writer thread if it is asleep. Lock-free, callable from any thread.
+     \param <int> Channel
+     \return <bool> false if the channel was already dirty, i.e. this update was coalesced with a pending one.
+     */
+    bool PWM_MarkDirty( int Channel );
+
+    /**
+     \fn public function void PWM_SetCoalesceWindow( long Nanoseconds )
+     \brief After being woken by a new target the writer waits this long before writing, so a burst of updates costs one write per channel. Timers and completions due meanwhile are still served, and end the wait early. Defaults to 0 (write straight away).
+     \param <long> Nanoseconds
+     \return <void>
+     */
+    void PWM_SetCoalesceWindow( long Nanoseconds );
+
+    /**
+     \fn public function long PWM_GetCoalesceWindow( void ) const
+     \brief Returns the coalescing window in nanoseconds.
+     \param <void>
+     \return <long> this->PWM_CoalesceNs
+     */
+    long PWM_GetCoalesceWindow( void ) const;
+
+    /**
+     \fn public function void PWM_SetTickPeriod( long Nanoseconds )
+     \brief Sets the ramp tick period, must be called before PWM_Start( ). Defaults to PWM_DEFAULT_TICK_NS.
+     \param <long> Nanoseconds
+     \return <void>
+     */
+    void PWM_SetTickPeriod( long Nanoseconds );
+
+    /**
+     \fn public function long PWM_GetTickPeriod( void ) const
+     \brief Returns the ramp tick period in nanoseconds.
+     \param <void>
+     \return <long> this->PWM_TickNs
+     */
+    long PWM_GetTickPeriod( void ) const;
+
+    /**
+     \fn public function int PWM_GetDeviceCount( void ) const
+     \brief Returns the number of devices registered with this controller.
+     \param <void>
+     \return <int> this->PWM_Devices.size( )
+     */
+    int PWM_GetDeviceCount( void ) const;
+
+    /**
+     \fn public function const BBBPWMChannelTable& PWM_GetChannelTable( void ) const
+     \brief Returns the table holding every channel's duty target and committed duty, e.g. to read them all in one pass.
+     \param <void>
+     \return <const BBBPWMChannelTable>& *this->PWM_Table
+     */
+    const BBBPWMChannelTable& PWM_GetChannelTable( void ) const;
+
+    /**
+     \fn public function uint64_t PWM_GetWriteCount( void ) const
+     \brief Returns the number of duty values written by the writer thread since PWM_Start( ).
+     \param <void>
+     \return <uint64_t> this->PWM_WriteCount
+     */
+    uint64_t PWM_GetWriteCount( void ) const;
+
+    /**
+     \fn public function int PWM_AddControl( int Channel, BBBPWMControlFn Callback, void* Arg )
+     \brief Registers a control callback, run by the writer thread every control period from PWM_Start( ) on. Its return
+     value becomes the channel's target as if passed to PWM_SetTargetSpeed( ), and is written in the same pass. Callbacks
+     run in the order they were added. Must be called before PWM_Start( ).
+     \param <int> Channel
+     \param <BBBPWMControlFn> Callback
+     \param <void>* Arg
+     \return <int> -1 controller running or no such channel, >= 0 the index of the callback.
+     */
+    int PWM_AddControl( int Channel, BBBPWMControlFn Callback, void* Arg );
+
+    /**
+     \fn public function void PWM_SetControlPeriod( long Nanoseconds )
+     \brief Sets the control tick period, must be called before PWM_Start( ). Defaults to PWM_DEFAULT_CONTROL_NS.
+     \param <long> Nanoseconds
+     \return <void>
+     */
+    void PWM_SetControlPeriod( long Nanoseconds );
+
+    /**
+     \fn public function long PWM_GetControlPeriod( void ) const
+     \brief Returns the control tick period in nanoseconds.
+     \param <void>
+     \return <long> this->PWM_Scheduler.PWM_GetPeriod( )
+     */
+    long PWM_GetControlPeriod( void ) const;
+
+    /**
+     \fn public function void PWM_GetControlStats( BBBPWMControlStats& Stats ) const
+     \brief Copies the timing of the control ticks since PWM_Start( ). Lock-free.
+     \param <BBBPWMControlStats>& Stats
+     \return <void>
+     */
+    void PWM_GetControlStats( BBBPWMControlStats& Stats ) const;
+
+    /**
+     \fn public function int PWM_Serve( BBBPWMShm* Shm, long PollNs )
+     \brief Takes commands for every channel from a shared memory segment made with BBBPWMShm::PWM_Create( ), polled by
+     the writer thread every PollNs, and publishes each channel's status to it. NULL stops serving. Must be called before
+     PWM_Start( ), the segment must stay mapped while the controller runs.
+     \param <BBBPWMShm>* Shm
+     \param <long> PollNs (0 for PWM_DEFAULT_SERVE_NS)
+     \return <int> -1 controller running or fewer slots than channels, 1 success.
+     */
+    int PWM_Serve( BBBPWMShm* Shm, long PollNs );
+
+    /**
+     \fn public function int64_t PWM_SetFrame( const int* Duties, int Count, const int* Periods, const int* Runs )
+     \brief Publishes the targets of channels 0 - Count - 1 as one frame : the writer commits all of them in the same
+     pass, channels with the lowest write latency first, and drops a frame replaced by a newer one before it got to it.
+     Periods and Runs may be NULL, or hold PWM_FRAME_KEEP for channels to leave alone. A channel with a slew starts its
+     ramp in that pass. Lock-free, but frames must come from one thread at a time. The controller must be running, a frame
+     published while PWM_Stop( ) runs may be dropped.
+     \param const <int>* Duties
+     \param <int> Count
+     \param const <int>* Periods
+     \param const <int>* Runs
+     \return <int64_t> -1 controller not running or Count out of range, > 0 the frame's generation number.
+     */
+    int64_t PWM_SetFrame( const int* Duties, int Count, const int* Periods, const int* Runs );
+
+    /**
+     \fn public function int64_t PWM_GetFrameCommit( int64_t Frame ) const
+     \brief Returns the CLOCK_MONOTONIC time a frame's writes were issued. Lock-free.
+     \param <int64_t> Frame (generation returned by PWM_SetFrame( ))
+     \return <int64_t> ns, 0 not committed yet, -1 dropped or older than the last PWM_FRAME_HISTORY commits.
+     */
+    int64_t PWM_GetFrameCommit( int64_t Frame ) const;
+
+    /**
+     \fn public function int PWM_SetCalibration( BBBPWMCalibration* Calibration )
+     \brief Sets the curves PWM_SetThrottle( ) and PWM_SetFrameThrottle( ) convert through, NULL for none. Must be called
+     before PWM_Start( ) and stay alive while the controller runs, its curves may be swapped at any time.
+     \param <BBBPWMCalibration>* Calibration
+     \return <int> -1 controller running or fewer curves than channels, 1 success.
+     */
+    int PWM_SetCalibration( BBBPWMCalibration* Calibration );
+
+    /**
+     \fn public function int PWM_SetThrottle( int Channel, float Throttle )
+     \brief Converts a throttle from 0 to 1 through the channel's curve and sets it as the channel's target. Lock-free.
+     \param <int> Channel
+     \param <float> Throttle
+     \return <int> -1 no calibration set or no such channel, 1 success.
+     */
+    int PWM_SetThrottle( int Channel, float Throttle );
+
+    /**
+     \fn public function int64_t PWM_SetFrameThrottle( const float* Throttles, int Count )
+     \brief PWM_SetFrame( ) with throttles from 0 to 1 : channels 0 - Count - 1 are converted in one vector pass straight
+     into the frame buffer, then published. Same threading rules as PWM_SetFrame( ).
+     \param const <float>* Throttles
+     \param <int> Count
+     \return <int64_t> -1 no calibration set, controller not running or Count out of range, > 0 the frame's generation number.
+     */
+    int64_t PWM_SetFrameThrottle( const float* Throttles, int Count );
+
+    /**
+     \fn public function void PWM_GetFrameStats( BBBPWMFrameStats& Stats ) const
+     \brief Copies the frame counters and publication to commit times. Lock-free.
+     \param <BBBPWMFrameStats>& Stats
+     \return <void>
+     */
+    void PWM_GetFrameStats( BBBPWMFrameStats& Stats ) const;
+
+    /**
+     \fn public function int PWM_SetFailsafe( int Channel, int TimeoutMs, int SafeDuty )
+     \brief Watches a channel from PWM_Start( ) on : if it gets no new target (from any source) for TimeoutMs, the writer
+     sets its target to SafeDuty, or with PWM_FAILSAFE_DISABLE sets its run value to OFF. The next target clears the
+     trip, a channel stopped through run stays stopped until PWM_SetRunVal( ). Ramp cancels and period changes do not
+     count as targets. Costs one relaxed OR per target on the update path, the writer checks every channel on one shared
+     timer. Must be called before PWM_Start( ).
+     \param <int> Channel
+     \param <int> TimeoutMs (0 to stop watching it)
+     \param <int> SafeDuty (ns, or PWM_FAILSAFE_DISABLE)
+     \return <int> -1 controller running, no such channel or duty out of range, 1 success.
+     */
+    int PWM_SetFailsafe( int Channel, int TimeoutMs, int SafeDuty );
+
+    /**
+     \fn public function bool PWM_IsFailsafe( int Channel ) const
+     \brief Checks whether a channel is tripped, i.e. held at its failsafe since its timeout. Lock-free.
+     \param <int> Channel
+     \return <bool> true if tripped.
+     */
+    bool PWM_IsFailsafe( int Channel ) const;
+
+    /**
+     \fn public function void PWM_GetFailsafeStats( BBBPWMFailsafeStats& Stats ) const
+     \brief Copies the watchdog trips and how late they were written since PWM_Start( ). Lock-free.
+     \param <BBBPWMFailsafeStats>& Stats
+     \return <void>
+     */
+    void PWM_GetFailsafeStats( BBBPWMFailsafeStats& Stats ) const;
+
+    /**
+     \fn public function int PWM_Play( BBBPWMProfile* Profile, long LeadNs )
+     \brief Plays a profile from the writer thread : each record's duty and period are handed to its channel at
+     its scheduled CLOCK_MONOTONIC time, LeadNs after this call, replacing any playback already running. Ordinary
+     PWM_SetTargetSpeed( ) calls still work and interleave with the profile. The controller must be running and
+     Profile must stay open until playback ends.
+     \param <BBBPWMProfile>* Profile
+     \param <long> LeadNs (delay before the profile's time 0)
+     \return <int> -1 controller not running or empty profile, 1 playback scheduled.
+     */
+    int PWM_Play( BBBPWMProfile* Profile, long LeadNs );
+
+    /**
+     \fn public function void PWM_StopPlayback( void )
+     \brief Stops a running playback, channels keep the last value played.
+     \param <void>
+     \return <void>
+     */
+    void PWM_StopPlayback( void );
+
+    /**
+     \fn public function bool PWM_IsPlaying( void ) const
+     \brief Checks whether a playback is scheduled or running.
+     \param <void>
+     \return <bool> this->PWM_Player.PWM_IsPlaying( )
+     */
+    bool PWM_IsPlaying( void ) const;
+
+    /**
+     \fn public function void PWM_GetPlaybackStats( BBBPWMPlaybackStats& Stats ) const
+     \brief Copies the timing error of the current (or last) playback, measured from each record's scheduled time until its values were written. Lock-free.
+     \param <BBBPWMPlaybackStats>& Stats
+     \return <void>
+     */
+    void PWM_GetPlaybackStats( BBBPWMPlaybackStats& Stats ) const;
+
+    /**
+     \brief BBBPWMController : A single writer thread shared by many PWM devices.
+     \param <void>
+     */
+    BBBPWMBasicController( );
+
+    /**
+     \brief ~BBBPWMController : Stops the writer thread.
+     */
+    ~BBBPWMBasicController( );
+
+protected:
+
+    friend class BBBPWMPlayer< PWM_Backend >;
+    friend class BBBPWMScheduler< PWM_Backend >;
+    friend class BBBPWMServer< PWM_Backend >;
+    friend class BBBPWMFailsafe< PWM_Backend >;
+
+    vector< BBBPWMBasicDevice< PWM_Backend >* > PWM_Devices; //!< Registered devices, indexed by channel.
+    bool PWM_Reserved; //!< PWM_Reserve( ) sized the channel table, PWM_AddDevice( ) must not move it.
+    shared_ptr< BBBPWMChannelTable > PWM_Table; //!< Hot state of every channel, indexed by channel and shared with its device. Holds the dirty set.
+    vector< uint32_t > PWM_Pending; //!< Writer-side copy of the dirty set, sized in PWM_Start( ) so a pass never allocates.
+    vector< uint32_t > PWM_Ramping; //!< Writer-only, one bit per channel still ramping towards its target.
+
+    pthread_t PWM_Thread; //!< The shared writer thread.
+
+    int PWM_WakeFD; //!< eventfd the writer thread blocks on until PWM_MarkDirty( ) or PWM_Stop( ) signals it, open from construction to destruction.
+    int PWM_TickFD; //!< timerfd driving ramps, armed by the writer only while PWM_Ramping is not empty.
+    long PWM_TickNs; //!< Ramp tick period in nanoseconds.
+    atomic< long > PWM_CoalesceNs; //!< How long the writer lets updates pile up after a wakeup, 0 = no wait.
+    atomic< bool > PWM_Running; //!< True while the writer thread is running, stored with release by PWM_Start( ) / PWM_Stop( ), loaded with acquire.
+    bool PWM_RealtimeOn; //!< PWM_SetRealtime( ) was called, PWM_Realtime applies to the writer.
+    BBBPWMRealtime PWM_Realtime; //!< Real-time settings, with the defaults filled in.
+
+    alignas( PWM_CACHE_LINE ) atomic< bool > PWM_Sleeping; //!< Set by the writer just before it blocks, tells callers the eventfd must be bumped.
+    atomic< bool > PWM_StopRequested; //!< Set by PWM_Stop( ) to make the writer thread exit.
+
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_WriteCount; //!< Duty values written by the writer thread, only ever stored by the writer.
+
+    BBBPWMPlayer< PWM_Backend > PWM_Player; //!< Profile playback, owns the playback timerfd.
+    BBBPWMScheduler< PWM_Backend > PWM_Scheduler; //!< Control loops, owns the control timerfd.
+    BBBPWMServer< PWM_Backend > PWM_Server; //!< Shared memory commands and status, owns the poll timerfd.
+    BBBPWMFailsafe< PWM_Backend > PWM_Failsafe; //!< Watchdog of the channels' targets, owns the check timerfd.
+
+    BBBPWMCalibration* PWM_Calibration; //!< Curves throttles are converted through, set by PWM_SetCalibration( ), NULL if none.
+
+    // Frames, a triple buffer : the publisher fills PWM_FrameBack and swaps it into PWM_FrameMailbox, the writer swaps
+    // PWM_FrameFront out of it when it holds a fresh frame. Buffers are sized in PWM_Start( ).
+    BBBPWMFrame PWM_Frames[ 3 ]; //!< The three buffers.
+    alignas( PWM_CACHE_LINE ) atomic< int > PWM_FrameMailbox; //!< Index of the buffer last published, | PWM_FRAME_FRESH until the writer takes it.
+    int PWM_FrameBack; //!< Publisher only, buffer the next frame is built in.
+    atomic< int64_t > PWM_FrameGeneration; //!< Publisher only, generation of the last frame published.
+    atomic< uint64_t > PWM_FramePublished; //!< Publisher only, frames published.
+    atomic< uint64_t > PWM_FrameDropped; //!< Publisher only, frames superseded before the writer took them.
+    int PWM_FrameFront; //!< Writer only, buffer holding the frame being committed.
+    vector< uint32_t > PWM_FrameBits; //!< Writer only, one bit per channel of the frame taken this pass.
+    vector< int > PWM_FrameOrder; //!< Writer only, channels by ascending median write latency.
+    vector< uint64_t > PWM_FrameLatency; //!< Writer only, scratch for sorting PWM_FrameOrder.
+
+    // Frame commits, stored by the writer only, read by PWM_GetFrameCommit( ) and PWM_GetFrameStats( ).
+    alignas( PWM_CACHE_LINE ) atomic< int64_t > PWM_FrameLast; //!< Generation of the last frame committed, 0 if none.
+    atomic< uint64_t > PWM_FrameCommitted; //!< Frames committed.
+    atomic< int64_t > PWM_FrameMaxCommit; //!< Longest publication to commit time in ns.
+    atomic< int64_t > PWM_FrameTotalCommit; //!< Sum of publication to commit times in ns.
+    atomic< uint64_t > PWM_FrameCommit[ PWM_LATENCY_BUCKETS ]; //!< Publication to commit histogram.
+    BBBPWMFrameCommit PWM_FrameHistory[ PWM_FRAME_HISTORY ]; //!< Commit times, indexed by generation % PWM_FRAME_HISTORY.
+
+    /**
+     \fn private function bool PWM_HasDirty( void ) const
+     \brief Checks whether any channel is in the dirty set.
+     \param <void>
+     \return <bool> true if at least one dirty bit is set.
+     */
+    bool PWM_HasDirty( void ) const;
+
+    /**
+     \fn private function int PWM_Step( size_t PWM_Channel, uint64_t PWM_Ticks )
+     \brief Writer pass for one channel : PWM_Update( ), then the write count, its ramping bit and its status slot.
+     \param <size_t> PWM_Channel
+     \param <uint64_t> PWM_Ticks (ramp ticks elapsed, 0 between ticks)
+     \return <int> PWM_UpdateFlags of the device.
+     */
+    int PWM_Step( size_t PWM_Channel, uint64_t PWM_Ticks );
+
+    /**
+     \fn private function int64_t PWM_PublishFrame( int PWM_Count, bool PWM_HasPeriod, bool PWM_HasRun )
+     \brief Stamps the frame filled in PWM_FrameBack and hands it to the writer.
+     \param <int> PWM_Count
+     \param <bool> PWM_HasPeriod
+     \param <bool> PWM_HasRun
+     \return <int64_t> the frame's generation number.
+     */
+    int64_t PWM_PublishFrame( int PWM_Count, bool PWM_HasPeriod, bool PWM_HasRun );
+
+    /**
+     \fn private function bool PWM_FrameTake( void )
+     \brief If a frame was published since the last one taken, takes it and hands its values to its channels : they
+     become targets PWM_FrameWrite( ) writes in the same pass.
+     \param <void>
+     \return <bool> true if a frame was taken.
+     */
+    bool PWM_FrameTake( void );
+
+    /**
+     \fn private function void PWM_FrameWrite( uint64_t PWM_Ticks )
+     \brief Writes the channels of the frame taken by PWM_FrameTake( ) in PWM_FrameOrder, the rest of the pass skips them.
+     \param <uint64_t> PWM_Ticks
+     \return <void>
+     */
+    void PWM_FrameWrite( uint64_t PWM_Ticks );
+
+    /**
+     \fn private function void PWM_FrameStamp( void )
+     \brief Once the frame is written : records its commit time and re-sorts PWM_FrameOrder every PWM_FRAME_REORDER frames.
+     \param <void>
+     \return <void>
+     */
+    void PWM_FrameStamp( void );
+
+    /**
+     \fn private function void PWM_FrameSort( void )
+     \brief Orders the channels by the median write latency their device has measured, ties by channel.
+     \param <void>
+     \return <void>
+     */
+    void PWM_FrameSort( void );
+
+    /**
+     \fn private function bool PWM_Reconcile( void )
+     \brief After the backend reports batched writes that failed, lets every device take back its failures and puts the
+     channels that must rewrite a value on the ramp tick.
+     \param <void>
+     \return <bool> true if at least one channel now has to be retried.
+     */
+    bool PWM_Reconcile( void );
+
+    /**
+     \fn private function void* PWM_Run( void *pwm_ctrl )
+     \brief Writer thread : blocks on PWM_WakeFD, PWM_TickFD and the timerfds of PWM_Player, PWM_Scheduler, PWM_Server and PWM_Failsafe, then has the player queue due profile records, the scheduler run the control loops if a tick is due and the server take shared memory commands on a poll, takes the newest frame, has the failsafe trip channels past their timeout on a check, writes every channel in the dirty set and steps every ramping channel on a tick.
+     Each pass is one backend batch (PWM_BatchBegin( ) / PWM_BatchEnd( )), a batching backend's descriptor is waited on as well.
+     \param <BBBPWMController> pwm_ctrl
+     \return <void> 0.
+     */
+    static void *PWM_Run( void *pwm_ctrl );
+
+    /**
+     \fn private function int PWM_CreateThread( void )
+     \brief pthread_create( )s the writer, with the real-time attributes and memory lock when PWM_RealtimeOn.
+     \param <void>
+     \return <int> -1 failure (reported), 1 success.
+     */
+    int PWM_CreateThread( void );
+
+    /**
+     \fn private function void PWM_CloseTimers( void )
+     \brief Closes the ramp tick and every component's timerfd, those never opened included. The player drops its playback.
+     \param <void>
+     \return <void>
+     */
+    void PWM_CloseTimers( void );
+
+    /**
+     \fn private function void PWM_Prefault( void )
+     \brief Run by the writer before its first pass in real-time mode : touches PWM_PrefaultBytes of its stack and takes its trace ring.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Prefault( void );
+
+    /**
+     \fn private function void PWM_ArmTick( bool Armed )
+     \brief Starts or stops the periodic ramp tick.
+     \param <bool> Armed
+     \return <void>
+     */
+    void PWM_ArmTick( bool Armed );
+
+    /**
+     \fn private function void PWM_Wake( void )
+     \brief Bumps PWM_WakeFD so that the writer thread runs a pass.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Wake( void );
+
+    /**
+     \fn private static function int64_t PWM_MonotonicNs( void )
+     \brief CLOCK_MONOTONIC in nanoseconds, the clock profiles are scheduled against.
+     \param <void>
+     \return <int64_t> ns
+     */
+    static int64_t PWM_MonotonicNs( void );
+};
+
+extern template class BBBPWMBasicController< BBBPWMSysfsBackend >;
+extern template class BBBPWMBasicController< BBBPWMSimBackend >;
+extern template class BBBPWMBasicController< BBBPWMNullBackend >;
+extern template class BBBPWMBasicController< BBBPWMUringBackend >;
+extern template class BBBPWMBasicController< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMBasicController< BBBPWMClassBackend >;
+
+typedef BBBPWMBasicController< BBBPWMSysfsBackend > BBBPWMController; //!< Writer for BBBPWMDevice channels.
+typedef BBBPWMBasicController< BBBPWMSimBackend > BBBPWMSimController; //!< Writer for BBBPWMSimDevice channels.
+typedef BBBPWMBasicController< BBBPWMNullBackend > BBBPWMNullController; //!< Writer for BBBPWMNullDevice channels.
+typedef BBBPWMBasicController< BBBPWMUringBackend > BBBPWMUringController; //!< Writer for BBBPWMUringDevice channels, one io_uring submission per pass.
+typedef BBBPWMBasicController< BBBPWMEhrpwmBackend > BBBPWMEhrpwmController; //!< Writer for BBBPWMEhrpwmDevice channels.
+typedef BBBPWMBasicController< BBBPWMClassBackend > BBBPWMClassController; //!< Writer for BBBPWMClassDevice channels.
+
+#endif /* BBBPWMController_h */
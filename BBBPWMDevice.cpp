@@ -7,6 +7,10 @@
 //
 
 #include "BBBPWMDevice.h"
+#include "BBBPWMController.h"
+
+#include <climits>
+#include <time.h>
 
 /**
  \brief BBBAnalogDevice : A low level control of PWM devices on the Beaglebone Black.
@@ -15,198 +19,245 @@
  \param <PWM_BlockNum> BlockNum
  \param <PWM_PinNum> PinNum
  */
-BBBPWMDevice::BBBPWMDevice( ) {
-
+template< class PWM_Backend >
+BBBPWMBasicDevice< PWM_Backend >::BBBPWMBasicDevice( ) {
+    this->PWM_PeriodTarget.store( 0, memory_order_relaxed );
+    this->PWM_PeriodSlew.store( 0, memory_order_relaxed );
+    this->PWM_PeriodVal.store( 0, memory_order_relaxed );
+    this->PWM_Ramping.store( false, memory_order_relaxed );
+    this->PWM_CoalescedCount.store( 0, memory_order_relaxed );
+    this->PWM_SuppressedCount.store( 0, memory_order_relaxed );
+    this->PWM_ClampedCount.store( 0, memory_order_relaxed );
+    this->PWM_WriteCount.store( 0, memory_order_relaxed );
+    this->PWM_FailureCount.store( 0, memory_order_relaxed );
+    this->PWM_Reported.store( 0, memory_order_relaxed );
+    this->PWM_LatencyTiming.store( true, memory_order_relaxed );
+    for( int i = 0; i < PWM_METRICS_ERRNOS; i++ )
+        this->PWM_ErrnoCount[ i ].store( 0, memory_order_relaxed );
+    for( int i = 0; i < PWM_LATENCY_BUCKETS; i++ )
+        this->PWM_LatencyCount[ i ].store( 0, memory_order_relaxed );
+    this->PWM_RunVal.store( -1 );
+    this->PWM_RunTarget.store( -1, memory_order_relaxed );
+    this->PWM_Table = make_shared< BBBPWMChannelTable >( );
+    this->PWM_Table->PWM_Resize( 1 );
+    this->PWM_Channel = 0;
+    this->PWM_Controller = NULL;
+    this->PWM_OwnsController = false;
 }
 
 /**
- \fn private function int PWM_SysCheck( void )
- \brief Checks that the system files are available for PWM operation on the BeagleBone Black.
- \param <void>
- \return <int> 0 failure load the system files, 1 success.
+ \brief ~BBBPWMDevice : Stops the duty writer thread and closes the backend (the duty, period and run files held open by this device).
  */
-int BBBPWMDevice::PWM_SysCheck( void ) {
-    if ( stat( MODALIAS_FILE, &sb ) == 0 && S_ISREG( sb.st_mode ) )
-        return 1;
-    else {
-        if( this->PWM_LoadOverlay( PWM_PREP_OVERLAY_FILE ) < 0 )
-            return 0;
-        else
-            return 1;
-    }
+template< class PWM_Backend >
+BBBPWMBasicDevice< PWM_Backend >::~BBBPWMBasicDevice( ) {
+    this->PWM_StopThread( );
+    this->PWM_Output.PWM_Close( );
+}
 
+/**
+ \fn public function void PWM_SetSysfsRoot( const string& Root )
+ \brief Sets the sysfs mount point used to build every device path, must be called before PWM_Init( ). Defaults to SYSFS_ROOT, ignored by backends without files.
+ \param const <string>& Root (e.g. "/sys" or a fake tree in a temp directory)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetSysfsRoot( const string& Root ) {
+    this->PWM_Output.PWM_SetRoot( Root );
 }
 
 /**
- \fn private function int PWM_PinCheck( void )
- \brief Checks that the PWM Pin files are available for PWM operation on the BeagleBone Black.
+ \fn public function string PWM_GetSysfsRoot( void ) const
+ \brief Returns the sysfs mount point used by this device.
  \param <void>
- \return <int> 99 failure load the PWM Pin files, < 99 success.
- */
-int BBBPWMDevice::PWM_PinCheck( void ) {
-    int i = 0;
-    while( i < RETRIES ) {
-        i++;
-        snprintf( this->PWM_PinOverlayFolderName, sizeof( this->PWM_PinOverlayFolderName ), "%spwm_test_P%d_%d.%d", DEVICE_DIR, this->BlockNum, this->PinNum, i );
-        if ( stat( this->PWM_PinOverlayFolderName, &sb ) == 0 && S_ISDIR( sb.st_mode ) )
-            break;
-    }
-    return i;
+ \return <string>
+ */
+template< class PWM_Backend >
+string BBBPWMBasicDevice< PWM_Backend >::PWM_GetSysfsRoot( void ) const {
+    return this->PWM_Output.PWM_GetRoot( );
 }
 
 /**
- \fn private function int PWM_LoadOverlay( const char* PWM_OverlayFile )
- \brief The BeagleBone Black has Overlay Files to allow operations like PWM. In this function we are attempting to export an overlay for PWM.
- \param const <char>* PWM_OverlayFile (just the file name, no path required)
- \return <int> -1 failure load the system files, 1 success.
+ \fn public function PWM_Backend& PWM_GetBackend( void )
+ \brief Returns the output backend, e.g. to read back the write log of a BBBPWMSimBackend.
+ \param <void>
+ \return <PWM_Backend>& this->PWM_Output
  */
-int BBBPWMDevice::PWM_LoadOverlay( const char* PWM_OverlayFile ) {
-    if( this->PWM_SetFileHandle( SLOTS_DIR ) < 0 )
-        return this->PWM_FileHandle;
-    else {
-        if( this->PWM_WriteToFile( this->PWM_Buffer, snprintf( this->PWM_Buffer, sizeof( this->PWM_Buffer ), "%s", PWM_OverlayFile ) ) > 0 ) {
-            close( this->PWM_FileHandle );
-            return 1;
-        }
-        else
-            return -1;
-    }
+template< class PWM_Backend >
+PWM_Backend& BBBPWMBasicDevice< PWM_Backend >::PWM_GetBackend( void ) {
+    return this->PWM_Output;
 }
 
 /**
- \fn private function int PWM_SetFileHandle( const char* PWM_FileName )
- \brief Creates a private FileHandle for use within this class.
- \param const <char>* PWM_FileName
- \throws Exception on failure to open the file.
- \return <int> -1 failure load the system files, > 0 success.
+ \fn public function void PWM_SetOverlayTimeout( int Milliseconds )
+ \brief Sets how long PWM_Init( ) waits for the pwm_test_ folder to appear after loading the pin overlay. Defaults to PWM_OVERLAY_TIMEOUT_MS, ignored by backends that never wait.
+ \param <int> Milliseconds
+ \return <void>
  */
-int BBBPWMDevice::PWM_SetFileHandle( const char* PWM_FileName ) {
-    try {
-        this->PWM_FileHandle = open( PWM_FileName, O_WRONLY );
-    } catch( exception& e ) {
-        cerr << "Error opening file : " << PWM_FileName << " | Error = " << e.what( ) << endl;
-        this->PWM_FileHandle = -1;
-    }
-    return this->PWM_FileHandle;
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetOverlayTimeout( int Milliseconds ) {
+    this->PWM_Output.PWM_SetTimeout( Milliseconds );
 }
 
 /**
  \fn private function int PWM_LoadPWMDefaultValues( void )
- \brief Load and store the file paths and the current values from the PWM, period, duty and run. Just so that they are set on program startup.
+ \brief Load and store the current values from the PWM, period, duty and run. Just so that they are set on program startup.
+ They are seeded as both committed and requested, nothing is written and nothing counts as suppressed.
  \param <void>
  \return <int> -1 failure load the default values, 1 success.
  */
-int BBBPWMDevice::PWM_LoadPWMDefaultValues( void ) {
-    this->PWM_SetPWMFilePaths( );
-
-    this->PWM_DutyVal = ( int ) this->PWM_ReadFromFile( this->duty_file_loc );
-    this->PWM_SetTargetSpeed( this->PWM_DutyVal );
-
-    if( this->PWM_GetDutyVal( ) == 0 )
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_LoadPWMDefaultValues( void ) {
+    int CurrentDutyVal, CurrentPeriodVal, CurrentRunVal;
+    if( this->PWM_Output.PWM_Read( PWM_ATTR_DUTY, CurrentDutyVal ) <= 0
+        || this->PWM_Output.PWM_Read( PWM_ATTR_PERIOD, CurrentPeriodVal ) <= 0
+        || this->PWM_Output.PWM_Read( PWM_ATTR_RUN, CurrentRunVal ) <= 0 )
         return -1;
 
-    int CurrentPeriodVal = ( int ) this->PWM_ReadFromFile( this->period_file_loc );
-    this->PWM_SetPeriodVal( ( PWM_PeriodValues ) CurrentPeriodVal );
-    if( this->PWM_GetPeriodVal( ) == 0 )
+    if( CurrentDutyVal <= 0 || CurrentPeriodVal == 0 || CurrentRunVal < 0 )
         return -1;
 
-    int CurrentRunVal = ( int ) this->PWM_ReadFromFile( this->run_file_loc );
-    this->PWM_SetRunVal( ( PWM_RunValues ) CurrentRunVal );
-    if( this->PWM_GetRunVal( ) < 0 )
-        return -1;
+    // The kernel already holds these : the targets match, so the writer has nothing to do for them.
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    PWM_Hot.PWM_Duty[ this->PWM_Channel ].store( CurrentDutyVal, memory_order_relaxed );
+    PWM_Hot.PWM_Target[ this->PWM_Channel ].store( CurrentDutyVal, memory_order_release );
+    this->PWM_PeriodVal.store( CurrentPeriodVal, memory_order_relaxed );
+    this->PWM_PeriodTarget.store( CurrentPeriodVal, memory_order_release );
+    this->PWM_RunVal.store( CurrentRunVal, memory_order_relaxed );
+    this->PWM_RunTarget.store( CurrentRunVal, memory_order_relaxed );
 
     return 1;
 }
 
 /**
- \fn private function int PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen )
- \brief Writes a value to a file.
- \param const <char>* PWM_Buffer (holds the value to be written)
- \param <int>PWM_BufferLen (length of the buffer to be written)
- \throws Exception on failure to write.
- \return <int> -1 exception occured, 0 failed to write, 1 success.
+ \fn private function void PWM_RecordFailure( int PWM_Errno )
+ \brief Counts a failed write against its errno.
+ \param <int> PWM_Errno
+ \return <void>
  */
-int BBBPWMDevice::PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen ) {
-    try {
-        if( write( this->PWM_FileHandle, PWM_Buffer, PWM_BufferLen ) > 0 ) {
-            close( this->PWM_FileHandle );
-            return 1;
-        }
-        else
-            return 0;
-    } catch( exception& e ) {
-        cerr << "Error writing to file. | Error = " << e.what( ) << endl;
-        return -1;
-    }
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_RecordFailure( int PWM_Errno ) {
+    this->PWM_FailureCount.fetch_add( 1, memory_order_relaxed );
+    this->PWM_ErrnoCount[ PWM_Errno > 0 && PWM_Errno < PWM_METRICS_ERRNOS ? PWM_Errno : PWM_METRICS_ERRNOS - 1 ].fetch_add( 1, memory_order_relaxed );
 }
 
 /**
- \fn private function int PWM_ReadFromFile( string FH_Name )
- \brief Reads a value from a file.
- \param <string> FH_Name
- \return <int> 0 failed to read, > 0 success.
- */
-char * BBBPWMDevice::PWM_ReadFromFile( string FH_Name ) {
-    this->PWM_ReadBuffer = 0;
-    this->PWM_ReadFile = fopen( FH_Name.c_str( ), "rb" );
-    if ( this->PWM_ReadFile == NULL )
-        cerr << "Unable to read from file : " << FH_Name << endl;
-    else{
-        fseek( this->PWM_ReadFile, 0, SEEK_END );
-        long lSize = ftell( this->PWM_ReadFile );
-        rewind( this->PWM_ReadFile );
-        this->PWM_ReadBuffer = ( char* ) malloc( sizeof( char )*lSize );
-        if( this->PWM_ReadBuffer == NULL )
-            cerr << "Memory Error" << endl;
-        else {
-            fread( this->PWM_ReadBuffer, 1, lSize, this->PWM_ReadFile );
-            fclose( this->PWM_ReadFile );
+ \fn private function void PWM_ReportFailure( PWM_Attribute PWM_Attr, int PWM_Errno )
+ \brief Prints the first failed write of an attribute, the ones after it are only counted (see PWM_GetMetrics( )).
+ \param <PWM_Attribute> PWM_Attr
+ \param <int> PWM_Errno
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_ReportFailure( PWM_Attribute PWM_Attr, int PWM_Errno ) {
+    // A pin that has gone away fails every tick, printing each one would stall the writer on the terminal.
+    if( this->PWM_Reported.fetch_or( 1u << PWM_Attr, memory_order_relaxed ) & ( 1u << PWM_Attr ) )
+        return;
+    cerr << "Error writing to file : " << this->PWM_Output.PWM_Describe( PWM_Attr ) << " | Error = " << strerror( PWM_Errno )
+         << " | further failures of this attribute are only counted, see PWM_GetMetrics( )" << endl;
+}
+
+/**
+ \fn private function int PWM_WriteValue( PWM_Attribute PWM_Attr, int PWM_Value )
+ \brief Hands a value to the backend, counting and optionally timing the write, and retries once when the backend reports EBADF or ENODEV.
+ Inside a batch (see PWM_BatchBegin( )) success only means queued, a later failure comes back through PWM_Reconcile( ).
+ \param <PWM_Attribute> PWM_Attr
+ \param <int> PWM_Value
+ \return <int> -1 failed to open, 0 failed to write, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_WriteValue( PWM_Attribute PWM_Attr, int PWM_Value ) {
+    for( int attempt = 0; attempt < 2; attempt++ ) {
+        int PWM_Wrote;
+        int64_t PWM_Ns = -1;
+        if( this->PWM_LatencyTiming.load( memory_order_relaxed ) ) {
+            struct timespec PWM_Start, PWM_End;
+            clock_gettime( CLOCK_MONOTONIC, &PWM_Start );
+            PWM_Wrote = this->PWM_Output.PWM_Write( PWM_Attr, PWM_Value );
+            clock_gettime( CLOCK_MONOTONIC, &PWM_End );
+            PWM_Ns = ( int64_t )( PWM_End.tv_sec - PWM_Start.tv_sec ) * 1000000000 + ( PWM_End.tv_nsec - PWM_Start.tv_nsec );
         }
+        else
+            PWM_Wrote = this->PWM_Output.PWM_Write( PWM_Attr, PWM_Value );
+        // The backend has already reported why it could not open the attribute.
+        if( PWM_Wrote < 0 ) {
+            BBBPWMTrace::PWM_Record( PWM_TRACE_FAIL, PWM_Attr, this->BlockNum, this->PinNum, PWM_Value, errno );
+            return -1;
+        }
+        // Relaxed increments : read by PWM_GetMetrics( ) from any thread.
+        this->PWM_WriteCount.fetch_add( 1, memory_order_relaxed );
+        if( PWM_Ns >= 0 )
+            this->PWM_LatencyCount[ PWM_LatencyBucket( ( uint64_t ) PWM_Ns ) ].fetch_add( 1, memory_order_relaxed );
+        if( PWM_Wrote > 0 ) {
+            BBBPWMTrace::PWM_Record( PWM_TRACE_WRITE, PWM_Attr, this->BlockNum, this->PinNum, PWM_Value, 0 );
+            return 1;
+        }
+        BBBPWMTrace::PWM_Record( PWM_TRACE_FAIL, PWM_Attr, this->BlockNum, this->PinNum, PWM_Value, errno );
+        this->PWM_RecordFailure( errno );
+        // The attribute went away underneath us (overlay reloaded), the backend has dropped it and reopens it once.
+        if( errno != EBADF && errno != ENODEV )
+            break;
     }
-    return this->PWM_ReadBuffer;
+    this->PWM_ReportFailure( PWM_Attr, errno );
+    return 0;
 }
 
 /**
- \fn public function void PWM_StartThread( void )
- \brief Start athread to handle the speed settings for this PWM device
+ \fn private function int PWM_StartThread( void )
+ \brief Starts a private single-channel BBBPWMController to modify the speed of the PWM Device, unless the device was added to a shared one.
  \param <void>
- \return <void>
+ \return <int> -1 unable to start the writer thread, 1 success.
  */
-void BBBPWMDevice::PWM_StartThread( ) {
-    this->PWM_Ret = pthread_create( &this->PWM_Thread, NULL, BBBPWMDevice::PWM_SetDutyVal, this );
-    if( PWM_Ret ) {
-        cerr << "Error - pthread_create() returned code: " << PWM_Ret << endl;
-        exit( 1 );
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_StartThread( ) {
+    if( this->PWM_Controller != NULL )
+        return 1;
+    // PWM_AddDevice( ) sets PWM_Controller, and only takes a device that has none yet.
+    BBBPWMBasicController< PWM_Backend >* PWM_Own = new BBBPWMBasicController< PWM_Backend >( );
+    if( PWM_Own->PWM_AddDevice( this ) < 0 ) {
+        delete PWM_Own;
+        return -1;
+    }
+    this->PWM_OwnsController = true;
+    if( this->PWM_Controller->PWM_Start( ) < 0 ) {
+        this->PWM_StopThread( );
+        return -1;
     }
+    return 1;
 }
 
 /**
- \fn private function int PWM_SetPWMFilePaths( void )
- \brief Load and store the file paths for use in this class.
+ \fn public function void PWM_StopThread( void )
+ \brief Stops the private duty writer started by PWM_Init( ) and waits for it to exit. Safe to call more than once. Devices added to a shared BBBPWMController are stopped with BBBPWMController::PWM_Stop( ) instead.
  \param <void>
  \return <void>
  */
-void BBBPWMDevice::PWM_SetPWMFilePaths( void ) {
-    this->period_file_loc = this->PWM_PinOverlayFolderName;
-    this->period_file_loc.append( "/period" );
-    this->duty_file_loc = this->PWM_PinOverlayFolderName;
-    this->duty_file_loc.append( "/duty" );
-    this->run_file_loc = this->PWM_PinOverlayFolderName;
-    this->run_file_loc.append( "/run" );
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_StopThread( void ) {
+    if( !this->PWM_OwnsController )
+        return;
+    delete this->PWM_Controller;
+    this->PWM_Controller = NULL;
+    this->PWM_OwnsController = false;
 }
 
 /**
  \fn public function int PWM_SetPeriodVal( int PWM_PeriodVal )
- \brief Store and write a new PWM Period Value
+ \brief Store and write a new PWM Period Value. Once the device has a controller the value is handed to its writer
+ thread like a duty target, ramped there while a period slew is set (see PWM_SetPeriodSlew( )).
  \param <int> PWM_PeriodVal
  \throws Exception on failure to write.
- \return <int> 0 Exception, > 0 success.
+ \return <int> 0 Exception or failed to write, > 0 success (or handed to the writer).
  */
-int BBBPWMDevice::PWM_SetPeriodVal( PWM_PeriodValues PWM_PeriodVal ) {
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_SetPeriodVal( PWM_PeriodValues PWM_PeriodVal ) {
     try {
-        this->PWM_PeriodVal = PWM_PeriodVal;
-        this->PWM_SetFileHandle( this->period_file_loc.c_str( ) );
-        return this->PWM_WriteToFile( this->PWM_Buffer, snprintf( this->PWM_Buffer, sizeof( this->PWM_Buffer ), "%d", this->PWM_PeriodVal ) );
+        this->PWM_RequestPeriod( PWM_PeriodVal );
+        // Only the writer may write an attribute it also writes, or the committed value could end up apart from the kernel's.
+        if( this->PWM_Controller != NULL ) {
+            this->PWM_MarkDirty( );
+            return 1;
+        }
+        return this->PWM_Commit( PWM_ATTR_PERIOD, this->PWM_PeriodVal, PWM_PeriodVal );
     }
     catch ( exception& e) {
         cerr << "An exception occurred : Unable to edit PWM Period. | " << e.what( ) << endl;
@@ -221,56 +272,332 @@ int BBBPWMDevice::PWM_SetPeriodVal( PWM_PeriodValues PWM_PeriodVal ) {
  \throws Exception on failure to write.
  \return <int> 0 Exception, > 0 success.
  */
-void BBBPWMDevice::PWM_SetTargetSpeed( int TargetSpeed ) {
-    this->PWM_TargetSpeed = TargetSpeed;
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetTargetSpeed( int TargetSpeed ) {
+    // Release pairs with the acquire in PWM_StepValue( ), the dirty bit set below is what actually wakes the writer.
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    PWM_Hot.PWM_Target[ this->PWM_Channel ].store( TargetSpeed, memory_order_release );
+    // Only a new target feeds a failsafe, not the ramp cancels and period changes that also mark the channel dirty.
+    if( PWM_Hot.PWM_Feeding.load( memory_order_relaxed ) )
+        PWM_Hot.PWM_Stored[ this->PWM_Channel / 32 ].fetch_or( 1u << ( this->PWM_Channel % 32 ), memory_order_relaxed );
+    this->PWM_NoteTarget( TargetSpeed );
+    if( this->PWM_Controller != NULL )
+        this->PWM_MarkDirty( );
 }
 
 /**
- \fn public function void PWM_SetDutyVal( void *motor_inst )
- \brief Store and write a new PWM Duty Value
- \param <PWMDevice> pwm_inst
- \throws Exception on failure to write.
- \return <void> 0.
- */
-void* BBBPWMDevice::PWM_SetDutyVal( void *pwm_inst ) {
-    BBBPWMDevice* PWM_Device = (BBBPWMDevice*)pwm_inst;
-
-    while( 1 ) {
-        if( PWM_Device->PWM_GetDutyVal( ) != PWM_Device->PWM_TargetSpeed ) {
-            try {
-
-                PWM_Device->PWM_DutyVal = PWM_Device->PWM_TargetSpeed;
-                if( PWM_Device->PWM_DutyVal < MAX_DUTY ) PWM_Device->PWM_DutyVal = MAX_DUTY;
-                if( PWM_Device->PWM_DutyVal > MIN_DUTY ) PWM_Device->PWM_DutyVal = MIN_DUTY;
-                PWM_Device->PWM_SetFileHandle( PWM_Device->duty_file_loc.c_str( ));
-                PWM_Device->PWM_WriteToFile( PWM_Device->PWM_Buffer,
-                                             snprintf( PWM_Device->PWM_Buffer, sizeof( PWM_Device->PWM_Buffer ), "%d",
-                                                       PWM_Device->PWM_DutyVal ));
-            }
-            catch( exception &e ) {
-                cerr << "An exception occurred : Unable to edit PWM Duty. | " << e.what( ) << endl;
-            }
+ \fn private function void PWM_NoteTarget( int PWM_Target )
+ \brief Traces a new duty target and counts it if it is out of range, for every way a target reaches the table.
+ \param <int> PWM_Target
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_NoteTarget( int PWM_Target ) {
+    BBBPWMTrace::PWM_Record( PWM_TRACE_REQUEST, PWM_ATTR_DUTY, this->BlockNum, this->PinNum, PWM_Target, 0 );
+    if( PWM_Target < PWM_DUTY_LOW || PWM_Target > PWM_DUTY_HIGH ) {
+        this->PWM_ClampedCount.fetch_add( 1, memory_order_relaxed );
+        BBBPWMTrace::PWM_Record( PWM_TRACE_CLAMP, PWM_ATTR_DUTY, this->BlockNum, this->PinNum, PWM_Target < PWM_DUTY_LOW ? PWM_DUTY_LOW : PWM_DUTY_HIGH, 0 );
+    }
+}
+
+/**
+ \fn private function void PWM_RequestPeriod( int PWM_Period )
+ \brief Traces a new period and makes it the target PWM_Update( ) writes, without marking the channel dirty.
+ \param <int> PWM_Period
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_RequestPeriod( int PWM_Period ) {
+    BBBPWMTrace::PWM_Record( PWM_TRACE_REQUEST, PWM_ATTR_PERIOD, this->BlockNum, this->PinNum, PWM_Period, 0 );
+    this->PWM_PeriodTarget.store( PWM_Period, memory_order_release );
+}
+
+/**
+ \fn private function void PWM_RequestRun( int PWM_Run )
+ \brief Traces a new run value and makes it the target PWM_Update( ) writes, without marking the channel dirty.
+ \param <int> PWM_Run (0 or 1)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_RequestRun( int PWM_Run ) {
+    BBBPWMTrace::PWM_Record( PWM_TRACE_REQUEST, PWM_ATTR_RUN, this->BlockNum, this->PinNum, PWM_Run, 0 );
+    this->PWM_RunTarget.store( PWM_Run, memory_order_relaxed );
+}
+
+/**
+ \fn private function int PWM_Commit( PWM_Attribute PWM_Attr, atomic< int >& PWM_Committed, int PWM_Value )
+ \brief Without a controller : writes a period or run value unless the kernel already holds it, then records it as committed.
+ \param <PWM_Attribute> PWM_Attr
+ \param <atomic<int>>& PWM_Committed (PWM_PeriodVal or PWM_RunVal)
+ \param <int> PWM_Value
+ \return <int> -1 failed to open, 0 failed to write, 1 success (or already held).
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_Commit( PWM_Attribute PWM_Attr, atomic< int >& PWM_Committed, int PWM_Value ) {
+    if( PWM_Committed.load( memory_order_relaxed ) == PWM_Value ) {
+        this->PWM_SuppressedCount.fetch_add( 1, memory_order_relaxed );
+        return 1;
+    }
+    int PWM_Ret = this->PWM_WriteValue( PWM_Attr, PWM_Value );
+    if( PWM_Ret > 0 )
+        PWM_Committed.store( PWM_Value, memory_order_relaxed );
+    return PWM_Ret;
+}
+
+/**
+ \fn private function void PWM_MarkDirty( void )
+ \brief Hands this channel to the controller's writer thread, counting the update as coalesced if one was already pending.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_MarkDirty( void ) {
+    if( !this->PWM_Controller->PWM_MarkDirty( this->PWM_Channel ) )
+        this->PWM_CoalescedCount.fetch_add( 1, memory_order_relaxed );
+}
+
+/**
+ \fn public function uint64_t PWM_GetCoalescedCount( void ) const
+ \brief Returns how many target updates were merged into an update the writer had not picked up yet.
+ \param <void>
+ \return <uint64_t> this->PWM_CoalescedCount
+ */
+template< class PWM_Backend >
+uint64_t BBBPWMBasicDevice< PWM_Backend >::PWM_GetCoalescedCount( void ) const {
+    return this->PWM_CoalescedCount.load( memory_order_relaxed );
+}
+
+/**
+ \fn public function uint64_t PWM_GetSuppressedCount( void ) const
+ \brief Returns how many duty, period or run updates were dropped because the kernel already held that value.
+ \param <void>
+ \return <uint64_t> this->PWM_SuppressedCount
+ */
+template< class PWM_Backend >
+uint64_t BBBPWMBasicDevice< PWM_Backend >::PWM_GetSuppressedCount( void ) const {
+    return this->PWM_SuppressedCount.load( memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_GetMetrics( BBBPWMMetrics& Metrics ) const
+ \brief Copies this device's counters and write latency histogram into Metrics. Lock-free, safe from any thread while
+ the writer runs, it never makes the writer wait. Each counter is read atomically but not all at the same instant, so
+ counters may be a few updates apart from each other.
+ \param <BBBPWMMetrics>& Metrics
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_GetMetrics( BBBPWMMetrics& Metrics ) const {
+    Metrics.PWM_Writes = this->PWM_WriteCount.load( memory_order_relaxed );
+    Metrics.PWM_WriteFailures = this->PWM_FailureCount.load( memory_order_relaxed );
+    for( int i = 0; i < PWM_METRICS_ERRNOS; i++ )
+        Metrics.PWM_FailuresByErrno[ i ] = this->PWM_ErrnoCount[ i ].load( memory_order_relaxed );
+    Metrics.PWM_Clamped = this->PWM_ClampedCount.load( memory_order_relaxed );
+    Metrics.PWM_Coalesced = this->PWM_CoalescedCount.load( memory_order_relaxed );
+    Metrics.PWM_Suppressed = this->PWM_SuppressedCount.load( memory_order_relaxed );
+    for( int i = 0; i < PWM_LATENCY_BUCKETS; i++ )
+        Metrics.PWM_Latency[ i ] = this->PWM_LatencyCount[ i ].load( memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_SetLatencyTiming( bool Enabled )
+ \brief Turns the write latency histogram on or off (on by default). Timing costs two clock_gettime( ) calls per write,
+ counters are always kept and cost one relaxed atomic increment per write.
+ \param <bool> Enabled
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetLatencyTiming( bool Enabled ) {
+    this->PWM_LatencyTiming.store( Enabled, memory_order_relaxed );
+}
+
+/**
+ \fn public function int PWM_GetTargetSpeed( void ) const
+ \brief Returns the latest target speed published with PWM_SetTargetSpeed( ).
+ \param <void>
+ \return <int> target of PWM_Channel in this->PWM_Table
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetTargetSpeed( void ) const {
+    return this->PWM_Table->PWM_Target[ this->PWM_Channel ].load( memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_SetDutySlew( int NsPerTick )
+ \brief Limits how far the duty may move per controller tick (see BBBPWMController::PWM_SetTickPeriod( )), so new targets are reached with a linear ramp.
+ \param <int> NsPerTick (0 disables the limit, targets are then written as soon as they arrive)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetDutySlew( int NsPerTick ) {
+    this->PWM_Table->PWM_DutySlew[ this->PWM_Channel ].store( NsPerTick > 0 ? NsPerTick : 0, memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_SetPeriodSlew( int NsPerTick )
+ \brief Limits how far the period may move per controller tick, e.g. for the STARTUP to ACTIVE transition.
+ \param <int> NsPerTick (0 disables the limit, PWM_SetPeriodVal( ) then writes straight away)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetPeriodSlew( int NsPerTick ) {
+    this->PWM_PeriodSlew.store( NsPerTick > 0 ? NsPerTick : 0, memory_order_relaxed );
+}
 
+/**
+ \fn public function void PWM_CancelRamp( void )
+ \brief Stops any duty or period ramp in flight at the value reached so far. A later PWM_SetTargetSpeed( ) starts a new ramp from there.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_CancelRamp( void ) {
+    // Leave a marker rather than copying the duty : only the writer knows where the ramp really is, and a newer target simply overwrites the marker.
+    this->PWM_Table->PWM_Target[ this->PWM_Channel ].store( PWM_RAMP_HOLD, memory_order_release );
+    this->PWM_PeriodTarget.store( PWM_RAMP_HOLD, memory_order_release );
+    if( this->PWM_Controller != NULL )
+        this->PWM_MarkDirty( );
+}
+
+/**
+ \fn public function bool PWM_IsRamping( void ) const
+ \brief Returns true while the writer is still stepping the duty or period towards its target.
+ \param <void>
+ \return <bool> this->PWM_Ramping
+ */
+template< class PWM_Backend >
+bool BBBPWMBasicDevice< PWM_Backend >::PWM_IsRamping( void ) const {
+    return this->PWM_Ramping.load( memory_order_relaxed );
+}
+
+/**
+ \fn private function int PWM_Update( int PWM_Ticks )
+ \brief Called from the writer thread of PWM_Controller : moves the PWM Duty and Period Values towards the latest targets (stepped while a slew is set), and writes the latest run value unless the kernel already holds it.
+ \param <int> PWM_Ticks (ticks elapsed since the last call, 0 when woken by a new target rather than by the tick)
+ \return <int> PWM_UpdateFlags bit mask.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_Update( int PWM_Ticks ) {
+    int PWM_Flags = 0;
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Table;
+    int PWM_Slot = this->PWM_Channel;
+    try {
+        // The period first : the duty written after it is checked against it by the driver (and linked to it by io_uring).
+        PWM_Flags |= this->PWM_StepValue( this->PWM_PeriodTarget, this->PWM_PeriodVal, this->PWM_PeriodSlew.load( memory_order_relaxed ),
+                                          PWM_Ticks, 0, INT_MAX, PWM_ATTR_PERIOD );
+        PWM_Flags |= this->PWM_StepValue( PWM_Hot.PWM_Target[ PWM_Slot ], PWM_Hot.PWM_Duty[ PWM_Slot ], PWM_Hot.PWM_DutySlew[ PWM_Slot ].load( memory_order_relaxed ),
+                                          PWM_Ticks, PWM_DUTY_LOW, PWM_DUTY_HIGH, PWM_ATTR_DUTY );
+        // Only the latest run value asked for, a failed write is left short of it and retried on the tick.
+        int PWM_Run = this->PWM_RunTarget.load( memory_order_relaxed );
+        if( PWM_Run >= 0 && PWM_Run != this->PWM_RunVal.load( memory_order_relaxed ) ) {
+            if( this->PWM_WriteValue( PWM_ATTR_RUN, PWM_Run ) > 0 ) {
+                this->PWM_RunVal.store( PWM_Run, memory_order_relaxed );
+                PWM_Flags |= PWM_WROTE;
+            }
+            else
+                PWM_Flags |= PWM_RAMPING;
         }
     }
-    //pthread_exit( NULL );
+    catch( exception &e ) {
+        cerr << "An exception occurred : Unable to edit PWM Duty. | " << e.what( ) << endl;
+    }
+    // Woken for this channel but the kernel already holds the (clamped) target : nothing was written.
+    if( PWM_Ticks == 0 && PWM_Flags == 0 )
+        this->PWM_SuppressedCount.fetch_add( 1, memory_order_relaxed );
+    this->PWM_Ramping.store( ( PWM_Flags & PWM_RAMPING ) != 0, memory_order_relaxed );
+    return PWM_Flags;
+}
 
-    return 0;
+/**
+ \fn private function int PWM_Reconcile( void )
+ \brief Called from the writer thread when its backend reports batched writes that failed after PWM_Update( ) had
+ counted them as written : each is counted as a failure and its value rolled back to what the kernel holds, so the
+ next tick writes it again like any failed write.
+ \param <void>
+ \return <int> PWM_RAMPING if a write has to be retried, 0 otherwise.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_Reconcile( void ) {
+    int PWM_Flags = 0;
+    int PWM_Value;
+    // Only the writer batches, and once there is a writer it is the only one writing : every attribute comes back here.
+    for( int a = PWM_ATTR_DUTY; a < PWM_ATTRS; a++ ) {
+        PWM_Attribute PWM_Attr = ( PWM_Attribute ) a;
+        int PWM_Errno = this->PWM_Output.PWM_TakeError( PWM_Attr, PWM_Value );
+        if( PWM_Errno == 0 )
+            continue;
+        this->PWM_RecordFailure( PWM_Errno );
+        BBBPWMTrace::PWM_Record( PWM_TRACE_FAIL, PWM_Attr, this->BlockNum, this->PinNum, PWM_Value, PWM_Errno );
+        this->PWM_ReportFailure( PWM_Attr, PWM_Errno );
+        if( PWM_Attr == PWM_ATTR_DUTY )
+            this->PWM_Table->PWM_Duty[ this->PWM_Channel ].store( PWM_Value, memory_order_relaxed );
+        else if( PWM_Attr == PWM_ATTR_PERIOD )
+            this->PWM_PeriodVal.store( PWM_Value, memory_order_relaxed );
+        else
+            this->PWM_RunVal.store( PWM_Value, memory_order_relaxed );
+        PWM_Flags |= PWM_RAMPING;
+    }
+    if( PWM_Flags )
+        this->PWM_Ramping.store( true, memory_order_relaxed );
+    return PWM_Flags;
+}
+
+/**
+ \fn private function int PWM_StepValue( ... )
+ \brief Steps one value towards its target by at most PWM_Slew * PWM_Ticks and writes it, clamped to [ PWM_Min, PWM_Max ].
+ \return <int> PWM_UpdateFlags bit mask.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_StepValue( atomic< int >& PWM_Target, atomic< int >& PWM_Current, int PWM_Slew, int PWM_Ticks, int PWM_Min, int PWM_Max, PWM_Attribute PWM_Attr ) {
+    int PWM_Now = PWM_Current.load( memory_order_relaxed );
+    int PWM_Goal = PWM_Target.load( memory_order_acquire );
+    if( PWM_Goal == PWM_RAMP_HOLD ) {
+        // Cancelled : adopt the value reached unless a new target has already replaced the marker.
+        if( PWM_Target.compare_exchange_strong( PWM_Goal, PWM_Now, memory_order_acq_rel ) || PWM_Goal == PWM_RAMP_HOLD )
+            PWM_Goal = PWM_Now;
+    }
+    if( PWM_Goal < PWM_Min ) PWM_Goal = PWM_Min;
+    if( PWM_Goal > PWM_Max ) PWM_Goal = PWM_Max;
+
+    int PWM_Next = PWM_Goal;
+    if( PWM_Slew > 0 ) {
+        // Integer stepping, 64 bit so that a large tick backlog cannot overflow.
+        int64_t PWM_MaxStep = ( int64_t ) PWM_Slew * PWM_Ticks;
+        int64_t PWM_Delta = ( int64_t ) PWM_Goal - PWM_Now;
+        if( PWM_Delta > PWM_MaxStep ) PWM_Next = PWM_Now + PWM_MaxStep;
+        else if( PWM_Delta < -PWM_MaxStep ) PWM_Next = PWM_Now - PWM_MaxStep;
+    }
+
+    int PWM_Flags = 0;
+    if( PWM_Next != PWM_Now && this->PWM_WriteValue( PWM_Attr, PWM_Next ) > 0 ) {
+        PWM_Current.store( PWM_Next, memory_order_relaxed );
+        PWM_Now = PWM_Next;
+        PWM_Flags |= PWM_WROTE;
+    }
+    // A failed write also leaves us short of the goal, so it is retried on the next tick.
+    if( PWM_Now != PWM_Goal )
+        PWM_Flags |= PWM_RAMPING;
+    return PWM_Flags;
 }
 
 /**
  \fn public function int PWM_SetRunVal( int PWM_RunVal )
- \brief Store and write a new PWM Run Value
+ \brief Store and write a new PWM Run Value. Once the device has a controller the value is handed to its writer
+ thread like a duty target, a failed write is then retried on the tick and counted in PWM_GetMetrics( ).
  \param <int> PWM_RunVal (0 or 1)
  \throws Exception on failure to write.
- \return <int> 0 Exception, > 0 success.
+ \return <int> -1 not 0 or 1, 0 Exception or failed to write, > 0 success (or handed to the writer).
  */
-int BBBPWMDevice::PWM_SetRunVal( PWM_RunValues PWM_RunVal ) {
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_SetRunVal( PWM_RunValues PWM_RunVal ) {
     if(PWM_RunVal < 2 && PWM_RunVal > -1) {
         try {
-            this->PWM_RunVal = PWM_RunVal;
-            this->PWM_SetFileHandle( this->duty_file_loc.c_str( ) );
-            return this->PWM_WriteToFile( this->PWM_Buffer, snprintf( this->PWM_Buffer, sizeof( this->PWM_Buffer ), "%d", this->PWM_DutyVal ) );
+            this->PWM_RequestRun( PWM_RunVal );
+            if( this->PWM_Controller != NULL ) {
+                this->PWM_MarkDirty( );
+                return 1;
+            }
+            return this->PWM_Commit( PWM_ATTR_RUN, this->PWM_RunVal, PWM_RunVal );
         }
         catch ( exception& e ) {
             cerr << "An exception occurred : Unable to edit PWM Run Value. | " << e.what( ) << endl;
@@ -286,7 +613,8 @@ int BBBPWMDevice::PWM_SetRunVal( PWM_RunValues PWM_RunVal ) {
  \brief Sets the Pin Number for this device. (Using the PinNum and BlockNum will tell you where this device is or should be plugged in)
  \param <PWM_PinNum> PinNum
  */
-void BBBPWMDevice::PWM_SetPinNum( PWM_PinNum PinNum ) {
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetPinNum( PWM_PinNum PinNum ) {
     this->PinNum = PinNum;
 }
 
@@ -295,7 +623,8 @@ void BBBPWMDevice::PWM_SetPinNum( PWM_PinNum PinNum ) {
  \brief Sets the Block Number for this PWM device. (Using the PinNum and BlockNum will tell you where this device is or should be plugged in)
  \param <PWM_BlockNum> BlockNum
  */
-void BBBPWMDevice::PWM_SetBlockNum( PWM_BlockNum BlockNum ) {
+template< class PWM_Backend >
+void BBBPWMBasicDevice< PWM_Backend >::PWM_SetBlockNum( PWM_BlockNum BlockNum ) {
     this->BlockNum = BlockNum;
 }
 
@@ -305,37 +634,65 @@ void BBBPWMDevice::PWM_SetBlockNum( PWM_BlockNum BlockNum ) {
  \param <void>
  \return 1 setup successful, 0 fail.
  */
-int BBBPWMDevice::PWM_Init( ) {
-
-    if( this->PWM_PinCheck( ) >= RETRIES ) {
-        snprintf( this->PWM_PinOverlay, sizeof( this->PWM_PinOverlay ), "bone_pwm_P%d_%d", this->BlockNum, this->PinNum );
-        if( this->PWM_LoadOverlay( this->PWM_PinOverlay ) < 0 ) {
-            cerr << "Critical Error 2 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export :" << this->PWM_PinOverlay << endl;
-            exit( 1 );
-        }
-        sleep(1);
-    }
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_Init( ) {
 
-    if( this->PWM_PinCheck( ) >= RETRIES ) {
-        cerr << "Critical Error 3 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export :" << this->PWM_PinOverlayFileName << endl;
+    // The backend reports which step failed (overlay, discovery, opening the attributes).
+    if( this->PWM_Output.PWM_Attach( this->BlockNum, this->PinNum ) <= 0 )
         exit( 1 );
-    }
-
-    if( this->PWM_SysCheck( ) == -1 ){
-        cerr << "Critical Error 1 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export am3xx_pwm" << endl;
-        exit( 1 );
-    }
 
     if( this->PWM_LoadPWMDefaultValues( ) == -1 ) {
         cerr << "Critical Error 4 : Unable to use PWM on your BeagleBone Black, sys error - unable to load PWM values on initialisation." << endl;
         exit( 1 );
     }
 
-    this->PWM_StartThread( );
+    if( this->PWM_StartThread( ) < 0 )
+        exit( 1 );
 
     return 1;
 }
 
+/**
+ \fn public static function int PWM_InitAll( const vector< BBBPWMBasicDevice* >& Devices, vector< int >& Status )
+ \brief Sets up many devices at once, their block and pin numbers already set : the backend attaches every pin in one
+ go (see PWM_AttachAll( ) in BBBPWMBackend.h, the sysfs backend loads all the missing overlays and waits for them
+ together), then the starting values of all channels are read and the writers started. Unlike PWM_Init( ) a device
+ that fails is reported in Status rather than ending the program.
+ \param const <vector<BBBPWMBasicDevice*>>& Devices
+ \param <vector<int>>& Status (resized to Devices, 1 ready, 0 unable to attach, -1 unable to load its values or start its writer)
+ \return <int> number of devices ready.
+ */
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_InitAll( const vector< BBBPWMBasicDevice* >& Devices, vector< int >& Status ) {
+    vector< PWM_Backend* > PWM_Outputs;
+    vector< int > PWM_Blocks, PWM_Pins;
+    for( size_t d = 0; d < Devices.size( ); d++ ) {
+        PWM_Outputs.push_back( &Devices[ d ]->PWM_Output );
+        PWM_Blocks.push_back( Devices[ d ]->BlockNum );
+        PWM_Pins.push_back( Devices[ d ]->PinNum );
+    }
+    PWM_Backend::PWM_AttachAll( PWM_Outputs, PWM_Blocks, PWM_Pins, Status );
+
+    // Every folder is there by now, reading the values is three pread( )s a channel and needs no more than one pass.
+    int PWM_Ready = 0;
+    for( size_t d = 0; d < Devices.size( ); d++ ) {
+        if( Status[ d ] <= 0 )
+            continue;
+        if( Devices[ d ]->PWM_LoadPWMDefaultValues( ) == -1 ) {
+            cerr << "Critical Error 4 : Unable to use PWM on your BeagleBone Black, sys error - unable to load PWM values on initialisation of P"
+                 << Devices[ d ]->BlockNum << "_" << Devices[ d ]->PinNum << "." << endl;
+            Status[ d ] = -1;
+        }
+        else if( Devices[ d ]->PWM_StartThread( ) < 0 ) {
+            cerr << "Unable to start the writer thread of P" << Devices[ d ]->BlockNum << "_" << Devices[ d ]->PinNum << "." << endl;
+            Status[ d ] = -1;
+        }
+        else
+            PWM_Ready++;
+    }
+    return PWM_Ready;
+}
+
 
 /**
  \fn public function int PWM_GetPinNum( void ) const
@@ -343,7 +700,8 @@ int BBBPWMDevice::PWM_Init( ) {
  \param <void>
  \return <int> this->PinNum
  */
-int BBBPWMDevice::PWM_GetPinNum( void ) const {
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetPinNum( void ) const {
     return this->PinNum;
 }
 
@@ -353,7 +711,8 @@ int BBBPWMDevice::PWM_GetPinNum( void ) const {
  \param <void>
  \return <int> this->BlockNum
  */
-int BBBPWMDevice::PWM_GetBlockNum( void ) const {
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetBlockNum( void ) const {
     return this->BlockNum;
 }
 
@@ -361,10 +720,11 @@ int BBBPWMDevice::PWM_GetBlockNum( void ) const {
  \fn public function int PWM_GetDutyVal( void ) const
  \brief Returns the DutyVal for this PWM Device
  \param <void>
- \return <int> this->PWM_DutyVal
+ \return <int> duty of PWM_Channel in this->PWM_Table
  */
-int BBBPWMDevice::PWM_GetDutyVal( void ) const {
-    return this->PWM_DutyVal;
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetDutyVal( void ) const {
+    return this->PWM_Table->PWM_Duty[ this->PWM_Channel ].load( memory_order_relaxed );
 }
 
 /**
@@ -373,8 +733,9 @@ int BBBPWMDevice::PWM_GetDutyVal( void ) const {
  \param <void>
  \return <int> this->PWM_PeriodVal
  */
-int BBBPWMDevice::PWM_GetPeriodVal( void ) const {
-    return this->PWM_PeriodVal;
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetPeriodVal( void ) const {
+    return this->PWM_PeriodVal.load( memory_order_relaxed );
 }
 
 /**
@@ -383,6 +744,14 @@ int BBBPWMDevice::PWM_GetPeriodVal( void ) const {
  \param <void>
  \return <int> this->PWM_RunVal
  */
-int BBBPWMDevice::PWM_GetRunVal( void ) const {
-    return this->PWM_RunVal;
+template< class PWM_Backend >
+int BBBPWMBasicDevice< PWM_Backend >::PWM_GetRunVal( void ) const {
+    return this->PWM_RunVal.load( memory_order_relaxed );
 }
+
+template class BBBPWMBasicDevice< BBBPWMSysfsBackend >;
+template class BBBPWMBasicDevice< BBBPWMSimBackend >;
+template class BBBPWMBasicDevice< BBBPWMNullBackend >;
+template class BBBPWMBasicDevice< BBBPWMUringBackend >;
+template class BBBPWMBasicDevice< BBBPWMEhrpwmBackend >;
+template class BBBPWMBasicDevice< BBBPWMClassBackend >;
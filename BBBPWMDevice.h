@@ -8,18 +8,18 @@
 #ifndef BBBPWMDevice_h
 #define BBBPWMDevice_h
 
-#define SLOTS_DIR                "/sys/devices/bone_capemgr.9/slots" //!< Full system path to SLOTS, used to export device tree overlays.
-#define DEVICE_DIR                "/sys/devices/ocp.3/" //!< Path to exported PWM overlay file systems
-#define MODALIAS_FILE            "/sys/devices/ocp.3/48300000.epwmss/modalias" //!< This file should exist after the am33xx device overlay is exported.
-#define PWM_PREP_OVERLAY_FILE    "am33xx_pwm" //!< This device tree must be exported before any specific pins
-#define PWM_OVERLAY_FILE        "pwm_test_" //!< Begining of device tree overlay name
-#define MAX_BUF                1024 //!< Used in setting the buffer size.
-#define RETRIES                100 //!< PWM system files have an index appended to the end of the folder name. normally 1 - 99, RETRIES is used to find that index.
-#define MAX_DUTY               150000
-#define MIN_DUTY               700000
+#define PWM_DUTY_LOW           150000 //!< Shortest duty a target is clamped to, in ns.
+#define PWM_DUTY_HIGH          700000 //!< Longest duty a target is clamped to, in ns.
+#define MAX_DUTY               PWM_DUTY_LOW //!< Deprecated, named backwards : use PWM_DUTY_LOW.
+#define MIN_DUTY               PWM_DUTY_HIGH //!< Deprecated, named backwards : use PWM_DUTY_HIGH.
+#define PWM_RAMP_HOLD          -1 //!< Target marker left by PWM_CancelRamp( ), the writer replaces it with the value it has reached.
 
 #include <iostream>
+#include <atomic>
 #include <exception>
+#include <memory>
+#include <cerrno>
+#include <cstring>
 #include <pthread.h>
 #include <sstream>
 #include <string>
@@ -28,22 +28,32 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <vector>
+
+#include "BBBPWMChannelTable.h"
+#include "BBBPWMBackend.h"
+#include "BBBPWMMetrics.h"
+#include "BBBPWMTrace.h"
+#include "BBBPWMSysfsBackend.h"
+#include "BBBPWMSimBackend.h"
+#include "BBBPWMNullBackend.h"
+#include "BBBPWMUringBackend.h"
+#include "BBBPWMEhrpwmBackend.h"
+#include "BBBPWMClassBackend.h"
+#include <stdint.h>
 
 using namespace std;
 
-/*!
- *  \brief     BBBPWMDevice provides low level access to the PWM files on the BeagleBone Black.
- *  \author    Michael Brookes
- *  \version   1.1
- *  \date      Oct-2015
- *  \copyright GNU Public License.
- */
-class BBBPWMDevice {
+template< class PWM_Backend > class BBBPWMBasicController;
+template< class PWM_Backend > class BBBPWMServer;
+template< class PWM_Backend > class BBBPWMFailsafe;
 
+/**
+ \brief Pin and value names shared by every BBBPWMBasicDevice, so BBBPWMDevice::P9 is also a BBBPWMSimDevice block.
+ */
+class BBBPWMDeviceTypes {
 public:
 
-    pthread_t PWM_Thread;
-    int PWM_TargetSpeed;
     /**
      \brief BlockNum refers to the block of exposed pins on your BBB, it will always be 8 or 9.
      */
@@ -53,13 +63,24 @@ public:
     };
 
     /**
-     \brief PinNum refers to a exposed PWM Pin on your BBB, this enum can be expanded to include more if required.
+     \brief PinNum refers to a exposed PWM Pin on your BBB, every pin of BBBPWMPins. Not every block / pin pair exists,
+     use BBBPWMPinDevice to have the pair checked when compiling.
      */
     enum PWM_PinNum {
-        PWM42 = 42, //!< GPIO PWM Pin Number 42
-        PWM22 = 22, //!< GPIO PWM Pin Number 22
-        PWM19 = 19, //!< GPIO PWM Pin Number 19
-        PWM14 = 14, //!< GPIO PWM Pin Number 14
+        PWM42 = 42, //!< GPIO PWM Pin Number 42 (P9, eCAP0)
+        PWM22 = 22, //!< GPIO PWM Pin Number 22 (P9)
+        PWM19 = 19, //!< GPIO PWM Pin Number 19 (P8)
+        PWM14 = 14, //!< GPIO PWM Pin Number 14 (P9)
+        PWM13 = 13, //!< GPIO PWM Pin Number 13 (P8)
+        PWM16 = 16, //!< GPIO PWM Pin Number 16 (P9)
+        PWM21 = 21, //!< GPIO PWM Pin Number 21 (P9)
+        PWM28 = 28, //!< GPIO PWM Pin Number 28 (P9, eCAP2)
+        PWM29 = 29, //!< GPIO PWM Pin Number 29 (P9)
+        PWM31 = 31, //!< GPIO PWM Pin Number 31 (P9)
+        PWM34 = 34, //!< GPIO PWM Pin Number 34 (P8)
+        PWM36 = 36, //!< GPIO PWM Pin Number 36 (P8)
+        PWM45 = 45, //!< GPIO PWM Pin Number 45 (P8)
+        PWM46 = 46, //!< GPIO PWM Pin Number 46 (P8)
     };
 
     /**
@@ -78,6 +99,28 @@ public:
         ACTIVE = 1900000,
         INACTIVE = 0,
     };
+};
+
+/*!
+ *  \brief     BBBPWMDevice provides low level access to the PWM files on the BeagleBone Black.
+ *  \details   Every value goes out through PWM_Backend, picked at compile time (see BBBPWMBackend.h) : BBBPWMDevice
+ *             writes to sysfs, BBBPWMUringDevice to the same files batched through io_uring, BBBPWMEhrpwmDevice
+ *             straight to the eHRPWM registers, BBBPWMClassDevice to /sys/class/pwm on current kernels,
+ *             BBBPWMSimDevice to an in-memory log and BBBPWMNullDevice nowhere. The members are defined in
+ *             BBBPWMDevice.cpp and instantiated there for these six backends.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMBasicDevice : public BBBPWMDeviceTypes {
+
+    friend class BBBPWMBasicController< PWM_Backend >;
+    friend class BBBPWMServer< PWM_Backend >;
+    friend class BBBPWMFailsafe< PWM_Backend >;
+
+public:
 
     /**
      \fn public function int PWM_Init( )
@@ -87,24 +130,105 @@ public:
      */
     int PWM_Init( );
 
+    /**
+     \fn public static function int PWM_InitAll( const vector< BBBPWMBasicDevice* >& Devices, vector< int >& Status )
+     \brief Sets up many devices at once, their block and pin numbers already set : the backend attaches every pin in one
+     go (see PWM_AttachAll( ) in BBBPWMBackend.h, the sysfs backend loads all the missing overlays and waits for them
+     together), then the starting values of all channels are read and the writers started. Unlike PWM_Init( ) a device
+     that fails is reported in Status rather than ending the program.
+     \param const <vector<BBBPWMBasicDevice*>>& Devices
+     \param <vector<int>>& Status (resized to Devices, 1 ready, 0 unable to attach, -1 unable to load its values or start its writer)
+     \return <int> number of devices ready.
+     */
+    static int PWM_InitAll( const vector< BBBPWMBasicDevice* >& Devices, vector< int >& Status );
+
     /**
      \fn public function int PWM_SetRunVal( <PWM_RunValues> PWM_RunVal )
-     \brief Store and write a new PWM Run Value
+     \brief Store and write a new PWM Run Value. Once the device has a controller the value is handed to its writer
+     thread like a duty target, a failed write is then retried on the tick and counted in PWM_GetMetrics( ).
      \param <int> PWM_RunVal (0 or 1)
      \throws Exception on failure to write.
-     \return <int> 0 Exception, > 0 success.
+     \return <int> -1 not 0 or 1, 0 Exception or failed to write, > 0 success (or handed to the writer).
      */
     int PWM_SetRunVal( PWM_RunValues PWM_RunVal );
 
     /**
      \fn public function int PWM_SetPeriodVal( <PWM_PeriodValues> PWM_PeriodVal )
-     \brief Store and write a new PWM Period Value
+     \brief Store and write a new PWM Period Value. Once the device has a controller the value is handed to its writer
+     thread like a duty target, ramped there while a period slew is set (see PWM_SetPeriodSlew( )).
      \param <int> PWM_PeriodVal
      \throws Exception on failure to write.
-     \return <int> 0 Exception, > 0 success.
+     \return <int> 0 Exception or failed to write, > 0 success (or handed to the writer).
      */
     int PWM_SetPeriodVal( PWM_PeriodValues PWM_PeriodVal );
 
+    /**
+     \fn public function void PWM_SetDutySlew( int NsPerTick )
+     \brief Limits how far the duty may move per controller tick (see BBBPWMController::PWM_SetTickPeriod( )), so new targets are reached with a linear ramp.
+     \param <int> NsPerTick (0 disables the limit, targets are then written as soon as they arrive)
+     \return <void>
+     */
+    void PWM_SetDutySlew( int NsPerTick );
+
+    /**
+     \fn public function void PWM_SetPeriodSlew( int NsPerTick )
+     \brief Limits how far the period may move per controller tick, e.g. for the STARTUP to ACTIVE transition.
+     \param <int> NsPerTick (0 disables the limit, the writer then jumps straight to a new period)
+     \return <void>
+     */
+    void PWM_SetPeriodSlew( int NsPerTick );
+
+    /**
+     \fn public function void PWM_CancelRamp( void )
+     \brief Stops any duty or period ramp in flight at the value reached so far. A later PWM_SetTargetSpeed( ) starts a new ramp from there.
+     \param <void>
+     \return <void>
+     */
+    void PWM_CancelRamp( void );
+
+    /**
+     \fn public function uint64_t PWM_GetCoalescedCount( void ) const
+     \brief Returns how many target updates were merged into an update the writer had not picked up yet.
+     \param <void>
+     \return <uint64_t> this->PWM_CoalescedCount
+     */
+    uint64_t PWM_GetCoalescedCount( void ) const;
+
+    /**
+     \fn public function uint64_t PWM_GetSuppressedCount( void ) const
+     \brief Returns how many duty, period or run updates were dropped because the kernel already held that value.
+     \param <void>
+     \return <uint64_t> this->PWM_SuppressedCount
+     */
+    uint64_t PWM_GetSuppressedCount( void ) const;
+
+    /**
+     \fn public function void PWM_GetMetrics( BBBPWMMetrics& Metrics ) const
+     \brief Copies this device's counters and write latency histogram into Metrics. Lock-free, safe from any thread while
+     the writer runs, it never makes the writer wait. Each counter is read atomically but not all at the same instant, so
+     counters may be a few updates apart from each other.
+     \param <BBBPWMMetrics>& Metrics
+     \return <void>
+     */
+    void PWM_GetMetrics( BBBPWMMetrics& Metrics ) const;
+
+    /**
+     \fn public function void PWM_SetLatencyTiming( bool Enabled )
+     \brief Turns the write latency histogram on or off (on by default). Timing costs two clock_gettime( ) calls per write,
+     counters are always kept and cost one relaxed atomic increment per write.
+     \param <bool> Enabled
+     \return <void>
+     */
+    void PWM_SetLatencyTiming( bool Enabled );
+
+    /**
+     \fn public function bool PWM_IsRamping( void ) const
+     \brief Returns true while the writer is still stepping the duty or period towards its target.
+     \param <void>
+     \return <bool> this->PWM_Ramping
+     */
+    bool PWM_IsRamping( void ) const;
+
     /**
      \fn public function void PWM_SetPinNum( PWM_BlockNum BlockNum )
      \brief Sets the Pin Number for this device. (Using the PinNum and BlockNum will tell you where this device is or should be plugged in)
@@ -141,7 +265,7 @@ public:
      \fn public function int PWM_GetDutyVal( void ) const
      \brief Returns the DutyVal for this PWM Device
      \param <void>
-     \return <int> this->PWM_DutyVal
+     \return <int> duty of PWM_Channel in this->PWM_Table
      */
     int PWM_GetDutyVal( void ) const;
 
@@ -163,126 +287,285 @@ public:
 
     /**
      \fn public function void PWM_SetTargetSpeed( int TargetSpeed )
-     \brief Returns the RunVal for this PWM Device
+     \brief Publishes a new target speed (duty in ns) and wakes the writer thread. Lock-free, callable from any thread.
      \param <int> TargetSpeed
-     \return <int> this->PWM_RunVal
+     \return <void>
      */
     void PWM_SetTargetSpeed( int TargetSpeed );
 
     /**
-     \brief BBBAnalogDevice : A low level control of PWM devices on the Beaglebone Black.
+     \fn public function int PWM_GetTargetSpeed( void ) const
+     \brief Returns the latest target speed published with PWM_SetTargetSpeed( ).
+     \param <void>
+     \return <int> target of PWM_Channel in this->PWM_Table
+     */
+    int PWM_GetTargetSpeed( void ) const;
+
+    /**
+     \fn public function void PWM_StopThread( void )
+     \brief Stops the private duty writer started by PWM_Init( ) and waits for it to exit. Safe to call more than once. Devices added to a shared BBBPWMController are stopped with BBBPWMController::PWM_Stop( ) instead.
+     \param <void>
+     \return <void>
+     */
+    void PWM_StopThread( void );
+
+    /**
+     \fn public function void PWM_SetOverlayTimeout( int Milliseconds )
+     \brief Sets how long PWM_Init( ) waits for the pwm_test_ folder to appear after loading the pin overlay. Defaults to PWM_OVERLAY_TIMEOUT_MS, ignored by backends that never wait.
+     \param <int> Milliseconds
+     \return <void>
+     */
+    void PWM_SetOverlayTimeout( int Milliseconds );
+
+    /**
+     \fn public function void PWM_SetSysfsRoot( const string& Root )
+     \brief Sets the sysfs mount point used to build every device path, must be called before PWM_Init( ). Defaults to SYSFS_ROOT, ignored by backends without files.
+     \param const <string>& Root (e.g. "/sys" or a fake tree in a temp directory)
+     \return <void>
+     */
+    void PWM_SetSysfsRoot( const string& Root );
+
+    /**
+     \fn public function string PWM_GetSysfsRoot( void ) const
+     \brief Returns the sysfs mount point used by this device.
      \param <void>
+     \return <string>
      */
-    BBBPWMDevice( );
+    string PWM_GetSysfsRoot( void ) const;
 
-protected:
+    /**
+     \fn public function PWM_Backend& PWM_GetBackend( void )
+     \brief Returns the output backend, e.g. to read back the write log of a BBBPWMSimBackend.
+     \param <void>
+     \return <PWM_Backend>& this->PWM_Output
+     */
+    PWM_Backend& PWM_GetBackend( void );
 
-    int PWM_RunVal; //!< Stores the PWM Devices Run Value
-    int PWM_DutyVal; //!< Stores the PWM Devices Duty Value
-    int PWM_PeriodVal; //!< Stores the PWM Devices Period Value
-    int PWM_FileHandle; //!< Stores the PWM Devices File Handle
-    int PWM_Ret; //!< Stores the thread created value.
+    /**
+     \brief BBBAnalogDevice : A low level control of PWM devices on the Beaglebone Black.
+     \param <void>
+     */
+    BBBPWMBasicDevice( );
+
+    /**
+     \brief ~BBBPWMDevice : Stops the duty writer thread and closes the backend (the duty, period and run files held open by this device).
+     */
+    ~BBBPWMBasicDevice( );
+
+private:
+
+    // Producer side : written by callers, read by the writer thread. The duty target and slew are in PWM_Table.
+    alignas( PWM_CACHE_LINE ) atomic< int > PWM_PeriodTarget; //!< Latest requested period, what the writer steps PWM_PeriodVal towards.
+    atomic< int > PWM_PeriodSlew; //!< Max period change per tick in ns, 0 = unlimited.
+    atomic< uint64_t > PWM_CoalescedCount; //!< Updates merged into one still pending in the controller's dirty set.
+    atomic< uint64_t > PWM_ClampedCount; //!< Duty targets outside PWM_DUTY_LOW - PWM_DUTY_HIGH.
+
+    // Written wherever the kernel write is issued : by the writer thread once the device has a controller, by the
+    // caller's thread before that (PWM_Init( ), or a device without one). Never by both, so the committed values always
+    // match the kernel. Kept on a line apart from the targets above so that target stores never false-share with these writes.
+    alignas( PWM_CACHE_LINE ) atomic< int > PWM_PeriodVal; //!< Stores the PWM Devices Period Value
+    atomic< bool > PWM_Ramping; //!< True while a duty or period ramp is in flight.
+    atomic< uint64_t > PWM_SuppressedCount; //!< Updates dropped because the committed value already matched.
+    atomic< uint64_t > PWM_WriteCount; //!< Writes issued to the duty, period and run attributes.
+    atomic< uint64_t > PWM_FailureCount; //!< Writes that failed, by errno in PWM_ErrnoCount.
+    atomic< uint32_t > PWM_Reported; //!< One bit per attribute whose first failed write has been printed.
+    atomic< bool > PWM_LatencyTiming; //!< True to time writes into PWM_LatencyCount.
+
+    // Only touched when a write fails or is timed, kept apart so the arrays do not push the fields above off their lines.
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_ErrnoCount[ PWM_METRICS_ERRNOS ]; //!< Failed writes indexed by errno.
+    atomic< uint64_t > PWM_LatencyCount[ PWM_LATENCY_BUCKETS ]; //!< Backend write latency histogram, see PWM_LatencyBucket( ).
+
+    alignas( PWM_CACHE_LINE ) atomic< int > PWM_RunVal; //!< Stores the PWM Devices Run Value (last value written to the kernel)
+    atomic< int > PWM_RunTarget; //!< Latest requested run value, -1 until one is known, what PWM_Update( ) writes.
+    shared_ptr< BBBPWMChannelTable > PWM_Table; //!< Hot state of this channel, a one-channel table of its own until BBBPWMController::PWM_AddDevice( ) moves it into the controller's.
+    int PWM_Channel; //!< Index of this device in PWM_Table and PWM_Controller.
+
+    BBBPWMBasicController< PWM_Backend > *PWM_Controller; //!< Writer engine servicing this device, NULL until PWM_Init( ) or BBBPWMController::PWM_AddDevice( ).
+    bool PWM_OwnsController; //!< True when PWM_Controller is private to this device and was created by PWM_StartThread( ).
 
     PWM_PinNum PinNum; //!< <PWM_PinNum> enum for Pin Number
     PWM_BlockNum BlockNum; //!< <PWM_BlockNum> enum for Block Number
 
-    FILE *PWM_ReadFile; //!< File object used for reading values
+    PWM_Backend PWM_Output; //!< Where the duty, period and run values are written.
 
-    struct stat sb; //!< Used to discover if a folder or file exists already.
-
-    string period_file_loc; //!< Stores the PWM Devices Period File Location
-    string duty_file_loc; //!< Stores the PWM Devices Duty File Location
-    string run_file_loc; //!< Stores the PWM Devices Run File Location
-
-    char *PWM_ReadBuffer; //!< Used to read to files.
-    char PWM_Buffer[MAX_BUF]; //!< Used to write to files.
-    char PWM_PinOverlayFileName[MAX_BUF]; //!< Stores the PWM File name
-    char PWM_PinOverlayFolderName[MAX_BUF]; //!< Stores the PWM folder name
-    char PWM_PinOverlay[MAX_BUF]; //!< Stores the PWM device tree overlay name.
+    /**
+     \brief PWM_UpdateFlags - what a call to PWM_Update( ) did, returned as a bit mask.
+     */
+    enum PWM_UpdateFlags {
+        PWM_WROTE = 1, //!< At least one value was written to the kernel.
+        PWM_RAMPING = 2, //!< The duty, period or run has not reached its target yet, call again on the next tick.
+    };
 
     /**
-     \fn private function void* PWM_SetDutyVal( void *pwm_inst )
-     \brief Store and write a new PWM Duty Value
+     \fn private function void PWM_MarkDirty( void )
+     \brief Hands this channel to the controller's writer thread, counting the update as coalesced if one was already pending.
      \param <void>
-     \throws Exception on failure to write.
-     \return <int> 0 Exception, > 0 success.
+     \return <void>
      */
-    static void *PWM_SetDutyVal( void *pwm_inst );
+    void PWM_MarkDirty( void );
 
     /**
-     \fn private function int PWM_SysCheck( void )
-     \brief Checks that the system files are available for PWM operation on the BeagleBone Black.
-     \param <void>
-     \return <int> 0 failure load the system files, 1 success.
+     \fn private function void PWM_NoteTarget( int PWM_Target )
+     \brief Traces a new duty target and counts it if it is out of range, for every way a target reaches the table.
+     \param <int> PWM_Target
+     \return <void>
      */
-    int PWM_SysCheck( void );
+    void PWM_NoteTarget( int PWM_Target );
 
     /**
-     \fn private function int PWM_StartThread( void )
-     \brief Starts a thread to modify the speed of the PWM Device
-     \param <void>
+     \fn private function void PWM_RequestPeriod( int PWM_Period )
+     \brief Traces a new period and makes it the target PWM_Update( ) writes, without marking the channel dirty.
+     \param <int> PWM_Period
+     \return <void>
+     */
+    void PWM_RequestPeriod( int PWM_Period );
+
+    /**
+     \fn private function void PWM_RequestRun( int PWM_Run )
+     \brief Traces a new run value and makes it the target PWM_Update( ) writes, without marking the channel dirty.
+     \param <int> PWM_Run (0 or 1)
      \return <void>
      */
-    void PWM_StartThread( void );
+    void PWM_RequestRun( int PWM_Run );
+
+    /**
+     \fn private function int PWM_Commit( PWM_Attribute PWM_Attr, atomic< int >& PWM_Committed, int PWM_Value )
+     \brief Without a controller : writes a period or run value unless the kernel already holds it, then records it as committed.
+     \param <PWM_Attribute> PWM_Attr
+     \param <atomic<int>>& PWM_Committed (PWM_PeriodVal or PWM_RunVal)
+     \param <int> PWM_Value
+     \return <int> -1 failed to open, 0 failed to write, 1 success (or already held).
+     */
+    int PWM_Commit( PWM_Attribute PWM_Attr, atomic< int >& PWM_Committed, int PWM_Value );
+
+    /**
+     \fn private function int PWM_Update( int PWM_Ticks )
+     \brief Called from the writer thread of PWM_Controller : moves the PWM Duty and Period Values towards the latest targets (stepped while a slew is set), and writes the latest run value unless the kernel already holds it.
+     \param <int> PWM_Ticks (ticks elapsed since the last call, 0 when woken by a new target rather than by the tick)
+     \return <int> PWM_UpdateFlags bit mask.
+     */
+    int PWM_Update( int PWM_Ticks );
 
     /**
-     \fn private function int PWM_PinCheck( void )
-     \brief Checks that the PWM Pin files are available for PWM operation on the BeagleBone Black.
+     \fn private function int PWM_Reconcile( void )
+     \brief Called from the writer thread when its backend reports batched writes that failed after PWM_Update( ) had
+     counted them as written : each is counted as a failure and its value rolled back to what the kernel holds, so the
+     next tick writes it again like any failed write.
      \param <void>
-     \return <int> 99 failure load the PWM Pin files, < 99 success.
+     \return <int> PWM_RAMPING if a write has to be retried, 0 otherwise.
      */
-    int PWM_PinCheck( void );
+    int PWM_Reconcile( void );
 
     /**
-     \fn private function int PWM_LoadOverlay( const char* PWM_OverlayFile )
-     \brief The BeagleBone Black has Overlay Files to allow operations like PWM. In this function we are attempting to export an overlay for PWM.
-     \param const <char>* PWM_OverlayFile (just the file name, no path required)
-     \return <int> -1 failure load the system files, 1 success.
+     \fn private function int PWM_StepValue( ... )
+     \brief Steps one value towards its target by at most PWM_Slew * PWM_Ticks and writes it, clamped to [ PWM_Min, PWM_Max ].
+     \param <atomic<int>>& PWM_Target (PWM_RAMP_HOLD is replaced by the current value)
+     \param <atomic<int>>& PWM_Current (last value written, updated on success)
+     \param <int> PWM_Slew (0 = jump straight to the target)
+     \param <int> PWM_Ticks
+     \param <int> PWM_Min
+     \param <int> PWM_Max
+     \param <PWM_Attribute> PWM_Attr
+     \return <int> PWM_UpdateFlags bit mask.
      */
-    int PWM_LoadOverlay( const char *PWM_OverlayFile );
+    int PWM_StepValue( atomic< int >& PWM_Target, atomic< int >& PWM_Current, int PWM_Slew, int PWM_Ticks, int PWM_Min, int PWM_Max, PWM_Attribute PWM_Attr );
 
     /**
-     \fn private function int PWM_SetFileHandle( const char* PWM_FileName )
-     \brief Creates a private FileHandle for use within this class.
-     \param const <char>* PWM_FileName
-     \throws Exception on failure to open the file.
-     \return <int> -1 failure load the system files, > 0 success.
+     \fn private function int PWM_StartThread( void )
+     \brief Starts a private single-channel BBBPWMController to modify the speed of the PWM Device, unless the device was added to a shared one.
+     \param <void>
+     \return <int> -1 unable to start the writer thread, 1 success.
      */
-    int PWM_SetFileHandle( const char *PWM_FileName );
+    int PWM_StartThread( void );
 
     /**
      \fn private function int PWM_LoadPWMDefaultValues( void )
-     \brief Load and store the file paths and the current values from the PWM, period, duty and run. Just so that they are set on program startup.
+     \brief Load and store the current values from the PWM, period, duty and run. Just so that they are set on program startup.
+     They are seeded as both committed and requested, nothing is written and nothing counts as suppressed.
      \param <void>
      \return <int> -1 failure load the default values, 1 success.
      */
     int PWM_LoadPWMDefaultValues( void );
 
     /**
-     \fn private function int PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen )
-     \brief Writes a value to a file.
-     \param const <char>* PWM_Buffer (holds the value to be written)
-     \param <int>PWM_BufferLen (length of the buffer to be written)
-     \throws Exception on failure to write.
-     \return <int> -1 exception occured, 0 failed to write, 1 success.
+     \fn private function void PWM_RecordFailure( int PWM_Errno )
+     \brief Counts a failed write against its errno.
+     \param <int> PWM_Errno
+     \return <void>
      */
-    int PWM_WriteToFile( const char *PWM_Buffer, int PWM_BufferLen );
+    void PWM_RecordFailure( int PWM_Errno );
 
     /**
-     \fn private function int PWM_ReadFromFile( string FH_Name )
-     \brief Reads a value from a file.
-     \param <string> FH_Name
-     \return <int> 0 failed to read, > 0 success.
+     \fn private function void PWM_ReportFailure( PWM_Attribute PWM_Attr, int PWM_Errno )
+     \brief Prints the first failed write of an attribute, the ones after it are only counted (see PWM_GetMetrics( )).
+     \param <PWM_Attribute> PWM_Attr
+     \param <int> PWM_Errno
+     \return <void>
      */
-    char *PWM_ReadFromFile( string FH_Name );
+    void PWM_ReportFailure( PWM_Attribute PWM_Attr, int PWM_Errno );
 
     /**
-     \fn private function int PWM_SetPWMFilePaths( void )
-     \brief Load and store the file paths for use in this class.
+     \fn private function int PWM_WriteValue( PWM_Attribute PWM_Attr, int PWM_Value )
+     \brief Hands a value to the backend, counting and optionally timing the write, and retries once when the backend reports EBADF or ENODEV.
+     Inside a batch (see PWM_BatchBegin( )) success only means queued, a later failure comes back through PWM_Reconcile( ).
+     \param <PWM_Attribute> PWM_Attr
+     \param <int> PWM_Value
+     \return <int> -1 failed to open, 0 failed to write, 1 success.
+     */
+    int PWM_WriteValue( PWM_Attribute PWM_Attr, int PWM_Value );
+};
+
+extern template class BBBPWMBasicDevice< BBBPWMSysfsBackend >;
+extern template class BBBPWMBasicDevice< BBBPWMSimBackend >;
+extern template class BBBPWMBasicDevice< BBBPWMNullBackend >;
+extern template class BBBPWMBasicDevice< BBBPWMUringBackend >;
+extern template class BBBPWMBasicDevice< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMBasicDevice< BBBPWMClassBackend >;
+
+typedef BBBPWMBasicDevice< BBBPWMSysfsBackend > BBBPWMDevice; //!< A device on the BeagleBone Black's sysfs PWM files.
+typedef BBBPWMBasicDevice< BBBPWMSimBackend > BBBPWMSimDevice; //!< A device on an in-memory simulated pin.
+typedef BBBPWMBasicDevice< BBBPWMNullBackend > BBBPWMNullDevice; //!< A device whose writes are discarded.
+typedef BBBPWMBasicDevice< BBBPWMUringBackend > BBBPWMUringDevice; //!< A device on the sysfs PWM files whose writer batches through io_uring.
+typedef BBBPWMBasicDevice< BBBPWMEhrpwmBackend > BBBPWMEhrpwmDevice; //!< A device writing the eHRPWM registers directly (root, mmap of /dev/mem).
+typedef BBBPWMBasicDevice< BBBPWMClassBackend > BBBPWMClassDevice; //!< A device on the generic /sys/class/pwm interface of 4.x and later kernels.
+
+/*!
+ *  \brief     BBBPWMPinDevice is a device fixed to one header pin when compiling.
+ *  \details   The block / pin pair is checked against BBBPWMPins by the compiler, so a pin that cannot output PWM is
+ *             a build error rather than an exit( 1 ) in PWM_Init( ). PWM_SetBlockNum( ) and PWM_SetPinNum( ) are hidden :
+ *             \code
+ *             BBBPWMPinDevice< BBBPWMDevice::P9, BBBPWMDevice::PWM14 > Motor;
+ *             BBBPWMPinDevice< BBBPWMDevice::P9, BBBPWMDevice::PWM14, BBBPWMUringBackend > Batched;
+ *             // BBBPWMPinDevice< BBBPWMDevice::P8, BBBPWMDevice::PWM14 > Wrong;   // does not compile
+ *             Motor.PWM_Init( );
+ *             \endcode
+ *             The pin's overlay name (PWM_Pin.PWM_Overlay) is a compile-time string. It adds nothing to the size of the
+ *             BBBPWMBasicDevice it derives from and works with a BBBPWMBasicController of the same backend.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< int PWM_Block, int PWM_PinNumber, class PWM_Backend = BBBPWMSysfsBackend >
+class BBBPWMPinDevice : public BBBPWMBasicDevice< PWM_Backend > {
+
+    static_assert( BBBPWMPins::PWM_Find( PWM_Block, PWM_PinNumber ) != NULL, "this block / pin pair cannot output PWM, see BBBPWMPins" );
+
+    using BBBPWMBasicDevice< PWM_Backend >::PWM_SetBlockNum;
+    using BBBPWMBasicDevice< PWM_Backend >::PWM_SetPinNum;
+
+public:
+
+    static constexpr const BBBPWMPinInfo& PWM_Pin = *BBBPWMPins::PWM_Find( PWM_Block, PWM_PinNumber ); //!< The pin's BBBPWMPins entry.
+
+    /**
+     \brief BBBPWMPinDevice : A device on P<PWM_Block>_<PWM_PinNumber>, ready for PWM_Init( ).
      \param <void>
-     \return <void>
      */
-    void PWM_SetPWMFilePaths( void );
+    BBBPWMPinDevice( ) {
+        this->PWM_SetBlockNum( ( BBBPWMDeviceTypes::PWM_BlockNum ) PWM_Block );
+        this->PWM_SetPinNum( ( BBBPWMDeviceTypes::PWM_PinNum ) PWM_PinNumber );
+    }
 };
 
 #endif /* BBBAnalogDevice_h */
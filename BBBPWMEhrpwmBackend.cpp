@@ -0,0 +1,343 @@
+//
+//  BBBPWMEhrpwmBackend.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMEhrpwmBackend.h"
+
+#include <sys/mman.h>
+
+#define PWM_TBCTL_CTRMODE      0x0003 //!< Counter mode, 0 up-count, 3 stopped.
+#define PWM_TBCTL_PRDLD        0x0008 //!< Set loads TBPRD immediately, clear loads it from its shadow at zero.
+#define PWM_TBCTL_SYNCOSEL_OFF 0x0030 //!< No sync output.
+#define PWM_TBCTL_DIVIDERS     0x1F80 //!< CLKDIV (12:10) and HSPCLKDIV (9:7).
+#define PWM_TBCTL_FREE_RUN     0x8000 //!< Keep counting when a debugger halts the CPU.
+#define PWM_CMPCTL_IMMEDIATE   0x005F //!< SHDWBMODE, SHDWAMODE and LOADxMODE clear : both compares shadowed, loaded at zero.
+#define PWM_AQ_CHANNEL_A       0x0012 //!< AQCTLA : set at zero, clear when the counter reaches CMPA going up.
+#define PWM_AQ_CHANNEL_B       0x0102 //!< AQCTLB : set at zero, clear when the counter reaches CMPB going up.
+#define PWM_AQCSFRC_LOW        0x1 //!< Continuously forced low, per output at bits 2 * channel.
+#define PWM_TBPRD_MAX          65535 //!< TBPRD is 16 bit.
+#define PWM_CLKDIV_MAX         7 //!< CLKDIV divides by up to 2^7.
+
+// Guards read-modify-write of registers two outputs of a module share (TBCTL, AQCSFRC) and the divider / compare pairs.
+static pthread_mutex_t PWM_RegLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ \brief BBBPWMEhrpwmBackend : Nothing is mapped until PWM_Attach( ).
+ \param <void>
+ */
+BBBPWMEhrpwmBackend::BBBPWMEhrpwmBackend( ) {
+    this->PWM_MemFD = -1;
+    this->PWM_MemBase = PWM_EHRPWM_BASE;
+    this->PWM_Map = MAP_FAILED;
+    this->PWM_Regs = NULL;
+    this->PWM_Pin = NULL;
+}
+
+/**
+ \brief ~BBBPWMEhrpwmBackend : Unmaps the registers.
+ */
+BBBPWMEhrpwmBackend::~BBBPWMEhrpwmBackend( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_SetMemory( int FD, off_t Base )
+ \brief Maps the registers from FD at Base instead of PWM_EHRPWM_MEM at PWM_EHRPWM_BASE, call before PWM_Attach( ).
+ FD stays open and owned by the caller.
+ \param <int> FD (-1 back to PWM_EHRPWM_MEM)
+ \param <off_t> Base (offset of PWMSS0 in FD, the other subsystems follow every PWM_EHRPWM_STRIDE)
+ \return <void>
+ */
+void BBBPWMEhrpwmBackend::PWM_SetMemory( int FD, off_t Base ) {
+    this->PWM_MemFD = FD;
+    this->PWM_MemBase = FD < 0 ? PWM_EHRPWM_BASE : Base;
+}
+
+/**
+ \fn public function int PWM_Attach( int Block, int Pin )
+ \brief Maps the registers of the pin's ePWM module, setting up the module and output if they are not yet.
+ \param <int> Block
+ \param <int> Pin
+ \return <int> 0 not an eHRPWM pin or unable to map (reported), 1 success.
+ */
+int BBBPWMEhrpwmBackend::PWM_Attach( int Block, int Pin ) {
+    this->PWM_Close( );
+    // eCAP pins (P9_28, P9_42) are in BBBPWMPins but have no ePWM registers.
+    this->PWM_Pin = BBBPWMPins::PWM_Find( Block, Pin );
+    if( this->PWM_Pin == NULL || this->PWM_Pin->PWM_Module < 0 ) {
+        this->PWM_Pin = NULL;
+        cerr << "Critical Error 5 : Unable to setup PWM on your BeagleBone Black, P" << Block << "_" << Pin << " is not an eHRPWM output." << endl;
+        return 0;
+    }
+
+    int PWM_FD = this->PWM_MemFD;
+    if( PWM_FD < 0 && ( PWM_FD = open( PWM_EHRPWM_MEM, O_RDWR | O_SYNC | O_CLOEXEC ) ) < 0 ) {
+        cerr << "Error opening file : " << PWM_EHRPWM_MEM << " | Error = " << strerror( errno ) << endl;
+        return 0;
+    }
+    off_t PWM_Offset = this->PWM_MemBase + ( off_t ) this->PWM_Pin->PWM_Module * PWM_EHRPWM_STRIDE;
+    this->PWM_Map = mmap( NULL, PWM_EHRPWM_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, PWM_FD, PWM_Offset );
+    int PWM_Errno = errno;
+    // The mapping holds its own reference, a descriptor from PWM_SetMemory( ) is left to the caller.
+    if( PWM_FD != this->PWM_MemFD )
+        close( PWM_FD );
+    if( this->PWM_Map == MAP_FAILED ) {
+        cerr << "Error mapping ePWM" << this->PWM_Pin->PWM_Module << " registers : " << strerror( PWM_Errno ) << endl;
+        return 0;
+    }
+    this->PWM_Regs = ( volatile uint16_t* )( ( char* ) this->PWM_Map + PWM_EHRPWM_EPWM );
+
+    pthread_mutex_lock( &PWM_RegLock );
+    *( volatile uint32_t* )( ( char* ) this->PWM_Map + PWM_EHRPWM_CLKCONFIG ) |= 0x100;
+    // A module left running (e.g. by a previous run) keeps its period, only loading is made shadowed.
+    if( this->PWM_Reg( PWM_EHRPWM_TBPRD ) == 0 ) {
+        this->PWM_Reg( PWM_EHRPWM_TBCTL ) = PWM_TBCTL_FREE_RUN | PWM_TBCTL_SYNCOSEL_OFF | PWM_TBCTL_CTRMODE;
+        this->PWM_SetPeriodTicks( PWM_EHRPWM_PERIOD );
+    }
+    this->PWM_Reg( PWM_EHRPWM_TBCTL ) &= ~PWM_TBCTL_PRDLD;
+    this->PWM_Reg( PWM_EHRPWM_CMPCTL ) &= ~PWM_CMPCTL_IMMEDIATE;
+    int PWM_Action = this->PWM_Pin->PWM_Channel ? PWM_AQ_CHANNEL_B : PWM_AQ_CHANNEL_A;
+    int PWM_AqReg = this->PWM_Pin->PWM_Channel ? PWM_EHRPWM_AQCTLB : PWM_EHRPWM_AQCTLA;
+    if( this->PWM_Reg( PWM_AqReg ) != PWM_Action ) {
+        // A fresh output starts forced low at PWM_EHRPWM_DUTY, like an exported pwm_test_ pin that is not running.
+        int PWM_Shift = 2 * this->PWM_Pin->PWM_Channel;
+        this->PWM_Reg( PWM_EHRPWM_AQCSFRC ) = ( this->PWM_Reg( PWM_EHRPWM_AQCSFRC ) & ~( 3 << PWM_Shift ) ) | ( PWM_AQCSFRC_LOW << PWM_Shift );
+        this->PWM_Reg( this->PWM_Pin->PWM_Channel ? PWM_EHRPWM_CMPB : PWM_EHRPWM_CMPA ) = PWM_EHRPWM_DUTY / this->PWM_TickNs( );
+        this->PWM_Reg( PWM_AqReg ) = PWM_Action;
+    }
+    pthread_mutex_unlock( &PWM_RegLock );
+    return 1;
+}
+
+/**
+ \fn public static function int PWM_AttachAll( const vector< BBBPWMEhrpwmBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+ \brief Mapping never waits, each output is attached in turn.
+ \param const <vector<BBBPWMEhrpwmBackend*>>& Outputs
+ \param const <vector<int>>& Blocks
+ \param const <vector<int>>& Pins
+ \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+ \return <int> number of outputs attached.
+ */
+int BBBPWMEhrpwmBackend::PWM_AttachAll( const vector< BBBPWMEhrpwmBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+    Status.assign( Outputs.size( ), 0 );
+    int PWM_Attached = 0;
+    for( size_t d = 0; d < Outputs.size( ); d++ )
+        PWM_Attached += Status[ d ] = Outputs[ d ]->PWM_Attach( Blocks[ d ], Pins[ d ] );
+    return PWM_Attached;
+}
+
+/**
+ \fn private function volatile uint16_t& PWM_Reg( int Offset )
+ \brief Returns an ePWM register of the mapped module.
+ \param <int> Offset (PWM_EHRPWM_TBCTL etc.)
+ \return volatile <uint16_t>&
+ */
+volatile uint16_t& BBBPWMEhrpwmBackend::PWM_Reg( int Offset ) {
+    return this->PWM_Regs[ Offset / 2 ];
+}
+
+/**
+ \fn private function int PWM_TickNs( void )
+ \brief Returns the time base tick in ns from the dividers in TBCTL.
+ \param <void>
+ \return <int>
+ */
+int BBBPWMEhrpwmBackend::PWM_TickNs( void ) {
+    int PWM_Tbctl = this->PWM_Reg( PWM_EHRPWM_TBCTL );
+    int PWM_HighSpeed = ( PWM_Tbctl >> 7 ) & 7;
+    return PWM_EHRPWM_CLOCK_NS * ( PWM_HighSpeed ? 2 * PWM_HighSpeed : 1 ) * ( 1 << ( ( PWM_Tbctl >> 10 ) & 7 ) );
+}
+
+/**
+ \fn private function void PWM_SetPeriodTicks( int Period )
+ \brief Picks the smallest divider that fits Period ns in TBPRD, rescales both compare registers if it changes, then stores TBPRD.
+ \param <int> Period
+ \return <void>
+ */
+void BBBPWMEhrpwmBackend::PWM_SetPeriodTicks( int Period ) {
+    int PWM_Div = 0;
+    while( PWM_Div < PWM_CLKDIV_MAX && ( Period + ( PWM_EHRPWM_CLOCK_NS << PWM_Div ) / 2 ) / ( PWM_EHRPWM_CLOCK_NS << PWM_Div ) > PWM_TBPRD_MAX + 1 )
+        PWM_Div++;
+    int PWM_Tick = PWM_EHRPWM_CLOCK_NS << PWM_Div, PWM_OldTick = this->PWM_TickNs( );
+    if( PWM_Tick != PWM_OldTick ) {
+        // Keep both outputs' duty in ns across the new tick.
+        for( int PWM_Cmp = PWM_EHRPWM_CMPA; PWM_Cmp <= PWM_EHRPWM_CMPB; PWM_Cmp += 2 )
+            this->PWM_Reg( PWM_Cmp ) = ( this->PWM_Reg( PWM_Cmp ) * PWM_OldTick + PWM_Tick / 2 ) / PWM_Tick;
+        this->PWM_Reg( PWM_EHRPWM_TBCTL ) = ( this->PWM_Reg( PWM_EHRPWM_TBCTL ) & ~PWM_TBCTL_DIVIDERS ) | ( PWM_Div << 10 );
+    }
+    int PWM_Ticks = ( Period + PWM_Tick / 2 ) / PWM_Tick;
+    this->PWM_Reg( PWM_EHRPWM_TBPRD ) = ( PWM_Ticks > 0 ? PWM_Ticks : 1 ) - 1;
+}
+
+/**
+ \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+ \brief Reads a value back from the registers, duty and period in ns rounded to time base ticks.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> -1 not attached, 1 success.
+ */
+int BBBPWMEhrpwmBackend::PWM_Read( PWM_Attribute Attr, int& Value ) {
+    if( this->PWM_Regs == NULL )
+        return -1;
+    pthread_mutex_lock( &PWM_RegLock );
+    int PWM_Tick = this->PWM_TickNs( );
+    if( Attr == PWM_ATTR_DUTY )
+        Value = this->PWM_Reg( this->PWM_Pin->PWM_Channel ? PWM_EHRPWM_CMPB : PWM_EHRPWM_CMPA ) * PWM_Tick;
+    else if( Attr == PWM_ATTR_PERIOD )
+        Value = ( this->PWM_Reg( PWM_EHRPWM_TBPRD ) + 1 ) * PWM_Tick;
+    else
+        Value = ( this->PWM_Reg( PWM_EHRPWM_TBCTL ) & PWM_TBCTL_CTRMODE ) != PWM_TBCTL_CTRMODE
+            && ( ( this->PWM_Reg( PWM_EHRPWM_AQCSFRC ) >> ( 2 * this->PWM_Pin->PWM_Channel ) ) & 3 ) != PWM_AQCSFRC_LOW;
+    pthread_mutex_unlock( &PWM_RegLock );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+ \brief Stores a value in the registers, rejecting a duty longer than the period like the pwm_test driver.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> -1 not attached, 0 value out of range (errno EINVAL), 1 success.
+ */
+int BBBPWMEhrpwmBackend::PWM_Write( PWM_Attribute Attr, int Value ) {
+    if( this->PWM_Regs == NULL ) {
+        cerr << "Error - ePWM registers not mapped : " << this->PWM_Describe( Attr ) << endl;
+        return -1;
+    }
+    if( Value < 0 || ( Attr == PWM_ATTR_PERIOD && ( Value == 0 || Value / ( PWM_EHRPWM_CLOCK_NS << PWM_CLKDIV_MAX ) > PWM_TBPRD_MAX ) ) ) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    int PWM_Ret = 1;
+    pthread_mutex_lock( &PWM_RegLock );
+    if( Attr == PWM_ATTR_DUTY ) {
+        int PWM_Tick = this->PWM_TickNs( );
+        int PWM_Ticks = ( Value + PWM_Tick / 2 ) / PWM_Tick;
+        // A compare past TBPRD + 1 would never clear the output, sysfs refuses the same duty.
+        if( PWM_Ticks > this->PWM_Reg( PWM_EHRPWM_TBPRD ) + 1 ) {
+            errno = EINVAL;
+            PWM_Ret = 0;
+        }
+        else
+            this->PWM_Reg( this->PWM_Pin->PWM_Channel ? PWM_EHRPWM_CMPB : PWM_EHRPWM_CMPA ) = PWM_Ticks;
+    }
+    else if( Attr == PWM_ATTR_PERIOD )
+        this->PWM_SetPeriodTicks( Value );
+    else {
+        int PWM_Shift = 2 * this->PWM_Pin->PWM_Channel;
+        int PWM_Force = this->PWM_Reg( PWM_EHRPWM_AQCSFRC ) & ~( 3 << PWM_Shift );
+        this->PWM_Reg( PWM_EHRPWM_AQCSFRC ) = Value ? PWM_Force : PWM_Force | ( PWM_AQCSFRC_LOW << PWM_Shift );
+        if( Value && ( this->PWM_Reg( PWM_EHRPWM_TBCTL ) & PWM_TBCTL_CTRMODE ) == PWM_TBCTL_CTRMODE )
+            this->PWM_Reg( PWM_EHRPWM_TBCTL ) &= ~PWM_TBCTL_CTRMODE;
+    }
+    pthread_mutex_unlock( &PWM_RegLock );
+    return PWM_Ret;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Unmaps the registers, the output keeps running with the values last written.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMEhrpwmBackend::PWM_Close( void ) {
+    if( this->PWM_Map != MAP_FAILED )
+        munmap( this->PWM_Map, PWM_EHRPWM_WINDOW );
+    this->PWM_Map = MAP_FAILED;
+    this->PWM_Regs = NULL;
+}
+
+/**
+ \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+ \brief Returns the pin, output and register of an attribute, for error messages. Valid until the next call on the same thread.
+ \param <PWM_Attribute> Attr
+ \return const <char>*
+ */
+const char* BBBPWMEhrpwmBackend::PWM_Describe( PWM_Attribute Attr ) const {
+    static const char* const PWM_Registers[ PWM_ATTRS ] = { "CMP", "TBPRD", "AQCSFRC" };
+    static thread_local char PWM_Name[ 48 ];
+    if( this->PWM_Pin == NULL )
+        return PWM_Registers[ Attr ];
+    const char* PWM_Output = this->PWM_Pin->PWM_Channel ? "B" : "A";
+    snprintf( PWM_Name, sizeof( PWM_Name ), "P%d_%d ehrpwm%d%s %s%s", this->PWM_Pin->PWM_Block, this->PWM_Pin->PWM_Pin, this->PWM_Pin->PWM_Module,
+        PWM_Output, PWM_Registers[ Attr ], Attr == PWM_ATTR_DUTY ? PWM_Output : "" );
+    return PWM_Name;
+}
+
+/**
+ \fn public function void PWM_SetRoot( const string& Root )
+ \brief Kept for BBBPWMBasicDevice::PWM_SetSysfsRoot( ), the registers are not reached through sysfs.
+ \param const <string>& Root
+ \return <void>
+ */
+void BBBPWMEhrpwmBackend::PWM_SetRoot( const string& Root ) {
+    this->PWM_Root = Root;
+}
+
+/**
+ \fn public function string PWM_GetRoot( void ) const
+ \brief Returns the root given to PWM_SetRoot( ).
+ \param <void>
+ \return <string> this->PWM_Root
+ */
+string BBBPWMEhrpwmBackend::PWM_GetRoot( void ) const {
+    return this->PWM_Root;
+}
+
+/**
+ \fn public function void PWM_SetTimeout( int Milliseconds )
+ \brief Ignored, PWM_Attach( ) never waits.
+ \param <int> Milliseconds
+ \return <void>
+ */
+void BBBPWMEhrpwmBackend::PWM_SetTimeout( int Milliseconds ) {
+    ( void ) Milliseconds;
+}
+
+/**
+ \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+ \brief Register stores cannot fail later, PWM_Write( ) has already reported every failure.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> 0 no failure.
+ */
+int BBBPWMEhrpwmBackend::PWM_TakeError( PWM_Attribute Attr, int& Value ) {
+    ( void ) Attr;
+    ( void ) Value;
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchBegin( void )
+ \brief Nothing is batched, every write is a register store.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMEhrpwmBackend::PWM_BatchBegin( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchEnd( void )
+ \brief Nothing is batched, every write is a register store.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMEhrpwmBackend::PWM_BatchEnd( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchFD( void )
+ \brief No completions to wait for.
+ \param <void>
+ \return <int> -1
+ */
+int BBBPWMEhrpwmBackend::PWM_BatchFD( void ) {
+    return -1;
+}
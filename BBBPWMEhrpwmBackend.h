@@ -0,0 +1,234 @@
+//
+//  BBBPWMEhrpwmBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMEhrpwmBackend_h
+#define BBBPWMEhrpwmBackend_h
+
+#define PWM_EHRPWM_MEM         "/dev/mem" //!< Physical memory, mapped unless PWM_SetMemory( ) gave another descriptor.
+#define PWM_EHRPWM_BASE        0x48300000 //!< PWMSS0 (the 48300000.epwmss of MODALIAS_FILE), PWMSS1 and PWMSS2 follow.
+#define PWM_EHRPWM_STRIDE      0x2000 //!< Distance between two PWM subsystems.
+#define PWM_EHRPWM_WINDOW      0x1000 //!< Size mapped per subsystem : config, eCAP, eQEP and ePWM registers.
+#define PWM_EHRPWM_MODULES     3 //!< ePWM0 to ePWM2.
+#define PWM_EHRPWM_CLOCK_NS    10 //!< Time base clock period before division (100MHz SYSCLKOUT).
+#define PWM_EHRPWM_DUTY        700000 //!< Duty an unconfigured channel starts with (PWM_DUTY_HIGH).
+#define PWM_EHRPWM_PERIOD      1200000 //!< Period an unconfigured module starts with (STARTUP).
+
+#define PWM_EHRPWM_CLKCONFIG   0x008 //!< PWMSS clock gating, 32 bit, EPWMCLK_EN is bit 8.
+#define PWM_EHRPWM_EPWM        0x200 //!< ePWM registers within a subsystem, the 16 bit offsets below are relative to it.
+#define PWM_EHRPWM_TBCTL       0x00 //!< Time base control : counter mode, period shadowing, clock dividers.
+#define PWM_EHRPWM_TBPRD       0x0A //!< Time base period, shadowed.
+#define PWM_EHRPWM_CMPCTL      0x0E //!< Compare control : shadowing of CMPA / CMPB.
+#define PWM_EHRPWM_CMPA        0x12 //!< Compare A, channel A's duty in time base ticks.
+#define PWM_EHRPWM_CMPB        0x14 //!< Compare B, channel B's duty in time base ticks.
+#define PWM_EHRPWM_AQCTLA      0x16 //!< Action qualifier of output A.
+#define PWM_EHRPWM_AQCTLB      0x18 //!< Action qualifier of output B.
+#define PWM_EHRPWM_AQCSFRC     0x1C //!< Continuous software force of the outputs, shadowed.
+
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "BBBPWMBackend.h"
+#include "BBBPWMPins.h"
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMEhrpwmBackend drives one eHRPWM output by writing the ePWM registers directly, no sysfs in between.
+ *  \details   PWM_Attach( ) maps the pin's PWM subsystem from /dev/mem (root required, the am33xx_pwm overlay or a
+ *             pinmux must have routed the pin to the ePWM module). Every update is then a register store : duty goes
+ *             to CMPA / CMPB, period to TBPRD. Both are shadowed and only loaded when the counter wraps to zero, so a
+ *             change never cuts a pulse short or stretches it. Run 0 forces the output low through AQCSFRC rather
+ *             than stopping the counter, which the module's other output may be using.
+ *             The two outputs of a module (e.g. P9_14 and P9_16 on ePWM1) share TBPRD : the last period written wins.
+ *             A period beyond the range of the current time base divider changes the divider, which is not shadowed,
+ *             so that one period may come out irregular.
+ *             PWM_SetMemory( ) maps any descriptor instead, e.g. a memfd the size of three subsystems, so register
+ *             level writes can be checked without a board. Use it through BBBPWMEhrpwmDevice and BBBPWMEhrpwmController.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMEhrpwmBackend {
+public:
+
+    /**
+     \fn public function int PWM_Attach( int Block, int Pin )
+     \brief Maps the registers of the pin's ePWM module, setting up the module and output if they are not yet.
+     \param <int> Block
+     \param <int> Pin
+     \return <int> 0 not an eHRPWM pin or unable to map (reported), 1 success.
+     */
+    int PWM_Attach( int Block, int Pin );
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMEhrpwmBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief Mapping never waits, each output is attached in turn.
+     \param const <vector<BBBPWMEhrpwmBackend*>>& Outputs
+     \param const <vector<int>>& Blocks
+     \param const <vector<int>>& Pins
+     \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+     \return <int> number of outputs attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMEhrpwmBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Reads a value back from the registers, duty and period in ns rounded to time base ticks.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> -1 not attached, 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Stores a value in the registers, rejecting a duty longer than the period like the pwm_test driver.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> -1 not attached, 0 value out of range (errno EINVAL), 1 success.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Unmaps the registers, the output keeps running with the values last written.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+     \brief Returns the pin, output and register of an attribute, for error messages. Valid until the next call on the same thread.
+     \param <PWM_Attribute> Attr
+     \return const <char>*
+     */
+    const char* PWM_Describe( PWM_Attribute Attr ) const;
+
+    /**
+     \fn public function void PWM_SetRoot( const string& Root )
+     \brief Kept for BBBPWMBasicDevice::PWM_SetSysfsRoot( ), the registers are not reached through sysfs.
+     \param const <string>& Root
+     \return <void>
+     */
+    void PWM_SetRoot( const string& Root );
+
+    /**
+     \fn public function string PWM_GetRoot( void ) const
+     \brief Returns the root given to PWM_SetRoot( ).
+     \param <void>
+     \return <string> this->PWM_Root
+     */
+    string PWM_GetRoot( void ) const;
+
+    /**
+     \fn public function void PWM_SetTimeout( int Milliseconds )
+     \brief Ignored, PWM_Attach( ) never waits.
+     \param <int> Milliseconds
+     \return <void>
+     */
+    void PWM_SetTimeout( int Milliseconds );
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Register stores cannot fail later, PWM_Write( ) has already reported every failure.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> 0 no failure.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Nothing is batched, every write is a register store.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchBegin( void );
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Nothing is batched, every write is a register store.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchEnd( void );
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief No completions to wait for.
+     \param <void>
+     \return <int> -1
+     */
+    static int PWM_BatchFD( void );
+
+    /**
+     \fn public function void PWM_SetMemory( int FD, off_t Base )
+     \brief Maps the registers from FD at Base instead of PWM_EHRPWM_MEM at PWM_EHRPWM_BASE, call before PWM_Attach( ).
+     FD stays open and owned by the caller.
+     \param <int> FD (-1 back to PWM_EHRPWM_MEM)
+     \param <off_t> Base (offset of PWMSS0 in FD, the other subsystems follow every PWM_EHRPWM_STRIDE)
+     \return <void>
+     */
+    void PWM_SetMemory( int FD, off_t Base );
+
+    /**
+     \brief BBBPWMEhrpwmBackend : Nothing is mapped until PWM_Attach( ).
+     \param <void>
+     */
+    BBBPWMEhrpwmBackend( );
+
+    /**
+     \brief ~BBBPWMEhrpwmBackend : Unmaps the registers.
+     */
+    ~BBBPWMEhrpwmBackend( );
+
+protected:
+
+    int PWM_MemFD; //!< Descriptor given to PWM_SetMemory( ), -1 to open PWM_EHRPWM_MEM.
+    off_t PWM_MemBase; //!< Offset of PWMSS0 in the mapped descriptor.
+    void* PWM_Map; //!< Mapped subsystem window, MAP_FAILED until PWM_Attach( ).
+    volatile uint16_t* PWM_Regs; //!< ePWM registers within PWM_Map.
+    const BBBPWMPinInfo* PWM_Pin; //!< BBBPWMPins entry, NULL until PWM_Attach( ).
+    string PWM_Root; //!< As given to PWM_SetRoot( ).
+
+    /**
+     \fn private function volatile uint16_t& PWM_Reg( int Offset )
+     \brief Returns an ePWM register of the mapped module.
+     \param <int> Offset (PWM_EHRPWM_TBCTL etc.)
+     \return volatile <uint16_t>&
+     */
+    volatile uint16_t& PWM_Reg( int Offset );
+
+    /**
+     \fn private function int PWM_TickNs( void )
+     \brief Returns the time base tick in ns from the dividers in TBCTL.
+     \param <void>
+     \return <int>
+     */
+    int PWM_TickNs( void );
+
+    /**
+     \fn private function void PWM_SetPeriodTicks( int Period )
+     \brief Picks the smallest divider that fits Period ns in TBPRD, rescales both compare registers if it changes, then stores TBPRD.
+     \param <int> Period
+     \return <void>
+     */
+    void PWM_SetPeriodTicks( int Period );
+};
+
+#endif /* BBBPWMEhrpwmBackend_h */
@@ -0,0 +1,321 @@
+//
+//  BBBPWMFailsafe.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMController.h"
+
+/**
+ \brief BBBPWMFailsafe : No channel watched, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+ \param <void>
+ */
+template< class PWM_Backend >
+BBBPWMFailsafe< PWM_Backend >::BBBPWMFailsafe( ) {
+    this->PWM_Owner = NULL;
+    this->PWM_FD = -1;
+    this->PWM_CheckNs = 0;
+    this->PWM_Start = 0;
+    this->PWM_Check = 0;
+    this->PWM_On = false;
+    this->PWM_Due = false;
+    this->PWM_Trips.store( 0 );
+    this->PWM_Recoveries.store( 0 );
+    this->PWM_MaxLate.store( 0 );
+    this->PWM_TotalLate.store( 0 );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        this->PWM_Late[ b ].store( 0 );
+}
+
+/**
+ \brief ~BBBPWMFailsafe : Closes the check timerfd.
+ */
+template< class PWM_Backend >
+BBBPWMFailsafe< PWM_Backend >::~BBBPWMFailsafe( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+ \brief Sets the controller whose channels are watched, from its constructor.
+ \param <BBBPWMBasicController<PWM_Backend>>* Owner
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner ) {
+    this->PWM_Owner = Owner;
+}
+
+/**
+ \fn public function int PWM_Open( void )
+ \brief Creates the check timerfd, disarmed.
+ \param <void>
+ \return <int> -1 failure (reported), 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMFailsafe< PWM_Backend >::PWM_Open( void ) {
+    this->PWM_FD = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if( this->PWM_FD < 0 ) {
+        cerr << "Error - unable to create the PWM failsafe check : " << strerror( errno ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes the check timerfd. Safe to call more than once.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_Close( void ) {
+    if( this->PWM_FD >= 0 )
+        close( this->PWM_FD );
+    this->PWM_FD = -1;
+}
+
+/**
+ \fn public function int PWM_GetFD( void ) const
+ \brief Returns the check timerfd for the writer to poll( ), -1 while closed.
+ \param <void>
+ \return <int> this->PWM_FD
+ */
+template< class PWM_Backend >
+int BBBPWMFailsafe< PWM_Backend >::PWM_GetFD( void ) const {
+    return this->PWM_FD;
+}
+
+/**
+ \fn public function int PWM_Set( int Channel, int TimeoutMs, int SafeDuty )
+ \brief Watches a channel, see BBBPWMController::PWM_SetFailsafe( ).
+ \param <int> Channel
+ \param <int> TimeoutMs (0 to stop watching it)
+ \param <int> SafeDuty (ns, or PWM_FAILSAFE_DISABLE)
+ \return <int> -1 no such channel or duty out of range, 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMFailsafe< PWM_Backend >::PWM_Set( int Channel, int TimeoutMs, int SafeDuty ) {
+    int PWM_Channels = this->PWM_Owner->PWM_GetDeviceCount( );
+    if( Channel < 0 || Channel >= PWM_Channels || TimeoutMs < 0
+        || ( SafeDuty != PWM_FAILSAFE_DISABLE && ( SafeDuty < PWM_DUTY_LOW || SafeDuty > PWM_DUTY_HIGH ) ) ) {
+        cerr << "Error - BBBPWMController::PWM_SetFailsafe( ) needs a registered channel and a safe duty between " << PWM_DUTY_LOW << " and " << PWM_DUTY_HIGH << endl;
+        return -1;
+    }
+    this->PWM_Timeout.resize( PWM_Channels, 0 );
+    this->PWM_Duty.resize( PWM_Channels, PWM_FAILSAFE_DISABLE );
+    this->PWM_Timeout[ Channel ] = ( int64_t ) TimeoutMs * 1000000;
+    this->PWM_Duty[ Channel ] = SafeDuty;
+    return 1;
+}
+
+/**
+ \fn public function bool PWM_IsTripped( int Channel ) const
+ \brief Checks whether a channel is held at its failsafe since its timeout. Lock-free.
+ \param <int> Channel
+ \return <bool> true if tripped.
+ */
+template< class PWM_Backend >
+bool BBBPWMFailsafe< PWM_Backend >::PWM_IsTripped( int Channel ) const {
+    if( Channel < 0 || Channel >= this->PWM_Owner->PWM_GetDeviceCount( ) )
+        return false;
+    const BBBPWMChannelTable& PWM_Hot = *this->PWM_Owner->PWM_Table;
+    return ( PWM_Hot.PWM_Tripped[ Channel / 32 ].load( memory_order_relaxed ) >> ( Channel % 32 ) ) & 1;
+}
+
+/**
+ \fn public function bool PWM_IsOn( void ) const
+ \brief Checks whether any channel is watched, as of the last PWM_Arm( ).
+ \param <void>
+ \return <bool> this->PWM_On
+ */
+template< class PWM_Backend >
+bool BBBPWMFailsafe< PWM_Backend >::PWM_IsOn( void ) const {
+    return this->PWM_On;
+}
+
+/**
+ \fn public function void PWM_GetStats( BBBPWMFailsafeStats& Stats ) const
+ \brief Copies the trips and how late they were written since PWM_Arm( ). Lock-free.
+ \param <BBBPWMFailsafeStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_GetStats( BBBPWMFailsafeStats& Stats ) const {
+    Stats.PWM_Trips = this->PWM_Trips.load( memory_order_relaxed );
+    Stats.PWM_Recoveries = this->PWM_Recoveries.load( memory_order_relaxed );
+    Stats.PWM_CheckNs = this->PWM_CheckNs;
+    Stats.PWM_MaxLateNs = this->PWM_MaxLate.load( memory_order_relaxed );
+    Stats.PWM_TotalLateNs = this->PWM_TotalLate.load( memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        Stats.PWM_Late[ b ] = this->PWM_Late[ b ].load( memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_Arm( void )
+ \brief Resets the watchdog, counts every watched channel as fed now and starts the periodic check.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_Arm( void ) {
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Owner->PWM_Table;
+    size_t PWM_Channels = this->PWM_Owner->PWM_Devices.size( );
+    size_t PWM_Words = PWM_Hot.PWM_DirtyWords;
+    this->PWM_Timeout.resize( PWM_Channels, 0 );
+    this->PWM_Duty.resize( PWM_Channels, PWM_FAILSAFE_DISABLE );
+    this->PWM_Fed.assign( PWM_Channels, 0 );
+    this->PWM_Watched.assign( PWM_Words, 0 );
+    this->PWM_Trip.assign( PWM_Words, 0 );
+    // The bits live in the channel table, sized as devices are added : PWM_IsTripped( ) may be reading them.
+    for( size_t w = 0; w < PWM_Words; w++ )
+        PWM_Hot.PWM_Tripped[ w ].store( 0, memory_order_relaxed );
+    this->PWM_Trips.store( 0, memory_order_relaxed );
+    this->PWM_Recoveries.store( 0, memory_order_relaxed );
+    this->PWM_MaxLate.store( 0, memory_order_relaxed );
+    this->PWM_TotalLate.store( 0, memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        this->PWM_Late[ b ].store( 0, memory_order_relaxed );
+    this->PWM_Due = false;
+
+    int64_t PWM_Shortest = 0;
+    for( size_t c = 0; c < PWM_Channels; c++ ) {
+        if( this->PWM_Timeout[ c ] <= 0 )
+            continue;
+        this->PWM_Watched[ c / 32 ] |= 1u << ( c % 32 );
+        if( PWM_Shortest == 0 || this->PWM_Timeout[ c ] < PWM_Shortest )
+            PWM_Shortest = this->PWM_Timeout[ c ];
+    }
+    this->PWM_On = PWM_Shortest > 0;
+    this->PWM_CheckNs = PWM_Shortest / PWM_FAILSAFE_CHECKS;
+    // Targets stored before now are covered by the start below.
+    for( size_t w = 0; w < PWM_Words; w++ )
+        PWM_Hot.PWM_Stored[ w ].store( 0, memory_order_relaxed );
+    PWM_Hot.PWM_Feeding.store( this->PWM_On, memory_order_relaxed );
+    if( !this->PWM_On )
+        return;
+
+    // A channel nobody feeds after the start trips one timeout in. Checks stay on a fixed grid, like the control tick.
+    this->PWM_Start = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+    for( size_t c = 0; c < PWM_Channels; c++ )
+        this->PWM_Fed[ c ] = this->PWM_Start;
+    int64_t PWM_First = this->PWM_Start + this->PWM_CheckNs;
+    struct itimerspec PWM_Timer;
+    PWM_Timer.it_value.tv_sec = PWM_First / 1000000000;
+    PWM_Timer.it_value.tv_nsec = PWM_First % 1000000000;
+    PWM_Timer.it_interval.tv_sec = this->PWM_CheckNs / 1000000000L;
+    PWM_Timer.it_interval.tv_nsec = this->PWM_CheckNs % 1000000000L;
+    if( timerfd_settime( this->PWM_FD, TFD_TIMER_ABSTIME, &PWM_Timer, NULL ) < 0 )
+        cerr << "Error - unable to set the PWM failsafe check : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn public function bool PWM_Run( void )
+ \brief Writer thread, once the pass has taken the dirty set : stamps the watched channels given a new duty target
+ since the last pass as fed, then on a check trips every other watched channel past its timeout : its safe duty or its
+ stop becomes its target and it joins the pass's pending set.
+ \param <void>
+ \return <bool> true if a channel tripped.
+ */
+template< class PWM_Backend >
+bool BBBPWMFailsafe< PWM_Backend >::PWM_Run( void ) {
+    if( !this->PWM_On )
+        return false;
+    BBBPWMChannelTable& PWM_Hot = *this->PWM_Owner->PWM_Table;
+    vector< uint32_t >& PWM_Pending = this->PWM_Owner->PWM_Pending;
+    // Stored bits rather than dirty ones : a cancelled ramp or a new period is not a sign of life. One clock read per pass that has any.
+    int64_t PWM_Now = 0;
+    for( size_t w = 0; w < PWM_Pending.size( ); w++ ) {
+        uint32_t PWM_Fed = PWM_Hot.PWM_Stored[ w ].exchange( 0, memory_order_relaxed ) & this->PWM_Watched[ w ];
+        if( !PWM_Fed )
+            continue;
+        if( !PWM_Now )
+            PWM_Now = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+        uint32_t PWM_Held = PWM_Hot.PWM_Tripped[ w ].load( memory_order_relaxed );
+        if( PWM_Fed & PWM_Held ) {
+            PWM_Hot.PWM_Tripped[ w ].store( PWM_Held & ~PWM_Fed, memory_order_relaxed );
+            this->PWM_Recoveries.store( this->PWM_Recoveries.load( memory_order_relaxed ) + __builtin_popcount( PWM_Fed & PWM_Held ), memory_order_relaxed );
+        }
+        while( PWM_Fed ) {
+            int PWM_Bit = __builtin_ctz( PWM_Fed );
+            PWM_Fed &= PWM_Fed - 1;
+            this->PWM_Fed[ w * 32 + PWM_Bit ] = PWM_Now;
+        }
+    }
+    if( !this->PWM_Due )
+        return false;
+    this->PWM_Due = false;
+
+    if( !PWM_Now )
+        PWM_Now = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+    this->PWM_Check = this->PWM_Start + ( PWM_Now - this->PWM_Start ) / this->PWM_CheckNs * this->PWM_CheckNs;
+    bool PWM_Any = false;
+    for( size_t w = 0; w < PWM_Pending.size( ); w++ ) {
+        uint32_t PWM_Held = PWM_Hot.PWM_Tripped[ w ].load( memory_order_relaxed );
+        // Channels fed this pass were stamped PWM_Now above and are never past their timeout.
+        uint32_t PWM_Bits = this->PWM_Watched[ w ] & ~PWM_Held;
+        while( PWM_Bits ) {
+            int PWM_Bit = __builtin_ctz( PWM_Bits );
+            PWM_Bits &= PWM_Bits - 1;
+            size_t c = w * 32 + PWM_Bit;
+            if( PWM_Now - this->PWM_Fed[ c ] < this->PWM_Timeout[ c ] )
+                continue;
+            // Not through PWM_SetTargetSpeed( ) : its stored bit would count as a feed on the next pass.
+            if( this->PWM_Duty[ c ] == PWM_FAILSAFE_DISABLE )
+                this->PWM_Owner->PWM_Devices[ c ]->PWM_RequestRun( BBBPWMDeviceTypes::OFF );
+            else
+                PWM_Hot.PWM_Target[ c ].store( this->PWM_Duty[ c ], memory_order_release );
+            PWM_Pending[ w ] |= 1u << PWM_Bit;
+            PWM_Held |= 1u << PWM_Bit;
+            this->PWM_Trip[ w ] |= 1u << PWM_Bit;
+            PWM_Any = true;
+        }
+        PWM_Hot.PWM_Tripped[ w ].store( PWM_Held, memory_order_relaxed );
+    }
+    return PWM_Any;
+}
+
+/**
+ \fn public function void PWM_Stamp( void )
+ \brief Writer thread, once the trips of a pass are written : records how long after the check was due.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_Stamp( void ) {
+    int64_t PWM_Delay = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( ) - this->PWM_Check;
+    int PWM_Bucket = PWM_LatencyBucket( PWM_Delay > 0 ? PWM_Delay : 0 );
+    for( size_t w = 0; w < this->PWM_Trip.size( ); w++ ) {
+        int PWM_Count = __builtin_popcount( this->PWM_Trip[ w ] );
+        this->PWM_Trip[ w ] = 0;
+        if( !PWM_Count )
+            continue;
+        this->PWM_Trips.store( this->PWM_Trips.load( memory_order_relaxed ) + PWM_Count, memory_order_relaxed );
+        this->PWM_TotalLate.store( this->PWM_TotalLate.load( memory_order_relaxed ) + PWM_Delay * PWM_Count, memory_order_relaxed );
+        this->PWM_Late[ PWM_Bucket ].store( this->PWM_Late[ PWM_Bucket ].load( memory_order_relaxed ) + PWM_Count, memory_order_relaxed );
+    }
+    if( PWM_Delay > this->PWM_MaxLate.load( memory_order_relaxed ) )
+        this->PWM_MaxLate.store( PWM_Delay, memory_order_relaxed );
+}
+
+/**
+ \fn public function void PWM_Expire( void )
+ \brief Writer thread, when poll( ) found the timer fired : clears the expiry and has the next PWM_Run( ) check.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMFailsafe< PWM_Backend >::PWM_Expire( void ) {
+    uint64_t PWM_Expired;
+    if( read( this->PWM_FD, &PWM_Expired, sizeof( PWM_Expired ) ) >= 0 )
+        this->PWM_Due = true;
+}
+
+template class BBBPWMFailsafe< BBBPWMSysfsBackend >;
+template class BBBPWMFailsafe< BBBPWMSimBackend >;
+template class BBBPWMFailsafe< BBBPWMNullBackend >;
+template class BBBPWMFailsafe< BBBPWMUringBackend >;
+template class BBBPWMFailsafe< BBBPWMEhrpwmBackend >;
+template class BBBPWMFailsafe< BBBPWMClassBackend >;
@@ -0,0 +1,200 @@
+//
+//  BBBPWMFailsafe.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMFailsafe_h
+#define BBBPWMFailsafe_h
+
+#include "BBBPWMDevice.h"
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#define PWM_FAILSAFE_DISABLE   -1 //!< Failsafe duty that stops the channel through its run attribute instead.
+#define PWM_FAILSAFE_CHECKS    4 //!< Watchdog checks per shortest failsafe timeout.
+
+using namespace std;
+
+/**
+ \brief Failsafe watchdog since PWM_Start( ), filled in by BBBPWMController::PWM_GetFailsafeStats( ). A channel fed
+ for the last time at t has its failsafe written by t + timeout + PWM_CheckNs + PWM_MaxLateNs.
+ */
+struct BBBPWMFailsafeStats {
+    uint64_t PWM_Trips; //!< Channels driven to their failsafe.
+    uint64_t PWM_Recoveries; //!< Tripped channels that got a new target again.
+    int64_t PWM_CheckNs; //!< Watchdog check period, the most a trip waits for a check after its deadline.
+    int64_t PWM_MaxLateNs; //!< Latest a failsafe has been written after the check that caught it was due.
+    int64_t PWM_TotalLateNs; //!< Sum of those delays, PWM_TotalLateNs / PWM_Trips is the mean.
+    uint64_t PWM_Late[ PWM_LATENCY_BUCKETS ]; //!< Those delays bucketed like write latencies, see PWM_BucketPercentile( ).
+};
+
+/*!
+ *  \brief     BBBPWMFailsafe drives the channels of a BBBPWMController that have gone without a new target for too long to a safe duty, or stops them.
+ *  \details   Owns the check timerfd, armed on a fixed grid of a quarter of the shortest timeout. Timeouts are set before
+ *             BBBPWMController::PWM_Start( ), everything else runs on the writer thread : PWM_Run( ) once the pass has
+ *             taken the dirty set stamps the channels fed since the last pass and, on a check, trips the rest past
+ *             their timeout, PWM_Stamp( ) once the trips are written, and PWM_Expire( ) when the timer fired.
+ *             PWM_IsTripped( ) and PWM_GetStats( ) are lock-free.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMFailsafe {
+
+public:
+
+    /**
+     \brief BBBPWMFailsafe : No channel watched, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMFailsafe( );
+
+    /**
+     \brief ~BBBPWMFailsafe : Closes the check timerfd.
+     */
+    ~BBBPWMFailsafe( );
+
+    /**
+     \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+     \brief Sets the controller whose channels are watched, from its constructor.
+     \param <BBBPWMBasicController<PWM_Backend>>* Owner
+     \return <void>
+     */
+    void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner );
+
+    /**
+     \fn public function int PWM_Open( void )
+     \brief Creates the check timerfd, disarmed.
+     \param <void>
+     \return <int> -1 failure (reported), 1 success.
+     */
+    int PWM_Open( void );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes the check timerfd. Safe to call more than once.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function int PWM_GetFD( void ) const
+     \brief Returns the check timerfd for the writer to poll( ), -1 while closed.
+     \param <void>
+     \return <int> this->PWM_FD
+     */
+    int PWM_GetFD( void ) const;
+
+    /**
+     \fn public function int PWM_Set( int Channel, int TimeoutMs, int SafeDuty )
+     \brief Watches a channel, see BBBPWMController::PWM_SetFailsafe( ).
+     \param <int> Channel
+     \param <int> TimeoutMs (0 to stop watching it)
+     \param <int> SafeDuty (ns, or PWM_FAILSAFE_DISABLE)
+     \return <int> -1 no such channel or duty out of range, 1 success.
+     */
+    int PWM_Set( int Channel, int TimeoutMs, int SafeDuty );
+
+    /**
+     \fn public function bool PWM_IsTripped( int Channel ) const
+     \brief Checks whether a channel is held at its failsafe since its timeout. Lock-free.
+     \param <int> Channel
+     \return <bool> true if tripped.
+     */
+    bool PWM_IsTripped( int Channel ) const;
+
+    /**
+     \fn public function bool PWM_IsOn( void ) const
+     \brief Checks whether any channel is watched, as of the last PWM_Arm( ).
+     \param <void>
+     \return <bool> this->PWM_On
+     */
+    bool PWM_IsOn( void ) const;
+
+    /**
+     \fn public function void PWM_GetStats( BBBPWMFailsafeStats& Stats ) const
+     \brief Copies the trips and how late they were written since PWM_Arm( ). Lock-free.
+     \param <BBBPWMFailsafeStats>& Stats
+     \return <void>
+     */
+    void PWM_GetStats( BBBPWMFailsafeStats& Stats ) const;
+
+    /**
+     \fn public function void PWM_Arm( void )
+     \brief Resets the watchdog, counts every watched channel as fed now and starts the periodic check.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Arm( void );
+
+    /**
+     \fn public function bool PWM_Run( void )
+     \brief Writer thread, once the pass has taken the dirty set : stamps the watched channels given a new duty target
+     since the last pass as fed, then on a check trips every other watched channel past its timeout : its safe duty or its
+     stop becomes its target and it joins the pass's pending set.
+     \param <void>
+     \return <bool> true if a channel tripped.
+     */
+    bool PWM_Run( void );
+
+    /**
+     \fn public function void PWM_Stamp( void )
+     \brief Writer thread, once the trips of a pass are written : records how long after the check was due.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Stamp( void );
+
+    /**
+     \fn public function void PWM_Expire( void )
+     \brief Writer thread, when poll( ) found the timer fired : clears the expiry and has the next PWM_Run( ) check.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Expire( void );
+
+private:
+
+    BBBPWMFailsafe( const BBBPWMFailsafe& );
+    BBBPWMFailsafe& operator=( const BBBPWMFailsafe& );
+
+    BBBPWMBasicController< PWM_Backend >* PWM_Owner; //!< Controller whose channels are watched.
+    int PWM_FD; //!< Periodic timerfd driving the checks, armed by PWM_Arm( ) if any channel is watched.
+
+    // Set by PWM_Set( ) before PWM_Start( ), then writer only.
+    vector< int64_t > PWM_Timeout; //!< Per channel, ns without a new target before it trips, 0 = not watched.
+    vector< int > PWM_Duty; //!< Per channel, duty to drive it to, or PWM_FAILSAFE_DISABLE.
+    vector< int64_t > PWM_Fed; //!< Per channel, CLOCK_MONOTONIC of the pass that last saw a new target.
+    vector< uint32_t > PWM_Watched; //!< One bit per watched channel.
+    vector< uint32_t > PWM_Trip; //!< One bit per channel tripped this pass.
+    long PWM_CheckNs; //!< Check period, the shortest timeout / PWM_FAILSAFE_CHECKS.
+    int64_t PWM_Start; //!< CLOCK_MONOTONIC the checks count from, check n is due PWM_CheckNs * n later.
+    int64_t PWM_Check; //!< CLOCK_MONOTONIC the check being run was due.
+    bool PWM_On; //!< At least one channel is watched.
+    bool PWM_Due; //!< Writer only, the next PWM_Run( ) checks.
+
+    // Timing, stored by the writer only, read by PWM_GetStats( ).
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_Trips; //!< Trips.
+    atomic< uint64_t > PWM_Recoveries; //!< Trips cleared by a new target.
+    atomic< int64_t > PWM_MaxLate; //!< Largest check due to failsafe written delay in ns.
+    atomic< int64_t > PWM_TotalLate; //!< Sum of delays in ns.
+    atomic< uint64_t > PWM_Late[ PWM_LATENCY_BUCKETS ]; //!< Delay histogram.
+};
+
+extern template class BBBPWMFailsafe< BBBPWMSysfsBackend >;
+extern template class BBBPWMFailsafe< BBBPWMSimBackend >;
+extern template class BBBPWMFailsafe< BBBPWMNullBackend >;
+extern template class BBBPWMFailsafe< BBBPWMUringBackend >;
+extern template class BBBPWMFailsafe< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMFailsafe< BBBPWMClassBackend >;
+
+#endif /* BBBPWMFailsafe_h */
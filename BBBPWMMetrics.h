@@ -0,0 +1,96 @@
+//
+//  BBBPWMMetrics.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMMetrics_h
+#define BBBPWMMetrics_h
+
+#include <stdint.h>
+
+#define PWM_METRICS_ERRNOS     64 //!< Write failures are counted per errno below this, anything higher lands in the last slot.
+#define PWM_LATENCY_SUB_BITS   3 //!< Histogram sub-buckets per power of two (2^3 = 8), bucket width is at most 12.5% of its value.
+#define PWM_LATENCY_MAX_BITS   36 //!< Latencies of 2^36 ns (~68 s) or more share the last bucket.
+#define PWM_LATENCY_BUCKETS    ( ( PWM_LATENCY_MAX_BITS - PWM_LATENCY_SUB_BITS + 1 ) << PWM_LATENCY_SUB_BITS ) //!< 272 buckets.
+
+/**
+ \brief Snapshot of one device's counters, filled in by BBBPWMDevice::PWM_GetMetrics( ).
+ */
+struct BBBPWMMetrics {
+    uint64_t PWM_Writes; //!< Writes issued to the duty, period and run attributes.
+    uint64_t PWM_WriteFailures; //!< Backend writes that failed, broken down in PWM_FailuresByErrno.
+    uint64_t PWM_FailuresByErrno[ PWM_METRICS_ERRNOS ]; //!< Failed writes indexed by errno.
+    uint64_t PWM_Clamped; //!< Duty targets outside PWM_DUTY_LOW - PWM_DUTY_HIGH that had to be clamped.
+    uint64_t PWM_Coalesced; //!< Updates merged into one still pending in the controller's dirty set.
+    uint64_t PWM_Suppressed; //!< Updates dropped because the kernel already held the value.
+    uint64_t PWM_Latency[ PWM_LATENCY_BUCKETS ]; //!< Timed writes per latency bucket, see PWM_LatencyBucket( ).
+};
+
+/**
+ \fn inline function int PWM_LatencyBucket( uint64_t PWM_Ns )
+ \brief HDR style log-linear bucketing : exact below 2^PWM_LATENCY_SUB_BITS ns, then 2^PWM_LATENCY_SUB_BITS linear buckets per power of two.
+ \param <uint64_t> PWM_Ns
+ \return <int> bucket index, 0 - PWM_LATENCY_BUCKETS - 1.
+ */
+inline int PWM_LatencyBucket( uint64_t PWM_Ns ) {
+    if( PWM_Ns < ( 1u << PWM_LATENCY_SUB_BITS ) )
+        return ( int ) PWM_Ns;
+    int PWM_Msb = 63 - __builtin_clzll( PWM_Ns );
+    if( PWM_Msb >= PWM_LATENCY_MAX_BITS )
+        return PWM_LATENCY_BUCKETS - 1;
+    int PWM_Shift = PWM_Msb - PWM_LATENCY_SUB_BITS;
+    return ( ( PWM_Shift + 1 ) << PWM_LATENCY_SUB_BITS ) + ( int )( ( PWM_Ns >> PWM_Shift ) & ( ( 1u << PWM_LATENCY_SUB_BITS ) - 1 ) );
+}
+
+/**
+ \fn inline function uint64_t PWM_LatencyBucketLow( int PWM_Bucket )
+ \brief Smallest latency in ns that falls into PWM_Bucket, the inverse of PWM_LatencyBucket( ).
+ \param <int> PWM_Bucket
+ \return <uint64_t> ns
+ */
+inline uint64_t PWM_LatencyBucketLow( int PWM_Bucket ) {
+    if( PWM_Bucket < ( 1 << PWM_LATENCY_SUB_BITS ) )
+        return ( uint64_t ) PWM_Bucket;
+    int PWM_Shift = ( PWM_Bucket >> PWM_LATENCY_SUB_BITS ) - 1;
+    uint64_t PWM_Sub = ( uint64_t )( PWM_Bucket & ( ( 1 << PWM_LATENCY_SUB_BITS ) - 1 ) ) | ( 1u << PWM_LATENCY_SUB_BITS );
+    return PWM_Sub << PWM_Shift;
+}
+
+/**
+ \fn inline function uint64_t PWM_BucketPercentile( const uint64_t* PWM_Buckets, double PWM_Fraction )
+ \brief Value below which PWM_Fraction (e.g. 0.99) of the samples in a PWM_LATENCY_BUCKETS histogram fall, reported as the upper edge of its bucket.
+ \param const <uint64_t>* PWM_Buckets
+ \param <double> PWM_Fraction
+ \return <uint64_t> ns, 0 for an empty histogram.
+ */
+inline uint64_t PWM_BucketPercentile( const uint64_t* PWM_Buckets, double PWM_Fraction ) {
+    uint64_t PWM_Total = 0;
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        PWM_Total += PWM_Buckets[ b ];
+    if( PWM_Total == 0 )
+        return 0;
+
+    uint64_t PWM_Rank = ( uint64_t )( PWM_Fraction * PWM_Total ), PWM_Seen = 0;
+    for( int b = 0; b < PWM_LATENCY_BUCKETS - 1; b++ ) {
+        PWM_Seen += PWM_Buckets[ b ];
+        if( PWM_Seen > PWM_Rank )
+            return PWM_LatencyBucketLow( b + 1 ) - 1;
+    }
+    return PWM_LatencyBucketLow( PWM_LATENCY_BUCKETS - 1 );
+}
+
+/**
+ \fn inline function uint64_t PWM_LatencyPercentile( const BBBPWMMetrics& PWM_Metrics, double PWM_Fraction )
+ \brief Latency below which PWM_Fraction (e.g. 0.99) of the timed writes completed, reported as the upper edge of its bucket.
+ \param const <BBBPWMMetrics>& PWM_Metrics
+ \param <double> PWM_Fraction
+ \return <uint64_t> ns, 0 if nothing has been timed yet.
+ */
+inline uint64_t PWM_LatencyPercentile( const BBBPWMMetrics& PWM_Metrics, double PWM_Fraction ) {
+    return PWM_BucketPercentile( PWM_Metrics.PWM_Latency, PWM_Fraction );
+}
+
+#endif /* BBBPWMMetrics_h */
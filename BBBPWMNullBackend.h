@@ -0,0 +1,132 @@
+//
+//  BBBPWMNullBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMNullBackend_h
+#define BBBPWMNullBackend_h
+
+#include <string>
+#include <vector>
+
+#include "BBBPWMBackend.h"
+#include "BBBPWMSimBackend.h"
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMNullBackend accepts every write and discards it.
+ *  \details   Inline throughout so that a BBBPWMNullDevice measures the cost of the device and controller alone. Reads
+ *             return the same starting values as BBBPWMSimBackend.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMNullBackend {
+public:
+
+    /**
+     \fn public function int PWM_Attach( int Block, int Pin )
+     \brief Nothing to attach to.
+     \return <int> 1 success.
+     */
+    int PWM_Attach( int Block, int Pin ) { ( void ) Block; ( void ) Pin; return 1; }
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMNullBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief Nothing to attach to.
+     \return <int> number of outputs, all attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMNullBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+        ( void ) Blocks;
+        ( void ) Pins;
+        Status.assign( Outputs.size( ), 1 );
+        return ( int ) Outputs.size( );
+    }
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Returns PWM_SIM_DUTY, PWM_SIM_PERIOD or PWM_SIM_RUN.
+     \return <int> 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value ) {
+        Value = Attr == PWM_ATTR_DUTY ? PWM_SIM_DUTY : Attr == PWM_ATTR_PERIOD ? PWM_SIM_PERIOD : PWM_SIM_RUN;
+        return 1;
+    }
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Discards the value.
+     \return <int> 1 success.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value ) { ( void ) Attr; ( void ) Value; return 1; }
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Nothing to close.
+     \return <void>
+     */
+    void PWM_Close( void ) { }
+
+    /**
+     \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+     \brief Returns "null".
+     \return const <char>*
+     */
+    const char* PWM_Describe( PWM_Attribute Attr ) const { ( void ) Attr; return "null"; }
+
+    /**
+     \fn public function void PWM_SetRoot( const string& Root )
+     \brief Ignored.
+     \return <void>
+     */
+    void PWM_SetRoot( const string& Root ) { ( void ) Root; }
+
+    /**
+     \fn public function string PWM_GetRoot( void ) const
+     \brief Always empty.
+     \return <string>
+     */
+    string PWM_GetRoot( void ) const { return string( ); }
+
+    /**
+     \fn public function void PWM_SetTimeout( int Milliseconds )
+     \brief Ignored.
+     \return <void>
+     */
+    void PWM_SetTimeout( int Milliseconds ) { ( void ) Milliseconds; }
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Writes never fail.
+     \return <int> 0 no failure.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value ) { ( void ) Attr; ( void ) Value; return 0; }
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Nothing is batched.
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchBegin( void ) { return 0; }
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Nothing is batched.
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchEnd( void ) { return 0; }
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief No completions to wait for.
+     \return <int> -1
+     */
+    static int PWM_BatchFD( void ) { return -1; }
+};
+
+#endif /* BBBPWMNullBackend_h */
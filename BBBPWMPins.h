@@ -0,0 +1,102 @@
+//
+//  BBBPWMPins.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMPins_h
+#define BBBPWMPins_h
+
+#define PWM_PIN_OVERLAY_PREFIX "bone_pwm_" //!< Beginning of a pin's device tree overlay name, e.g. bone_pwm_P9_14.
+#define PWM_OVERLAY_FILE       "pwm_test_" //!< Beginning of the folder a pin overlay creates, e.g. pwm_test_P9_14.12.
+#define PWM_PIN_NAME_MAX       16 //!< Room for the longest overlay name ("bone_pwm_P9_14") and its terminator.
+
+/**
+ \brief BBBPWMPinName - a pin's overlay name, built by the compiler from the block and pin numbers.
+ */
+struct BBBPWMPinName {
+    char PWM_Text[ PWM_PIN_NAME_MAX ]; //!< Terminated.
+
+    /**
+     \brief BBBPWMPinName : Prefix followed by P<Block>_<Pin>.
+     \param const <char>* Prefix
+     \param <int> Block
+     \param <int> Pin (1 - 99)
+     */
+    constexpr BBBPWMPinName( const char* Prefix, int Block, int Pin ) : PWM_Text( ) {
+        int n = 0;
+        while( Prefix[ n ] != '\0' ) {
+            this->PWM_Text[ n ] = Prefix[ n ];
+            n++;
+        }
+        this->PWM_Text[ n++ ] = 'P';
+        this->PWM_Text[ n++ ] = ( char )( '0' + Block );
+        this->PWM_Text[ n++ ] = '_';
+        if( Pin >= 10 )
+            this->PWM_Text[ n++ ] = ( char )( '0' + Pin / 10 );
+        this->PWM_Text[ n++ ] = ( char )( '0' + Pin % 10 );
+        this->PWM_Text[ n ] = '\0';
+    }
+};
+
+/**
+ \brief BBBPWMPinInfo - a BeagleBone Black header pin that can output PWM, and what drives it.
+ */
+struct BBBPWMPinInfo {
+    int PWM_Block; //!< 8 or 9.
+    int PWM_Pin; //!< Pin number on that block.
+    int PWM_Module; //!< ePWM0 to ePWM2, -1 for an eCAP output.
+    int PWM_Channel; //!< ePWM output, 0 A (CMPA) or 1 B (CMPB). eCAP number for an eCAP output.
+    BBBPWMPinName PWM_Overlay; //!< Device tree overlay exporting the pin, written to SLOTS.
+};
+
+/*!
+ *  \brief     BBBPWMPins lists every PWM capable header pin (AM335x TRM / BeagleBone Black SRM) at compile time.
+ *  \details   Overlay names are built by the compiler and live in read-only data, nothing is formatted at run time.
+ *             PWM_Find( ) is constexpr, so BBBPWMPinDevice< 9, 15 > fails to compile instead of failing in PWM_Init( ).
+ *             A pin listed twice (e.g. P9_22 and P9_31) is the same output routed to two pins, use one of them.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMPins {
+public:
+
+    static constexpr BBBPWMPinInfo PWM_Table[ ] = {
+        { 8, 13, 2, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 13 ) },
+        { 8, 19, 2, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 19 ) },
+        { 8, 34, 1, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 34 ) },
+        { 8, 36, 1, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 36 ) },
+        { 8, 45, 2, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 45 ) },
+        { 8, 46, 2, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 8, 46 ) },
+        { 9, 14, 1, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 14 ) },
+        { 9, 16, 1, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 16 ) },
+        { 9, 21, 0, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 21 ) },
+        { 9, 22, 0, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 22 ) },
+        { 9, 28, -1, 2, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 28 ) },
+        { 9, 29, 0, 1, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 29 ) },
+        { 9, 31, 0, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 31 ) },
+        { 9, 42, -1, 0, BBBPWMPinName( PWM_PIN_OVERLAY_PREFIX, 9, 42 ) },
+    }; //!< Sorted by block then pin.
+
+    static constexpr int PWM_Count = sizeof( PWM_Table ) / sizeof( PWM_Table[ 0 ] ); //!< Number of pins in PWM_Table.
+
+    /**
+     \fn public static function const BBBPWMPinInfo* PWM_Find( int Block, int Pin )
+     \brief Looks a header pin up, usable in constant expressions.
+     \param <int> Block
+     \param <int> Pin
+     \return const <BBBPWMPinInfo>* NULL if the pin cannot output PWM.
+     */
+    static constexpr const BBBPWMPinInfo* PWM_Find( int Block, int Pin ) {
+        for( int p = 0; p < PWM_Count; p++ )
+            if( PWM_Table[ p ].PWM_Block == Block && PWM_Table[ p ].PWM_Pin == Pin )
+                return &PWM_Table[ p ];
+        return NULL;
+    }
+};
+
+#endif /* BBBPWMPins_h */
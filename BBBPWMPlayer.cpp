@@ -0,0 +1,286 @@
+//
+//  BBBPWMPlayer.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMController.h"
+
+/**
+ \brief BBBPWMPlayer : Nothing playing, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+ \param <void>
+ */
+template< class PWM_Backend >
+BBBPWMPlayer< PWM_Backend >::BBBPWMPlayer( ) {
+    this->PWM_Owner = NULL;
+    this->PWM_FD = -1;
+    this->PWM_Requested.store( NULL );
+    this->PWM_StartNs.store( 0 );
+    this->PWM_Stop.store( false );
+    this->PWM_Active.store( false );
+    this->PWM_Playing = NULL;
+    this->PWM_Index = 0;
+    this->PWM_Start = 0;
+    this->PWM_Played.store( 0 );
+    this->PWM_Skipped.store( 0 );
+    this->PWM_MaxError.store( 0 );
+    this->PWM_TotalError.store( 0 );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        this->PWM_Error[ b ].store( 0 );
+}
+
+/**
+ \brief ~BBBPWMPlayer : Closes the playback timerfd.
+ */
+template< class PWM_Backend >
+BBBPWMPlayer< PWM_Backend >::~BBBPWMPlayer( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+ \brief Sets the controller whose channels the records are played on, from its constructor.
+ \param <BBBPWMBasicController<PWM_Backend>>* Owner
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner ) {
+    this->PWM_Owner = Owner;
+}
+
+/**
+ \fn public function int PWM_Open( void )
+ \brief Creates the playback timerfd, disarmed.
+ \param <void>
+ \return <int> -1 failure (reported), 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMPlayer< PWM_Backend >::PWM_Open( void ) {
+    this->PWM_FD = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if( this->PWM_FD < 0 ) {
+        cerr << "Error - unable to create the PWM playback timer : " << strerror( errno ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes the playback timerfd and drops any playback : it does not survive a restart. Writer stopped only.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Close( void ) {
+    if( this->PWM_FD >= 0 )
+        close( this->PWM_FD );
+    this->PWM_FD = -1;
+    this->PWM_Requested.store( NULL );
+    this->PWM_Stop.store( false );
+    this->PWM_Active.store( false );
+    this->PWM_Playing = NULL;
+}
+
+/**
+ \fn public function int PWM_GetFD( void ) const
+ \brief Returns the playback timerfd for the writer to poll( ), -1 while closed.
+ \param <void>
+ \return <int> this->PWM_FD
+ */
+template< class PWM_Backend >
+int BBBPWMPlayer< PWM_Backend >::PWM_GetFD( void ) const {
+    return this->PWM_FD;
+}
+
+/**
+ \fn public function void PWM_Request( BBBPWMProfile* Profile, int64_t StartNs )
+ \brief Asks the writer to play a profile from StartNs on, replacing any playback running. Any thread.
+ \param <BBBPWMProfile>* Profile
+ \param <int64_t> StartNs (CLOCK_MONOTONIC of the profile's time 0)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Request( BBBPWMProfile* Profile, int64_t StartNs ) {
+    this->PWM_StartNs.store( StartNs );
+    this->PWM_Active.store( true );
+    // Release : the writer that takes the request also sees the start time and the mapped profile.
+    this->PWM_Requested.store( Profile, memory_order_release );
+}
+
+/**
+ \fn public function void PWM_Cancel( void )
+ \brief Asks the writer to stop the running playback, and withdraws a request it has not taken yet. Any thread.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Cancel( void ) {
+    // Also withdraw a request the writer has not taken yet, or it would start right after the stop.
+    this->PWM_Requested.store( NULL );
+    this->PWM_Stop.store( true );
+}
+
+/**
+ \fn public function bool PWM_IsPlaying( void ) const
+ \brief Checks whether a playback is scheduled or running.
+ \param <void>
+ \return <bool> this->PWM_Active
+ */
+template< class PWM_Backend >
+bool BBBPWMPlayer< PWM_Backend >::PWM_IsPlaying( void ) const {
+    return this->PWM_Active.load( );
+}
+
+/**
+ \fn public function void PWM_GetStats( BBBPWMPlaybackStats& Stats ) const
+ \brief Copies the timing error of the current (or last) playback. Lock-free.
+ \param <BBBPWMPlaybackStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_GetStats( BBBPWMPlaybackStats& Stats ) const {
+    Stats.PWM_Played = this->PWM_Played.load( memory_order_relaxed );
+    Stats.PWM_Skipped = this->PWM_Skipped.load( memory_order_relaxed );
+    Stats.PWM_MaxErrorNs = this->PWM_MaxError.load( memory_order_relaxed );
+    Stats.PWM_TotalErrorNs = this->PWM_TotalError.load( memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+        Stats.PWM_Error[ b ] = this->PWM_Error[ b ].load( memory_order_relaxed );
+}
+
+/**
+ \fn public function uint64_t PWM_Run( int64_t& PWM_Scheduled )
+ \brief Writer thread : takes any pending request and (re)starts or stops playback, then if the next record is due,
+ hands every record sharing its time to its channel, so the pass that follows writes them.
+ \param <int64_t>& PWM_Scheduled (set to the records' scheduled CLOCK_MONOTONIC time)
+ \return <uint64_t> number of records queued, 0 if none was due.
+ */
+template< class PWM_Backend >
+uint64_t BBBPWMPlayer< PWM_Backend >::PWM_Run( int64_t& PWM_Scheduled ) {
+    if( this->PWM_Stop.exchange( false ) ) {
+        this->PWM_Playing = NULL;
+        this->PWM_Arm( 0 );
+        if( this->PWM_Requested.load( ) == NULL )
+            this->PWM_Active.store( false );
+    }
+    BBBPWMProfile* PWM_Request = this->PWM_Requested.exchange( NULL, memory_order_acquire );
+    if( PWM_Request != NULL ) {
+        this->PWM_Played.store( 0, memory_order_relaxed );
+        this->PWM_Skipped.store( 0, memory_order_relaxed );
+        this->PWM_MaxError.store( 0, memory_order_relaxed );
+        this->PWM_TotalError.store( 0, memory_order_relaxed );
+        for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ )
+            this->PWM_Error[ b ].store( 0, memory_order_relaxed );
+        this->PWM_Playing = PWM_Request;
+        this->PWM_Index = 0;
+        this->PWM_Start = this->PWM_StartNs.load( );
+        this->PWM_Arm( this->PWM_Start + PWM_Request->PWM_Records[ 0 ].PWM_TimeNs );
+    }
+
+    BBBPWMProfile* PWM_Profile = this->PWM_Playing;
+    if( PWM_Profile == NULL )
+        return 0;
+    uint64_t PWM_TimeNs = PWM_Profile->PWM_Records[ this->PWM_Index ].PWM_TimeNs;
+    PWM_Scheduled = this->PWM_Start + PWM_TimeNs;
+    if( PWM_Scheduled > BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( ) )
+        return 0;
+
+    vector< BBBPWMBasicDevice< PWM_Backend >* >& PWM_Devices = this->PWM_Owner->PWM_Devices;
+    uint64_t PWM_Group = 0;
+    for( uint64_t i = this->PWM_Index; i < PWM_Profile->PWM_Count && PWM_Profile->PWM_Records[ i ].PWM_TimeNs == PWM_TimeNs; i++, PWM_Group++ ) {
+        const BBBPWMProfileRecord& PWM_Record = PWM_Profile->PWM_Records[ i ];
+        if( PWM_Record.PWM_Channel >= PWM_Devices.size( ) ) {
+            this->PWM_Skipped.store( this->PWM_Skipped.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+            continue;
+        }
+        // The same entry points callers use : slews, clamping, dedupe and metrics all apply to profile values too.
+        BBBPWMBasicDevice< PWM_Backend >* PWM_Device = PWM_Devices[ PWM_Record.PWM_Channel ];
+        if( PWM_Record.PWM_Period != PWM_PROFILE_KEEP )
+            PWM_Device->PWM_SetPeriodVal( ( BBBPWMDeviceTypes::PWM_PeriodValues ) PWM_Record.PWM_Period );
+        if( PWM_Record.PWM_Duty != PWM_PROFILE_KEEP )
+            PWM_Device->PWM_SetTargetSpeed( PWM_Record.PWM_Duty );
+    }
+    return PWM_Group;
+}
+
+/**
+ \fn public function bool PWM_Stamp( uint64_t PWM_Group, int64_t PWM_Scheduled )
+ \brief Writer thread, once the records queued by PWM_Run( ) are written : records their timing error, then arms the next record or ends playback.
+ \param <uint64_t> PWM_Group
+ \param <int64_t> PWM_Scheduled
+ \return <bool> true if the next record is already due, the writer should run another pass without sleeping.
+ */
+template< class PWM_Backend >
+bool BBBPWMPlayer< PWM_Backend >::PWM_Stamp( uint64_t PWM_Group, int64_t PWM_Scheduled ) {
+    BBBPWMProfile* PWM_Profile = this->PWM_Playing;
+    int64_t PWM_Now = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+    int64_t PWM_Late = PWM_Now - PWM_Scheduled;
+
+    this->PWM_Played.store( this->PWM_Played.load( memory_order_relaxed ) + PWM_Group, memory_order_relaxed );
+    this->PWM_TotalError.store( this->PWM_TotalError.load( memory_order_relaxed ) + PWM_Late * ( int64_t ) PWM_Group, memory_order_relaxed );
+    if( PWM_Late > this->PWM_MaxError.load( memory_order_relaxed ) )
+        this->PWM_MaxError.store( PWM_Late, memory_order_relaxed );
+    atomic< uint64_t >& PWM_Bucket = this->PWM_Error[ PWM_LatencyBucket( PWM_Late > 0 ? ( uint64_t ) PWM_Late : 0 ) ];
+    PWM_Bucket.store( PWM_Bucket.load( memory_order_relaxed ) + PWM_Group, memory_order_relaxed );
+    if( PWM_Profile->PWM_Errors != NULL ) {
+        int32_t PWM_Logged = PWM_Late > INT32_MAX ? INT32_MAX : ( int32_t ) PWM_Late;
+        for( uint64_t i = 0; i < PWM_Group; i++ )
+            PWM_Profile->PWM_Errors[ this->PWM_Index + i ] = PWM_Logged;
+    }
+
+    this->PWM_Index += PWM_Group;
+    PWM_Profile->PWM_Release( this->PWM_Index );
+    if( this->PWM_Index < PWM_Profile->PWM_Count ) {
+        // Running behind : go straight on with the next record rather than paying for a timer round trip.
+        int64_t PWM_Next = this->PWM_Start + PWM_Profile->PWM_Records[ this->PWM_Index ].PWM_TimeNs;
+        if( PWM_Next <= PWM_Now )
+            return true;
+        this->PWM_Arm( PWM_Next );
+        return false;
+    }
+    this->PWM_Playing = NULL;
+    this->PWM_Arm( 0 );
+    if( this->PWM_Requested.load( ) == NULL )
+        this->PWM_Active.store( false );
+    return false;
+}
+
+/**
+ \fn public function void PWM_Expire( void )
+ \brief Writer thread, when poll( ) found the timer fired : clears the expiry, PWM_Run( ) checks the clock itself.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Expire( void ) {
+    uint64_t PWM_Expired;
+    if( read( this->PWM_FD, &PWM_Expired, sizeof( PWM_Expired ) ) < 0 && errno != EAGAIN )
+        cerr << "Error - PWM writer thread unable to read its playback timer : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn private function void PWM_Arm( int64_t PWM_AtNs )
+ \brief Arms the timerfd to fire at an absolute CLOCK_MONOTONIC time, 0 disarms it.
+ \param <int64_t> PWM_AtNs
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMPlayer< PWM_Backend >::PWM_Arm( int64_t PWM_AtNs ) {
+    struct itimerspec PWM_At;
+    memset( &PWM_At, 0, sizeof( PWM_At ) );
+    // Absolute deadlines : a late pass never pushes later records back, and a deadline already passed fires at once.
+    PWM_At.it_value.tv_sec = PWM_AtNs / 1000000000;
+    PWM_At.it_value.tv_nsec = PWM_AtNs % 1000000000;
+    if( PWM_AtNs > 0 && PWM_At.it_value.tv_sec == 0 && PWM_At.it_value.tv_nsec == 0 )
+        PWM_At.it_value.tv_nsec = 1;
+    if( timerfd_settime( this->PWM_FD, TFD_TIMER_ABSTIME, &PWM_At, NULL ) < 0 )
+        cerr << "Error - unable to set the PWM playback timer : " << strerror( errno ) << endl;
+}
+
+template class BBBPWMPlayer< BBBPWMSysfsBackend >;
+template class BBBPWMPlayer< BBBPWMSimBackend >;
+template class BBBPWMPlayer< BBBPWMNullBackend >;
+template class BBBPWMPlayer< BBBPWMUringBackend >;
+template class BBBPWMPlayer< BBBPWMEhrpwmBackend >;
+template class BBBPWMPlayer< BBBPWMClassBackend >;
@@ -0,0 +1,182 @@
+//
+//  BBBPWMPlayer.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMPlayer_h
+#define BBBPWMPlayer_h
+
+#include "BBBPWMDevice.h"
+#include "BBBPWMProfile.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMPlayer plays a BBBPWMProfile back on the channels of a BBBPWMController.
+ *  \details   Owns the playback timerfd, armed with the absolute time of the next record so a late pass never pushes
+ *             later records back. BBBPWMController::PWM_Play( ) and PWM_StopPlayback( ) post requests from any thread
+ *             through PWM_Request( ) and PWM_Cancel( ). The writer thread calls PWM_Run( ) at the top of each pass,
+ *             which takes those requests and hands the records that are due to their channels, PWM_Stamp( ) once the
+ *             pass is written, and PWM_Expire( ) when the timer fired.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMPlayer {
+
+public:
+
+    /**
+     \brief BBBPWMPlayer : Nothing playing, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMPlayer( );
+
+    /**
+     \brief ~BBBPWMPlayer : Closes the playback timerfd.
+     */
+    ~BBBPWMPlayer( );
+
+    /**
+     \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+     \brief Sets the controller whose channels the records are played on, from its constructor.
+     \param <BBBPWMBasicController<PWM_Backend>>* Owner
+     \return <void>
+     */
+    void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner );
+
+    /**
+     \fn public function int PWM_Open( void )
+     \brief Creates the playback timerfd, disarmed.
+     \param <void>
+     \return <int> -1 failure (reported), 1 success.
+     */
+    int PWM_Open( void );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes the playback timerfd and drops any playback : it does not survive a restart. Writer stopped only.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function int PWM_GetFD( void ) const
+     \brief Returns the playback timerfd for the writer to poll( ), -1 while closed.
+     \param <void>
+     \return <int> this->PWM_FD
+     */
+    int PWM_GetFD( void ) const;
+
+    /**
+     \fn public function void PWM_Request( BBBPWMProfile* Profile, int64_t StartNs )
+     \brief Asks the writer to play a profile from StartNs on, replacing any playback running. Any thread.
+     \param <BBBPWMProfile>* Profile
+     \param <int64_t> StartNs (CLOCK_MONOTONIC of the profile's time 0)
+     \return <void>
+     */
+    void PWM_Request( BBBPWMProfile* Profile, int64_t StartNs );
+
+    /**
+     \fn public function void PWM_Cancel( void )
+     \brief Asks the writer to stop the running playback, and withdraws a request it has not taken yet. Any thread.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Cancel( void );
+
+    /**
+     \fn public function bool PWM_IsPlaying( void ) const
+     \brief Checks whether a playback is scheduled or running.
+     \param <void>
+     \return <bool> this->PWM_Active
+     */
+    bool PWM_IsPlaying( void ) const;
+
+    /**
+     \fn public function void PWM_GetStats( BBBPWMPlaybackStats& Stats ) const
+     \brief Copies the timing error of the current (or last) playback. Lock-free.
+     \param <BBBPWMPlaybackStats>& Stats
+     \return <void>
+     */
+    void PWM_GetStats( BBBPWMPlaybackStats& Stats ) const;
+
+    /**
+     \fn public function uint64_t PWM_Run( int64_t& PWM_Scheduled )
+     \brief Writer thread : takes any pending request and (re)starts or stops playback, then if the next record is due,
+     hands every record sharing its time to its channel, so the pass that follows writes them.
+     \param <int64_t>& PWM_Scheduled (set to the records' scheduled CLOCK_MONOTONIC time)
+     \return <uint64_t> number of records queued, 0 if none was due.
+     */
+    uint64_t PWM_Run( int64_t& PWM_Scheduled );
+
+    /**
+     \fn public function bool PWM_Stamp( uint64_t PWM_Group, int64_t PWM_Scheduled )
+     \brief Writer thread, once the records queued by PWM_Run( ) are written : records their timing error, then arms the next record or ends playback.
+     \param <uint64_t> PWM_Group
+     \param <int64_t> PWM_Scheduled
+     \return <bool> true if the next record is already due, the writer should run another pass without sleeping.
+     */
+    bool PWM_Stamp( uint64_t PWM_Group, int64_t PWM_Scheduled );
+
+    /**
+     \fn public function void PWM_Expire( void )
+     \brief Writer thread, when poll( ) found the timer fired : clears the expiry, PWM_Run( ) checks the clock itself.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Expire( void );
+
+private:
+
+    BBBPWMPlayer( const BBBPWMPlayer& );
+    BBBPWMPlayer& operator=( const BBBPWMPlayer& );
+
+    /**
+     \fn private function void PWM_Arm( int64_t PWM_AtNs )
+     \brief Arms the timerfd to fire at an absolute CLOCK_MONOTONIC time, 0 disarms it.
+     \param <int64_t> PWM_AtNs
+     \return <void>
+     */
+    void PWM_Arm( int64_t PWM_AtNs );
+
+    BBBPWMBasicController< PWM_Backend >* PWM_Owner; //!< Controller the records' channels belong to.
+    int PWM_FD; //!< timerfd armed with the absolute time of the next record.
+
+    // Requests, set by PWM_Request( ) / PWM_Cancel( ) and taken by the writer.
+    atomic< BBBPWMProfile* > PWM_Requested; //!< Profile to start playing, NULL once the writer has taken it.
+    atomic< int64_t > PWM_StartNs; //!< CLOCK_MONOTONIC time of the requested profile's time 0.
+    atomic< bool > PWM_Stop; //!< Set to stop the running playback.
+    atomic< bool > PWM_Active; //!< True from PWM_Request( ) until the last record has been written or playback stopped.
+
+    // State, writer only.
+    BBBPWMProfile* PWM_Playing; //!< Profile being played, NULL if none.
+    uint64_t PWM_Index; //!< Next record to play.
+    int64_t PWM_Start; //!< CLOCK_MONOTONIC time of the profile's time 0.
+
+    // Timing, stored by the writer only, read by PWM_GetStats( ).
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_Played; //!< Records played.
+    atomic< uint64_t > PWM_Skipped; //!< Records naming a channel the controller does not have.
+    atomic< int64_t > PWM_MaxError; //!< Largest scheduled-to-written error in ns.
+    atomic< int64_t > PWM_TotalError; //!< Sum of errors in ns.
+    atomic< uint64_t > PWM_Error[ PWM_LATENCY_BUCKETS ]; //!< Error histogram, see PWM_LatencyBucket( ).
+};
+
+extern template class BBBPWMPlayer< BBBPWMSysfsBackend >;
+extern template class BBBPWMPlayer< BBBPWMSimBackend >;
+extern template class BBBPWMPlayer< BBBPWMNullBackend >;
+extern template class BBBPWMPlayer< BBBPWMUringBackend >;
+extern template class BBBPWMPlayer< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMPlayer< BBBPWMClassBackend >;
+
+#endif /* BBBPWMPlayer_h */
@@ -0,0 +1,214 @@
+//
+//  BBBPWMProfile.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMProfile.h"
+
+/**
+ \brief BBBPWMProfile : An empty profile, see PWM_Open( ).
+ \param <void>
+ */
+BBBPWMProfile::BBBPWMProfile( ) {
+    this->PWM_Map = NULL;
+    this->PWM_MapBytes = 0;
+    this->PWM_Records = NULL;
+    this->PWM_Count = 0;
+    this->PWM_Released = 0;
+    this->PWM_Errors = NULL;
+    this->PWM_ErrorBytes = 0;
+}
+
+/**
+ \brief ~BBBPWMProfile : Unmaps the profile and error log.
+ */
+BBBPWMProfile::~BBBPWMProfile( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function int PWM_Open( const char* Path )
+ \brief Maps a profile file and checks its header.
+ \param const <char>* Path
+ \return <int> -1 failure to open, map or validate the file, 1 success.
+ */
+int BBBPWMProfile::PWM_Open( const char* Path ) {
+    this->PWM_Close( );
+    int PWM_FD = open( Path, O_RDONLY | O_CLOEXEC );
+    if( PWM_FD < 0 ) {
+        cerr << "Unable to open profile : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    struct stat PWM_Stat;
+    if( fstat( PWM_FD, &PWM_Stat ) < 0 || ( size_t ) PWM_Stat.st_size < sizeof( BBBPWMProfileHeader ) ) {
+        cerr << "Profile too short : " << Path << endl;
+        close( PWM_FD );
+        return -1;
+    }
+    // The mapping keeps the file referenced, the descriptor is not needed past this point.
+    void* PWM_Map = mmap( NULL, PWM_Stat.st_size, PROT_READ, MAP_SHARED, PWM_FD, 0 );
+    close( PWM_FD );
+    if( PWM_Map == MAP_FAILED ) {
+        cerr << "Unable to map profile : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+
+    const BBBPWMProfileHeader* PWM_Header = ( const BBBPWMProfileHeader* ) PWM_Map;
+    uint64_t PWM_Room = ( PWM_Stat.st_size - sizeof( BBBPWMProfileHeader ) ) / sizeof( BBBPWMProfileRecord );
+    if( memcmp( PWM_Header->PWM_Magic, PWM_PROFILE_MAGIC, sizeof( PWM_Header->PWM_Magic ) ) != 0
+        || PWM_Header->PWM_RecordSize != sizeof( BBBPWMProfileRecord ) || PWM_Header->PWM_Records > PWM_Room ) {
+        cerr << "Not a valid profile : " << Path << endl;
+        munmap( PWM_Map, PWM_Stat.st_size );
+        return -1;
+    }
+    // Playback reads front to back exactly once : aggressive readahead, and pages behind us are released in PWM_Release( ).
+    madvise( PWM_Map, PWM_Stat.st_size, MADV_SEQUENTIAL );
+
+    this->PWM_Map = PWM_Map;
+    this->PWM_MapBytes = PWM_Stat.st_size;
+    this->PWM_Records = ( const BBBPWMProfileRecord* )( PWM_Header + 1 );
+    this->PWM_Count = PWM_Header->PWM_Records;
+    this->PWM_Released = 0;
+    return 1;
+}
+
+/**
+ \fn public function int PWM_OpenErrorLog( const char* Path )
+ \brief Creates (or truncates) Path to hold one int32_t timing error per record, filled in during playback. Call after PWM_Open( ).
+ \param const <char>* Path
+ \return <int> -1 failure to create or map the file, 1 success.
+ */
+int BBBPWMProfile::PWM_OpenErrorLog( const char* Path ) {
+    if( this->PWM_Errors != NULL ) {
+        munmap( this->PWM_Errors, this->PWM_ErrorBytes );
+        this->PWM_Errors = NULL;
+    }
+    size_t PWM_Bytes = this->PWM_Count * sizeof( int32_t );
+    if( PWM_Bytes == 0 )
+        return 1;
+    int PWM_FD = open( Path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    // Allocate the blocks now, a sparse file would make the writer thread wait on block allocation mid playback.
+    if( PWM_FD < 0 || ftruncate( PWM_FD, PWM_Bytes ) < 0 || ( errno = posix_fallocate( PWM_FD, 0, PWM_Bytes ) ) != 0 ) {
+        cerr << "Unable to create error log : " << Path << " | Error = " << strerror( errno ) << endl;
+        if( PWM_FD >= 0 )
+            close( PWM_FD );
+        return -1;
+    }
+    void* PWM_Map = mmap( NULL, PWM_Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, PWM_FD, 0 );
+    close( PWM_FD );
+    if( PWM_Map == MAP_FAILED ) {
+        cerr << "Unable to map error log : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    madvise( PWM_Map, PWM_Bytes, MADV_SEQUENTIAL );
+    // The first store into a shared file mapping is by far the slowest (ms on ext4), take it here rather than during playback.
+    *( volatile int32_t* ) PWM_Map = 0;
+    this->PWM_Errors = ( int32_t* ) PWM_Map;
+    this->PWM_ErrorBytes = PWM_Bytes;
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Unmaps the profile and error log. Must not be called while a controller is playing this profile.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMProfile::PWM_Close( void ) {
+    if( this->PWM_Errors != NULL )
+        munmap( this->PWM_Errors, this->PWM_ErrorBytes );
+    if( this->PWM_Map != NULL )
+        munmap( this->PWM_Map, this->PWM_MapBytes );
+    this->PWM_Map = NULL;
+    this->PWM_MapBytes = 0;
+    this->PWM_Records = NULL;
+    this->PWM_Count = 0;
+    this->PWM_Released = 0;
+    this->PWM_Errors = NULL;
+    this->PWM_ErrorBytes = 0;
+}
+
+/**
+ \fn public function uint64_t PWM_GetRecordCount( void ) const
+ \brief Returns the number of records in the profile.
+ \param <void>
+ \return <uint64_t> this->PWM_Count
+ */
+uint64_t BBBPWMProfile::PWM_GetRecordCount( void ) const {
+    return this->PWM_Count;
+}
+
+/**
+ \fn public function const BBBPWMProfileRecord& PWM_GetRecord( uint64_t Index ) const
+ \brief Returns one record of the profile.
+ \param <uint64_t> Index
+ \return const <BBBPWMProfileRecord>&
+ */
+const BBBPWMProfileRecord& BBBPWMProfile::PWM_GetRecord( uint64_t Index ) const {
+    return this->PWM_Records[ Index ];
+}
+
+/**
+ \fn private function void PWM_Release( uint64_t PWM_Played )
+ \brief Drops the pages of records before PWM_Played (and of their error log entries) from this process, in PWM_PROFILE_RELEASE steps.
+ \param <uint64_t> PWM_Played
+ \return <void>
+ */
+void BBBPWMProfile::PWM_Release( uint64_t PWM_Played ) {
+    size_t PWM_Done = ( ( const char* ) ( this->PWM_Records + PWM_Played ) - ( const char* ) this->PWM_Map );
+    if( PWM_Done < this->PWM_Released + PWM_PROFILE_RELEASE )
+        return;
+    // Both mappings are file backed and shared, so dropped pages are simply re-read (or written back, for the log) by the kernel.
+    size_t PWM_Page = sysconf( _SC_PAGESIZE );
+    size_t PWM_Upto = PWM_Done / PWM_Page * PWM_Page;
+    madvise( this->PWM_Map, PWM_Upto, MADV_DONTNEED );
+    if( this->PWM_Errors != NULL ) {
+        size_t PWM_LogUpto = PWM_Played * sizeof( int32_t ) / PWM_Page * PWM_Page;
+        if( PWM_LogUpto > 0 )
+            madvise( this->PWM_Errors, PWM_LogUpto, MADV_DONTNEED );
+    }
+    this->PWM_Released = PWM_Upto;
+}
+
+/**
+ \fn public static function int PWM_Save( const char* Path, const BBBPWMProfileRecord* Records, uint64_t Count )
+ \brief Writes a profile file, Records must be sorted by PWM_TimeNs.
+ \param const <char>* Path
+ \param const <BBBPWMProfileRecord>* Records
+ \param <uint64_t> Count
+ \return <int> -1 failure to write the file, 1 success.
+ */
+int BBBPWMProfile::PWM_Save( const char* Path, const BBBPWMProfileRecord* Records, uint64_t Count ) {
+    BBBPWMProfileHeader PWM_Header;
+    memset( &PWM_Header, 0, sizeof( PWM_Header ) );
+    memcpy( PWM_Header.PWM_Magic, PWM_PROFILE_MAGIC, sizeof( PWM_Header.PWM_Magic ) );
+    PWM_Header.PWM_RecordSize = sizeof( BBBPWMProfileRecord );
+    PWM_Header.PWM_Records = Count;
+
+    int PWM_FD = open( Path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if( PWM_FD < 0 ) {
+        cerr << "Unable to create profile : " << Path << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    const char* PWM_Data[ 2 ] = { ( const char* ) &PWM_Header, ( const char* ) Records };
+    size_t PWM_Left[ 2 ] = { sizeof( PWM_Header ), Count * sizeof( BBBPWMProfileRecord ) };
+    for( int part = 0; part < 2; part++ ) {
+        while( PWM_Left[ part ] > 0 ) {
+            ssize_t PWM_Wrote = write( PWM_FD, PWM_Data[ part ], PWM_Left[ part ] );
+            if( PWM_Wrote < 0 && errno == EINTR )
+                continue;
+            if( PWM_Wrote <= 0 ) {
+                cerr << "Unable to write profile : " << Path << " | Error = " << strerror( errno ) << endl;
+                close( PWM_FD );
+                return -1;
+            }
+            PWM_Data[ part ] += PWM_Wrote;
+            PWM_Left[ part ] -= PWM_Wrote;
+        }
+    }
+    close( PWM_FD );
+    return 1;
+}
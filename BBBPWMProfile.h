@@ -0,0 +1,156 @@
+//
+//  BBBPWMProfile.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMProfile_h
+#define BBBPWMProfile_h
+
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "BBBPWMMetrics.h"
+
+#define PWM_PROFILE_MAGIC      "BBBPWMP1" //!< First 8 bytes of every profile file.
+#define PWM_PROFILE_KEEP       -1 //!< Duty or period value in a record that leaves the current value alone.
+#define PWM_PROFILE_RELEASE    ( 4 << 20 ) //!< Pages already played are handed back to the kernel in steps of this many bytes.
+
+using namespace std;
+
+/**
+ \brief Profile file header, followed directly by PWM_Records records. All fields are little endian, as written on the target.
+ */
+struct BBBPWMProfileHeader {
+    char PWM_Magic[ 8 ]; //!< PWM_PROFILE_MAGIC, not terminated.
+    uint32_t PWM_RecordSize; //!< sizeof( BBBPWMProfileRecord ), lets older readers reject newer layouts.
+    uint32_t PWM_Reserved; //!< 0.
+    uint64_t PWM_Records; //!< Number of records that follow.
+};
+
+/**
+ \brief One scheduled update. Records must be sorted by PWM_TimeNs, records sharing a time are applied together.
+ */
+struct BBBPWMProfileRecord {
+    uint64_t PWM_TimeNs; //!< When to apply, in ns after playback starts.
+    uint32_t PWM_Channel; //!< Channel index in the playing BBBPWMController.
+    int32_t PWM_Duty; //!< New duty in ns, or PWM_PROFILE_KEEP.
+    int32_t PWM_Period; //!< New period in ns, or PWM_PROFILE_KEEP.
+    int32_t PWM_Reserved; //!< 0.
+};
+
+/**
+ \brief Achieved-vs-scheduled timing of a playback, filled in by BBBPWMController::PWM_GetPlaybackStats( ).
+ */
+struct BBBPWMPlaybackStats {
+    uint64_t PWM_Played; //!< Records reached so far, skipped ones included.
+    uint64_t PWM_Skipped; //!< Records naming a channel the controller does not have.
+    int64_t PWM_MaxErrorNs; //!< Latest a record has been written after its scheduled time.
+    int64_t PWM_TotalErrorNs; //!< Sum of all errors, PWM_TotalErrorNs / PWM_Played is the mean.
+    uint64_t PWM_Error[ PWM_LATENCY_BUCKETS ]; //!< Errors bucketed like write latencies, see PWM_BucketPercentile( ).
+};
+
+/*!
+ *  \brief     BBBPWMProfile maps a duty / period profile file for playback by BBBPWMController::PWM_Play( ).
+ *  \details   The file is mmap( )ed read-only and read sequentially, pages behind the playback position are released as
+ *             it goes, so a multi-hour profile never needs more than a few MB of memory. An optional error log file
+ *             receives one int32_t per record : how many ns after its scheduled time the record was written.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMProfile {
+public:
+
+    /**
+     \fn public function int PWM_Open( const char* Path )
+     \brief Maps a profile file and checks its header.
+     \param const <char>* Path
+     \return <int> -1 failure to open, map or validate the file, 1 success.
+     */
+    int PWM_Open( const char* Path );
+
+    /**
+     \fn public function int PWM_OpenErrorLog( const char* Path )
+     \brief Creates (or truncates) Path to hold one int32_t timing error per record, filled in during playback. Call after PWM_Open( ).
+     \param const <char>* Path
+     \return <int> -1 failure to create or map the file, 1 success.
+     */
+    int PWM_OpenErrorLog( const char* Path );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Unmaps the profile and error log. Must not be called while a controller is playing this profile.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function uint64_t PWM_GetRecordCount( void ) const
+     \brief Returns the number of records in the profile.
+     \param <void>
+     \return <uint64_t> this->PWM_Count
+     */
+    uint64_t PWM_GetRecordCount( void ) const;
+
+    /**
+     \fn public function const BBBPWMProfileRecord& PWM_GetRecord( uint64_t Index ) const
+     \brief Returns one record of the profile.
+     \param <uint64_t> Index
+     \return const <BBBPWMProfileRecord>&
+     */
+    const BBBPWMProfileRecord& PWM_GetRecord( uint64_t Index ) const;
+
+    /**
+     \fn public static function int PWM_Save( const char* Path, const BBBPWMProfileRecord* Records, uint64_t Count )
+     \brief Writes a profile file, Records must be sorted by PWM_TimeNs.
+     \param const <char>* Path
+     \param const <BBBPWMProfileRecord>* Records
+     \param <uint64_t> Count
+     \return <int> -1 failure to write the file, 1 success.
+     */
+    static int PWM_Save( const char* Path, const BBBPWMProfileRecord* Records, uint64_t Count );
+
+    /**
+     \brief BBBPWMProfile : An empty profile, see PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMProfile( );
+
+    /**
+     \brief ~BBBPWMProfile : Unmaps the profile and error log.
+     */
+    ~BBBPWMProfile( );
+
+protected:
+
+    template< class PWM_Backend > friend class BBBPWMPlayer;
+
+    void* PWM_Map; //!< The whole profile file, header included.
+    size_t PWM_MapBytes; //!< Length of PWM_Map.
+    const BBBPWMProfileRecord* PWM_Records; //!< First record inside PWM_Map.
+    uint64_t PWM_Count; //!< Number of records.
+    size_t PWM_Released; //!< Bytes at the start of PWM_Map already handed back to the kernel.
+    int32_t* PWM_Errors; //!< Mapped error log, one entry per record, NULL if none.
+    size_t PWM_ErrorBytes; //!< Length of PWM_Errors.
+
+    /**
+     \fn private function void PWM_Release( uint64_t PWM_Played )
+     \brief Drops the pages of records before PWM_Played (and of their error log entries) from this process, in PWM_PROFILE_RELEASE steps.
+     \param <uint64_t> PWM_Played
+     \return <void>
+     */
+    void PWM_Release( uint64_t PWM_Played );
+};
+
+#endif /* BBBPWMProfile_h */
@@ -0,0 +1,265 @@
+//
+//  BBBPWMScheduler.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMController.h"
+
+/**
+ \brief BBBPWMScheduler : No callbacks, PWM_DEFAULT_CONTROL_NS, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+ \param <void>
+ */
+template< class PWM_Backend >
+BBBPWMScheduler< PWM_Backend >::BBBPWMScheduler( ) {
+    this->PWM_Owner = NULL;
+    this->PWM_FD = -1;
+    this->PWM_PeriodNs = PWM_DEFAULT_CONTROL_NS;
+    this->PWM_Start = 0;
+    this->PWM_Tick = 0;
+    this->PWM_Ticks.store( 0 );
+    this->PWM_Missed.store( 0 );
+    this->PWM_Overruns.store( 0 );
+    this->PWM_MaxJitter.store( 0 );
+    this->PWM_TotalJitter.store( 0 );
+    this->PWM_MaxCallback.store( 0 );
+    this->PWM_TotalCallback.store( 0 );
+    this->PWM_MaxWrite.store( 0 );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ ) {
+        this->PWM_Jitter[ b ].store( 0 );
+        this->PWM_Callback[ b ].store( 0 );
+    }
+}
+
+/**
+ \brief ~BBBPWMScheduler : Closes the control timerfd.
+ */
+template< class PWM_Backend >
+BBBPWMScheduler< PWM_Backend >::~BBBPWMScheduler( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+ \brief Sets the controller whose channels the callbacks drive, from its constructor.
+ \param <BBBPWMBasicController<PWM_Backend>>* Owner
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner ) {
+    this->PWM_Owner = Owner;
+}
+
+/**
+ \fn public function int PWM_Open( void )
+ \brief Creates the control timerfd, disarmed.
+ \param <void>
+ \return <int> -1 failure (reported), 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMScheduler< PWM_Backend >::PWM_Open( void ) {
+    // Non blocking : PWM_Run( ) goes by the clock and only reads it to clear the expiry.
+    this->PWM_FD = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK );
+    if( this->PWM_FD < 0 ) {
+        cerr << "Error - unable to create the PWM control tick : " << strerror( errno ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes the control timerfd. Safe to call more than once.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_Close( void ) {
+    if( this->PWM_FD >= 0 )
+        close( this->PWM_FD );
+    this->PWM_FD = -1;
+}
+
+/**
+ \fn public function int PWM_GetFD( void ) const
+ \brief Returns the control timerfd for the writer to poll( ), -1 while closed.
+ \param <void>
+ \return <int> this->PWM_FD
+ */
+template< class PWM_Backend >
+int BBBPWMScheduler< PWM_Backend >::PWM_GetFD( void ) const {
+    return this->PWM_FD;
+}
+
+/**
+ \fn public function int PWM_Add( int Channel, BBBPWMControlFn Callback, void* Arg )
+ \brief Registers a callback, see BBBPWMController::PWM_AddControl( ).
+ \param <int> Channel
+ \param <BBBPWMControlFn> Callback
+ \param <void>* Arg
+ \return <int> -1 no such channel or no callback, >= 0 the index of the callback.
+ */
+template< class PWM_Backend >
+int BBBPWMScheduler< PWM_Backend >::PWM_Add( int Channel, BBBPWMControlFn Callback, void* Arg ) {
+    if( Channel < 0 || Channel >= this->PWM_Owner->PWM_GetDeviceCount( ) || Callback == NULL ) {
+        cerr << "Error - BBBPWMController::PWM_AddControl( ) needs a callback and a registered channel" << endl;
+        return -1;
+    }
+    BBBPWMControlLoop PWM_Loop = { Callback, Arg, Channel };
+    this->PWM_Loops.push_back( PWM_Loop );
+    return this->PWM_Loops.size( ) - 1;
+}
+
+/**
+ \fn public function void PWM_SetPeriod( long Nanoseconds )
+ \brief Sets the tick period, PWM_DEFAULT_CONTROL_NS if not positive.
+ \param <long> Nanoseconds
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_SetPeriod( long Nanoseconds ) {
+    this->PWM_PeriodNs = Nanoseconds > 0 ? Nanoseconds : PWM_DEFAULT_CONTROL_NS;
+}
+
+/**
+ \fn public function long PWM_GetPeriod( void ) const
+ \brief Returns the tick period in nanoseconds.
+ \param <void>
+ \return <long> this->PWM_PeriodNs
+ */
+template< class PWM_Backend >
+long BBBPWMScheduler< PWM_Backend >::PWM_GetPeriod( void ) const {
+    return this->PWM_PeriodNs;
+}
+
+/**
+ \fn public function void PWM_GetStats( BBBPWMControlStats& Stats ) const
+ \brief Copies the timing of the ticks since PWM_Arm( ). Lock-free.
+ \param <BBBPWMControlStats>& Stats
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_GetStats( BBBPWMControlStats& Stats ) const {
+    Stats.PWM_Ticks = this->PWM_Ticks.load( memory_order_relaxed );
+    Stats.PWM_Missed = this->PWM_Missed.load( memory_order_relaxed );
+    Stats.PWM_Overruns = this->PWM_Overruns.load( memory_order_relaxed );
+    Stats.PWM_MaxJitterNs = this->PWM_MaxJitter.load( memory_order_relaxed );
+    Stats.PWM_TotalJitterNs = this->PWM_TotalJitter.load( memory_order_relaxed );
+    Stats.PWM_MaxCallbackNs = this->PWM_MaxCallback.load( memory_order_relaxed );
+    Stats.PWM_TotalCallbackNs = this->PWM_TotalCallback.load( memory_order_relaxed );
+    Stats.PWM_MaxWriteNs = this->PWM_MaxWrite.load( memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ ) {
+        Stats.PWM_Jitter[ b ] = this->PWM_Jitter[ b ].load( memory_order_relaxed );
+        Stats.PWM_Callback[ b ] = this->PWM_Callback[ b ].load( memory_order_relaxed );
+    }
+}
+
+/**
+ \fn public function void PWM_Arm( void )
+ \brief Resets the timing and, with callbacks registered, starts the tick, the first one a period from now.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_Arm( void ) {
+    this->PWM_Tick = 0;
+    this->PWM_Ticks.store( 0, memory_order_relaxed );
+    this->PWM_Missed.store( 0, memory_order_relaxed );
+    this->PWM_Overruns.store( 0, memory_order_relaxed );
+    this->PWM_MaxJitter.store( 0, memory_order_relaxed );
+    this->PWM_TotalJitter.store( 0, memory_order_relaxed );
+    this->PWM_MaxCallback.store( 0, memory_order_relaxed );
+    this->PWM_TotalCallback.store( 0, memory_order_relaxed );
+    this->PWM_MaxWrite.store( 0, memory_order_relaxed );
+    for( int b = 0; b < PWM_LATENCY_BUCKETS; b++ ) {
+        this->PWM_Jitter[ b ].store( 0, memory_order_relaxed );
+        this->PWM_Callback[ b ].store( 0, memory_order_relaxed );
+    }
+    if( this->PWM_Loops.empty( ) )
+        return;
+
+    // An absolute first deadline and a fixed interval : the kernel keeps every tick on PWM_Start + n * period,
+    // however late the writer gets to one of them.
+    this->PWM_Start = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( ) + this->PWM_PeriodNs;
+    struct itimerspec PWM_Timer;
+    PWM_Timer.it_value.tv_sec = this->PWM_Start / 1000000000;
+    PWM_Timer.it_value.tv_nsec = this->PWM_Start % 1000000000;
+    PWM_Timer.it_interval.tv_sec = this->PWM_PeriodNs / 1000000000L;
+    PWM_Timer.it_interval.tv_nsec = this->PWM_PeriodNs % 1000000000L;
+    if( timerfd_settime( this->PWM_FD, TFD_TIMER_ABSTIME, &PWM_Timer, NULL ) < 0 )
+        cerr << "Error - unable to set the PWM control tick : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn public function bool PWM_Run( int64_t& PWM_Scheduled )
+ \brief Writer thread : if a tick is due, runs every callback once and hands their outputs to their channels, so the pass that follows writes them.
+ \param <int64_t>& PWM_Scheduled (set to the tick's deadline)
+ \return <bool> true if a tick was run.
+ */
+template< class PWM_Backend >
+bool BBBPWMScheduler< PWM_Backend >::PWM_Run( int64_t& PWM_Scheduled ) {
+    if( this->PWM_Loops.empty( ) )
+        return false;
+    int64_t PWM_Now = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+    if( PWM_Now < this->PWM_Start + ( int64_t ) this->PWM_Tick * this->PWM_PeriodNs )
+        return false;
+
+    // The clock, not the expiry count, says which tick this is : a pass that ran late (or a playback burst that never
+    // went back to poll( )) runs the latest tick only, the ones before it are counted as missed.
+    uint64_t PWM_Expired;
+    if( read( this->PWM_FD, &PWM_Expired, sizeof( PWM_Expired ) ) < 0 && errno != EAGAIN )
+        cerr << "Error - PWM writer thread unable to read its control tick : " << strerror( errno ) << endl;
+    uint64_t PWM_Due = ( uint64_t )( ( PWM_Now - this->PWM_Start ) / this->PWM_PeriodNs );
+    PWM_Scheduled = this->PWM_Start + ( int64_t ) PWM_Due * this->PWM_PeriodNs;
+    this->PWM_Missed.store( this->PWM_Missed.load( memory_order_relaxed ) + PWM_Due - this->PWM_Tick, memory_order_relaxed );
+    this->PWM_Tick = PWM_Due + 1;
+
+    int64_t PWM_Late = PWM_Now - PWM_Scheduled;
+    this->PWM_TotalJitter.store( this->PWM_TotalJitter.load( memory_order_relaxed ) + PWM_Late, memory_order_relaxed );
+    if( PWM_Late > this->PWM_MaxJitter.load( memory_order_relaxed ) )
+        this->PWM_MaxJitter.store( PWM_Late, memory_order_relaxed );
+    atomic< uint64_t >& PWM_JitterBucket = this->PWM_Jitter[ PWM_LatencyBucket( ( uint64_t ) PWM_Late ) ];
+    PWM_JitterBucket.store( PWM_JitterBucket.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+
+    for( size_t l = 0; l < this->PWM_Loops.size( ); l++ ) {
+        const BBBPWMControlLoop& PWM_Loop = this->PWM_Loops[ l ];
+        int PWM_Duty = PWM_Loop.PWM_Callback( PWM_Loop.PWM_Arg, PWM_Due );
+        int64_t PWM_Done = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+        int64_t PWM_Took = PWM_Done - PWM_Now;
+        PWM_Now = PWM_Done;
+        this->PWM_TotalCallback.store( this->PWM_TotalCallback.load( memory_order_relaxed ) + PWM_Took, memory_order_relaxed );
+        if( PWM_Took > this->PWM_MaxCallback.load( memory_order_relaxed ) )
+            this->PWM_MaxCallback.store( PWM_Took, memory_order_relaxed );
+        atomic< uint64_t >& PWM_TookBucket = this->PWM_Callback[ PWM_LatencyBucket( ( uint64_t ) PWM_Took ) ];
+        PWM_TookBucket.store( PWM_TookBucket.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+        // From this thread PWM_SetTargetSpeed( ) only sets the dirty bit : the pass this tick is part of writes it.
+        if( PWM_Duty != PWM_CONTROL_KEEP )
+            this->PWM_Owner->PWM_Devices[ PWM_Loop.PWM_Channel ]->PWM_SetTargetSpeed( PWM_Duty );
+    }
+    this->PWM_Ticks.store( this->PWM_Ticks.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+    return true;
+}
+
+/**
+ \fn public function void PWM_Stamp( int64_t PWM_Scheduled )
+ \brief Writer thread, once the tick run by PWM_Run( ) is written : records how long after its deadline, and an overrun if past the next one.
+ \param <int64_t> PWM_Scheduled
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMScheduler< PWM_Backend >::PWM_Stamp( int64_t PWM_Scheduled ) {
+    int64_t PWM_Write = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( ) - PWM_Scheduled;
+    if( PWM_Write > this->PWM_MaxWrite.load( memory_order_relaxed ) )
+        this->PWM_MaxWrite.store( PWM_Write, memory_order_relaxed );
+    if( PWM_Write >= this->PWM_PeriodNs )
+        this->PWM_Overruns.store( this->PWM_Overruns.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+}
+
+template class BBBPWMScheduler< BBBPWMSysfsBackend >;
+template class BBBPWMScheduler< BBBPWMSimBackend >;
+template class BBBPWMScheduler< BBBPWMNullBackend >;
+template class BBBPWMScheduler< BBBPWMUringBackend >;
+template class BBBPWMScheduler< BBBPWMEhrpwmBackend >;
+template class BBBPWMScheduler< BBBPWMClassBackend >;
@@ -0,0 +1,205 @@
+//
+//  BBBPWMScheduler.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMScheduler_h
+#define BBBPWMScheduler_h
+
+#include "BBBPWMDevice.h"
+
+#include <vector>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#define PWM_DEFAULT_CONTROL_NS 2500000 //!< Default control loop period, 400 Hz.
+#define PWM_CONTROL_KEEP       -1 //!< Returned by a control callback to leave its channel's target as it is.
+
+using namespace std;
+
+/**
+ \brief Control callback run by the writer thread on every control tick, see BBBPWMController::PWM_AddControl( ).
+ Gets the Arg it was registered with and the tick's index (ticks that were missed are skipped, not replayed), and
+ returns its channel's new target duty in ns, or PWM_CONTROL_KEEP. It must not block nor call back into the controller.
+ */
+typedef int ( *BBBPWMControlFn )( void* Arg, uint64_t Tick );
+
+/**
+ \brief One registered control callback.
+ */
+struct BBBPWMControlLoop {
+    BBBPWMControlFn PWM_Callback; //!< Function to run on each tick.
+    void* PWM_Arg; //!< Passed back to it.
+    int PWM_Channel; //!< Channel its return value is the target of.
+};
+
+/**
+ \brief Timing of the control ticks since PWM_Start( ), filled in by BBBPWMController::PWM_GetControlStats( ).
+ */
+struct BBBPWMControlStats {
+    uint64_t PWM_Ticks; //!< Ticks run.
+    uint64_t PWM_Missed; //!< Ticks skipped because the writer was still busy when a later one fell due.
+    uint64_t PWM_Overruns; //!< Ticks whose writes were not issued before the next tick's deadline.
+    int64_t PWM_MaxJitterNs; //!< Latest a tick's callbacks have started after its deadline.
+    int64_t PWM_TotalJitterNs; //!< Sum of all start delays, PWM_TotalJitterNs / PWM_Ticks is the mean.
+    uint64_t PWM_Jitter[ PWM_LATENCY_BUCKETS ]; //!< Start delays bucketed like write latencies, see PWM_BucketPercentile( ).
+    int64_t PWM_MaxCallbackNs; //!< Longest a single callback has run.
+    int64_t PWM_TotalCallbackNs; //!< Sum of all callback run times.
+    uint64_t PWM_Callback[ PWM_LATENCY_BUCKETS ]; //!< Callback run times, one sample per callback and tick.
+    int64_t PWM_MaxWriteNs; //!< Longest from a tick's deadline until its writes were issued.
+};
+
+/*!
+ *  \brief     BBBPWMScheduler runs the control callbacks of a BBBPWMController on a fixed rate tick.
+ *  \details   Owns the control timerfd, armed with an absolute first deadline and a fixed interval so every tick stays
+ *             on the same grid however late the writer gets to one. The writer thread calls PWM_Run( ) at the top of
+ *             each pass and PWM_Stamp( ) once the pass is written : callback outputs become targets of that same pass.
+ *             Registration happens before BBBPWMController::PWM_Start( ), everything else on the writer thread, except
+ *             PWM_GetStats( ) which is lock-free.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMScheduler {
+
+public:
+
+    /**
+     \brief BBBPWMScheduler : No callbacks, PWM_DEFAULT_CONTROL_NS, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMScheduler( );
+
+    /**
+     \brief ~BBBPWMScheduler : Closes the control timerfd.
+     */
+    ~BBBPWMScheduler( );
+
+    /**
+     \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+     \brief Sets the controller whose channels the callbacks drive, from its constructor.
+     \param <BBBPWMBasicController<PWM_Backend>>* Owner
+     \return <void>
+     */
+    void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner );
+
+    /**
+     \fn public function int PWM_Open( void )
+     \brief Creates the control timerfd, disarmed.
+     \param <void>
+     \return <int> -1 failure (reported), 1 success.
+     */
+    int PWM_Open( void );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes the control timerfd. Safe to call more than once.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function int PWM_GetFD( void ) const
+     \brief Returns the control timerfd for the writer to poll( ), -1 while closed.
+     \param <void>
+     \return <int> this->PWM_FD
+     */
+    int PWM_GetFD( void ) const;
+
+    /**
+     \fn public function int PWM_Add( int Channel, BBBPWMControlFn Callback, void* Arg )
+     \brief Registers a callback, see BBBPWMController::PWM_AddControl( ).
+     \param <int> Channel
+     \param <BBBPWMControlFn> Callback
+     \param <void>* Arg
+     \return <int> -1 no such channel or no callback, >= 0 the index of the callback.
+     */
+    int PWM_Add( int Channel, BBBPWMControlFn Callback, void* Arg );
+
+    /**
+     \fn public function void PWM_SetPeriod( long Nanoseconds )
+     \brief Sets the tick period, PWM_DEFAULT_CONTROL_NS if not positive.
+     \param <long> Nanoseconds
+     \return <void>
+     */
+    void PWM_SetPeriod( long Nanoseconds );
+
+    /**
+     \fn public function long PWM_GetPeriod( void ) const
+     \brief Returns the tick period in nanoseconds.
+     \param <void>
+     \return <long> this->PWM_PeriodNs
+     */
+    long PWM_GetPeriod( void ) const;
+
+    /**
+     \fn public function void PWM_GetStats( BBBPWMControlStats& Stats ) const
+     \brief Copies the timing of the ticks since PWM_Arm( ). Lock-free.
+     \param <BBBPWMControlStats>& Stats
+     \return <void>
+     */
+    void PWM_GetStats( BBBPWMControlStats& Stats ) const;
+
+    /**
+     \fn public function void PWM_Arm( void )
+     \brief Resets the timing and, with callbacks registered, starts the tick, the first one a period from now.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Arm( void );
+
+    /**
+     \fn public function bool PWM_Run( int64_t& PWM_Scheduled )
+     \brief Writer thread : if a tick is due, runs every callback once and hands their outputs to their channels, so the pass that follows writes them.
+     \param <int64_t>& PWM_Scheduled (set to the tick's deadline)
+     \return <bool> true if a tick was run.
+     */
+    bool PWM_Run( int64_t& PWM_Scheduled );
+
+    /**
+     \fn public function void PWM_Stamp( int64_t PWM_Scheduled )
+     \brief Writer thread, once the tick run by PWM_Run( ) is written : records how long after its deadline, and an overrun if past the next one.
+     \param <int64_t> PWM_Scheduled
+     \return <void>
+     */
+    void PWM_Stamp( int64_t PWM_Scheduled );
+
+private:
+
+    BBBPWMScheduler( const BBBPWMScheduler& );
+    BBBPWMScheduler& operator=( const BBBPWMScheduler& );
+
+    BBBPWMBasicController< PWM_Backend >* PWM_Owner; //!< Controller the callbacks' channels belong to.
+    int PWM_FD; //!< Periodic timerfd, non blocking : PWM_Run( ) goes by the clock and only reads it to clear the expiry.
+    long PWM_PeriodNs; //!< Tick period in nanoseconds.
+    vector< BBBPWMControlLoop > PWM_Loops; //!< Registered callbacks.
+    int64_t PWM_Start; //!< CLOCK_MONOTONIC deadline of tick 0, tick n is due PWM_PeriodNs * n later.
+    uint64_t PWM_Tick; //!< Ticks due so far, the index of the next one.
+
+    // Timing, stored by the writer only, read by PWM_GetStats( ).
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_Ticks; //!< Ticks run.
+    atomic< uint64_t > PWM_Missed; //!< Ticks skipped.
+    atomic< uint64_t > PWM_Overruns; //!< Ticks written after the next deadline.
+    atomic< int64_t > PWM_MaxJitter; //!< Largest start delay in ns.
+    atomic< int64_t > PWM_TotalJitter; //!< Sum of start delays in ns.
+    atomic< int64_t > PWM_MaxCallback; //!< Longest callback in ns.
+    atomic< int64_t > PWM_TotalCallback; //!< Sum of callback run times in ns.
+    atomic< int64_t > PWM_MaxWrite; //!< Longest deadline to writes issued in ns.
+    atomic< uint64_t > PWM_Jitter[ PWM_LATENCY_BUCKETS ]; //!< Start delay histogram.
+    atomic< uint64_t > PWM_Callback[ PWM_LATENCY_BUCKETS ]; //!< Callback run time histogram.
+};
+
+extern template class BBBPWMScheduler< BBBPWMSysfsBackend >;
+extern template class BBBPWMScheduler< BBBPWMSimBackend >;
+extern template class BBBPWMScheduler< BBBPWMNullBackend >;
+extern template class BBBPWMScheduler< BBBPWMUringBackend >;
+extern template class BBBPWMScheduler< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMScheduler< BBBPWMClassBackend >;
+
+#endif /* BBBPWMScheduler_h */
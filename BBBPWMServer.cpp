@@ -0,0 +1,220 @@
+//
+//  BBBPWMServer.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMController.h"
+
+/**
+ \brief BBBPWMServer : No segment, PWM_DEFAULT_SERVE_NS, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+ \param <void>
+ */
+template< class PWM_Backend >
+BBBPWMServer< PWM_Backend >::BBBPWMServer( ) {
+    this->PWM_Owner = NULL;
+    this->PWM_FD = -1;
+    this->PWM_Shm = NULL;
+    this->PWM_PollNs = PWM_DEFAULT_SERVE_NS;
+    this->PWM_Generation = 0;
+    this->PWM_Retry = false;
+    this->PWM_Due = false;
+}
+
+/**
+ \brief ~BBBPWMServer : Closes the poll timerfd.
+ */
+template< class PWM_Backend >
+BBBPWMServer< PWM_Backend >::~BBBPWMServer( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+ \brief Sets the controller whose channels are served, from its constructor.
+ \param <BBBPWMBasicController<PWM_Backend>>* Owner
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner ) {
+    this->PWM_Owner = Owner;
+}
+
+/**
+ \fn public function int PWM_Open( void )
+ \brief Creates the poll timerfd, disarmed.
+ \param <void>
+ \return <int> -1 failure (reported), 1 success.
+ */
+template< class PWM_Backend >
+int BBBPWMServer< PWM_Backend >::PWM_Open( void ) {
+    this->PWM_FD = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if( this->PWM_FD < 0 ) {
+        cerr << "Error - unable to create the PWM shared memory poll : " << strerror( errno ) << endl;
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes the poll timerfd. Safe to call more than once.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Close( void ) {
+    if( this->PWM_FD >= 0 )
+        close( this->PWM_FD );
+    this->PWM_FD = -1;
+}
+
+/**
+ \fn public function int PWM_GetFD( void ) const
+ \brief Returns the poll timerfd for the writer to poll( ), -1 while closed.
+ \param <void>
+ \return <int> this->PWM_FD
+ */
+template< class PWM_Backend >
+int BBBPWMServer< PWM_Backend >::PWM_GetFD( void ) const {
+    return this->PWM_FD;
+}
+
+/**
+ \fn public function void PWM_Set( BBBPWMShm* Shm, long PollNs )
+ \brief Sets the segment served, NULL for none, see BBBPWMController::PWM_Serve( ).
+ \param <BBBPWMShm>* Shm
+ \param <long> PollNs (0 for PWM_DEFAULT_SERVE_NS)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Set( BBBPWMShm* Shm, long PollNs ) {
+    this->PWM_Shm = Shm;
+    this->PWM_PollNs = PollNs > 0 ? PollNs : PWM_DEFAULT_SERVE_NS;
+    this->PWM_Generation = 0;
+    this->PWM_Seen.assign( this->PWM_Owner->PWM_Devices.size( ), 0 );
+    this->PWM_Written.assign( this->PWM_Owner->PWM_Devices.size( ), 0 );
+}
+
+/**
+ \fn public function BBBPWMShm* PWM_GetSegment( void ) const
+ \brief Returns the segment served.
+ \param <void>
+ \return <BBBPWMShm>* this->PWM_Shm, NULL if none.
+ */
+template< class PWM_Backend >
+BBBPWMShm* BBBPWMServer< PWM_Backend >::PWM_GetSegment( void ) const {
+    return this->PWM_Shm;
+}
+
+/**
+ \fn public function void PWM_Arm( void )
+ \brief While serving : publishes where every channel is now, starts the periodic poll and has the first pass poll.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Arm( void ) {
+    this->PWM_Due = this->PWM_Shm != NULL;
+    if( this->PWM_Shm == NULL )
+        return;
+    // Commands left in the segment before the start are taken by the first poll, clients see where every channel is now.
+    size_t PWM_Channels = this->PWM_Owner->PWM_Devices.size( );
+    this->PWM_Seen.resize( PWM_Channels, 0 );
+    this->PWM_Written.resize( PWM_Channels, 0 );
+    this->PWM_Retry = true;
+    for( size_t c = 0; c < PWM_Channels; c++ )
+        this->PWM_Publish( c, false );
+    struct itimerspec PWM_Poll;
+    PWM_Poll.it_interval.tv_sec = this->PWM_PollNs / 1000000000L;
+    PWM_Poll.it_interval.tv_nsec = this->PWM_PollNs % 1000000000L;
+    PWM_Poll.it_value = PWM_Poll.it_interval;
+    if( timerfd_settime( this->PWM_FD, 0, &PWM_Poll, NULL ) < 0 )
+        cerr << "Error - unable to set the PWM shared memory poll : " << strerror( errno ) << endl;
+}
+
+/**
+ \fn public function void PWM_Run( void )
+ \brief Writer thread : on a poll, if the segment's generation moved, takes every new command and hands it to its channel, its values become targets the pass that follows writes.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Run( void ) {
+    if( !this->PWM_Due )
+        return;
+    this->PWM_Due = false;
+    BBBPWMShm* PWM_Segment = this->PWM_Shm;
+    PWM_Segment->PWM_Status->PWM_ServedNs.store( BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( ), memory_order_relaxed );
+    // One load when no client has written since the last poll, the slots are only read when it moved.
+    uint32_t PWM_Commands = PWM_Segment->PWM_Commands->PWM_Generation.load( memory_order_acquire );
+    if( PWM_Commands == this->PWM_Generation && !this->PWM_Retry )
+        return;
+    this->PWM_Generation = PWM_Commands;
+    this->PWM_Retry = false;
+
+    vector< BBBPWMBasicDevice< PWM_Backend >* >& PWM_Devices = this->PWM_Owner->PWM_Devices;
+    for( size_t c = 0; c < PWM_Devices.size( ); c++ ) {
+        int PWM_Duty, PWM_Period, PWM_Run;
+        int PWM_Taken = PWM_Segment->PWM_TakeCommand( c, this->PWM_Seen[ c ], PWM_Duty, PWM_Period, PWM_Run );
+        if( PWM_Taken < 0 )
+            this->PWM_Retry = true;
+        if( PWM_Taken <= 0 )
+            continue;
+        // The same entry points in-process callers use, the pass that follows writes all three and publishes the slot.
+        BBBPWMBasicDevice< PWM_Backend >* PWM_Device = PWM_Devices[ c ];
+        if( PWM_Period != PWM_SHM_KEEP )
+            PWM_Device->PWM_SetPeriodVal( ( BBBPWMDeviceTypes::PWM_PeriodValues ) PWM_Period );
+        if( PWM_Run != PWM_SHM_KEEP )
+            PWM_Device->PWM_SetRunVal( ( BBBPWMDeviceTypes::PWM_RunValues ) PWM_Run );
+        if( PWM_Duty != PWM_SHM_KEEP )
+            PWM_Device->PWM_SetTargetSpeed( PWM_Duty );
+    }
+}
+
+/**
+ \fn public function void PWM_Publish( size_t PWM_Channel, bool PWM_Wrote )
+ \brief Writer thread : copies a channel's committed values and counters to its status slot, nothing while not serving.
+ \param <size_t> PWM_Channel
+ \param <bool> PWM_Wrote (the writer has just issued a write for it)
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Publish( size_t PWM_Channel, bool PWM_Wrote ) {
+    if( this->PWM_Shm == NULL )
+        return;
+    BBBPWMBasicDevice< PWM_Backend >* PWM_Device = this->PWM_Owner->PWM_Devices[ PWM_Channel ];
+    if( PWM_Wrote )
+        this->PWM_Written[ PWM_Channel ] = BBBPWMBasicController< PWM_Backend >::PWM_MonotonicNs( );
+    BBBPWMShmStatusRecord PWM_Record;
+    PWM_Record.PWM_Duty = this->PWM_Owner->PWM_Table->PWM_Duty[ PWM_Channel ].load( memory_order_relaxed );
+    PWM_Record.PWM_Period = PWM_Device->PWM_PeriodVal.load( memory_order_relaxed );
+    PWM_Record.PWM_Run = PWM_Device->PWM_RunVal.load( memory_order_relaxed );
+    PWM_Record.PWM_Writes = PWM_Device->PWM_WriteCount.load( memory_order_relaxed );
+    PWM_Record.PWM_Errors = PWM_Device->PWM_FailureCount.load( memory_order_relaxed );
+    PWM_Record.PWM_LastWriteNs = this->PWM_Written[ PWM_Channel ];
+    this->PWM_Shm->PWM_Publish( PWM_Channel, PWM_Record );
+    this->PWM_Shm->PWM_Status->PWM_Generation.fetch_add( 1, memory_order_release );
+}
+
+/**
+ \fn public function void PWM_Expire( void )
+ \brief Writer thread, when poll( ) found the timer fired : clears the expiry and has the next pass poll.
+ \param <void>
+ \return <void>
+ */
+template< class PWM_Backend >
+void BBBPWMServer< PWM_Backend >::PWM_Expire( void ) {
+    uint64_t PWM_Expired;
+    if( read( this->PWM_FD, &PWM_Expired, sizeof( PWM_Expired ) ) >= 0 )
+        this->PWM_Due = true;
+}
+
+template class BBBPWMServer< BBBPWMSysfsBackend >;
+template class BBBPWMServer< BBBPWMSimBackend >;
+template class BBBPWMServer< BBBPWMNullBackend >;
+template class BBBPWMServer< BBBPWMUringBackend >;
+template class BBBPWMServer< BBBPWMEhrpwmBackend >;
+template class BBBPWMServer< BBBPWMClassBackend >;
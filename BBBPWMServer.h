@@ -0,0 +1,155 @@
+//
+//  BBBPWMServer.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMServer_h
+#define BBBPWMServer_h
+
+#include "BBBPWMDevice.h"
+#include "BBBPWMShm.h"
+
+#include <vector>
+#include <stdint.h>
+#include <sys/timerfd.h>
+
+#define PWM_DEFAULT_SERVE_NS   1000000 //!< Default shared memory poll period, 1 kHz.
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMServer serves the channels of a BBBPWMController to other processes through a BBBPWMShm segment.
+ *  \details   Owns the poll timerfd. The segment is set before BBBPWMController::PWM_Start( ), everything else runs on the
+ *             writer thread : PWM_Run( ) at the top of a pass takes the commands posted since the last poll,
+ *             PWM_Publish( ) copies a channel's committed values to its status slot whenever the writer touched it, and
+ *             PWM_Expire( ) marks the next pass as a poll when the timer fired.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+template< class PWM_Backend >
+class BBBPWMServer {
+
+public:
+
+    /**
+     \brief BBBPWMServer : No segment, PWM_DEFAULT_SERVE_NS, no owner until PWM_Attach( ), no descriptor until PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMServer( );
+
+    /**
+     \brief ~BBBPWMServer : Closes the poll timerfd.
+     */
+    ~BBBPWMServer( );
+
+    /**
+     \fn public function void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner )
+     \brief Sets the controller whose channels are served, from its constructor.
+     \param <BBBPWMBasicController<PWM_Backend>>* Owner
+     \return <void>
+     */
+    void PWM_Attach( BBBPWMBasicController< PWM_Backend >* Owner );
+
+    /**
+     \fn public function int PWM_Open( void )
+     \brief Creates the poll timerfd, disarmed.
+     \param <void>
+     \return <int> -1 failure (reported), 1 success.
+     */
+    int PWM_Open( void );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes the poll timerfd. Safe to call more than once.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function int PWM_GetFD( void ) const
+     \brief Returns the poll timerfd for the writer to poll( ), -1 while closed.
+     \param <void>
+     \return <int> this->PWM_FD
+     */
+    int PWM_GetFD( void ) const;
+
+    /**
+     \fn public function void PWM_Set( BBBPWMShm* Shm, long PollNs )
+     \brief Sets the segment served, NULL for none, see BBBPWMController::PWM_Serve( ).
+     \param <BBBPWMShm>* Shm
+     \param <long> PollNs (0 for PWM_DEFAULT_SERVE_NS)
+     \return <void>
+     */
+    void PWM_Set( BBBPWMShm* Shm, long PollNs );
+
+    /**
+     \fn public function BBBPWMShm* PWM_GetSegment( void ) const
+     \brief Returns the segment served.
+     \param <void>
+     \return <BBBPWMShm>* this->PWM_Shm, NULL if none.
+     */
+    BBBPWMShm* PWM_GetSegment( void ) const;
+
+    /**
+     \fn public function void PWM_Arm( void )
+     \brief While serving : publishes where every channel is now, starts the periodic poll and has the first pass poll.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Arm( void );
+
+    /**
+     \fn public function void PWM_Run( void )
+     \brief Writer thread : on a poll, if the segment's generation moved, takes every new command and hands it to its channel, its values become targets the pass that follows writes.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Run( void );
+
+    /**
+     \fn public function void PWM_Publish( size_t PWM_Channel, bool PWM_Wrote )
+     \brief Writer thread : copies a channel's committed values and counters to its status slot, nothing while not serving.
+     \param <size_t> PWM_Channel
+     \param <bool> PWM_Wrote (the writer has just issued a write for it)
+     \return <void>
+     */
+    void PWM_Publish( size_t PWM_Channel, bool PWM_Wrote );
+
+    /**
+     \fn public function void PWM_Expire( void )
+     \brief Writer thread, when poll( ) found the timer fired : clears the expiry and has the next pass poll.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Expire( void );
+
+private:
+
+    BBBPWMServer( const BBBPWMServer& );
+    BBBPWMServer& operator=( const BBBPWMServer& );
+
+    BBBPWMBasicController< PWM_Backend >* PWM_Owner; //!< Controller whose channels are served.
+    int PWM_FD; //!< Periodic timerfd driving the poll, armed by PWM_Arm( ) while serving.
+    BBBPWMShm* PWM_Shm; //!< Segment served, NULL if none.
+    long PWM_PollNs; //!< Poll period in nanoseconds.
+    uint32_t PWM_Generation; //!< Command generation as of the last poll.
+    bool PWM_Retry; //!< A slot was caught mid-write, the next poll reads the slots even if the generation has not moved.
+    bool PWM_Due; //!< Writer only, the next PWM_Run( ) polls.
+    vector< uint32_t > PWM_Seen; //!< Per channel, sequence of the last command taken.
+    vector< int64_t > PWM_Written; //!< Per channel, CLOCK_MONOTONIC of the last write issued by the writer.
+};
+
+extern template class BBBPWMServer< BBBPWMSysfsBackend >;
+extern template class BBBPWMServer< BBBPWMSimBackend >;
+extern template class BBBPWMServer< BBBPWMNullBackend >;
+extern template class BBBPWMServer< BBBPWMUringBackend >;
+extern template class BBBPWMServer< BBBPWMEhrpwmBackend >;
+extern template class BBBPWMServer< BBBPWMClassBackend >;
+
+#endif /* BBBPWMServer_h */
@@ -0,0 +1,337 @@
+//
+//  BBBPWMShm.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMShm.h"
+
+/**
+ \brief BBBPWMShm : Nothing is mapped until PWM_Create( ) or PWM_Open( ).
+ \param <void>
+ */
+BBBPWMShm::BBBPWMShm( ) {
+    this->PWM_Commands = NULL;
+    this->PWM_Status = NULL;
+    this->PWM_CommandBytes = 0;
+    this->PWM_StatusBytes = 0;
+    this->PWM_Channels = 0;
+}
+
+/**
+ \brief ~BBBPWMShm : Unmaps both regions.
+ */
+BBBPWMShm::~BBBPWMShm( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn private static function void* PWM_MapRegion( const string& PWM_Name, int PWM_Flags, int PWM_Prot, size_t& PWM_Bytes )
+ \brief shm_open( )s and maps one region. With O_CREAT, PWM_Bytes is the size to give it, otherwise it is set from the object.
+ \return <void>* NULL failure (reported).
+ */
+void* BBBPWMShm::PWM_MapRegion( const string& PWM_Name, int PWM_Flags, int PWM_Prot, size_t& PWM_Bytes ) {
+    int PWM_FD = shm_open( PWM_Name.c_str( ), PWM_Flags | O_CLOEXEC, 0660 );
+    if( PWM_FD < 0 ) {
+        cerr << "Error - unable to open the shared memory " << PWM_Name << " : " << strerror( errno ) << endl;
+        return NULL;
+    }
+    struct stat PWM_Stat;
+    if( PWM_Flags & O_CREAT ) {
+        if( ftruncate( PWM_FD, PWM_Bytes ) < 0 ) {
+            cerr << "Error - unable to size the shared memory " << PWM_Name << " : " << strerror( errno ) << endl;
+            close( PWM_FD );
+            return NULL;
+        }
+    }
+    else if( fstat( PWM_FD, &PWM_Stat ) < 0 || PWM_Stat.st_size < PWM_CACHE_LINE ) {
+        cerr << "Error - " << PWM_Name << " is not a PWM shared memory segment" << endl;
+        close( PWM_FD );
+        return NULL;
+    }
+    else
+        PWM_Bytes = PWM_Stat.st_size;
+
+    void* PWM_Map = mmap( NULL, PWM_Bytes, PWM_Prot, MAP_SHARED, PWM_FD, 0 );
+    close( PWM_FD );
+    if( PWM_Map == MAP_FAILED ) {
+        cerr << "Error - unable to map the shared memory " << PWM_Name << " : " << strerror( errno ) << endl;
+        return NULL;
+    }
+    return PWM_Map;
+}
+
+/**
+ \fn public function int PWM_Create( const char* Name, int Channels )
+ \brief Driver side : creates (or recreates) both regions with Channels slots, every command set to PWM_SHM_KEEP.
+ \param const <char>* Name (e.g. "/bbbpwm")
+ \param <int> Channels
+ \return <int> -1 failure to create or map a region (reported), 1 success.
+ */
+int BBBPWMShm::PWM_Create( const char* Name, int Channels ) {
+    this->PWM_Close( );
+    if( Channels <= 0 || Channels > PWM_SHM_MAX_CHANNELS ) {
+        cerr << "Error - a PWM shared memory segment holds 1 - " << PWM_SHM_MAX_CHANNELS << " channels" << endl;
+        return -1;
+    }
+    // Recreated rather than reused : clients still mapping an old segment keep it, and see no more updates.
+    PWM_Unlink( Name );
+    this->PWM_CommandBytes = PWM_CACHE_LINE + Channels * sizeof( BBBPWMShmCommand );
+    this->PWM_StatusBytes = PWM_CACHE_LINE + Channels * sizeof( BBBPWMShmStatus );
+    this->PWM_Commands = ( BBBPWMShmHeader* ) PWM_MapRegion( string( Name ) + PWM_SHM_COMMAND, O_RDWR | O_CREAT | O_EXCL, PROT_READ | PROT_WRITE, this->PWM_CommandBytes );
+    this->PWM_Status = ( BBBPWMShmHeader* ) PWM_MapRegion( string( Name ) + PWM_SHM_STATUS, O_RDWR | O_CREAT | O_EXCL, PROT_READ | PROT_WRITE, this->PWM_StatusBytes );
+    if( this->PWM_Commands == NULL || this->PWM_Status == NULL ) {
+        this->PWM_Close( );
+        PWM_Unlink( Name );
+        return -1;
+    }
+    this->PWM_Channels = Channels;
+
+    // Fresh objects are zero filled, only the KEEP markers and the headers need setting.
+    BBBPWMShmHeader* PWM_Regions[ 2 ] = { this->PWM_Commands, this->PWM_Status };
+    for( int r = 0; r < 2; r++ ) {
+        memcpy( PWM_Regions[ r ]->PWM_Magic, PWM_SHM_MAGIC, sizeof( PWM_Regions[ r ]->PWM_Magic ) );
+        PWM_Regions[ r ]->PWM_Channels = Channels;
+        PWM_Regions[ r ]->PWM_SlotSize = r == 0 ? sizeof( BBBPWMShmCommand ) : sizeof( BBBPWMShmStatus );
+    }
+    for( int c = 0; c < Channels; c++ ) {
+        BBBPWMShmCommand* PWM_Slot = this->PWM_CommandSlot( c );
+        PWM_Slot->PWM_Duty.store( PWM_SHM_KEEP, memory_order_relaxed );
+        PWM_Slot->PWM_Period.store( PWM_SHM_KEEP, memory_order_relaxed );
+        PWM_Slot->PWM_Run.store( PWM_SHM_KEEP, memory_order_relaxed );
+    }
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Open( const char* Name )
+ \brief Client side : maps an existing segment, the command region read-write and the status region read-only.
+ \param const <char>* Name
+ \return <int> -1 no such segment or not one this build can read (reported), 1 success.
+ */
+int BBBPWMShm::PWM_Open( const char* Name ) {
+    this->PWM_Close( );
+    this->PWM_Commands = ( BBBPWMShmHeader* ) PWM_MapRegion( string( Name ) + PWM_SHM_COMMAND, O_RDWR, PROT_READ | PROT_WRITE, this->PWM_CommandBytes );
+    this->PWM_Status = ( BBBPWMShmHeader* ) PWM_MapRegion( string( Name ) + PWM_SHM_STATUS, O_RDONLY, PROT_READ, this->PWM_StatusBytes );
+    if( this->PWM_Commands == NULL || this->PWM_Status == NULL ) {
+        this->PWM_Close( );
+        return -1;
+    }
+    uint32_t PWM_Count = this->PWM_Commands->PWM_Channels;
+    if( memcmp( this->PWM_Commands->PWM_Magic, PWM_SHM_MAGIC, sizeof( this->PWM_Commands->PWM_Magic ) ) != 0
+        || memcmp( this->PWM_Status->PWM_Magic, PWM_SHM_MAGIC, sizeof( this->PWM_Status->PWM_Magic ) ) != 0
+        || this->PWM_Commands->PWM_SlotSize != sizeof( BBBPWMShmCommand ) || this->PWM_Status->PWM_SlotSize != sizeof( BBBPWMShmStatus )
+        || PWM_Count == 0 || PWM_Count > PWM_SHM_MAX_CHANNELS || this->PWM_Status->PWM_Channels != PWM_Count
+        || this->PWM_CommandBytes < PWM_CACHE_LINE + PWM_Count * sizeof( BBBPWMShmCommand )
+        || this->PWM_StatusBytes < PWM_CACHE_LINE + PWM_Count * sizeof( BBBPWMShmStatus ) ) {
+        cerr << "Error - " << Name << " is not a PWM shared memory segment this build can use" << endl;
+        this->PWM_Close( );
+        return -1;
+    }
+    this->PWM_Channels = PWM_Count;
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Unmaps both regions, the segment stays until PWM_Unlink( ). Must not be called while a controller serves it.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMShm::PWM_Close( void ) {
+    if( this->PWM_Commands != NULL )
+        munmap( this->PWM_Commands, this->PWM_CommandBytes );
+    if( this->PWM_Status != NULL )
+        munmap( this->PWM_Status, this->PWM_StatusBytes );
+    this->PWM_Commands = NULL;
+    this->PWM_Status = NULL;
+    this->PWM_CommandBytes = this->PWM_StatusBytes = 0;
+    this->PWM_Channels = 0;
+}
+
+/**
+ \fn public static function void PWM_Unlink( const char* Name )
+ \brief Removes both regions' names, mappings already made stay valid.
+ \param const <char>* Name
+ \return <void>
+ */
+void BBBPWMShm::PWM_Unlink( const char* Name ) {
+    shm_unlink( ( string( Name ) + PWM_SHM_COMMAND ).c_str( ) );
+    shm_unlink( ( string( Name ) + PWM_SHM_STATUS ).c_str( ) );
+}
+
+/**
+ \fn public function int PWM_GetChannelCount( void ) const
+ \brief Returns the number of slots, 0 while nothing is mapped.
+ \param <void>
+ \return <int> channels
+ */
+int BBBPWMShm::PWM_GetChannelCount( void ) const {
+    return this->PWM_Channels;
+}
+
+/**
+ \fn private function BBBPWMShmCommand* PWM_CommandSlot( int PWM_Channel ) const
+ \brief Returns a channel's command slot.
+ \param <int> PWM_Channel
+ \return <BBBPWMShmCommand>*
+ */
+BBBPWMShmCommand* BBBPWMShm::PWM_CommandSlot( int PWM_Channel ) const {
+    return ( BBBPWMShmCommand* )( ( char* ) this->PWM_Commands + PWM_CACHE_LINE ) + PWM_Channel;
+}
+
+/**
+ \fn private function BBBPWMShmStatus* PWM_StatusSlot( int PWM_Channel ) const
+ \brief Returns a channel's status slot.
+ \param <int> PWM_Channel
+ \return <BBBPWMShmStatus>*
+ */
+BBBPWMShmStatus* BBBPWMShm::PWM_StatusSlot( int PWM_Channel ) const {
+    return ( BBBPWMShmStatus* )( ( char* ) this->PWM_Status + PWM_CACHE_LINE ) + PWM_Channel;
+}
+
+/**
+ \fn private function void PWM_WriteCommand( int PWM_Channel, int PWM_Duty, int PWM_Period, int PWM_Run )
+ \brief Seqlock write of one command slot, without bumping the generation. Values given as PWM_SHM_KEEP leave the
+ slot's own alone, so a command the controller has not taken yet is never undone by a later one.
+ \return <void>
+ */
+void BBBPWMShm::PWM_WriteCommand( int PWM_Channel, int PWM_Duty, int PWM_Period, int PWM_Run ) {
+    BBBPWMShmCommand* PWM_Slot = this->PWM_CommandSlot( PWM_Channel );
+    uint32_t PWM_Seq = PWM_Slot->PWM_Seq.load( memory_order_relaxed );
+    // Odd first, and the fence keeps the values from being seen before it : a reader that sees any new value sees odd.
+    PWM_Slot->PWM_Seq.store( PWM_Seq + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+    if( PWM_Duty != PWM_SHM_KEEP )
+        PWM_Slot->PWM_Duty.store( PWM_Duty, memory_order_relaxed );
+    if( PWM_Period != PWM_SHM_KEEP )
+        PWM_Slot->PWM_Period.store( PWM_Period, memory_order_relaxed );
+    if( PWM_Run != PWM_SHM_KEEP )
+        PWM_Slot->PWM_Run.store( PWM_Run, memory_order_relaxed );
+    PWM_Slot->PWM_Seq.store( PWM_Seq + 2, memory_order_release );
+}
+
+/**
+ \fn public function int PWM_SetTarget( int Channel, int Duty, int Period, int Run )
+ \brief Client side : writes one channel's command and tells the controller. Stores only, no system call.
+ A value left as PWM_SHM_KEEP keeps whatever the slot already holds.
+ \param <int> Channel
+ \param <int> Duty (PWM_SHM_KEEP to leave it)
+ \param <int> Period (PWM_SHM_KEEP to leave it)
+ \param <int> Run (PWM_SHM_KEEP to leave it)
+ \return <int> -1 no such channel, 1 success.
+ */
+int BBBPWMShm::PWM_SetTarget( int Channel, int Duty, int Period, int Run ) {
+    if( Channel < 0 || Channel >= this->PWM_Channels )
+        return -1;
+    this->PWM_WriteCommand( Channel, Duty, Period, Run );
+    this->PWM_Commands->PWM_Generation.fetch_add( 1, memory_order_release );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_SetDuties( const int* Duties, int Count )
+ \brief Client side : writes the duty of channels 0 - Count - 1 and tells the controller once, so they are picked up by the same poll.
+ Their periods and runs keep whatever the slots already hold.
+ \param const <int>* Duties
+ \param <int> Count
+ \return <int> -1 more duties than channels, 1 success.
+ */
+int BBBPWMShm::PWM_SetDuties( const int* Duties, int Count ) {
+    if( Count < 0 || Count > this->PWM_Channels )
+        return -1;
+    for( int c = 0; c < Count; c++ )
+        this->PWM_WriteCommand( c, Duties[ c ], PWM_SHM_KEEP, PWM_SHM_KEEP );
+    this->PWM_Commands->PWM_Generation.fetch_add( 1, memory_order_release );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_GetStatus( int Channel, BBBPWMShmStatusRecord& Status ) const
+ \brief Client side : copies a channel's status, retrying while the writer is publishing it. Loads only.
+ \param <int> Channel
+ \param <BBBPWMShmStatusRecord>& Status
+ \return <int> -1 no such channel, 1 success.
+ */
+int BBBPWMShm::PWM_GetStatus( int Channel, BBBPWMShmStatusRecord& Status ) const {
+    if( Channel < 0 || Channel >= this->PWM_Channels )
+        return -1;
+    const BBBPWMShmStatus* PWM_Slot = this->PWM_StatusSlot( Channel );
+    uint32_t PWM_Before, PWM_After;
+    do {
+        PWM_Before = PWM_Slot->PWM_Seq.load( memory_order_acquire );
+        Status.PWM_Duty = PWM_Slot->PWM_Duty.load( memory_order_relaxed );
+        Status.PWM_Period = PWM_Slot->PWM_Period.load( memory_order_relaxed );
+        Status.PWM_Run = PWM_Slot->PWM_Run.load( memory_order_relaxed );
+        Status.PWM_Writes = PWM_Slot->PWM_Writes.load( memory_order_relaxed );
+        Status.PWM_Errors = PWM_Slot->PWM_Errors.load( memory_order_relaxed );
+        Status.PWM_LastWriteNs = PWM_Slot->PWM_LastWriteNs.load( memory_order_relaxed );
+        atomic_thread_fence( memory_order_acquire );
+        PWM_After = PWM_Slot->PWM_Seq.load( memory_order_relaxed );
+    } while( ( PWM_Before & 1 ) || PWM_Before != PWM_After );
+    return 1;
+}
+
+/**
+ \fn public function int64_t PWM_GetServedNs( void ) const
+ \brief Returns the CLOCK_MONOTONIC time of the controller's last poll, 0 if it has never polled.
+ \param <void>
+ \return <int64_t> ns
+ */
+int64_t BBBPWMShm::PWM_GetServedNs( void ) const {
+    return this->PWM_Status != NULL ? this->PWM_Status->PWM_ServedNs.load( memory_order_relaxed ) : 0;
+}
+
+/**
+ \fn private function int PWM_TakeCommand( int PWM_Channel, uint32_t& PWM_Seen, int& PWM_Duty, int& PWM_Period, int& PWM_Run )
+ \brief Driver side : reads a command slot if its sequence moved past PWM_Seen and no write is in progress.
+ \param <int> PWM_Channel
+ \param <uint32_t>& PWM_Seen (sequence of the last command taken, updated)
+ \param <int>& PWM_Duty
+ \param <int>& PWM_Period
+ \param <int>& PWM_Run
+ \return <int> -1 still being written (retry on the next poll), 0 nothing new, 1 new command.
+ */
+int BBBPWMShm::PWM_TakeCommand( int PWM_Channel, uint32_t& PWM_Seen, int& PWM_Duty, int& PWM_Period, int& PWM_Run ) {
+    const BBBPWMShmCommand* PWM_Slot = this->PWM_CommandSlot( PWM_Channel );
+    for( int t = 0; t < PWM_SHM_RETRIES; t++ ) {
+        uint32_t PWM_Before = PWM_Slot->PWM_Seq.load( memory_order_acquire );
+        if( PWM_Before == PWM_Seen )
+            return 0;
+        if( PWM_Before & 1 )
+            continue;
+        PWM_Duty = PWM_Slot->PWM_Duty.load( memory_order_relaxed );
+        PWM_Period = PWM_Slot->PWM_Period.load( memory_order_relaxed );
+        PWM_Run = PWM_Slot->PWM_Run.load( memory_order_relaxed );
+        atomic_thread_fence( memory_order_acquire );
+        if( PWM_Slot->PWM_Seq.load( memory_order_relaxed ) == PWM_Before ) {
+            PWM_Seen = PWM_Before;
+            return 1;
+        }
+    }
+    // The writer thread never spins on a client : a client descheduled mid-write is picked up on a later poll.
+    return -1;
+}
+
+/**
+ \fn private function void PWM_Publish( int PWM_Channel, const BBBPWMShmStatusRecord& PWM_Record )
+ \brief Driver side : seqlock write of one status slot.
+ \param <int> PWM_Channel
+ \param const <BBBPWMShmStatusRecord>& PWM_Record
+ \return <void>
+ */
+void BBBPWMShm::PWM_Publish( int PWM_Channel, const BBBPWMShmStatusRecord& PWM_Record ) {
+    BBBPWMShmStatus* PWM_Slot = this->PWM_StatusSlot( PWM_Channel );
+    uint32_t PWM_Seq = PWM_Slot->PWM_Seq.load( memory_order_relaxed );
+    PWM_Slot->PWM_Seq.store( PWM_Seq + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+    PWM_Slot->PWM_Duty.store( PWM_Record.PWM_Duty, memory_order_relaxed );
+    PWM_Slot->PWM_Period.store( PWM_Record.PWM_Period, memory_order_relaxed );
+    PWM_Slot->PWM_Run.store( PWM_Record.PWM_Run, memory_order_relaxed );
+    PWM_Slot->PWM_Writes.store( PWM_Record.PWM_Writes, memory_order_relaxed );
+    PWM_Slot->PWM_Errors.store( PWM_Record.PWM_Errors, memory_order_relaxed );
+    PWM_Slot->PWM_LastWriteNs.store( PWM_Record.PWM_LastWriteNs, memory_order_relaxed );
+    PWM_Slot->PWM_Seq.store( PWM_Seq + 2, memory_order_release );
+}
@@ -0,0 +1,264 @@
+//
+//  BBBPWMShm.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMShm_h
+#define BBBPWMShm_h
+
+#include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "BBBPWMDevice.h"
+
+#define PWM_SHM_MAGIC          "BBBPWMS1" //!< First 8 bytes of both regions.
+#define PWM_SHM_COMMAND        ".cmd" //!< Appended to the segment name for the command region, e.g. /bbbpwm.cmd.
+#define PWM_SHM_STATUS         ".status" //!< Appended to the segment name for the status region.
+#define PWM_SHM_KEEP           -1 //!< Command value that leaves the current duty, period or run alone.
+#define PWM_SHM_MAX_CHANNELS   1024 //!< Largest segment PWM_Open( ) accepts.
+#define PWM_SHM_RETRIES        4 //!< Reads of a slot that keep racing a write are left for the next poll after this many tries.
+
+using namespace std;
+
+/**
+ \brief First cache line of both regions. Lays out as the same bytes in every process, the atomics are lock-free.
+ */
+struct BBBPWMShmHeader {
+    char PWM_Magic[ 8 ]; //!< PWM_SHM_MAGIC, not terminated.
+    uint32_t PWM_Channels; //!< Slots that follow.
+    uint32_t PWM_SlotSize; //!< sizeof( BBBPWMShmCommand ) or sizeof( BBBPWMShmStatus ), lets older clients reject newer layouts.
+    atomic< uint32_t > PWM_Generation; //!< Command region : bumped by clients after writing slots. Status region : bumped by the writer after publishing.
+    atomic< int64_t > PWM_ServedNs; //!< Status region : CLOCK_MONOTONIC of the writer's last poll, a heartbeat. Unused in the command region.
+};
+
+/**
+ \brief One channel's command, written by one client under a seqlock and read by the controller's writer thread.
+ */
+struct alignas( PWM_CACHE_LINE ) BBBPWMShmCommand {
+    atomic< uint32_t > PWM_Seq; //!< Odd while the client is writing, bumped by 2 per command.
+    atomic< int32_t > PWM_Duty; //!< Target duty in ns, or PWM_SHM_KEEP.
+    atomic< int32_t > PWM_Period; //!< Period in ns, or PWM_SHM_KEEP.
+    atomic< int32_t > PWM_Run; //!< 0 or 1, or PWM_SHM_KEEP.
+};
+
+/**
+ \brief One channel's status, written by the controller's writer thread under a seqlock, read-only to clients.
+ */
+struct alignas( PWM_CACHE_LINE ) BBBPWMShmStatus {
+    atomic< uint32_t > PWM_Seq; //!< Odd while the writer is publishing.
+    atomic< int32_t > PWM_Duty; //!< Duty the kernel holds.
+    atomic< int32_t > PWM_Period; //!< Period the kernel holds.
+    atomic< int32_t > PWM_Run; //!< Run value the kernel holds.
+    atomic< uint64_t > PWM_Writes; //!< Writes issued by the device.
+    atomic< uint64_t > PWM_Errors; //!< Writes that failed.
+    atomic< int64_t > PWM_LastWriteNs; //!< CLOCK_MONOTONIC of the last write the writer thread issued, 0 if none.
+};
+
+/**
+ \brief Plain copy of a status slot, filled in by BBBPWMShm::PWM_GetStatus( ).
+ */
+struct BBBPWMShmStatusRecord {
+    int PWM_Duty;
+    int PWM_Period;
+    int PWM_Run;
+    uint64_t PWM_Writes;
+    uint64_t PWM_Errors;
+    int64_t PWM_LastWriteNs;
+};
+
+/*!
+ *  \brief     BBBPWMShm lets other processes drive a BBBPWMController's channels through POSIX shared memory.
+ *  \details   The segment is two objects : <name>.cmd holds one BBBPWMShmCommand slot per channel, <name>.status one
+ *             BBBPWMShmStatus slot, mapped read-only by clients. A client sets a channel with stores only, no system
+ *             call : it makes the slot's sequence odd, stores the values, makes it even again and bumps the region's
+ *             generation. The controller (BBBPWMController::PWM_Serve( )) polls the generation on its own timerfd and
+ *             only when it moved reads the slots whose sequence changed, retrying any it caught mid-write. Values then
+ *             go through PWM_SetTargetSpeed( ), PWM_SetPeriodVal( ) and PWM_SetRunVal( ) like in-process calls, and
+ *             every channel the writer touches has its status republished. A slot keeps the last value set for each
+ *             field, the controller's repeats are suppressed by the device. Each slot must have a single writer (one
+ *             client per channel, or clients that agree who writes what). The driver process :
+ *             \code
+ *             BBBPWMShm Shm;
+ *             Shm.PWM_Create( "/bbbpwm", Controller.PWM_GetDeviceCount( ) );
+ *             Controller.PWM_Serve( &Shm, 1000000 );   // before PWM_Start( ), polls at 1 kHz
+ *             \endcode
+ *             and a client :
+ *             \code
+ *             BBBPWMShm Motors;
+ *             Motors.PWM_Open( "/bbbpwm" );
+ *             Motors.PWM_SetTarget( 0, 400000, PWM_SHM_KEEP, PWM_SHM_KEEP );
+ *             \endcode
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMShm {
+public:
+
+    /**
+     \fn public function int PWM_Create( const char* Name, int Channels )
+     \brief Driver side : creates (or recreates) both regions with Channels slots, every command set to PWM_SHM_KEEP.
+     \param const <char>* Name (e.g. "/bbbpwm")
+     \param <int> Channels
+     \return <int> -1 failure to create or map a region (reported), 1 success.
+     */
+    int PWM_Create( const char* Name, int Channels );
+
+    /**
+     \fn public function int PWM_Open( const char* Name )
+     \brief Client side : maps an existing segment, the command region read-write and the status region read-only.
+     \param const <char>* Name
+     \return <int> -1 no such segment or not one this build can read (reported), 1 success.
+     */
+    int PWM_Open( const char* Name );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Unmaps both regions, the segment stays until PWM_Unlink( ). Must not be called while a controller serves it.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public static function void PWM_Unlink( const char* Name )
+     \brief Removes both regions' names, mappings already made stay valid.
+     \param const <char>* Name
+     \return <void>
+     */
+    static void PWM_Unlink( const char* Name );
+
+    /**
+     \fn public function int PWM_GetChannelCount( void ) const
+     \brief Returns the number of slots, 0 while nothing is mapped.
+     \param <void>
+     \return <int> channels
+     */
+    int PWM_GetChannelCount( void ) const;
+
+    /**
+     \fn public function int PWM_SetTarget( int Channel, int Duty, int Period, int Run )
+     \brief Client side : writes one channel's command and tells the controller. Stores only, no system call.
+     A value left as PWM_SHM_KEEP keeps whatever the slot already holds.
+     \param <int> Channel
+     \param <int> Duty (PWM_SHM_KEEP to leave it)
+     \param <int> Period (PWM_SHM_KEEP to leave it)
+     \param <int> Run (PWM_SHM_KEEP to leave it)
+     \return <int> -1 no such channel, 1 success.
+     */
+    int PWM_SetTarget( int Channel, int Duty, int Period, int Run );
+
+    /**
+     \fn public function int PWM_SetDuties( const int* Duties, int Count )
+     \brief Client side : writes the duty of channels 0 - Count - 1 and tells the controller once, so they are picked up by the same poll.
+     Their periods and runs keep whatever the slots already hold.
+     \param const <int>* Duties
+     \param <int> Count
+     \return <int> -1 more duties than channels, 1 success.
+     */
+    int PWM_SetDuties( const int* Duties, int Count );
+
+    /**
+     \fn public function int PWM_GetStatus( int Channel, BBBPWMShmStatusRecord& Status ) const
+     \brief Client side : copies a channel's status, retrying while the writer is publishing it. Loads only.
+     \param <int> Channel
+     \param <BBBPWMShmStatusRecord>& Status
+     \return <int> -1 no such channel, 1 success.
+     */
+    int PWM_GetStatus( int Channel, BBBPWMShmStatusRecord& Status ) const;
+
+    /**
+     \fn public function int64_t PWM_GetServedNs( void ) const
+     \brief Returns the CLOCK_MONOTONIC time of the controller's last poll, 0 if it has never polled.
+     \param <void>
+     \return <int64_t> ns
+     */
+    int64_t PWM_GetServedNs( void ) const;
+
+    /**
+     \brief BBBPWMShm : Nothing is mapped until PWM_Create( ) or PWM_Open( ).
+     \param <void>
+     */
+    BBBPWMShm( );
+
+    /**
+     \brief ~BBBPWMShm : Unmaps both regions.
+     */
+    ~BBBPWMShm( );
+
+protected:
+
+    template< class PWM_Backend > friend class BBBPWMServer;
+
+    BBBPWMShmHeader* PWM_Commands; //!< Command region, slots start on the next cache line.
+    BBBPWMShmHeader* PWM_Status; //!< Status region, read-only for clients.
+    size_t PWM_CommandBytes; //!< Length of the command mapping.
+    size_t PWM_StatusBytes; //!< Length of the status mapping.
+    int PWM_Channels; //!< Slots in each region.
+
+    /**
+     \fn private function BBBPWMShmCommand* PWM_CommandSlot( int PWM_Channel ) const
+     \brief Returns a channel's command slot.
+     \param <int> PWM_Channel
+     \return <BBBPWMShmCommand>*
+     */
+    BBBPWMShmCommand* PWM_CommandSlot( int PWM_Channel ) const;
+
+    /**
+     \fn private function BBBPWMShmStatus* PWM_StatusSlot( int PWM_Channel ) const
+     \brief Returns a channel's status slot.
+     \param <int> PWM_Channel
+     \return <BBBPWMShmStatus>*
+     */
+    BBBPWMShmStatus* PWM_StatusSlot( int PWM_Channel ) const;
+
+    /**
+     \fn private function void PWM_WriteCommand( int PWM_Channel, int PWM_Duty, int PWM_Period, int PWM_Run )
+     \brief Seqlock write of one command slot, without bumping the generation. Values given as PWM_SHM_KEEP leave the
+     slot's own alone, so a command the controller has not taken yet is never undone by a later one.
+     \return <void>
+     */
+    void PWM_WriteCommand( int PWM_Channel, int PWM_Duty, int PWM_Period, int PWM_Run );
+
+    /**
+     \fn private function int PWM_TakeCommand( int PWM_Channel, uint32_t& PWM_Seen, int& PWM_Duty, int& PWM_Period, int& PWM_Run )
+     \brief Driver side : reads a command slot if its sequence moved past PWM_Seen and no write is in progress.
+     \param <int> PWM_Channel
+     \param <uint32_t>& PWM_Seen (sequence of the last command taken, updated)
+     \param <int>& PWM_Duty
+     \param <int>& PWM_Period
+     \param <int>& PWM_Run
+     \return <int> -1 still being written (retry on the next poll), 0 nothing new, 1 new command.
+     */
+    int PWM_TakeCommand( int PWM_Channel, uint32_t& PWM_Seen, int& PWM_Duty, int& PWM_Period, int& PWM_Run );
+
+    /**
+     \fn private function void PWM_Publish( int PWM_Channel, const BBBPWMShmStatusRecord& PWM_Record )
+     \brief Driver side : seqlock write of one status slot.
+     \param <int> PWM_Channel
+     \param const <BBBPWMShmStatusRecord>& PWM_Record
+     \return <void>
+     */
+    void PWM_Publish( int PWM_Channel, const BBBPWMShmStatusRecord& PWM_Record );
+
+    /**
+     \fn private static function void* PWM_MapRegion( const string& PWM_Name, int PWM_Flags, int PWM_Prot, size_t& PWM_Bytes )
+     \brief shm_open( )s and maps one region. With O_CREAT, PWM_Bytes is the size to give it, otherwise it is set from the object.
+     \return <void>* NULL failure (reported).
+     */
+    static void* PWM_MapRegion( const string& PWM_Name, int PWM_Flags, int PWM_Prot, size_t& PWM_Bytes );
+};
+
+#endif /* BBBPWMShm_h */
@@ -0,0 +1,286 @@
+//
+//  BBBPWMSimBackend.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMSimBackend.h"
+
+#include <cerrno>
+#include <time.h>
+
+/**
+ \brief BBBPWMSimBackend : A pin holding PWM_SIM_DUTY, PWM_SIM_PERIOD and PWM_SIM_RUN.
+ \param <void>
+ */
+BBBPWMSimBackend::BBBPWMSimBackend( ) {
+    pthread_mutex_init( &this->PWM_Lock, NULL );
+    this->PWM_Values[ PWM_ATTR_DUTY ] = PWM_SIM_DUTY;
+    this->PWM_Values[ PWM_ATTR_PERIOD ] = PWM_SIM_PERIOD;
+    this->PWM_Values[ PWM_ATTR_RUN ] = PWM_SIM_RUN;
+    this->PWM_FailErrno = 0;
+    this->PWM_FailCount = 0;
+    this->PWM_Recording = true;
+    this->PWM_WriteCount = 0;
+}
+
+/**
+ \brief ~BBBPWMSimBackend : Releases the log.
+ */
+BBBPWMSimBackend::~BBBPWMSimBackend( ) {
+    pthread_mutex_destroy( &this->PWM_Lock );
+}
+
+/**
+ \fn public function int PWM_Attach( int Block, int Pin )
+ \brief Records the pin, there is nothing to export.
+ \param <int> Block
+ \param <int> Pin
+ \return <int> 1 success.
+ */
+int BBBPWMSimBackend::PWM_Attach( int Block, int Pin ) {
+    ( void ) Block;
+    ( void ) Pin;
+    return 1;
+}
+
+/**
+ \fn public static function int PWM_AttachAll( const vector< BBBPWMSimBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+ \brief Nothing to wait for, each output is attached in turn.
+ \param const <vector<BBBPWMSimBackend*>>& Outputs
+ \param const <vector<int>>& Blocks
+ \param const <vector<int>>& Pins
+ \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+ \return <int> number of outputs attached.
+ */
+int BBBPWMSimBackend::PWM_AttachAll( const vector< BBBPWMSimBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+    Status.assign( Outputs.size( ), 0 );
+    int PWM_Attached = 0;
+    for( size_t d = 0; d < Outputs.size( ); d++ )
+        PWM_Attached += Status[ d ] = Outputs[ d ]->PWM_Attach( Blocks[ d ], Pins[ d ] );
+    return PWM_Attached;
+}
+
+/**
+ \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+ \brief Returns the value last written (or set with PWM_SetValue( )).
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> 1 success.
+ */
+int BBBPWMSimBackend::PWM_Read( PWM_Attribute Attr, int& Value ) {
+    Value = this->PWM_GetValue( Attr );
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+ \brief Stores and logs a value, unless a failure was injected with PWM_FailWrites( ).
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> 0 injected failure (errno set), 1 success.
+ */
+int BBBPWMSimBackend::PWM_Write( PWM_Attribute Attr, int Value ) {
+    struct timespec PWM_Now;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+    BBBPWMSimWrite PWM_Write = { ( int64_t ) PWM_Now.tv_sec * 1000000000 + PWM_Now.tv_nsec, Attr, Value };
+
+    pthread_mutex_lock( &this->PWM_Lock );
+    if( this->PWM_FailCount > 0 ) {
+        this->PWM_FailCount--;
+        int PWM_Errno = this->PWM_FailErrno;
+        pthread_mutex_unlock( &this->PWM_Lock );
+        errno = PWM_Errno;
+        return 0;
+    }
+    this->PWM_Values[ Attr ] = Value;
+    this->PWM_WriteCount++;
+    if( this->PWM_Recording )
+        this->PWM_Writes.push_back( PWM_Write );
+    pthread_mutex_unlock( &this->PWM_Lock );
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Nothing to close, values and log are kept.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_Close( void ) {
+}
+
+/**
+ \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+ \brief Returns a name for an attribute, for error messages.
+ \param <PWM_Attribute> Attr
+ \return const <char>*
+ */
+const char* BBBPWMSimBackend::PWM_Describe( PWM_Attribute Attr ) const {
+    static const char* PWM_Names[ PWM_ATTRS ] = { "sim:duty", "sim:period", "sim:run" };
+    return PWM_Names[ Attr ];
+}
+
+/**
+ \fn public function void PWM_SetRoot( const string& Root )
+ \brief Kept for BBBPWMBasicDevice::PWM_SetSysfsRoot( ), a simulated pin has no files.
+ \param const <string>& Root
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_SetRoot( const string& Root ) {
+    this->PWM_Root = Root;
+}
+
+/**
+ \fn public function string PWM_GetRoot( void ) const
+ \brief Returns the root given to PWM_SetRoot( ).
+ \param <void>
+ \return <string> this->PWM_Root
+ */
+string BBBPWMSimBackend::PWM_GetRoot( void ) const {
+    return this->PWM_Root;
+}
+
+/**
+ \fn public function void PWM_SetTimeout( int Milliseconds )
+ \brief Ignored, PWM_Attach( ) never waits.
+ \param <int> Milliseconds
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_SetTimeout( int Milliseconds ) {
+    ( void ) Milliseconds;
+}
+
+/**
+ \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+ \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> 0 no failure.
+ */
+int BBBPWMSimBackend::PWM_TakeError( PWM_Attribute Attr, int& Value ) {
+    ( void ) Attr;
+    ( void ) Value;
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchBegin( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMSimBackend::PWM_BatchBegin( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchEnd( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMSimBackend::PWM_BatchEnd( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchFD( void )
+ \brief No completions to wait for.
+ \param <void>
+ \return <int> -1
+ */
+int BBBPWMSimBackend::PWM_BatchFD( void ) {
+    return -1;
+}
+
+/**
+ \fn public function void PWM_SetValue( PWM_Attribute Attr, int Value )
+ \brief Sets a value without logging it, e.g. the duty the pin holds before PWM_Init( ) reads it.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_SetValue( PWM_Attribute Attr, int Value ) {
+    pthread_mutex_lock( &this->PWM_Lock );
+    this->PWM_Values[ Attr ] = Value;
+    pthread_mutex_unlock( &this->PWM_Lock );
+}
+
+/**
+ \fn public function int PWM_GetValue( PWM_Attribute Attr ) const
+ \brief Returns the value the simulated pin currently holds.
+ \param <PWM_Attribute> Attr
+ \return <int>
+ */
+int BBBPWMSimBackend::PWM_GetValue( PWM_Attribute Attr ) const {
+    pthread_mutex_lock( &this->PWM_Lock );
+    int PWM_Value = this->PWM_Values[ Attr ];
+    pthread_mutex_unlock( &this->PWM_Lock );
+    return PWM_Value;
+}
+
+/**
+ \fn public function void PWM_FailWrites( int Errno, int Count )
+ \brief Makes the next Count writes fail with Errno, nothing is stored or logged for them.
+ \param <int> Errno
+ \param <int> Count
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_FailWrites( int Errno, int Count ) {
+    pthread_mutex_lock( &this->PWM_Lock );
+    this->PWM_FailErrno = Errno;
+    this->PWM_FailCount = Count > 0 ? Count : 0;
+    pthread_mutex_unlock( &this->PWM_Lock );
+}
+
+/**
+ \fn public function void PWM_SetRecording( bool Enabled )
+ \brief Turns the write log on or off (on by default), values are always kept.
+ \param <bool> Enabled
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_SetRecording( bool Enabled ) {
+    pthread_mutex_lock( &this->PWM_Lock );
+    this->PWM_Recording = Enabled;
+    pthread_mutex_unlock( &this->PWM_Lock );
+}
+
+/**
+ \fn public function void PWM_GetWrites( vector< BBBPWMSimWrite >& Writes ) const
+ \brief Copies the write log, oldest first.
+ \param <vector<BBBPWMSimWrite>>& Writes
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_GetWrites( vector< BBBPWMSimWrite >& Writes ) const {
+    pthread_mutex_lock( &this->PWM_Lock );
+    Writes = this->PWM_Writes;
+    pthread_mutex_unlock( &this->PWM_Lock );
+}
+
+/**
+ \fn public function uint64_t PWM_GetWriteCount( void ) const
+ \brief Returns the number of successful writes, logged or not.
+ \param <void>
+ \return <uint64_t> this->PWM_WriteCount
+ */
+uint64_t BBBPWMSimBackend::PWM_GetWriteCount( void ) const {
+    pthread_mutex_lock( &this->PWM_Lock );
+    uint64_t PWM_Count = this->PWM_WriteCount;
+    pthread_mutex_unlock( &this->PWM_Lock );
+    return PWM_Count;
+}
+
+/**
+ \fn public function void PWM_ClearWrites( void )
+ \brief Empties the write log.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMSimBackend::PWM_ClearWrites( void ) {
+    pthread_mutex_lock( &this->PWM_Lock );
+    this->PWM_Writes.clear( );
+    pthread_mutex_unlock( &this->PWM_Lock );
+}
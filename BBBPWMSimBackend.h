@@ -0,0 +1,246 @@
+//
+//  BBBPWMSimBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMSimBackend_h
+#define BBBPWMSimBackend_h
+
+#define PWM_SIM_DUTY           700000 //!< Duty a simulated pin starts with (PWM_DUTY_HIGH).
+#define PWM_SIM_PERIOD         1200000 //!< Period a simulated pin starts with (STARTUP).
+#define PWM_SIM_RUN            0 //!< Run value a simulated pin starts with (OFF).
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "BBBPWMBackend.h"
+
+using namespace std;
+
+/**
+ \brief One value committed to a BBBPWMSimBackend.
+ */
+struct BBBPWMSimWrite {
+    int64_t PWM_TimeNs; //!< CLOCK_MONOTONIC time of the write.
+    PWM_Attribute PWM_Attr; //!< Which attribute was written.
+    int PWM_Value; //!< The value written.
+};
+
+/*!
+ *  \brief     BBBPWMSimBackend is an in-memory pin : it holds the duty, period and run values and logs every write with a timestamp.
+ *  \details   Lets the whole init / ramp / update flow run on any Linux box (CI, profiling) and be checked write by write :
+ *             \code
+ *             BBBPWMSimDevice Motor;
+ *             Motor.PWM_Init( );
+ *             Motor.PWM_SetTargetSpeed( 400000 );
+ *             ...
+ *             vector< BBBPWMSimWrite > Writes;
+ *             Motor.PWM_GetBackend( ).PWM_GetWrites( Writes );
+ *             \endcode
+ *             Writes may come from the controller's writer thread and the caller at once, the log is guarded by a mutex.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMSimBackend {
+public:
+
+    /**
+     \fn public function int PWM_Attach( int Block, int Pin )
+     \brief Records the pin, there is nothing to export.
+     \param <int> Block
+     \param <int> Pin
+     \return <int> 1 success.
+     */
+    int PWM_Attach( int Block, int Pin );
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMSimBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief Nothing to wait for, each output is attached in turn.
+     \param const <vector<BBBPWMSimBackend*>>& Outputs
+     \param const <vector<int>>& Blocks
+     \param const <vector<int>>& Pins
+     \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+     \return <int> number of outputs attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMSimBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Returns the value last written (or set with PWM_SetValue( )).
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Stores and logs a value, unless a failure was injected with PWM_FailWrites( ).
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> 0 injected failure (errno set), 1 success.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Nothing to close, values and log are kept.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+     \brief Returns a name for an attribute, for error messages.
+     \param <PWM_Attribute> Attr
+     \return const <char>*
+     */
+    const char* PWM_Describe( PWM_Attribute Attr ) const;
+
+    /**
+     \fn public function void PWM_SetRoot( const string& Root )
+     \brief Kept for BBBPWMBasicDevice::PWM_SetSysfsRoot( ), a simulated pin has no files.
+     \param const <string>& Root
+     \return <void>
+     */
+    void PWM_SetRoot( const string& Root );
+
+    /**
+     \fn public function string PWM_GetRoot( void ) const
+     \brief Returns the root given to PWM_SetRoot( ).
+     \param <void>
+     \return <string> this->PWM_Root
+     */
+    string PWM_GetRoot( void ) const;
+
+    /**
+     \fn public function void PWM_SetTimeout( int Milliseconds )
+     \brief Ignored, PWM_Attach( ) never waits.
+     \param <int> Milliseconds
+     \return <void>
+     */
+    void PWM_SetTimeout( int Milliseconds );
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> 0 no failure.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchBegin( void );
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchEnd( void );
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief No completions to wait for.
+     \param <void>
+     \return <int> -1
+     */
+    static int PWM_BatchFD( void );
+
+    /**
+     \fn public function void PWM_SetValue( PWM_Attribute Attr, int Value )
+     \brief Sets a value without logging it, e.g. the duty the pin holds before PWM_Init( ) reads it.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <void>
+     */
+    void PWM_SetValue( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function int PWM_GetValue( PWM_Attribute Attr ) const
+     \brief Returns the value the simulated pin currently holds.
+     \param <PWM_Attribute> Attr
+     \return <int>
+     */
+    int PWM_GetValue( PWM_Attribute Attr ) const;
+
+    /**
+     \fn public function void PWM_FailWrites( int Errno, int Count )
+     \brief Makes the next Count writes fail with Errno, nothing is stored or logged for them.
+     \param <int> Errno
+     \param <int> Count
+     \return <void>
+     */
+    void PWM_FailWrites( int Errno, int Count );
+
+    /**
+     \fn public function void PWM_SetRecording( bool Enabled )
+     \brief Turns the write log on or off (on by default), values are always kept.
+     \param <bool> Enabled
+     \return <void>
+     */
+    void PWM_SetRecording( bool Enabled );
+
+    /**
+     \fn public function void PWM_GetWrites( vector< BBBPWMSimWrite >& Writes ) const
+     \brief Copies the write log, oldest first.
+     \param <vector<BBBPWMSimWrite>>& Writes
+     \return <void>
+     */
+    void PWM_GetWrites( vector< BBBPWMSimWrite >& Writes ) const;
+
+    /**
+     \fn public function uint64_t PWM_GetWriteCount( void ) const
+     \brief Returns the number of successful writes, logged or not.
+     \param <void>
+     \return <uint64_t> this->PWM_WriteCount
+     */
+    uint64_t PWM_GetWriteCount( void ) const;
+
+    /**
+     \fn public function void PWM_ClearWrites( void )
+     \brief Empties the write log.
+     \param <void>
+     \return <void>
+     */
+    void PWM_ClearWrites( void );
+
+    /**
+     \brief BBBPWMSimBackend : A pin holding PWM_SIM_DUTY, PWM_SIM_PERIOD and PWM_SIM_RUN.
+     \param <void>
+     */
+    BBBPWMSimBackend( );
+
+    /**
+     \brief ~BBBPWMSimBackend : Releases the log.
+     */
+    ~BBBPWMSimBackend( );
+
+protected:
+
+    mutable pthread_mutex_t PWM_Lock; //!< Guards everything below.
+    int PWM_Values[ PWM_ATTRS ]; //!< What the pin holds.
+    int PWM_FailErrno; //!< errno of injected failures.
+    int PWM_FailCount; //!< Writes still to fail.
+    bool PWM_Recording; //!< True to append writes to PWM_Writes.
+    uint64_t PWM_WriteCount; //!< Successful writes.
+    vector< BBBPWMSimWrite > PWM_Writes; //!< Write log.
+    string PWM_Root; //!< As given to PWM_SetRoot( ).
+};
+
+#endif /* BBBPWMSimBackend_h */
@@ -0,0 +1,527 @@
+//
+//  BBBPWMSysfsBackend.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMSysfsBackend.h"
+
+#include <dirent.h>
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/inotify.h>
+
+static const char* const PWM_AttrFiles[ PWM_ATTRS ] = { "/duty", "/period", "/run" }; //!< Indexed by PWM_Attribute.
+
+/**
+ \brief Parses a pwm_test_P<block>_<pin>.<index> folder name, false for anything else.
+ */
+static bool PWM_ParseFolder( const char* PWM_Name, int& PWM_Block, int& PWM_Pin, int& PWM_Index ) {
+    if( strncmp( PWM_Name, PWM_OVERLAY_FILE "P", sizeof( PWM_OVERLAY_FILE ) ) != 0 )
+        return false;
+    const char* PWM_Start = PWM_Name + sizeof( PWM_OVERLAY_FILE );
+    const char* PWM_Under = strchr( PWM_Start, '_' );
+    const char* PWM_Dot = PWM_Under == NULL ? NULL : strchr( PWM_Under, '.' );
+    return PWM_Dot != NULL
+        && PWM_ParseDecimal( PWM_Start, ( int )( PWM_Under - PWM_Start ), PWM_Block )
+        && PWM_ParseDecimal( PWM_Under + 1, ( int )( PWM_Dot - PWM_Under - 1 ), PWM_Pin )
+        && PWM_ParseDecimal( PWM_Dot + 1, ( int ) strlen( PWM_Dot + 1 ), PWM_Index ) && PWM_Index >= 0;
+}
+
+/**
+ \brief BBBPWMSysfsBackend : Nothing is opened until PWM_Attach( ).
+ \param <void>
+ */
+BBBPWMSysfsBackend::BBBPWMSysfsBackend( ) {
+    for( int a = 0; a < PWM_ATTRS; a++ )
+        this->PWM_FD[ a ] = -1;
+    this->PWM_FileHandle = -1;
+    this->PWM_BlockNum = 0;
+    this->PWM_PinNum = 0;
+    this->PWM_FolderIndex = -1;
+    this->PWM_OverlayTimeoutMs = PWM_OVERLAY_TIMEOUT_MS;
+    this->PWM_SysfsRoot = SYSFS_ROOT;
+}
+
+/**
+ \brief ~BBBPWMSysfsBackend : Closes the duty, period and run files.
+ */
+BBBPWMSysfsBackend::~BBBPWMSysfsBackend( ) {
+    this->PWM_Close( );
+}
+
+/**
+ \fn public function void PWM_SetRoot( const string& Root )
+ \brief Sets the sysfs mount point used to build every path, must be called before PWM_Attach( ). Defaults to SYSFS_ROOT.
+ \param const <string>& Root
+ \return <void>
+ */
+void BBBPWMSysfsBackend::PWM_SetRoot( const string& Root ) {
+    this->PWM_SysfsRoot = Root;
+}
+
+/**
+ \fn public function string PWM_GetRoot( void ) const
+ \brief Returns the sysfs mount point.
+ \param <void>
+ \return <string> this->PWM_SysfsRoot
+ */
+string BBBPWMSysfsBackend::PWM_GetRoot( void ) const {
+    return this->PWM_SysfsRoot;
+}
+
+/**
+ \fn public function void PWM_SetTimeout( int Milliseconds )
+ \brief Sets how long PWM_Attach( ) waits for the pwm_test_ folder to appear after loading the pin overlay. Defaults to PWM_OVERLAY_TIMEOUT_MS.
+ \param <int> Milliseconds
+ \return <void>
+ */
+void BBBPWMSysfsBackend::PWM_SetTimeout( int Milliseconds ) {
+    this->PWM_OverlayTimeoutMs = Milliseconds;
+}
+
+/**
+ \fn public function int PWM_Attach( int Block, int Pin )
+ \brief Finds the pwm_test_ folder of the pin, loading its overlay first if it is missing, and opens the duty, period and run files.
+ \param <int> Block (8 or 9)
+ \param <int> Pin
+ \return <int> 0 failure (the critical error has been reported), 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_Attach( int Block, int Pin ) {
+    vector< BBBPWMSysfsBackend* > PWM_Self( 1, this );
+    vector< int > PWM_Blocks( 1, Block ), PWM_Pins( 1, Pin ), PWM_Status;
+    return PWM_AttachAll( PWM_Self, PWM_Blocks, PWM_Pins, PWM_Status );
+}
+
+/**
+ \fn public static function int PWM_AttachAll( const vector< BBBPWMSysfsBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+ \brief PWM_Attach( ) for many pins at once : am33xx_pwm is checked once, every missing pin overlay is written to SLOTS
+ back to back and all of their pwm_test_ folders are waited for together, so the wait does not grow with the number of pins.
+ The outputs are expected to share one sysfs root, any other is attached on its own. The timeout is the longest of theirs.
+ \param const <vector<BBBPWMSysfsBackend*>>& Outputs
+ \param const <vector<int>>& Blocks
+ \param const <vector<int>>& Pins
+ \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+ \return <int> number of outputs attached.
+ */
+int BBBPWMSysfsBackend::PWM_AttachAll( const vector< BBBPWMSysfsBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+    Status.assign( Outputs.size( ), 0 );
+    if( Outputs.empty( ) )
+        return 0;
+    const string& PWM_Root = Outputs[ 0 ]->PWM_SysfsRoot;
+    vector< BBBPWMSysfsBackend* > PWM_Shared;
+    int PWM_Attached = 0, PWM_TimeoutMs = 0;
+    for( size_t d = 0; d < Outputs.size( ); d++ ) {
+        if( Outputs[ d ]->PWM_SysfsRoot != PWM_Root ) {
+            PWM_Attached += Status[ d ] = Outputs[ d ]->PWM_Attach( Blocks[ d ], Pins[ d ] );
+            continue;
+        }
+        Outputs[ d ]->PWM_Close( );
+        Outputs[ d ]->PWM_BlockNum = Blocks[ d ];
+        Outputs[ d ]->PWM_PinNum = Pins[ d ];
+        Outputs[ d ]->PWM_FolderIndex = -1;
+        PWM_TimeoutMs = max( PWM_TimeoutMs, Outputs[ d ]->PWM_OverlayTimeoutMs );
+        PWM_Shared.push_back( Outputs[ d ] );
+    }
+    if( PWM_Shared.empty( ) )
+        return PWM_Attached;
+
+    // The pin overlays need the PWM subsystems, so am33xx_pwm goes first.
+    if( !PWM_Shared[ 0 ]->PWM_SysCheck( ) ) {
+        cerr << "Critical Error 1 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export am3xx_pwm" << endl;
+        return PWM_Attached;
+    }
+
+    string PWM_DeviceDir = PWM_Root + DEVICE_DIR;
+    vector< BBBPWMSysfsBackend* > PWM_Loading;
+    if( PWM_ScanPins( PWM_DeviceDir, PWM_Shared ) < ( int ) PWM_Shared.size( ) ) {
+        // Watch before writing to SLOTS, a folder can appear before PWM_LoadOverlay( ) returns.
+        int PWM_Watch = PWM_WatchPins( PWM_DeviceDir );
+        for( size_t d = 0; d < PWM_Shared.size( ); d++ ) {
+            BBBPWMSysfsBackend* PWM_Output = PWM_Shared[ d ];
+            if( PWM_Output->PWM_FolderIndex >= 0 )
+                continue;
+            // Only pins in the table have an overlay, any other pin can only use a folder that is already there.
+            const BBBPWMPinInfo* PWM_Info = BBBPWMPins::PWM_Find( PWM_Output->PWM_BlockNum, PWM_Output->PWM_PinNum );
+            if( PWM_Info == NULL )
+                cerr << "Critical Error 5 : Unable to setup PWM on your BeagleBone Black, P" << PWM_Output->PWM_BlockNum << "_" << PWM_Output->PWM_PinNum << " is not a PWM pin." << endl;
+            else if( PWM_Output->PWM_LoadOverlay( PWM_Info->PWM_Overlay.PWM_Text ) < 0 )
+                cerr << "Critical Error 2 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export :" << PWM_Info->PWM_Overlay.PWM_Text << endl;
+            else
+                PWM_Loading.push_back( PWM_Output );
+        }
+        if( !PWM_Loading.empty( ) )
+            PWM_WaitForPins( PWM_Watch, PWM_DeviceDir, PWM_Loading, PWM_TimeoutMs );
+    }
+    for( size_t d = 0; d < PWM_Loading.size( ); d++ )
+        if( PWM_Loading[ d ]->PWM_FolderIndex < 0 )
+            cerr << "Critical Error 3 : Unable to setup PWM on your BeagleBone Black, sys error - unable to export :" << BBBPWMPins::PWM_Find( PWM_Loading[ d ]->PWM_BlockNum, PWM_Loading[ d ]->PWM_PinNum )->PWM_Overlay.PWM_Text << endl;
+
+    for( size_t d = 0; d < Outputs.size( ); d++ ) {
+        if( Outputs[ d ]->PWM_SysfsRoot != PWM_Root || Outputs[ d ]->PWM_FolderIndex < 0 )
+            continue;
+        if( Outputs[ d ]->PWM_OpenFiles( ) < 0 ) {
+            cerr << "Critical Error 4 : Unable to use PWM on your BeagleBone Black, sys error - unable to load PWM values on initialisation." << endl;
+            continue;
+        }
+        Status[ d ] = 1;
+        PWM_Attached++;
+    }
+    return PWM_Attached;
+}
+
+/**
+ \fn private function int PWM_SysCheck( void )
+ \brief Checks that the system files are available for PWM operation on the BeagleBone Black.
+ \param <void>
+ \return <int> 0 failure load the system files, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_SysCheck( void ) {
+    struct stat sb;
+    if ( stat( ( this->PWM_SysfsRoot + MODALIAS_FILE ).c_str( ), &sb ) == 0 && S_ISREG( sb.st_mode ) )
+        return 1;
+    else {
+        if( this->PWM_LoadOverlay( PWM_PREP_OVERLAY_FILE ) < 0 )
+            return 0;
+        else
+            return 1;
+    }
+
+}
+
+/**
+ \fn private function int PWM_PinCheck( void )
+ \brief Checks that the PWM Pin files are available for PWM operation on the BeagleBone Black.
+ \param <void>
+ \return <int> 0 the PWM Pin files are missing, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_PinCheck( void ) {
+    vector< BBBPWMSysfsBackend* > PWM_Self( 1, this );
+    return PWM_ScanPins( this->PWM_SysfsRoot + DEVICE_DIR, PWM_Self ) == 1;
+}
+
+/**
+ \fn private static function int PWM_ScanPins( const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins )
+ \brief A single opendir( ) / readdir( ) pass over PWM_DeviceDir that resolves the pwm_test_P<block>_<pin>.<index> folder of every pin given.
+ \param const <string>& PWM_DeviceDir (sysfs root + DEVICE_DIR)
+ \param <vector<BBBPWMSysfsBackend*>>& PWM_Pins
+ \return <int> -1 unable to read the folder, >= 0 number of pins whose folder has been found.
+ */
+int BBBPWMSysfsBackend::PWM_ScanPins( const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins ) {
+    DIR* PWM_Dir = opendir( PWM_DeviceDir.c_str( ) );
+    if( PWM_Dir == NULL ) {
+        cerr << "Unable to read folder : " << PWM_DeviceDir << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+
+    int PWM_Found = 0;
+    for( size_t d = 0; d < PWM_Pins.size( ); d++ )
+        PWM_Found += PWM_Pins[ d ]->PWM_FolderIndex >= 0;
+
+    // Entries are parsed rather than compared against a formatted prefix per pin, only the <index> is kept.
+    struct dirent* PWM_Entry;
+    int PWM_Block, PWM_PinNum, PWM_Index;
+    while( PWM_Found < ( int ) PWM_Pins.size( ) && ( PWM_Entry = readdir( PWM_Dir ) ) != NULL ) {
+        if( !PWM_ParseFolder( PWM_Entry->d_name, PWM_Block, PWM_PinNum, PWM_Index ) )
+            continue;
+        for( size_t d = 0; d < PWM_Pins.size( ); d++ ) {
+            BBBPWMSysfsBackend* PWM_Pin = PWM_Pins[ d ];
+            if( PWM_Pin->PWM_FolderIndex >= 0 || PWM_Pin->PWM_BlockNum != PWM_Block || PWM_Pin->PWM_PinNum != PWM_PinNum )
+                continue;
+            PWM_Pin->PWM_FolderIndex = PWM_Index;
+            PWM_Found++;
+            break;
+        }
+    }
+    closedir( PWM_Dir );
+    return PWM_Found;
+}
+
+/**
+ \fn private static function int PWM_WatchPins( const string& PWM_DeviceDir )
+ \brief Starts an inotify watch for new folders in PWM_DeviceDir, set it up before writing to SLOTS so that no creation is missed.
+ \param const <string>& PWM_DeviceDir
+ \return <int> -1 inotify unavailable (PWM_WaitForPins( ) then rescans on a timer only), >= 0 the shared inotify descriptor, never closed.
+ */
+int BBBPWMSysfsBackend::PWM_WatchPins( const string& PWM_DeviceDir ) {
+    // One inotify instance for the process : closing one blocks for a kernel grace period (~10-20ms), longer than the discovery it speeds up.
+    static int PWM_Inotify = inotify_init1( IN_CLOEXEC | IN_NONBLOCK );
+    if( PWM_Inotify < 0 || inotify_add_watch( PWM_Inotify, PWM_DeviceDir.c_str( ), IN_CREATE | IN_MOVED_TO ) < 0 )
+        return -1;
+    char PWM_Events[ 4096 ] __attribute__( ( aligned( __alignof__( struct inotify_event ) ) ) );
+    while( read( PWM_Inotify, PWM_Events, sizeof( PWM_Events ) ) > 0 );
+    return PWM_Inotify;
+}
+
+/**
+ \fn private static function int PWM_WaitForPins( int PWM_Watch, const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins, int PWM_TimeoutMs )
+ \brief Waits until the pwm_test_ folder of every pin exists, rescanning on each inotify event (and every PWM_DISCOVERY_POLL_MS).
+ \param <int> PWM_Watch (from PWM_WatchPins( ), may be -1)
+ \param const <string>& PWM_DeviceDir
+ \param <vector<BBBPWMSysfsBackend*>>& PWM_Pins
+ \param <int> PWM_TimeoutMs
+ \return <int> 0 timed out, 1 every folder found.
+ */
+int BBBPWMSysfsBackend::PWM_WaitForPins( int PWM_Watch, const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins, int PWM_TimeoutMs ) {
+    struct timespec PWM_Now;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+    int64_t PWM_Deadline = ( int64_t ) PWM_Now.tv_sec * 1000 + PWM_Now.tv_nsec / 1000000 + PWM_TimeoutMs;
+    char PWM_Events[ 4096 ] __attribute__( ( aligned( __alignof__( struct inotify_event ) ) ) );
+    int PWM_Ret = 0;
+
+    while( 1 ) {
+        if( PWM_ScanPins( PWM_DeviceDir, PWM_Pins ) == ( int ) PWM_Pins.size( ) ) {
+            PWM_Ret = 1;
+            break;
+        }
+        clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+        int64_t PWM_Left = PWM_Deadline - ( ( int64_t ) PWM_Now.tv_sec * 1000 + PWM_Now.tv_nsec / 1000000 );
+        if( PWM_Left <= 0 )
+            break;
+        // inotify makes fake trees (tmpfs) instant, kernfs never reports new device folders so the poll timeout is the real sysfs path.
+        struct pollfd PWM_Wait = { PWM_Watch, POLLIN, 0 };
+        int PWM_Wait_Ms = PWM_Left < PWM_DISCOVERY_POLL_MS ? ( int ) PWM_Left : PWM_DISCOVERY_POLL_MS;
+        if( poll( &PWM_Wait, PWM_Watch >= 0 ? 1 : 0, PWM_Wait_Ms ) > 0 )
+            while( read( PWM_Watch, PWM_Events, sizeof( PWM_Events ) ) > 0 );
+    }
+
+    return PWM_Ret;
+}
+
+/**
+ \fn private function int PWM_LoadOverlay( const char* PWM_OverlayFile )
+ \brief The BeagleBone Black has Overlay Files to allow operations like PWM. In this function we are attempting to export an overlay for PWM.
+ \param const <char>* PWM_OverlayFile (just the file name, no path required)
+ \return <int> -1 failure load the system files, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_LoadOverlay( const char* PWM_OverlayFile ) {
+    if( this->PWM_SetFileHandle( ( this->PWM_SysfsRoot + SLOTS_DIR ).c_str( ) ) < 0 )
+        return this->PWM_FileHandle;
+    else {
+        int PWM_Wrote = this->PWM_WriteToFile( PWM_OverlayFile, ( int ) strlen( PWM_OverlayFile ) );
+        close( this->PWM_FileHandle );
+        return PWM_Wrote > 0 ? 1 : -1;
+    }
+}
+
+/**
+ \fn private function int PWM_SetFileHandle( const char* PWM_FileName )
+ \brief Creates a private FileHandle for use within this class.
+ \param const <char>* PWM_FileName
+ \throws Exception on failure to open the file.
+ \return <int> -1 failure load the system files, > 0 success.
+ */
+int BBBPWMSysfsBackend::PWM_SetFileHandle( const char* PWM_FileName ) {
+    try {
+        this->PWM_FileHandle = open( PWM_FileName, O_WRONLY );
+    } catch( exception& e ) {
+        cerr << "Error opening file : " << PWM_FileName << " | Error = " << e.what( ) << endl;
+        this->PWM_FileHandle = -1;
+    }
+    return this->PWM_FileHandle;
+}
+
+/**
+ \fn private function int PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen )
+ \brief Writes a value to PWM_FileHandle, the caller closes it.
+ \param const <char>* PWM_Buffer (holds the value to be written)
+ \param <int>PWM_BufferLen (length of the buffer to be written)
+ \return <int> 0 failed to write, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen ) {
+    if( write( this->PWM_FileHandle, PWM_Buffer, PWM_BufferLen ) == PWM_BufferLen )
+        return 1;
+    cerr << "Error writing to file. | Error = " << strerror( errno ) << endl;
+    return 0;
+}
+
+/**
+ \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+ \brief Writes a value to one of the persistent descriptors with pwrite( ), (re)opening it first if it is closed.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> -1 failed to open, 0 failed to write (errno set, the descriptor is dropped on EBADF or ENODEV), 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_Write( PWM_Attribute Attr, int Value ) {
+    int& PWM_FD = this->PWM_FD[ Attr ];
+    if( this->PWM_OpenAttr( Attr ) < 0 )
+        return -1;
+    char PWM_ValueBuffer[ PWM_DECIMAL_MAX ];
+    int PWM_ValueLen = PWM_FormatDecimal( Value, PWM_ValueBuffer );
+    ssize_t PWM_Wrote = pwrite( PWM_FD, PWM_ValueBuffer, PWM_ValueLen, 0 );
+    if( PWM_Wrote == PWM_ValueLen )
+        return 1;
+    if( PWM_Wrote >= 0 )
+        errno = EIO;
+    else if( errno == EBADF || errno == ENODEV ) {
+        // The attribute went away underneath us (overlay reloaded), the next write reopens it.
+        int PWM_Errno = errno;
+        close( PWM_FD );
+        PWM_FD = -1;
+        errno = PWM_Errno;
+    }
+    return 0;
+}
+
+/**
+ \fn private function int PWM_OpenAttr( PWM_Attribute Attr )
+ \brief Returns the persistent descriptor of an attribute, (re)opening it first if it is closed.
+ \param <PWM_Attribute> Attr
+ \return <int> -1 failed to open (reported), >= 0 the descriptor.
+ */
+int BBBPWMSysfsBackend::PWM_OpenAttr( PWM_Attribute Attr ) {
+    int& PWM_FD = this->PWM_FD[ Attr ];
+    if( PWM_FD >= 0 )
+        return PWM_FD;
+    char PWM_Path[ MAX_BUF ];
+    if( this->PWM_BuildPath( PWM_AttrFiles[ Attr ], PWM_Path ) < 0 || ( PWM_FD = open( PWM_Path, O_RDWR ) ) < 0 )
+        cerr << "Error opening file : " << this->PWM_Describe( Attr ) << " | Error = " << strerror( errno ) << endl;
+    return PWM_FD;
+}
+
+/**
+ \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+ \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value
+ \return <int> 0 no failure.
+ */
+int BBBPWMSysfsBackend::PWM_TakeError( PWM_Attribute Attr, int& Value ) {
+    ( void ) Attr;
+    ( void ) Value;
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchBegin( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMSysfsBackend::PWM_BatchBegin( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchEnd( void )
+ \brief Nothing is batched, every write is issued as it is made.
+ \param <void>
+ \return <int> 0 no failed writes.
+ */
+int BBBPWMSysfsBackend::PWM_BatchEnd( void ) {
+    return 0;
+}
+
+/**
+ \fn public static function int PWM_BatchFD( void )
+ \brief No completions to wait for.
+ \param <void>
+ \return <int> -1
+ */
+int BBBPWMSysfsBackend::PWM_BatchFD( void ) {
+    return -1;
+}
+
+/**
+ \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+ \brief Reads a decimal value from one of the persistent descriptors with pread( ), no stdio and no allocation.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value (only written on success)
+ \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_Read( PWM_Attribute Attr, int& Value ) {
+    // sysfs attributes are a single value and a newline, anything longer than this is not a value we wrote.
+    char PWM_ValueBuffer[ 32 ];
+    ssize_t PWM_Len = pread( this->PWM_FD[ Attr ], PWM_ValueBuffer, sizeof( PWM_ValueBuffer ), 0 );
+    if( PWM_Len < 0 ) {
+        cerr << "Unable to read from file : " << this->PWM_Describe( Attr ) << " | Error = " << strerror( errno ) << endl;
+        return -1;
+    }
+    if( !PWM_ParseDecimal( PWM_ValueBuffer, ( int ) PWM_Len, Value ) ) {
+        cerr << "Unable to read from file : " << this->PWM_Describe( Attr ) << " | Error = not a decimal value : '" << string( PWM_ValueBuffer, PWM_Len ) << "'" << endl;
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+ \brief Returns the path of an attribute, for error messages. Built on demand, valid until the next call on the same thread.
+ \param <PWM_Attribute> Attr
+ \return const <char>*
+ */
+const char* BBBPWMSysfsBackend::PWM_Describe( PWM_Attribute Attr ) const {
+    static thread_local char PWM_Path[ MAX_BUF ];
+    int PWM_Errno = errno;
+    if( this->PWM_BuildPath( PWM_AttrFiles[ Attr ], PWM_Path ) < 0 )
+        strcpy( PWM_Path, PWM_AttrFiles[ Attr ] + 1 );
+    // Callers print strerror( errno ) right after.
+    errno = PWM_Errno;
+    return PWM_Path;
+}
+
+/**
+ \fn private function int PWM_BuildPath( const char* PWM_Leaf, char* PWM_Path ) const
+ \brief Writes the path of the pin's pwm_test_ folder followed by PWM_Leaf (e.g. "/duty"), paths are only built to open or report.
+ \param const <char>* PWM_Leaf
+ \param <char>* PWM_Path (MAX_BUF bytes)
+ \return <int> -1 the path does not fit (errno ENAMETOOLONG), >= 0 its length.
+ */
+int BBBPWMSysfsBackend::PWM_BuildPath( const char* PWM_Leaf, char* PWM_Path ) const {
+    size_t PWM_Root = this->PWM_SysfsRoot.size( ), PWM_LeafLen = strlen( PWM_Leaf );
+    // Three decimals, the fixed parts and the terminator.
+    if( PWM_Root + sizeof( DEVICE_DIR PWM_OVERLAY_FILE ) + 3 * PWM_DECIMAL_MAX + PWM_LeafLen + 4 > MAX_BUF ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    char* p = PWM_Path;
+    memcpy( p, this->PWM_SysfsRoot.data( ), PWM_Root );
+    p += PWM_Root;
+    memcpy( p, DEVICE_DIR PWM_OVERLAY_FILE "P", sizeof( DEVICE_DIR PWM_OVERLAY_FILE "P" ) - 1 );
+    p += sizeof( DEVICE_DIR PWM_OVERLAY_FILE "P" ) - 1;
+    p += PWM_FormatDecimal( this->PWM_BlockNum, p );
+    *p++ = '_';
+    p += PWM_FormatDecimal( this->PWM_PinNum, p );
+    *p++ = '.';
+    p += PWM_FormatDecimal( this->PWM_FolderIndex, p );
+    memcpy( p, PWM_Leaf, PWM_LeafLen + 1 );
+    return ( int )( p - PWM_Path + PWM_LeafLen );
+}
+
+/**
+ \fn private function int PWM_OpenFiles( void )
+ \brief Opens the duty, period and run files (read / write) once so that updates only cost a single pwrite( ).
+ \param <void>
+ \return <int> -1 failure to open the files, 1 success.
+ */
+int BBBPWMSysfsBackend::PWM_OpenFiles( void ) {
+    this->PWM_Close( );
+    char PWM_Path[ MAX_BUF ];
+    for( int a = 0; a < PWM_ATTRS; a++ )
+        if( this->PWM_BuildPath( PWM_AttrFiles[ a ], PWM_Path ) >= 0 )
+            this->PWM_FD[ a ] = open( PWM_Path, O_RDWR );
+    if( this->PWM_FD[ PWM_ATTR_DUTY ] < 0 || this->PWM_FD[ PWM_ATTR_PERIOD ] < 0 || this->PWM_FD[ PWM_ATTR_RUN ] < 0 ) {
+        int PWM_Errno = errno;
+        this->PWM_BuildPath( "", PWM_Path );
+        cerr << "Error opening PWM files in : " << PWM_Path << " | Error = " << strerror( PWM_Errno ) << endl;
+        this->PWM_Close( );
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ \fn public function void PWM_Close( void )
+ \brief Closes any of the duty, period and run descriptors that are open.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMSysfsBackend::PWM_Close( void ) {
+    for( int a = 0; a < PWM_ATTRS; a++ ) {
+        if( this->PWM_FD[ a ] >= 0 ) close( this->PWM_FD[ a ] );
+        this->PWM_FD[ a ] = -1;
+    }
+}
@@ -0,0 +1,281 @@
+//
+//  BBBPWMSysfsBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMSysfsBackend_h
+#define BBBPWMSysfsBackend_h
+
+#define SYSFS_ROOT               "/sys" //!< Default sysfs mount point, see PWM_SetSysfsRoot( ) to point a device at another tree.
+#define SLOTS_DIR                "/devices/bone_capemgr.9/slots" //!< Path to SLOTS (relative to the sysfs root), used to export device tree overlays.
+#define DEVICE_DIR                "/devices/ocp.3/" //!< Path to exported PWM overlay file systems (relative to the sysfs root)
+#define MODALIAS_FILE            "/devices/ocp.3/48300000.epwmss/modalias" //!< This file should exist after the am33xx device overlay is exported (relative to the sysfs root).
+#define PWM_PREP_OVERLAY_FILE    "am33xx_pwm" //!< This device tree must be exported before any specific pins
+#define MAX_BUF                1024 //!< Used in setting the buffer size.
+#define PWM_OVERLAY_TIMEOUT_MS 2000 //!< Default time allowed for a pwm_test_ folder to appear after its overlay is written to SLOTS.
+#define PWM_DISCOVERY_POLL_MS  10 //!< Rescan interval while waiting, sysfs (kernfs) does not raise inotify events for new devices.
+
+#include <iostream>
+#include <exception>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "BBBPWMBackend.h"
+#include "BBBPWMCodec.h"
+#include "BBBPWMPins.h"
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMSysfsBackend writes the duty, period and run values of one pin to the BeagleBone Black's pwm_test_ sysfs files.
+ *  \details   PWM_Attach( ) exports the pin overlay if needed and opens the three attributes once, every write is then a
+ *             single pwrite( ). This is the backend behind BBBPWMDevice.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMSysfsBackend {
+public:
+
+    /**
+     \fn public function int PWM_Attach( int Block, int Pin )
+     \brief Finds the pwm_test_ folder of the pin, loading its overlay first if it is missing, and opens the duty, period and run files.
+     \param <int> Block (8 or 9)
+     \param <int> Pin
+     \return <int> 0 failure (the critical error has been reported), 1 success.
+     */
+    int PWM_Attach( int Block, int Pin );
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMSysfsBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief PWM_Attach( ) for many pins at once : am33xx_pwm is checked once, every missing pin overlay is written to SLOTS
+     back to back and all of their pwm_test_ folders are waited for together, so the wait does not grow with the number of pins.
+     The outputs are expected to share one sysfs root, any other is attached on its own. The timeout is the longest of theirs.
+     \param const <vector<BBBPWMSysfsBackend*>>& Outputs
+     \param const <vector<int>>& Blocks
+     \param const <vector<int>>& Pins
+     \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+     \return <int> number of outputs attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMSysfsBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Reads a decimal value from one of the persistent descriptors with pread( ), no stdio and no allocation.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value (only written on success)
+     \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Writes a value to one of the persistent descriptors with pwrite( ), (re)opening it first if it is closed.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> -1 failed to open, 0 failed to write (errno set, the descriptor is dropped on EBADF or ENODEV), 1 success.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function void PWM_Close( void )
+     \brief Closes any of the duty, period and run descriptors that are open.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Close( void );
+
+    /**
+     \fn public function const char* PWM_Describe( PWM_Attribute Attr ) const
+     \brief Returns the path of an attribute, for error messages. Built on demand, valid until the next call on the same thread.
+     \param <PWM_Attribute> Attr
+     \return const <char>*
+     */
+    const char* PWM_Describe( PWM_Attribute Attr ) const;
+
+    /**
+     \fn public function void PWM_SetRoot( const string& Root )
+     \brief Sets the sysfs mount point used to build every path, must be called before PWM_Attach( ). Defaults to SYSFS_ROOT.
+     \param const <string>& Root
+     \return <void>
+     */
+    void PWM_SetRoot( const string& Root );
+
+    /**
+     \fn public function string PWM_GetRoot( void ) const
+     \brief Returns the sysfs mount point.
+     \param <void>
+     \return <string> this->PWM_SysfsRoot
+     */
+    string PWM_GetRoot( void ) const;
+
+    /**
+     \fn public function void PWM_SetTimeout( int Milliseconds )
+     \brief Sets how long PWM_Attach( ) waits for the pwm_test_ folder to appear after loading the pin overlay. Defaults to PWM_OVERLAY_TIMEOUT_MS.
+     \param <int> Milliseconds
+     \return <void>
+     */
+    void PWM_SetTimeout( int Milliseconds );
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Writes are synchronous, PWM_Write( ) has already reported every failure.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value
+     \return <int> 0 no failure.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchBegin( void );
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Nothing is batched, every write is issued as it is made.
+     \param <void>
+     \return <int> 0 no failed writes.
+     */
+    static int PWM_BatchEnd( void );
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief No completions to wait for.
+     \param <void>
+     \return <int> -1
+     */
+    static int PWM_BatchFD( void );
+
+    /**
+     \brief BBBPWMSysfsBackend : Nothing is opened until PWM_Attach( ).
+     \param <void>
+     */
+    BBBPWMSysfsBackend( );
+
+    /**
+     \brief ~BBBPWMSysfsBackend : Closes the duty, period and run files.
+     */
+    ~BBBPWMSysfsBackend( );
+
+protected:
+
+    int PWM_FD[ PWM_ATTRS ]; //!< Persistent descriptors for the duty, period and run files, -1 while closed.
+    int PWM_FileHandle; //!< Short lived handle used to write to SLOTS.
+    int PWM_BlockNum; //!< Block of the attached pin.
+    int PWM_PinNum; //!< Attached pin.
+    int PWM_FolderIndex; //!< Kernel assigned <index> of the pin's pwm_test_P<block>_<pin>.<index> folder, -1 until found.
+    int PWM_OverlayTimeoutMs; //!< How long PWM_Attach( ) waits for the pin overlay folder.
+
+    string PWM_SysfsRoot; //!< Stores the sysfs mount point all device paths are built from.
+
+    /**
+     \fn private function int PWM_SysCheck( void )
+     \brief Checks that the system files are available for PWM operation on the BeagleBone Black.
+     \param <void>
+     \return <int> 0 failure load the system files, 1 success.
+     */
+    int PWM_SysCheck( void );
+
+    /**
+     \fn private function int PWM_PinCheck( void )
+     \brief Checks that the PWM Pin files are available for PWM operation on the BeagleBone Black.
+     \param <void>
+     \return <int> 0 the PWM Pin files are missing, 1 success.
+     */
+    int PWM_PinCheck( void );
+
+    /**
+     \fn private static function int PWM_ScanPins( const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins )
+     \brief A single opendir( ) / readdir( ) pass over PWM_DeviceDir that resolves the pwm_test_P<block>_<pin>.<index> folder of every pin given.
+     \param const <string>& PWM_DeviceDir (sysfs root + DEVICE_DIR)
+     \param <vector<BBBPWMSysfsBackend*>>& PWM_Pins
+     \return <int> -1 unable to read the folder, >= 0 number of pins whose folder has been found.
+     */
+    static int PWM_ScanPins( const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins );
+
+    /**
+     \fn private static function int PWM_WatchPins( const string& PWM_DeviceDir )
+     \brief Starts an inotify watch for new folders in PWM_DeviceDir, set it up before writing to SLOTS so that no creation is missed.
+     \param const <string>& PWM_DeviceDir
+     \return <int> -1 inotify unavailable (PWM_WaitForPins( ) then rescans on a timer only), >= 0 the shared inotify descriptor, never closed.
+     */
+    static int PWM_WatchPins( const string& PWM_DeviceDir );
+
+    /**
+     \fn private static function int PWM_WaitForPins( int PWM_Watch, const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins, int PWM_TimeoutMs )
+     \brief Waits until the pwm_test_ folder of every pin exists, rescanning on each inotify event (and every PWM_DISCOVERY_POLL_MS).
+     \param <int> PWM_Watch (from PWM_WatchPins( ), may be -1)
+     \param const <string>& PWM_DeviceDir
+     \param <vector<BBBPWMSysfsBackend*>>& PWM_Pins
+     \param <int> PWM_TimeoutMs
+     \return <int> 0 timed out, 1 every folder found.
+     */
+    static int PWM_WaitForPins( int PWM_Watch, const string& PWM_DeviceDir, vector< BBBPWMSysfsBackend* >& PWM_Pins, int PWM_TimeoutMs );
+
+    /**
+     \fn private function int PWM_LoadOverlay( const char* PWM_OverlayFile )
+     \brief The BeagleBone Black has Overlay Files to allow operations like PWM. In this function we are attempting to export an overlay for PWM.
+     \param const <char>* PWM_OverlayFile (just the file name, no path required)
+     \return <int> -1 failure load the system files, 1 success.
+     */
+    int PWM_LoadOverlay( const char *PWM_OverlayFile );
+
+    /**
+     \fn private function int PWM_SetFileHandle( const char* PWM_FileName )
+     \brief Creates a private FileHandle for use within this class.
+     \param const <char>* PWM_FileName
+     \throws Exception on failure to open the file.
+     \return <int> -1 failure load the system files, > 0 success.
+     */
+    int PWM_SetFileHandle( const char *PWM_FileName );
+
+    /**
+     \fn private function int PWM_WriteToFile( const char* PWM_Buffer, int PWM_BufferLen )
+     \brief Writes a value to PWM_FileHandle, the caller closes it.
+     \param const <char>* PWM_Buffer (holds the value to be written)
+     \param <int>PWM_BufferLen (length of the buffer to be written)
+     \return <int> 0 failed to write, 1 success.
+     */
+    int PWM_WriteToFile( const char *PWM_Buffer, int PWM_BufferLen );
+
+    /**
+     \fn private function int PWM_OpenFiles( void )
+     \brief Opens the duty, period and run files (read / write) once so that updates only cost a single pwrite( ).
+     \param <void>
+     \return <int> -1 failure to open the files, 1 success.
+     */
+    int PWM_OpenFiles( void );
+
+    /**
+     \fn private function int PWM_OpenAttr( PWM_Attribute Attr )
+     \brief Returns the persistent descriptor of an attribute, (re)opening it first if it is closed.
+     \param <PWM_Attribute> Attr
+     \return <int> -1 failed to open (reported), >= 0 the descriptor.
+     */
+    int PWM_OpenAttr( PWM_Attribute Attr );
+
+    /**
+     \fn private function int PWM_BuildPath( const char* PWM_Leaf, char* PWM_Path ) const
+     \brief Writes the path of the pin's pwm_test_ folder followed by PWM_Leaf (e.g. "/duty"), paths are only built to open or report.
+     \param const <char>* PWM_Leaf
+     \param <char>* PWM_Path (MAX_BUF bytes)
+     \return <int> -1 the path does not fit (errno ENAMETOOLONG), >= 0 its length.
+     */
+    int PWM_BuildPath( const char* PWM_Leaf, char* PWM_Path ) const;
+};
+
+#endif /* BBBPWMSysfsBackend_h */
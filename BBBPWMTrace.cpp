@@ -0,0 +1,312 @@
+//
+//  BBBPWMTrace.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMTrace.h"
+
+atomic< bool > BBBPWMTrace::PWM_Enabled( false );
+atomic< BBBPWMTraceRing* > BBBPWMTrace::PWM_Rings[ PWM_TRACE_THREADS ];
+atomic< int > BBBPWMTrace::PWM_RingCount( 0 );
+atomic< uint64_t > BBBPWMTrace::PWM_Unringed( 0 );
+atomic< uint64_t > BBBPWMTrace::PWM_Written( 0 );
+atomic< uint64_t > BBBPWMTrace::PWM_Lost( 0 );
+pthread_mutex_t BBBPWMTrace::PWM_RingLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t BBBPWMTrace::PWM_StartLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_t BBBPWMTrace::PWM_Drain;
+atomic< bool > BBBPWMTrace::PWM_DrainStop( false );
+int BBBPWMTrace::PWM_FD = -1;
+
+/**
+ \brief The calling thread's ring, given back when the thread exits so a later thread can take it over.
+ */
+struct BBBPWMTraceSlot {
+    BBBPWMTraceRing* PWM_Ring; //!< NULL until the thread's first event.
+    bool PWM_NoRing; //!< Set when no ring was left, so later events do not try again.
+
+    ~BBBPWMTraceSlot( ) {
+        if( this->PWM_Ring != NULL )
+            this->PWM_Ring->PWM_Owned.store( false, memory_order_release );
+    }
+};
+
+static thread_local BBBPWMTraceSlot PWM_TraceSlot = { NULL, false };
+
+/**
+ \fn public static function int PWM_Start( const char* Path )
+ \brief Creates (or truncates) the trace file, starts the drain thread and turns recording on.
+ \param const <char>* Path
+ \return <int> -1 already tracing or failure to create the file or the thread, 1 success.
+ */
+int BBBPWMTrace::PWM_Start( const char* Path ) {
+    pthread_mutex_lock( &PWM_StartLock );
+    if( PWM_FD >= 0 ) {
+        pthread_mutex_unlock( &PWM_StartLock );
+        cerr << "Error - BBBPWMTrace::PWM_Start( ) called while already tracing" << endl;
+        return -1;
+    }
+    int PWM_File = open( Path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if( PWM_File < 0 ) {
+        pthread_mutex_unlock( &PWM_StartLock );
+        cerr << "Error - unable to create the trace file " << Path << " : " << strerror( errno ) << endl;
+        return -1;
+    }
+
+    BBBPWMTraceHeader PWM_Header;
+    struct timespec PWM_Mono, PWM_Real;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Mono );
+    clock_gettime( CLOCK_REALTIME, &PWM_Real );
+    memset( &PWM_Header, 0, sizeof( PWM_Header ) );
+    memcpy( PWM_Header.PWM_Magic, PWM_TRACE_MAGIC, sizeof( PWM_Header.PWM_Magic ) );
+    PWM_Header.PWM_EventSize = sizeof( BBBPWMTraceEvent );
+    PWM_Header.PWM_MonotonicNs = ( int64_t ) PWM_Mono.tv_sec * 1000000000 + PWM_Mono.tv_nsec;
+    PWM_Header.PWM_RealtimeNs = ( int64_t ) PWM_Real.tv_sec * 1000000000 + PWM_Real.tv_nsec;
+    if( write( PWM_File, &PWM_Header, sizeof( PWM_Header ) ) != ( ssize_t ) sizeof( PWM_Header ) ) {
+        cerr << "Error - unable to write the trace file " << Path << " : " << strerror( errno ) << endl;
+        close( PWM_File );
+        pthread_mutex_unlock( &PWM_StartLock );
+        return -1;
+    }
+
+    // Leftovers of an earlier trace (a thread that was past the enabled check when it stopped) are not part of this one.
+    int PWM_Count = PWM_RingCount.load( memory_order_acquire );
+    for( int r = 0; r < PWM_Count; r++ ) {
+        BBBPWMTraceRing* PWM_Ring = PWM_Rings[ r ].load( memory_order_relaxed );
+        PWM_Ring->PWM_Tail.store( PWM_Ring->PWM_Head.load( memory_order_acquire ), memory_order_release );
+        PWM_Ring->PWM_LostSeen = PWM_Ring->PWM_Lost.load( memory_order_relaxed );
+    }
+    PWM_Unringed.store( 0, memory_order_relaxed );
+    PWM_Written.store( 0, memory_order_relaxed );
+    PWM_Lost.store( 0, memory_order_relaxed );
+    PWM_FD = PWM_File;
+    PWM_DrainStop.store( false );
+
+    int PWM_Ret = pthread_create( &PWM_Drain, NULL, BBBPWMTrace::PWM_Run, NULL );
+    if( PWM_Ret ) {
+        cerr << "Error - pthread_create() returned code: " << PWM_Ret << endl;
+        close( PWM_FD );
+        PWM_FD = -1;
+        pthread_mutex_unlock( &PWM_StartLock );
+        return -1;
+    }
+    PWM_Enabled.store( true );
+    pthread_mutex_unlock( &PWM_StartLock );
+    return 1;
+}
+
+/**
+ \fn public static function void PWM_Stop( void )
+ \brief Turns recording off, drains what is left and closes the file. Safe to call when not tracing.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMTrace::PWM_Stop( void ) {
+    pthread_mutex_lock( &PWM_StartLock );
+    if( PWM_FD < 0 ) {
+        pthread_mutex_unlock( &PWM_StartLock );
+        return;
+    }
+    PWM_Enabled.store( false );
+    PWM_DrainStop.store( true );
+    pthread_join( PWM_Drain, NULL );
+    close( PWM_FD );
+    PWM_FD = -1;
+    pthread_mutex_unlock( &PWM_StartLock );
+}
+
+/**
+ \fn public static function uint64_t PWM_GetWritten( void )
+ \brief Returns the number of events written to the file by the current (or last) trace.
+ \param <void>
+ \return <uint64_t> PWM_Written
+ */
+uint64_t BBBPWMTrace::PWM_GetWritten( void ) {
+    return PWM_Written.load( memory_order_relaxed );
+}
+
+/**
+ \fn public static function uint64_t PWM_GetLost( void )
+ \brief Returns the number of events dropped by the current (or last) trace, full rings and threads beyond PWM_TRACE_THREADS.
+ \param <void>
+ \return <uint64_t> events
+ */
+uint64_t BBBPWMTrace::PWM_GetLost( void ) {
+    return PWM_Lost.load( memory_order_relaxed ) + PWM_Unringed.load( memory_order_relaxed );
+}
+
+/**
+ \fn public static function int PWM_Attach( void )
+ \brief Takes the calling thread's ring now rather than on its first event, and faults it in, so that a real-time
+ thread never allocates or waits on the ring lock once it is running. Works whether tracing is on or not.
+ \param <void>
+ \return <int> -1 PWM_TRACE_THREADS rings are in use, 1 success.
+ */
+int BBBPWMTrace::PWM_Attach( void ) {
+    if( PWM_TraceSlot.PWM_Ring == NULL && !PWM_TraceSlot.PWM_NoRing ) {
+        PWM_TraceSlot.PWM_Ring = PWM_TakeRing( );
+        PWM_TraceSlot.PWM_NoRing = PWM_TraceSlot.PWM_Ring == NULL;
+        // A ring is only handed out once the drain has emptied it, so no slot is being read while it is cleared.
+        if( PWM_TraceSlot.PWM_Ring != NULL )
+            memset( PWM_TraceSlot.PWM_Ring->PWM_Events, 0, sizeof( PWM_TraceSlot.PWM_Ring->PWM_Events ) );
+    }
+    return PWM_TraceSlot.PWM_Ring != NULL ? 1 : -1;
+}
+
+/**
+ \fn private static function void PWM_Push( PWM_TraceType PWM_Type, int PWM_Attr, int PWM_Block, int PWM_Pin, int PWM_Value, int PWM_Errno )
+ \brief Stamps an event and stores it in the calling thread's ring, taking one on the thread's first event.
+ \return <void>
+ */
+void BBBPWMTrace::PWM_Push( PWM_TraceType PWM_Type, int PWM_Attr, int PWM_Block, int PWM_Pin, int PWM_Value, int PWM_Errno ) {
+    BBBPWMTraceRing* PWM_Ring = PWM_TraceSlot.PWM_Ring;
+    if( PWM_Ring == NULL ) {
+        if( !PWM_TraceSlot.PWM_NoRing )
+            PWM_Ring = PWM_TraceSlot.PWM_Ring = PWM_TakeRing( );
+        if( PWM_Ring == NULL ) {
+            PWM_TraceSlot.PWM_NoRing = true;
+            PWM_Unringed.fetch_add( 1, memory_order_relaxed );
+            return;
+        }
+    }
+
+    // Single producer : only this thread stores PWM_Head, the drain's PWM_Tail is only read when the ring looks full.
+    uint64_t PWM_Head = PWM_Ring->PWM_Head.load( memory_order_relaxed );
+    if( PWM_Head - PWM_Ring->PWM_TailSeen >= PWM_TRACE_RING ) {
+        PWM_Ring->PWM_TailSeen = PWM_Ring->PWM_Tail.load( memory_order_acquire );
+        if( PWM_Head - PWM_Ring->PWM_TailSeen >= PWM_TRACE_RING ) {
+            PWM_Ring->PWM_Lost.store( PWM_Ring->PWM_Lost.load( memory_order_relaxed ) + 1, memory_order_relaxed );
+            return;
+        }
+    }
+
+    struct timespec PWM_Now;
+    clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+    BBBPWMTraceEvent& PWM_Event = PWM_Ring->PWM_Events[ PWM_Head & ( PWM_TRACE_RING - 1 ) ];
+    PWM_Event.PWM_TimeNs = ( int64_t ) PWM_Now.tv_sec * 1000000000 + PWM_Now.tv_nsec;
+    PWM_Event.PWM_Value = PWM_Value;
+    PWM_Event.PWM_Errno = PWM_Errno;
+    PWM_Event.PWM_Type = ( uint8_t ) PWM_Type;
+    PWM_Event.PWM_Attr = ( uint8_t ) PWM_Attr;
+    PWM_Event.PWM_Block = ( uint8_t ) PWM_Block;
+    PWM_Event.PWM_Pin = ( uint8_t ) PWM_Pin;
+    PWM_Event.PWM_Thread = PWM_Ring->PWM_Index;
+    PWM_Event.PWM_Reserved = 0;
+    // Release : the drain that sees the new head also sees the event.
+    PWM_Ring->PWM_Head.store( PWM_Head + 1, memory_order_release );
+}
+
+/**
+ \fn private static function BBBPWMTraceRing* PWM_TakeRing( void )
+ \brief Hands the calling thread a ring : one left empty by a thread that has exited, or a new one.
+ \param <void>
+ \return <BBBPWMTraceRing>* NULL if PWM_TRACE_THREADS rings are in use.
+ */
+BBBPWMTraceRing* BBBPWMTrace::PWM_TakeRing( void ) {
+    pthread_mutex_lock( &PWM_RingLock );
+    int PWM_Count = PWM_RingCount.load( memory_order_relaxed );
+    // Controllers come and go with their writer threads, reuse their rings once the drain has emptied them.
+    for( int r = 0; r < PWM_Count; r++ ) {
+        BBBPWMTraceRing* PWM_Ring = PWM_Rings[ r ].load( memory_order_relaxed );
+        if( !PWM_Ring->PWM_Owned.load( memory_order_acquire )
+            && PWM_Ring->PWM_Tail.load( memory_order_acquire ) == PWM_Ring->PWM_Head.load( memory_order_relaxed ) ) {
+            PWM_Ring->PWM_TailSeen = PWM_Ring->PWM_Head.load( memory_order_relaxed );
+            PWM_Ring->PWM_Owned.store( true, memory_order_relaxed );
+            pthread_mutex_unlock( &PWM_RingLock );
+            return PWM_Ring;
+        }
+    }
+    if( PWM_Count == PWM_TRACE_THREADS ) {
+        pthread_mutex_unlock( &PWM_RingLock );
+        return NULL;
+    }
+
+    BBBPWMTraceRing* PWM_Ring = new BBBPWMTraceRing;
+    PWM_Ring->PWM_Head.store( 0, memory_order_relaxed );
+    PWM_Ring->PWM_Lost.store( 0, memory_order_relaxed );
+    PWM_Ring->PWM_TailSeen = 0;
+    PWM_Ring->PWM_Tail.store( 0, memory_order_relaxed );
+    PWM_Ring->PWM_LostSeen = 0;
+    PWM_Ring->PWM_Owned.store( true, memory_order_relaxed );
+    PWM_Ring->PWM_Index = ( uint16_t ) PWM_Count;
+    PWM_Rings[ PWM_Count ].store( PWM_Ring, memory_order_relaxed );
+    // Release : the drain that sees the new count also sees the initialised ring.
+    PWM_RingCount.store( PWM_Count + 1, memory_order_release );
+    pthread_mutex_unlock( &PWM_RingLock );
+    return PWM_Ring;
+}
+
+/**
+ \fn private static function int PWM_DrainOnce( void )
+ \brief Moves every ring's pending events, and a PWM_TRACE_LOST event for any new drops, into the file.
+ \param <void>
+ \return <int> -1 failure to write the file, 1 success.
+ */
+int BBBPWMTrace::PWM_DrainOnce( void ) {
+    int PWM_Count = PWM_RingCount.load( memory_order_acquire );
+    for( int r = 0; r < PWM_Count; r++ ) {
+        BBBPWMTraceRing* PWM_Ring = PWM_Rings[ r ].load( memory_order_relaxed );
+        uint64_t PWM_Tail = PWM_Ring->PWM_Tail.load( memory_order_relaxed );
+        uint64_t PWM_Head = PWM_Ring->PWM_Head.load( memory_order_acquire );
+
+        // Straight out of the ring, in at most two pieces when it wraps.
+        while( PWM_Tail != PWM_Head ) {
+            uint64_t PWM_Start = PWM_Tail & ( PWM_TRACE_RING - 1 );
+            uint64_t PWM_Run = PWM_Head - PWM_Tail;
+            if( PWM_Run > PWM_TRACE_RING - PWM_Start )
+                PWM_Run = PWM_TRACE_RING - PWM_Start;
+            ssize_t PWM_Bytes = PWM_Run * sizeof( BBBPWMTraceEvent );
+            if( write( PWM_FD, &PWM_Ring->PWM_Events[ PWM_Start ], PWM_Bytes ) != PWM_Bytes ) {
+                cerr << "Error - unable to write the trace file : " << strerror( errno ) << endl;
+                return -1;
+            }
+            PWM_Tail += PWM_Run;
+            // Release : the owner may only reuse the slots once they are in the file.
+            PWM_Ring->PWM_Tail.store( PWM_Tail, memory_order_release );
+            PWM_Written.fetch_add( PWM_Run, memory_order_relaxed );
+        }
+
+        uint64_t PWM_Dropped = PWM_Ring->PWM_Lost.load( memory_order_relaxed );
+        if( PWM_Dropped != PWM_Ring->PWM_LostSeen ) {
+            BBBPWMTraceEvent PWM_Event;
+            struct timespec PWM_Now;
+            clock_gettime( CLOCK_MONOTONIC, &PWM_Now );
+            memset( &PWM_Event, 0, sizeof( PWM_Event ) );
+            PWM_Event.PWM_TimeNs = ( int64_t ) PWM_Now.tv_sec * 1000000000 + PWM_Now.tv_nsec;
+            PWM_Event.PWM_Value = ( int32_t )( PWM_Dropped - PWM_Ring->PWM_LostSeen );
+            PWM_Event.PWM_Type = PWM_TRACE_LOST;
+            PWM_Event.PWM_Thread = PWM_Ring->PWM_Index;
+            if( write( PWM_FD, &PWM_Event, sizeof( PWM_Event ) ) != ( ssize_t ) sizeof( PWM_Event ) ) {
+                cerr << "Error - unable to write the trace file : " << strerror( errno ) << endl;
+                return -1;
+            }
+            PWM_Lost.fetch_add( PWM_Dropped - PWM_Ring->PWM_LostSeen, memory_order_relaxed );
+            PWM_Ring->PWM_LostSeen = PWM_Dropped;
+        }
+    }
+    return 1;
+}
+
+/**
+ \fn private static function void* PWM_Run( void* PWM_Arg )
+ \brief Drain thread : PWM_DrainOnce( ) every PWM_TRACE_DRAIN_NS until PWM_Stop( ).
+ \param <void>* PWM_Arg
+ \return <void> 0.
+ */
+void* BBBPWMTrace::PWM_Run( void* PWM_Arg ) {
+    ( void ) PWM_Arg;
+    struct timespec PWM_Delay = { PWM_TRACE_DRAIN_NS / 1000000000L, PWM_TRACE_DRAIN_NS % 1000000000L };
+    while( !PWM_DrainStop.load( ) ) {
+        nanosleep( &PWM_Delay, NULL );
+        if( PWM_DrainOnce( ) < 0 ) {
+            // Nothing empties the rings any more, recording threads would only be filling them to drop.
+            PWM_Enabled.store( false );
+            return 0;
+        }
+    }
+    // Recording is off by now : this pass takes everything that made it into a ring.
+    PWM_DrainOnce( );
+    return 0;
+}
@@ -0,0 +1,219 @@
+//
+//  BBBPWMTrace.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMTrace_h
+#define BBBPWMTrace_h
+
+#include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "BBBPWMDevice.h"
+
+#define PWM_TRACE_MAGIC        "BBBPWMT1" //!< First 8 bytes of every trace file.
+#define PWM_TRACE_RING         8192 //!< Events each thread can have waiting for the drain, a power of two (192 KB).
+#define PWM_TRACE_THREADS      64 //!< Threads that can record at the same time, events of any more are counted as lost.
+#define PWM_TRACE_DRAIN_NS     5000000 //!< How often the drain thread empties the rings, 5 ms.
+
+using namespace std;
+
+/**
+ \brief What a trace event records.
+ */
+enum PWM_TraceType {
+    PWM_TRACE_REQUEST = 0, //!< A new value was asked for (PWM_SetTargetSpeed( ), PWM_SetPeriodVal( ), PWM_SetRunVal( )).
+    PWM_TRACE_CLAMP = 1, //!< The duty asked for was out of range, PWM_Value is the limit it will be held to.
+    PWM_TRACE_WRITE = 2, //!< A value was handed to the kernel (queued, for a batching backend).
+    PWM_TRACE_FAIL = 3, //!< A write failed, PWM_Errno says why. A batched write is a PWM_TRACE_WRITE when queued, and its PWM_TRACE_FAIL carries the value the kernel kept.
+    PWM_TRACE_LOST = 4, //!< Written by the drain : PWM_Value events of thread PWM_Thread were dropped because its ring was full.
+    PWM_TRACE_TYPES = 5
+};
+
+/**
+ \brief Trace file header, followed directly by events in the order they were drained, sorted per thread only.
+ All fields are little endian, as written on the target.
+ */
+struct BBBPWMTraceHeader {
+    char PWM_Magic[ 8 ]; //!< PWM_TRACE_MAGIC, not terminated.
+    uint32_t PWM_EventSize; //!< sizeof( BBBPWMTraceEvent ), lets older readers reject newer layouts.
+    uint32_t PWM_Reserved; //!< 0.
+    int64_t PWM_MonotonicNs; //!< CLOCK_MONOTONIC when the trace started, the clock events are stamped with.
+    int64_t PWM_RealtimeNs; //!< CLOCK_REALTIME at the same moment, to turn event times into wall clock times.
+};
+
+/**
+ \brief One fixed-size trace event.
+ */
+struct BBBPWMTraceEvent {
+    int64_t PWM_TimeNs; //!< CLOCK_MONOTONIC.
+    int32_t PWM_Value; //!< Value requested, written or clamped to, or the number of lost events.
+    int32_t PWM_Errno; //!< errno of a PWM_TRACE_FAIL, 0 otherwise.
+    uint8_t PWM_Type; //!< PWM_TraceType.
+    uint8_t PWM_Attr; //!< PWM_Attribute the value is for.
+    uint8_t PWM_Block; //!< Header block of the channel (8 or 9).
+    uint8_t PWM_Pin; //!< Header pin of the channel.
+    uint16_t PWM_Thread; //!< Ring the event went through, one per recording thread.
+    uint16_t PWM_Reserved; //!< 0.
+};
+
+/**
+ \brief One thread's events, written by that thread only and read by the drain only.
+ */
+struct BBBPWMTraceRing {
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_Head; //!< Events recorded, stored by the owner.
+    atomic< uint64_t > PWM_Lost; //!< Events dropped because the ring was full, stored by the owner.
+    uint64_t PWM_TailSeen; //!< Owner's copy of PWM_Tail, only refreshed when the ring looks full.
+    alignas( PWM_CACHE_LINE ) atomic< uint64_t > PWM_Tail; //!< Events drained, stored by the drain.
+    uint64_t PWM_LostSeen; //!< Drain's copy of PWM_Lost as of its last PWM_TRACE_LOST event.
+    alignas( PWM_CACHE_LINE ) atomic< bool > PWM_Owned; //!< True while a live thread records into this ring.
+    uint16_t PWM_Index; //!< Position in BBBPWMTrace::PWM_Rings, recorded as PWM_Thread.
+    BBBPWMTraceEvent PWM_Events[ PWM_TRACE_RING ]; //!< The events, indexed by count % PWM_TRACE_RING.
+};
+
+/*!
+ *  \brief     BBBPWMTrace records when each value was requested, clamped and written, for every device, to a binary file.
+ *  \details   Always compiled in, and off until PWM_Start( ) : every device calls PWM_Record( ), which costs one
+ *             relaxed load while tracing is off. While it is on, each thread writes 24 byte events into its own ring
+ *             (no lock, no system call, a full ring drops the event and counts it) and a drain thread empties the rings
+ *             into the file every PWM_TRACE_DRAIN_NS. tools/BBBPWMTraceDecode turns the file into CSV and latency
+ *             summaries. Usage :
+ *             \code
+ *             BBBPWMTrace::PWM_Start( "/tmp/pwm.trace" );
+ *             ...
+ *             BBBPWMTrace::PWM_Stop( );   // drains what is left and closes the file
+ *             \endcode
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMTrace {
+public:
+
+    /**
+     \fn public static function int PWM_Start( const char* Path )
+     \brief Creates (or truncates) the trace file, starts the drain thread and turns recording on.
+     \param const <char>* Path
+     \return <int> -1 already tracing or failure to create the file or the thread, 1 success.
+     */
+    static int PWM_Start( const char* Path );
+
+    /**
+     \fn public static function void PWM_Stop( void )
+     \brief Turns recording off, drains what is left and closes the file. Safe to call when not tracing.
+     \param <void>
+     \return <void>
+     */
+    static void PWM_Stop( void );
+
+    /**
+     \fn public static function bool PWM_IsEnabled( void )
+     \brief Checks whether events are being recorded.
+     \param <void>
+     \return <bool> PWM_Enabled
+     */
+    static bool PWM_IsEnabled( void ) {
+        return PWM_Enabled.load( memory_order_relaxed );
+    }
+
+    /**
+     \fn public static function int PWM_Attach( void )
+     \brief Takes the calling thread's ring now rather than on its first event, and faults it in, so that a real-time
+     thread never allocates or waits on the ring lock once it is running. Works whether tracing is on or not.
+     \param <void>
+     \return <int> -1 PWM_TRACE_THREADS rings are in use, 1 success.
+     */
+    static int PWM_Attach( void );
+
+    /**
+     \fn public static function void PWM_Record( PWM_TraceType Type, int Attr, int Block, int Pin, int Value, int Errno )
+     \brief Records an event if tracing is on. Lock-free and never blocks, callable from any thread.
+     \param <PWM_TraceType> Type
+     \param <int> Attr
+     \param <int> Block
+     \param <int> Pin
+     \param <int> Value
+     \param <int> Errno
+     \return <void>
+     */
+    static void PWM_Record( PWM_TraceType Type, int Attr, int Block, int Pin, int Value, int Errno ) {
+        if( PWM_Enabled.load( memory_order_relaxed ) )
+            PWM_Push( Type, Attr, Block, Pin, Value, Errno );
+    }
+
+    /**
+     \fn public static function uint64_t PWM_GetWritten( void )
+     \brief Returns the number of events written to the file by the current (or last) trace.
+     \param <void>
+     \return <uint64_t> PWM_Written
+     */
+    static uint64_t PWM_GetWritten( void );
+
+    /**
+     \fn public static function uint64_t PWM_GetLost( void )
+     \brief Returns the number of events dropped by the current (or last) trace, full rings and threads beyond PWM_TRACE_THREADS.
+     \param <void>
+     \return <uint64_t> events
+     */
+    static uint64_t PWM_GetLost( void );
+
+private:
+
+    static atomic< bool > PWM_Enabled; //!< Recording on, checked by every PWM_Record( ).
+    static atomic< BBBPWMTraceRing* > PWM_Rings[ PWM_TRACE_THREADS ]; //!< Every ring ever handed to a thread, kept for the process.
+    static atomic< int > PWM_RingCount; //!< Used entries of PWM_Rings.
+    static atomic< uint64_t > PWM_Unringed; //!< Events dropped because no ring was left.
+    static atomic< uint64_t > PWM_Written; //!< Events written to the file.
+    static atomic< uint64_t > PWM_Lost; //!< Events dropped, as reported in the file.
+    static pthread_mutex_t PWM_RingLock; //!< Serialises threads taking a ring, never held by PWM_Record( ) after that.
+    static pthread_mutex_t PWM_StartLock; //!< Serialises PWM_Start( ) and PWM_Stop( ).
+    static pthread_t PWM_Drain; //!< The drain thread.
+    static atomic< bool > PWM_DrainStop; //!< Set by PWM_Stop( ) to make the drain thread exit.
+    static int PWM_FD; //!< The trace file, -1 when not tracing.
+
+    /**
+     \fn private static function void PWM_Push( PWM_TraceType PWM_Type, int PWM_Attr, int PWM_Block, int PWM_Pin, int PWM_Value, int PWM_Errno )
+     \brief Stamps an event and stores it in the calling thread's ring, taking one on the thread's first event.
+     \return <void>
+     */
+    static void PWM_Push( PWM_TraceType PWM_Type, int PWM_Attr, int PWM_Block, int PWM_Pin, int PWM_Value, int PWM_Errno );
+
+    /**
+     \fn private static function BBBPWMTraceRing* PWM_TakeRing( void )
+     \brief Hands the calling thread a ring : one left empty by a thread that has exited, or a new one.
+     \param <void>
+     \return <BBBPWMTraceRing>* NULL if PWM_TRACE_THREADS rings are in use.
+     */
+    static BBBPWMTraceRing* PWM_TakeRing( void );
+
+    /**
+     \fn private static function int PWM_DrainOnce( void )
+     \brief Moves every ring's pending events, and a PWM_TRACE_LOST event for any new drops, into the file.
+     \param <void>
+     \return <int> -1 failure to write the file, 1 success.
+     */
+    static int PWM_DrainOnce( void );
+
+    /**
+     \fn private static function void* PWM_Run( void* PWM_Arg )
+     \brief Drain thread : PWM_DrainOnce( ) every PWM_TRACE_DRAIN_NS until PWM_Stop( ).
+     \param <void>* PWM_Arg
+     \return <void> 0.
+     */
+    static void* PWM_Run( void* PWM_Arg );
+
+    friend struct BBBPWMTraceSlot;
+};
+
+#endif /* BBBPWMTrace_h */
@@ -0,0 +1,524 @@
+//
+//  BBBPWMUringBackend.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMUringBackend.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static_assert( alignof( BBBPWMUringBackend ) >= 4, "the attribute is kept in the low bits of the backend pointer" );
+
+// One ring per writer thread : a pass only ever batches the writes of the thread running it.
+static thread_local BBBPWMUring PWM_ThreadRing;
+static thread_local bool PWM_ThreadTried = false; //!< PWM_Setup( ) attempted on this thread.
+static thread_local bool PWM_ThreadBatching = false; //!< Between PWM_BatchBegin( ) and PWM_BatchEnd( ).
+static thread_local int PWM_ThreadFailed = 0; //!< Failures reaped since the last PWM_BatchBegin( ) / PWM_BatchEnd( ).
+static atomic< uint64_t > PWM_EnterCount( 0 );
+
+// Constructed once the ring is, so it is destroyed first : hands the last completions to their backends on thread exit.
+struct BBBPWMUringThreadExit {
+    bool PWM_Armed;
+    BBBPWMUringThreadExit( ) : PWM_Armed( false ) { }
+    ~BBBPWMUringThreadExit( ) {
+        if( this->PWM_Armed )
+            BBBPWMUringBackend::PWM_BatchWait( );
+    }
+};
+static thread_local BBBPWMUringThreadExit PWM_ThreadExit;
+
+/**
+ \brief BBBPWMUring : Nothing is created until PWM_Setup( ).
+ \param <void>
+ */
+BBBPWMUring::BBBPWMUring( ) {
+    this->PWM_RingFD = -1;
+    this->PWM_Queued = 0;
+    this->PWM_InFlight = 0;
+    this->PWM_LastQueued = 0;
+    this->PWM_SqRing = this->PWM_CqRing = MAP_FAILED;
+    this->PWM_Sqes = ( struct io_uring_sqe* ) MAP_FAILED;
+    this->PWM_SqRingSize = this->PWM_CqRingSize = this->PWM_SqesSize = 0;
+}
+
+/**
+ \brief ~BBBPWMUring : Waits for writes still in flight (their buffers belong to the caller), then closes the ring.
+ */
+BBBPWMUring::~BBBPWMUring( ) {
+    if( this->PWM_RingFD < 0 )
+        return;
+    uint64_t PWM_UserData;
+    int PWM_Result;
+    while( this->PWM_Queued + this->PWM_InFlight > 0 && this->PWM_Submit( this->PWM_InFlight > 0 ? 1 : 0 ) >= 0 )
+        while( this->PWM_Reap( PWM_UserData, PWM_Result ) );
+    this->PWM_Unmap( );
+}
+
+/**
+ \fn public function int PWM_Setup( unsigned Entries )
+ \brief Creates the ring and maps its queues.
+ \param <unsigned> Entries (submission queue size)
+ \return <int> -1 io_uring unavailable (errno set), 1 success.
+ */
+int BBBPWMUring::PWM_Setup( unsigned Entries ) {
+    struct io_uring_params PWM_Params;
+    memset( &PWM_Params, 0, sizeof( PWM_Params ) );
+    // SUBMIT_ALL (5.18) keeps going past an entry that fails to prepare, so one bad descriptor cannot hold back other channels.
+    PWM_Params.flags = IORING_SETUP_SUBMIT_ALL;
+    this->PWM_RingFD = syscall( __NR_io_uring_setup, Entries, &PWM_Params );
+    if( this->PWM_RingFD < 0 && errno == EINVAL ) {
+        memset( &PWM_Params, 0, sizeof( PWM_Params ) );
+        this->PWM_RingFD = syscall( __NR_io_uring_setup, Entries, &PWM_Params );
+    }
+    if( this->PWM_RingFD < 0 )
+        return -1;
+
+    this->PWM_SqRingSize = PWM_Params.sq_off.array + PWM_Params.sq_entries * sizeof( unsigned );
+    this->PWM_CqRingSize = PWM_Params.cq_off.cqes + PWM_Params.cq_entries * sizeof( struct io_uring_cqe );
+    bool PWM_Single = ( PWM_Params.features & IORING_FEAT_SINGLE_MMAP ) != 0;
+    if( PWM_Single )
+        this->PWM_SqRingSize = this->PWM_CqRingSize = max( this->PWM_SqRingSize, this->PWM_CqRingSize );
+    // Populated up front, the writer never takes a page fault on the rings.
+    this->PWM_SqRing = mmap( NULL, this->PWM_SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->PWM_RingFD, IORING_OFF_SQ_RING );
+    this->PWM_CqRing = PWM_Single ? this->PWM_SqRing
+        : mmap( NULL, this->PWM_CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->PWM_RingFD, IORING_OFF_CQ_RING );
+    this->PWM_SqesSize = PWM_Params.sq_entries * sizeof( struct io_uring_sqe );
+    this->PWM_Sqes = ( struct io_uring_sqe* ) mmap( NULL, this->PWM_SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->PWM_RingFD, IORING_OFF_SQES );
+    if( this->PWM_SqRing == MAP_FAILED || this->PWM_CqRing == MAP_FAILED || this->PWM_Sqes == MAP_FAILED ) {
+        int PWM_Errno = errno;
+        this->PWM_Unmap( );
+        errno = PWM_Errno;
+        return -1;
+    }
+
+    char* PWM_Sq = ( char* ) this->PWM_SqRing;
+    char* PWM_Cq = ( char* ) this->PWM_CqRing;
+    this->PWM_SqHead = ( unsigned* )( PWM_Sq + PWM_Params.sq_off.head );
+    this->PWM_SqTail = ( unsigned* )( PWM_Sq + PWM_Params.sq_off.tail );
+    this->PWM_SqMask = *( unsigned* )( PWM_Sq + PWM_Params.sq_off.ring_mask );
+    this->PWM_SqEntries = PWM_Params.sq_entries;
+    this->PWM_CqHead = ( unsigned* )( PWM_Cq + PWM_Params.cq_off.head );
+    this->PWM_CqTail = ( unsigned* )( PWM_Cq + PWM_Params.cq_off.tail );
+    this->PWM_CqMask = *( unsigned* )( PWM_Cq + PWM_Params.cq_off.ring_mask );
+    this->PWM_Cqes = ( struct io_uring_cqe* )( PWM_Cq + PWM_Params.cq_off.cqes );
+    // Slot i always points at entry i, PWM_Queue( ) then only has to fill the entry and bump the tail.
+    unsigned* PWM_Array = ( unsigned* )( PWM_Sq + PWM_Params.sq_off.array );
+    for( unsigned i = 0; i < this->PWM_SqEntries; i++ )
+        PWM_Array[ i ] = i;
+    return 1;
+}
+
+/**
+ \fn private function void PWM_Unmap( void )
+ \brief Unmaps the queues and closes the ring.
+ \param <void>
+ \return <void>
+ */
+void BBBPWMUring::PWM_Unmap( void ) {
+    if( this->PWM_Sqes != MAP_FAILED )
+        munmap( this->PWM_Sqes, this->PWM_SqesSize );
+    if( this->PWM_CqRing != MAP_FAILED && this->PWM_CqRing != this->PWM_SqRing )
+        munmap( this->PWM_CqRing, this->PWM_CqRingSize );
+    if( this->PWM_SqRing != MAP_FAILED )
+        munmap( this->PWM_SqRing, this->PWM_SqRingSize );
+    if( this->PWM_RingFD >= 0 )
+        close( this->PWM_RingFD );
+    this->PWM_SqRing = this->PWM_CqRing = MAP_FAILED;
+    this->PWM_Sqes = ( struct io_uring_sqe* ) MAP_FAILED;
+    this->PWM_RingFD = -1;
+}
+
+/**
+ \fn public function bool PWM_IsReady( void ) const
+ \brief Checks whether PWM_Setup( ) succeeded.
+ \param <void>
+ \return <bool>
+ */
+bool BBBPWMUring::PWM_IsReady( void ) const {
+    return this->PWM_RingFD >= 0;
+}
+
+/**
+ \fn public function int PWM_GetFD( void ) const
+ \brief Returns the ring descriptor, readable while completions wait to be reaped.
+ \param <void>
+ \return <int> this->PWM_RingFD
+ */
+int BBBPWMUring::PWM_GetFD( void ) const {
+    return this->PWM_RingFD;
+}
+
+/**
+ \fn public function int PWM_Queue( int FD, const char* Buffer, unsigned Len, uint64_t UserData, bool Link )
+ \brief Queues a write of Buffer at offset 0 of FD. Buffer must stay untouched until the write completes.
+ \param <int> FD
+ \param const <char>* Buffer
+ \param <unsigned> Len
+ \param <uint64_t> UserData (handed back by PWM_Reap( ))
+ \param <bool> Link (only start once the write queued just before has completed)
+ \return <int> 0 submission queue full, 1 queued.
+ */
+int BBBPWMUring::PWM_Queue( int FD, const char* Buffer, unsigned Len, uint64_t UserData, bool Link ) {
+    unsigned PWM_Tail = *this->PWM_SqTail;
+    if( PWM_Tail - __atomic_load_n( this->PWM_SqHead, __ATOMIC_ACQUIRE ) >= this->PWM_SqEntries )
+        return 0;
+    if( Link && this->PWM_Queued > 0 )
+        this->PWM_Sqes[ ( PWM_Tail - 1 ) & this->PWM_SqMask ].flags |= IOSQE_IO_LINK;
+
+    struct io_uring_sqe* PWM_Sqe = &this->PWM_Sqes[ PWM_Tail & this->PWM_SqMask ];
+    memset( PWM_Sqe, 0, sizeof( *PWM_Sqe ) );
+    PWM_Sqe->opcode = IORING_OP_WRITE;
+    PWM_Sqe->fd = FD;
+    PWM_Sqe->addr = ( uintptr_t ) Buffer;
+    PWM_Sqe->len = Len;
+    PWM_Sqe->off = 0;
+    PWM_Sqe->user_data = UserData;
+    // Release : the kernel sees a filled entry once it sees the new tail.
+    __atomic_store_n( this->PWM_SqTail, PWM_Tail + 1, __ATOMIC_RELEASE );
+    this->PWM_Queued++;
+    this->PWM_LastQueued = UserData;
+    return 1;
+}
+
+/**
+ \fn public function int PWM_Submit( unsigned WaitFor )
+ \brief Submits everything queued with one io_uring_enter( ), then waits until at least WaitFor completions are ready.
+ \param <unsigned> WaitFor (0 returns straight away)
+ \return <int> -1 failed (errno set, the writes stay queued), >= 0 number of writes submitted.
+ */
+int BBBPWMUring::PWM_Submit( unsigned WaitFor ) {
+    while( 1 ) {
+        PWM_EnterCount.fetch_add( 1, memory_order_relaxed );
+        int PWM_Ret = syscall( __NR_io_uring_enter, this->PWM_RingFD, this->PWM_Queued, WaitFor, WaitFor > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+        if( PWM_Ret >= 0 ) {
+            this->PWM_Queued -= PWM_Ret;
+            this->PWM_InFlight += PWM_Ret;
+            if( this->PWM_Queued == 0 )
+                this->PWM_LastQueued = 0;
+            return PWM_Ret;
+        }
+        if( errno != EINTR )
+            return -1;
+    }
+}
+
+/**
+ \fn public function bool PWM_Reap( uint64_t& UserData, int& Result )
+ \brief Takes one completion off the ring, no syscall.
+ \param <uint64_t>& UserData
+ \param <int>& Result (bytes written, or -errno)
+ \return <bool> false if none is ready.
+ */
+bool BBBPWMUring::PWM_Reap( uint64_t& UserData, int& Result ) {
+    unsigned PWM_Head = *this->PWM_CqHead;
+    // Acquire pairs with the kernel's tail store, the entry below is complete.
+    if( PWM_Head == __atomic_load_n( this->PWM_CqTail, __ATOMIC_ACQUIRE ) )
+        return false;
+    struct io_uring_cqe* PWM_Cqe = &this->PWM_Cqes[ PWM_Head & this->PWM_CqMask ];
+    UserData = PWM_Cqe->user_data;
+    Result = PWM_Cqe->res;
+    __atomic_store_n( this->PWM_CqHead, PWM_Head + 1, __ATOMIC_RELEASE );
+    this->PWM_InFlight--;
+    return true;
+}
+
+/**
+ \fn public function uint64_t PWM_GetLastQueued( void ) const
+ \brief Returns the user data of the last write queued since the last submit, 0 if none.
+ \param <void>
+ \return <uint64_t> this->PWM_LastQueued
+ */
+uint64_t BBBPWMUring::PWM_GetLastQueued( void ) const {
+    return this->PWM_LastQueued;
+}
+
+/**
+ \fn public function unsigned PWM_GetQueued( void ) const
+ \brief Returns the number of writes queued but not submitted yet.
+ \param <void>
+ \return <unsigned> this->PWM_Queued
+ */
+unsigned BBBPWMUring::PWM_GetQueued( void ) const {
+    return this->PWM_Queued;
+}
+
+/**
+ \fn public function unsigned PWM_GetInFlight( void ) const
+ \brief Returns the number of writes submitted whose completion has not been reaped yet.
+ \param <void>
+ \return <unsigned> this->PWM_InFlight
+ */
+unsigned BBBPWMUring::PWM_GetInFlight( void ) const {
+    return this->PWM_InFlight;
+}
+
+/**
+ \brief BBBPWMUringBackend : Nothing is opened until PWM_Attach( ).
+ \param <void>
+ */
+BBBPWMUringBackend::BBBPWMUringBackend( ) {
+    for( int a = 0; a < PWM_ATTRS; a++ ) {
+        this->PWM_PendingLen[ a ] = 0;
+        this->PWM_PendingValue[ a ] = 0;
+        this->PWM_PendingPrior[ a ] = 0;
+        this->PWM_InFlight[ a ] = false;
+        this->PWM_FailErrno[ a ] = 0;
+        this->PWM_FailValue[ a ] = 0;
+        this->PWM_Last[ a ] = 0;
+    }
+    this->PWM_Owner = NULL;
+}
+
+/**
+ \brief ~BBBPWMUringBackend : Waits for its writes still in flight, the kernel reads their text from this object.
+ Destroy it on the thread that batched its writes, or once that thread has exited.
+ */
+BBBPWMUringBackend::~BBBPWMUringBackend( ) {
+    for( int a = 0; a < PWM_ATTRS; a++ )
+        if( this->PWM_InFlight[ a ] && this->PWM_Owner == &PWM_ThreadRing ) {
+            PWM_BatchWait( );
+            break;
+        }
+}
+
+/**
+ \fn public static function int PWM_AttachAll( const vector< BBBPWMUringBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+ \brief BBBPWMSysfsBackend::PWM_AttachAll( ) for io_uring outputs, the pins are found and opened the same way.
+ \param const <vector<BBBPWMUringBackend*>>& Outputs
+ \param const <vector<int>>& Blocks
+ \param const <vector<int>>& Pins
+ \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+ \return <int> number of outputs attached.
+ */
+int BBBPWMUringBackend::PWM_AttachAll( const vector< BBBPWMUringBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status ) {
+    vector< BBBPWMSysfsBackend* > PWM_Outputs( Outputs.begin( ), Outputs.end( ) );
+    return BBBPWMSysfsBackend::PWM_AttachAll( PWM_Outputs, Blocks, Pins, Status );
+}
+
+/**
+ \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+ \brief Reads a decimal value like BBBPWMSysfsBackend and remembers it as the value the attribute holds.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value (only written on success)
+ \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+ */
+int BBBPWMUringBackend::PWM_Read( PWM_Attribute Attr, int& Value ) {
+    int PWM_Ret = BBBPWMSysfsBackend::PWM_Read( Attr, Value );
+    if( PWM_Ret > 0 )
+        this->PWM_Last[ Attr ] = Value;
+    return PWM_Ret;
+}
+
+/**
+ \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+ \brief Queues the write inside a batch opened by this thread, otherwise writes it with pwrite( ) straight away.
+ \param <PWM_Attribute> Attr
+ \param <int> Value
+ \return <int> -1 failed to open, 0 failed to write (errno set), 1 success or queued.
+ */
+int BBBPWMUringBackend::PWM_Write( PWM_Attribute Attr, int Value ) {
+    BBBPWMUring& PWM_Ring = PWM_ThreadRing;
+    // One write per attribute in flight : its buffer is reused and a later value must not overtake it.
+    if( PWM_ThreadBatching && this->PWM_InFlight[ Attr ] && this->PWM_WaitFor( PWM_Ring, Attr ) < 0 )
+        cerr << "Error - unable to wait for a queued PWM write : " << strerror( errno ) << endl;
+    if( !PWM_ThreadBatching || this->PWM_InFlight[ Attr ] ) {
+        int PWM_Ret = BBBPWMSysfsBackend::PWM_Write( Attr, Value );
+        if( PWM_Ret > 0 )
+            this->PWM_Last[ Attr ] = Value;
+        return PWM_Ret;
+    }
+
+    int PWM_FD = this->PWM_OpenAttr( Attr );
+    if( PWM_FD < 0 )
+        return -1;
+    int PWM_Len = PWM_FormatDecimal( Value, this->PWM_Pending[ Attr ] );
+    uint64_t PWM_Tag = ( uintptr_t ) this | ( uint64_t ) Attr;
+    // Only a duty right behind its channel's period is chained, it must not land before the period it was checked
+    // against. Anything else stands alone : a failed run write must not cancel the duty after it.
+    bool PWM_Link = Attr == PWM_ATTR_DUTY && PWM_Ring.PWM_GetLastQueued( ) == ( ( uintptr_t ) this | ( uint64_t ) PWM_ATTR_PERIOD );
+    if( !PWM_Ring.PWM_Queue( PWM_FD, this->PWM_Pending[ Attr ], PWM_Len, PWM_Tag, PWM_Link ) ) {
+        // Full : push out what is queued so far, the kernel frees the slots as it consumes them.
+        if( PWM_Ring.PWM_Submit( 0 ) < 0 || !PWM_Ring.PWM_Queue( PWM_FD, this->PWM_Pending[ Attr ], PWM_Len, PWM_Tag, false ) ) {
+            int PWM_Ret = BBBPWMSysfsBackend::PWM_Write( Attr, Value );
+            if( PWM_Ret > 0 )
+                this->PWM_Last[ Attr ] = Value;
+            return PWM_Ret;
+        }
+    }
+    this->PWM_PendingLen[ Attr ] = PWM_Len;
+    this->PWM_PendingValue[ Attr ] = Value;
+    this->PWM_PendingPrior[ Attr ] = this->PWM_Last[ Attr ];
+    this->PWM_InFlight[ Attr ] = true;
+    this->PWM_Owner = &PWM_Ring;
+    this->PWM_Last[ Attr ] = Value;
+    return 1;
+}
+
+/**
+ \fn private function int PWM_WaitFor( BBBPWMUring& Ring, PWM_Attribute Attr )
+ \brief Submits and waits until the write in flight to Attr has completed, its buffer is then free again.
+ \param <BBBPWMUring>& Ring
+ \param <PWM_Attribute> Attr
+ \return <int> -1 unable to wait (errno set), 1 success.
+ */
+int BBBPWMUringBackend::PWM_WaitFor( BBBPWMUring& Ring, PWM_Attribute Attr ) {
+    PWM_ReapAll( Ring );
+    while( this->PWM_InFlight[ Attr ] ) {
+        if( Ring.PWM_Submit( 1 ) < 0 )
+            return -1;
+        PWM_ReapAll( Ring );
+    }
+    return 1;
+}
+
+/**
+ \fn private function int PWM_Complete( PWM_Attribute Attr, int Result )
+ \brief Records the completion of the write in flight to Attr.
+ \param <PWM_Attribute> Attr
+ \param <int> Result (bytes written, or -errno)
+ \return <int> 0 success, 1 the write failed.
+ */
+int BBBPWMUringBackend::PWM_Complete( PWM_Attribute Attr, int Result ) {
+    this->PWM_InFlight[ Attr ] = false;
+    if( Result == this->PWM_PendingLen[ Attr ] )
+        return 0;
+    // Short writes count as EIO like in BBBPWMSysfsBackend, -ECANCELED means the period a duty was linked to failed.
+    int PWM_Errno = Result < 0 ? -Result : EIO;
+    if( PWM_Errno == EBADF || PWM_Errno == ENODEV ) {
+        // The attribute went away underneath us (overlay reloaded), the retry reopens it.
+        close( this->PWM_FD[ Attr ] );
+        this->PWM_FD[ Attr ] = -1;
+    }
+    this->PWM_FailErrno[ Attr ] = PWM_Errno;
+    this->PWM_FailValue[ Attr ] = this->PWM_PendingPrior[ Attr ];
+    this->PWM_Last[ Attr ] = this->PWM_PendingPrior[ Attr ];
+    return 1;
+}
+
+/**
+ \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+ \brief Hands back (once) the failure of a queued write to Attr that has been reaped since the last call.
+ \param <PWM_Attribute> Attr
+ \param <int>& Value (set to the value the attribute is left holding)
+ \return <int> 0 no failure, > 0 the errno of the write.
+ */
+int BBBPWMUringBackend::PWM_TakeError( PWM_Attribute Attr, int& Value ) {
+    int PWM_Errno = this->PWM_FailErrno[ Attr ];
+    if( PWM_Errno == 0 )
+        return 0;
+    this->PWM_FailErrno[ Attr ] = 0;
+    // A newer write queued since the failure decides what the attribute ends up holding.
+    Value = this->PWM_InFlight[ Attr ] ? this->PWM_PendingValue[ Attr ] : this->PWM_FailValue[ Attr ];
+    return PWM_Errno;
+}
+
+/**
+ \fn private static function void PWM_ReapAll( BBBPWMUring& Ring )
+ \brief Reaps every completion ready on Ring and hands it to the backend that queued it, counting failures.
+ \param <BBBPWMUring>& Ring
+ \return <void>
+ */
+void BBBPWMUringBackend::PWM_ReapAll( BBBPWMUring& Ring ) {
+    uint64_t PWM_Tag;
+    int PWM_Result;
+    while( Ring.PWM_Reap( PWM_Tag, PWM_Result ) ) {
+        BBBPWMUringBackend* PWM_Backend = ( BBBPWMUringBackend* )( uintptr_t )( PWM_Tag & ~( uint64_t ) 3 );
+        PWM_ThreadFailed += PWM_Backend->PWM_Complete( ( PWM_Attribute )( PWM_Tag & 3 ), PWM_Result );
+    }
+}
+
+/**
+ \fn public static function bool PWM_IsAvailable( void )
+ \brief Checks whether the calling thread can batch through io_uring, creating its ring if it has none yet.
+ \param <void>
+ \return <bool> false if writes fall back to pwrite( ).
+ */
+bool BBBPWMUringBackend::PWM_IsAvailable( void ) {
+    if( !PWM_ThreadTried ) {
+        PWM_ThreadTried = true;
+        if( PWM_ThreadRing.PWM_Setup( PWM_URING_ENTRIES ) > 0 )
+            PWM_ThreadExit.PWM_Armed = true;
+    }
+    return PWM_ThreadRing.PWM_IsReady( );
+}
+
+/**
+ \fn public static function int PWM_BatchBegin( void )
+ \brief Opens a batch on the calling thread, creating its ring on first use, and reaps completions of earlier batches.
+ \param <void>
+ \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+ */
+int BBBPWMUringBackend::PWM_BatchBegin( void ) {
+    if( !PWM_IsAvailable( ) )
+        return 0;
+    PWM_ReapAll( PWM_ThreadRing );
+    PWM_ThreadBatching = true;
+    int PWM_Failed = PWM_ThreadFailed;
+    PWM_ThreadFailed = 0;
+    return PWM_Failed;
+}
+
+/**
+ \fn public static function int PWM_BatchEnd( void )
+ \brief Submits everything queued since PWM_BatchBegin( ) with one io_uring_enter( ), then reaps whatever has already completed.
+ \param <void>
+ \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+ */
+int BBBPWMUringBackend::PWM_BatchEnd( void ) {
+    if( !PWM_ThreadBatching )
+        return 0;
+    PWM_ThreadBatching = false;
+    if( PWM_ThreadRing.PWM_GetQueued( ) > 0 && PWM_ThreadRing.PWM_Submit( 0 ) < 0 )
+        cerr << "Error - unable to submit queued PWM writes, retrying on the next pass : " << strerror( errno ) << endl;
+    // Writes the kernel could finish inline are already there, the rest wake the writer through PWM_BatchFD( ).
+    PWM_ReapAll( PWM_ThreadRing );
+    int PWM_Failed = PWM_ThreadFailed;
+    PWM_ThreadFailed = 0;
+    return PWM_Failed;
+}
+
+/**
+ \fn public static function int PWM_BatchWait( void )
+ \brief Submits whatever the calling thread has queued and waits until all its writes have completed. Runs on its own
+ when the thread exits, so a backend never outlives the ring its writes are on.
+ \param <void>
+ \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+ */
+int BBBPWMUringBackend::PWM_BatchWait( void ) {
+    BBBPWMUring& PWM_Ring = PWM_ThreadRing;
+    PWM_ReapAll( PWM_Ring );
+    while( PWM_Ring.PWM_GetQueued( ) + PWM_Ring.PWM_GetInFlight( ) > 0 ) {
+        if( PWM_Ring.PWM_Submit( PWM_Ring.PWM_GetInFlight( ) > 0 ? 1 : 0 ) < 0 ) {
+            cerr << "Error - unable to wait for queued PWM writes : " << strerror( errno ) << endl;
+            break;
+        }
+        PWM_ReapAll( PWM_Ring );
+    }
+    int PWM_Failed = PWM_ThreadFailed;
+    PWM_ThreadFailed = 0;
+    return PWM_Failed;
+}
+
+/**
+ \fn public static function int PWM_BatchFD( void )
+ \brief Returns the calling thread's ring descriptor, readable while completions wait to be reaped.
+ \param <void>
+ \return <int> -1 no ring (not created yet or io_uring unavailable), >= 0 the descriptor.
+ */
+int BBBPWMUringBackend::PWM_BatchFD( void ) {
+    return PWM_ThreadRing.PWM_GetFD( );
+}
+
+/**
+ \fn public static function uint64_t PWM_GetEnterCount( void )
+ \brief Returns the number of io_uring_enter( ) calls made by every thread since the program started.
+ \param <void>
+ \return <uint64_t>
+ */
+uint64_t BBBPWMUringBackend::PWM_GetEnterCount( void ) {
+    return PWM_EnterCount.load( memory_order_relaxed );
+}
@@ -0,0 +1,312 @@
+//
+//  BBBPWMUringBackend.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#ifndef BBBPWMUringBackend_h
+#define BBBPWMUringBackend_h
+
+#define PWM_URING_ENTRIES      64 //!< Submission queue size, two attributes for 32 channels fit in one pass.
+
+#include <atomic>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+#include "BBBPWMSysfsBackend.h"
+
+using namespace std;
+
+/*!
+ *  \brief     BBBPWMUring is a minimal io_uring instance driven with the raw syscalls, no liburing required.
+ *  \details   Only what BBBPWMUringBackend needs : queue pwrite( ) style writes, submit them with one io_uring_enter( )
+ *             and reap completions from the shared ring without a syscall. Not thread safe, one instance per thread.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMUring {
+public:
+
+    /**
+     \fn public function int PWM_Setup( unsigned Entries )
+     \brief Creates the ring and maps its queues.
+     \param <unsigned> Entries (submission queue size)
+     \return <int> -1 io_uring unavailable (errno set), 1 success.
+     */
+    int PWM_Setup( unsigned Entries );
+
+    /**
+     \fn public function bool PWM_IsReady( void ) const
+     \brief Checks whether PWM_Setup( ) succeeded.
+     \param <void>
+     \return <bool>
+     */
+    bool PWM_IsReady( void ) const;
+
+    /**
+     \fn public function int PWM_GetFD( void ) const
+     \brief Returns the ring descriptor, readable while completions wait to be reaped.
+     \param <void>
+     \return <int> this->PWM_RingFD
+     */
+    int PWM_GetFD( void ) const;
+
+    /**
+     \fn public function int PWM_Queue( int FD, const char* Buffer, unsigned Len, uint64_t UserData, bool Link )
+     \brief Queues a write of Buffer at offset 0 of FD. Buffer must stay untouched until the write completes.
+     \param <int> FD
+     \param const <char>* Buffer
+     \param <unsigned> Len
+     \param <uint64_t> UserData (handed back by PWM_Reap( ))
+     \param <bool> Link (only start once the write queued just before has completed)
+     \return <int> 0 submission queue full, 1 queued.
+     */
+    int PWM_Queue( int FD, const char* Buffer, unsigned Len, uint64_t UserData, bool Link );
+
+    /**
+     \fn public function int PWM_Submit( unsigned WaitFor )
+     \brief Submits everything queued with one io_uring_enter( ), then waits until at least WaitFor completions are ready.
+     \param <unsigned> WaitFor (0 returns straight away)
+     \return <int> -1 failed (errno set, the writes stay queued), >= 0 number of writes submitted.
+     */
+    int PWM_Submit( unsigned WaitFor );
+
+    /**
+     \fn public function bool PWM_Reap( uint64_t& UserData, int& Result )
+     \brief Takes one completion off the ring, no syscall.
+     \param <uint64_t>& UserData
+     \param <int>& Result (bytes written, or -errno)
+     \return <bool> false if none is ready.
+     */
+    bool PWM_Reap( uint64_t& UserData, int& Result );
+
+    /**
+     \fn public function uint64_t PWM_GetLastQueued( void ) const
+     \brief Returns the user data of the last write queued since the last submit, 0 if none.
+     \param <void>
+     \return <uint64_t> this->PWM_LastQueued
+     */
+    uint64_t PWM_GetLastQueued( void ) const;
+
+    /**
+     \fn public function unsigned PWM_GetQueued( void ) const
+     \brief Returns the number of writes queued but not submitted yet.
+     \param <void>
+     \return <unsigned> this->PWM_Queued
+     */
+    unsigned PWM_GetQueued( void ) const;
+
+    /**
+     \fn public function unsigned PWM_GetInFlight( void ) const
+     \brief Returns the number of writes submitted whose completion has not been reaped yet.
+     \param <void>
+     \return <unsigned> this->PWM_InFlight
+     */
+    unsigned PWM_GetInFlight( void ) const;
+
+    /**
+     \brief BBBPWMUring : Nothing is created until PWM_Setup( ).
+     \param <void>
+     */
+    BBBPWMUring( );
+
+    /**
+     \brief ~BBBPWMUring : Waits for writes still in flight (their buffers belong to the caller), then closes the ring.
+     */
+    ~BBBPWMUring( );
+
+protected:
+
+    int PWM_RingFD; //!< io_uring descriptor, -1 until PWM_Setup( ).
+    unsigned PWM_Queued; //!< Writes queued since the last submit.
+    unsigned PWM_InFlight; //!< Writes submitted and not reaped yet.
+    uint64_t PWM_LastQueued; //!< User data of the last write queued since the last submit.
+
+    void* PWM_SqRing; //!< Mapped submission ring.
+    size_t PWM_SqRingSize; //!< Size of PWM_SqRing.
+    void* PWM_CqRing; //!< Mapped completion ring, the same mapping as PWM_SqRing with IORING_FEAT_SINGLE_MMAP.
+    size_t PWM_CqRingSize; //!< Size of PWM_CqRing.
+    struct io_uring_sqe* PWM_Sqes; //!< Mapped submission entries.
+    size_t PWM_SqesSize; //!< Size of PWM_Sqes.
+
+    unsigned* PWM_SqHead; //!< Advanced by the kernel as it consumes entries.
+    unsigned* PWM_SqTail; //!< Advanced by us as we queue entries.
+    unsigned PWM_SqMask; //!< Submission ring index mask.
+    unsigned PWM_SqEntries; //!< Submission ring size.
+    unsigned* PWM_CqHead; //!< Advanced by us as we reap completions.
+    unsigned* PWM_CqTail; //!< Advanced by the kernel as it posts completions.
+    unsigned PWM_CqMask; //!< Completion ring index mask.
+    struct io_uring_cqe* PWM_Cqes; //!< Completion entries.
+
+    /**
+     \fn private function void PWM_Unmap( void )
+     \brief Unmaps the queues and closes the ring.
+     \param <void>
+     \return <void>
+     */
+    void PWM_Unmap( void );
+};
+
+/*!
+ *  \brief     BBBPWMUringBackend writes to the same pwm_test_ files as BBBPWMSysfsBackend, but batches the writer thread's writes through io_uring.
+ *  \details   Between PWM_BatchBegin( ) and PWM_BatchEnd( ) (a BBBPWMController pass) PWM_Write( ) only queues the value,
+ *             so every duty, period and run write of every dirty channel goes out with a single io_uring_enter( ) when the
+ *             pass ends. A duty queued right after the same channel's period is linked to it and lands after it, other
+ *             writes are independent so one failing cancels nothing else. Completions are reaped from the ring
+ *             at the end of the pass and at the start of the next one (the controller also wakes on the ring descriptor),
+ *             a write that failed is handed back to its device through PWM_TakeError( ) and retried on the next tick.
+ *             Writes made outside a pass (PWM_Init( ), a device without a controller) and every write on a system
+ *             without io_uring (kernel older than 5.6, io_uring_disabled, seccomp) fall back to BBBPWMSysfsBackend's pwrite( ).
+ *             A device's writes come from one thread at a time : once it has a controller only the writer writes it.
+ *             Use it through BBBPWMUringDevice and BBBPWMUringController.
+ *  \author    Michael Brookes
+ *  \version   1.1
+ *  \date      Oct-2015
+ *  \copyright GNU Public License.
+ */
+class BBBPWMUringBackend : public BBBPWMSysfsBackend {
+public:
+
+    /**
+     \fn public static function int PWM_AttachAll( const vector< BBBPWMUringBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status )
+     \brief BBBPWMSysfsBackend::PWM_AttachAll( ) for io_uring outputs, the pins are found and opened the same way.
+     \param const <vector<BBBPWMUringBackend*>>& Outputs
+     \param const <vector<int>>& Blocks
+     \param const <vector<int>>& Pins
+     \param <vector<int>>& Status (resized to Outputs, 1 attached, 0 failed and reported)
+     \return <int> number of outputs attached.
+     */
+    static int PWM_AttachAll( const vector< BBBPWMUringBackend* >& Outputs, const vector< int >& Blocks, const vector< int >& Pins, vector< int >& Status );
+
+    /**
+     \fn public function int PWM_Read( PWM_Attribute Attr, int& Value )
+     \brief Reads a decimal value like BBBPWMSysfsBackend and remembers it as the value the attribute holds.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value (only written on success)
+     \return <int> -1 failed to read, 0 not a decimal value, 1 success.
+     */
+    int PWM_Read( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public function int PWM_Write( PWM_Attribute Attr, int Value )
+     \brief Queues the write inside a batch opened by this thread, otherwise writes it with pwrite( ) straight away.
+     \param <PWM_Attribute> Attr
+     \param <int> Value
+     \return <int> -1 failed to open, 0 failed to write (errno set), 1 success or queued.
+     */
+    int PWM_Write( PWM_Attribute Attr, int Value );
+
+    /**
+     \fn public function int PWM_TakeError( PWM_Attribute Attr, int& Value )
+     \brief Hands back (once) the failure of a queued write to Attr that has been reaped since the last call.
+     \param <PWM_Attribute> Attr
+     \param <int>& Value (set to the value the attribute is left holding)
+     \return <int> 0 no failure, > 0 the errno of the write.
+     */
+    int PWM_TakeError( PWM_Attribute Attr, int& Value );
+
+    /**
+     \fn public static function int PWM_BatchBegin( void )
+     \brief Opens a batch on the calling thread, creating its ring on first use, and reaps completions of earlier batches.
+     \param <void>
+     \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+     */
+    static int PWM_BatchBegin( void );
+
+    /**
+     \fn public static function int PWM_BatchEnd( void )
+     \brief Submits everything queued since PWM_BatchBegin( ) with one io_uring_enter( ), then reaps whatever has already completed.
+     \param <void>
+     \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+     */
+    static int PWM_BatchEnd( void );
+
+    /**
+     \fn public static function int PWM_BatchFD( void )
+     \brief Returns the calling thread's ring descriptor, readable while completions wait to be reaped.
+     \param <void>
+     \return <int> -1 no ring (not created yet or io_uring unavailable), >= 0 the descriptor.
+     */
+    static int PWM_BatchFD( void );
+
+    /**
+     \fn public static function int PWM_BatchWait( void )
+     \brief Submits whatever the calling thread has queued and waits until all its writes have completed. Runs on its own
+     when the thread exits, so a backend never outlives the ring its writes are on.
+     \param <void>
+     \return <int> number of queued writes found to have failed, see PWM_TakeError( ).
+     */
+    static int PWM_BatchWait( void );
+
+    /**
+     \fn public static function bool PWM_IsAvailable( void )
+     \brief Checks whether the calling thread can batch through io_uring, creating its ring if it has none yet.
+     \param <void>
+     \return <bool> false if writes fall back to pwrite( ).
+     */
+    static bool PWM_IsAvailable( void );
+
+    /**
+     \fn public static function uint64_t PWM_GetEnterCount( void )
+     \brief Returns the number of io_uring_enter( ) calls made by every thread since the program started.
+     \param <void>
+     \return <uint64_t>
+     */
+    static uint64_t PWM_GetEnterCount( void );
+
+    /**
+     \brief BBBPWMUringBackend : Nothing is opened until PWM_Attach( ).
+     \param <void>
+     */
+    BBBPWMUringBackend( );
+
+    /**
+     \brief ~BBBPWMUringBackend : Waits for its writes still in flight, the kernel reads their text from this object.
+     Destroy it on the thread that batched its writes, or once that thread has exited.
+     */
+    ~BBBPWMUringBackend( );
+
+protected:
+
+    char PWM_Pending[ PWM_ATTRS ][ PWM_DECIMAL_MAX ]; //!< Text of the write in flight per attribute, read by the kernel until it completes.
+    int PWM_PendingLen[ PWM_ATTRS ]; //!< Length of PWM_Pending.
+    int PWM_PendingValue[ PWM_ATTRS ]; //!< Value of the write in flight.
+    int PWM_PendingPrior[ PWM_ATTRS ]; //!< Value the attribute held before it.
+    bool PWM_InFlight[ PWM_ATTRS ]; //!< True from queueing until the completion is reaped.
+    int PWM_FailErrno[ PWM_ATTRS ]; //!< errno of a reaped failure not taken by PWM_TakeError( ) yet, 0 none.
+    int PWM_FailValue[ PWM_ATTRS ]; //!< Value the attribute holds after that failure.
+    BBBPWMUring* PWM_Owner; //!< Ring of the thread that queued the writes in flight.
+    int PWM_Last[ PWM_ATTRS ]; //!< Last value read, written or queued, by the one thread writing the device at a time.
+
+    /**
+     \fn private function int PWM_Complete( PWM_Attribute Attr, int Result )
+     \brief Records the completion of the write in flight to Attr.
+     \param <PWM_Attribute> Attr
+     \param <int> Result (bytes written, or -errno)
+     \return <int> 0 success, 1 the write failed.
+     */
+    int PWM_Complete( PWM_Attribute Attr, int Result );
+
+    /**
+     \fn private static function void PWM_ReapAll( BBBPWMUring& Ring )
+     \brief Reaps every completion ready on Ring and hands it to the backend that queued it, counting failures.
+     \param <BBBPWMUring>& Ring
+     \return <void>
+     */
+    static void PWM_ReapAll( BBBPWMUring& Ring );
+
+    /**
+     \fn private function int PWM_WaitFor( BBBPWMUring& Ring, PWM_Attribute Attr )
+     \brief Submits and waits until the write in flight to Attr has completed, its buffer is then free again.
+     \param <BBBPWMUring>& Ring
+     \param <PWM_Attribute> Attr
+     \return <int> -1 unable to wait (errno set), 1 success.
+     */
+    int PWM_WaitFor( BBBPWMUring& Ring, PWM_Attribute Attr );
+};
+
+#endif /* BBBPWMUringBackend_h */
@@ -0,0 +1,1390 @@
+//
+//  BBBPWMBench.cpp
+//  BBBPWMDevice
+//
+//  Benchmarks BBBPWMDevice against a fake sysfs tree, no BeagleBone required.
+//  Build : make bench ( from the repository root, builds build/BBBPWMBench ). Exits 1 if any correctness check failed.
+//  Run   : ./BBBPWMBench [--root=/dev/shm/bbbpwm_bench] [--format=text|csv|json] [--tag=<label>] [--seconds=0.5]
+//                        [--channels=32] [--only=<bench>]
+//
+//  Every result is one record : bench, params, metric, value. --format=csv / json print the records in a form that can be
+//  stored per version and diffed, --tag labels the run (e.g. a git describe) so results from several builds can be merged.
+//
+
+#include "BBBPWMDevice.h"
+#include "BBBPWMController.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <time.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+using namespace std;
+
+/**
+ \brief One measurement, params holds the space separated settings it was taken with (e.g. "channels=4 mode=shared").
+ */
+struct Bench_Result {
+    string Bench;
+    string Params;
+    string Metric;
+    double Value;
+};
+
+static vector< Bench_Result > Bench_Results;
+static string Bench_Only;
+static int Bench_Failures;
+
+/**
+ \brief Monotonic clock in nanoseconds.
+ */
+static uint64_t Bench_Now( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint64_t ) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ \brief CPU time used by the whole process in nanoseconds.
+ */
+static uint64_t Bench_CpuNow( void ) {
+    struct timespec ts;
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts );
+    return ( uint64_t ) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ \brief Adds a result to the report.
+ */
+static void Bench_Record( const string& Bench, const string& Params, const string& Metric, double Value ) {
+    Bench_Result Result = { Bench, Params, Metric, Value };
+    Bench_Results.push_back( Result );
+}
+
+/**
+ \brief Counts and reports a bench whose outcome was wrong, main( ) then exits with 1 after printing the report.
+ */
+static void Bench_Check( bool Ok, const string& Bench, const string& Params, const string& What ) {
+    if( Ok )
+        return;
+    Bench_Failures++;
+    cerr << "Check failed : " << Bench << " " << Params << " : " << What << endl;
+}
+
+/**
+ \brief True if the bench named should run (--only).
+ */
+static bool Bench_Selected( const string& Bench ) {
+    return Bench_Only.empty( ) || Bench_Only == Bench;
+}
+
+/**
+ \brief Writes Value into the file at Path, creating it if necessary.
+ */
+static void Bench_WriteFile( const string& Path, const char* Value ) {
+    FILE* f = fopen( Path.c_str( ), "w" );
+    if( f == NULL ) {
+        cerr << "Unable to create : " << Path << endl;
+        exit( 1 );
+    }
+    fputs( Value, f );
+    fclose( f );
+}
+
+/**
+ \brief Builds the capemgr/ocp layout BBBPWMDevice expects, with one pwm_test_ folder per pin.
+ */
+static void Bench_MakeFakeTree( const string& Root, const vector< int >& Pins ) {
+    string cmd = "rm -rf '" + Root + "' && mkdir -p '" + Root + "/devices/bone_capemgr.9' '" + Root + "/devices/ocp.3/48300000.epwmss'";
+    if( system( cmd.c_str( ) ) != 0 ) {
+        cerr << "Unable to create fake sysfs tree in : " << Root << endl;
+        exit( 1 );
+    }
+    Bench_WriteFile( Root + SLOTS_DIR, "" );
+    Bench_WriteFile( Root + MODALIAS_FILE, "platform:omap-ehrpwm\n" );
+    for( size_t i = 0; i < Pins.size( ); i++ ) {
+        char dir[ MAX_BUF ];
+        snprintf( dir, sizeof( dir ), "%s%spwm_test_P9_%d.12", Root.c_str( ), DEVICE_DIR, Pins[ i ] );
+        mkdir( dir, 0755 );
+        Bench_WriteFile( string( dir ) + "/duty", "500000\n" );
+        Bench_WriteFile( string( dir ) + "/period", "1900000\n" );
+        Bench_WriteFile( string( dir ) + "/run", "1\n" );
+    }
+
+    // sysfs attributes live in memory, a disk backed root would measure the filesystem rather than BBBPWMDevice.
+    struct statfs fs;
+    if( statfs( Root.c_str( ), &fs ) == 0 && fs.f_type != TMPFS_MAGIC )
+        cerr << "Warning : " << Root << " is not on tmpfs, results include disk filesystem overhead." << endl;
+}
+
+/**
+ \brief Percentile of an already sorted sample set.
+ */
+static uint64_t Bench_Percentile( const vector< uint64_t >& Sorted, double P ) {
+    return Sorted[ std::min( Sorted.size( ) - 1, ( size_t )( P * Sorted.size( ) ) ) ];
+}
+
+/**
+ \brief Records p50 / p99 / p99.9 / max of Samples (sorted in place) as <Metric>_p50 etc.
+ */
+static void Bench_RecordPercentiles( const string& Bench, const string& Params, const string& Metric, vector< uint64_t >& Samples ) {
+    if( Samples.empty( ) )
+        return;
+    sort( Samples.begin( ), Samples.end( ) );
+    Bench_Record( Bench, Params, Metric + "_p50", Bench_Percentile( Samples, 0.50 ) );
+    Bench_Record( Bench, Params, Metric + "_p99", Bench_Percentile( Samples, 0.99 ) );
+    Bench_Record( Bench, Params, Metric + "_p999", Bench_Percentile( Samples, 0.999 ) );
+    Bench_Record( Bench, Params, Metric + "_max", Samples.back( ) );
+}
+
+/**
+ \brief Adds the /sys/class/pwm layout of a current kernel to the fake tree : pwmchip0, 2 and 4 for ePWM0 - 2 linked to
+ their platform devices, each with an export file and both channels exported but never configured (tmpfs cannot
+ create pwm<M> on an export write).
+ */
+static void Bench_MakeClassTree( const string& Root ) {
+    string Cmd = "mkdir -p '" + Root + PWM_CLASS_DIR + "'";
+    for( int m = 0; m < PWM_EHRPWM_MODULES; m++ ) {
+        char Device[ 32 ], Chip[ 32 ];
+        snprintf( Device, sizeof( Device ), "%x.pwm", 0x48300200 + m * PWM_EHRPWM_STRIDE );
+        snprintf( Chip, sizeof( Chip ), PWM_CLASS_CHIP "%d", 2 * m );
+        string Dir = Root + "/devices/platform/ocp/" + Device + "/pwm/" + Chip;
+        Cmd += " && mkdir -p '" + Dir + "/pwm0' '" + Dir + "/pwm1'"
+            + " && for c in pwm0 pwm1; do for a in duty_cycle period enable; do echo 0 > '" + Dir + "'/$c/$a; done; done"
+            + " && ln -s '../../devices/platform/ocp/" + Device + "/pwm/" + Chip + "' '" + Root + PWM_CLASS_DIR + Chip + "'"
+            + " && ln -s '../../../" + Device + "' '" + Dir + "/device' && touch '" + Dir + "/export'";
+    }
+    if( system( Cmd.c_str( ) ) != 0 ) {
+        cerr << "Unable to create fake /sys/class/pwm tree in : " << Root << endl;
+        exit( 1 );
+    }
+}
+
+/**
+ \brief Points a device at the fake tree, P9 block, pin number used as-is so any channel count can be simulated.
+ */
+template< class Backend >
+static void Bench_SetupDevice( BBBPWMBasicDevice< Backend >& Device, const string& Root, int Pin ) {
+    Device.PWM_SetSysfsRoot( Root );
+    Device.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    Device.PWM_SetPinNum( ( BBBPWMDevice::PWM_PinNum ) Pin );
+}
+
+/**
+ \brief Channels devices on pins 1 - Channels of the fake tree (or null devices when Root is empty), spread round-robin
+ over Writers controllers and initialised. Configure Writer( ) before Start( ), everything is stopped and freed on
+ destruction.
+ */
+template< class Backend >
+struct Bench_Fixture {
+    vector< BBBPWMBasicController< Backend >* > Controllers;
+    vector< BBBPWMBasicDevice< Backend >* > Devices;
+
+    Bench_Fixture( const string& Root, int Channels, int Writers = 1 ) {
+        for( int w = 0; w < Writers; w++ ) {
+            Controllers.push_back( new BBBPWMBasicController< Backend >( ) );
+            Controllers[ w ]->PWM_Reserve( ( Channels + Writers - 1 ) / Writers );
+        }
+        for( int c = 0; c < Channels; c++ ) {
+            Devices.push_back( new BBBPWMBasicDevice< Backend >( ) );
+            Controllers[ c % Writers ]->PWM_AddDevice( Devices[ c ] );
+            if( Root.empty( ) )
+                continue;
+            Bench_SetupDevice( *Devices[ c ], Root, c + 1 );
+            Devices[ c ]->PWM_Init( );
+        }
+    }
+
+    ~Bench_Fixture( ) {
+        Stop( );
+        for( size_t c = 0; c < Devices.size( ); c++ )
+            delete Devices[ c ];
+        for( size_t w = 0; w < Controllers.size( ); w++ )
+            delete Controllers[ w ];
+    }
+
+    BBBPWMBasicController< Backend >& Writer( void ) {
+        return *Controllers[ 0 ];
+    }
+
+    int Start( void ) {
+        for( size_t w = 0; w < Controllers.size( ); w++ )
+            if( Controllers[ w ]->PWM_Start( ) < 0 )
+                return -1;
+        return 1;
+    }
+
+    void Stop( void ) {
+        for( size_t w = 0; w < Controllers.size( ); w++ )
+            Controllers[ w ]->PWM_Stop( );
+    }
+
+    /**
+     \brief Waits up to a second for every channel's committed duty to reach its (clamped) latest target.
+     */
+    bool Settled( void ) {
+        for( uint64_t End = Bench_Now( ) + 1000000000ull; ; usleep( 100 ) ) {
+            size_t c = 0;
+            for( ; c < Devices.size( ); c++ ) {
+                int Target = Devices[ c ]->PWM_GetTargetSpeed( );
+                Target = Target < PWM_DUTY_LOW ? PWM_DUTY_LOW : Target > PWM_DUTY_HIGH ? PWM_DUTY_HIGH : Target;
+                if( Devices[ c ]->PWM_GetDutyVal( ) != Target )
+                    break;
+            }
+            if( c == Devices.size( ) )
+                return true;
+            if( Bench_Now( ) > End )
+                return false;
+        }
+    }
+};
+
+/**
+ \brief Idle CPU and end-to-end latency of a single device with its own writer : PWM_SetTargetSpeed( ) until the
+ duty file has been modified, as seen by an inotify watch on it.
+ */
+static void Bench_WakeLatency( const string& Root, int Samples ) {
+    BBBPWMDevice Device;
+    Bench_SetupDevice( Device, Root, BBBPWMDevice::PWM42 );
+    Device.PWM_Init( );
+
+    // Idle : the writer thread has nothing to do, it should not cost any CPU.
+    uint64_t Wall = Bench_Now( ), Cpu = Bench_CpuNow( );
+    usleep( 1000000 );
+    Bench_Record( "wake", "", "idle_cpu_percent", 100.0 * ( Bench_CpuNow( ) - Cpu ) / ( Bench_Now( ) - Wall ) );
+
+    int Watch = inotify_init1( IN_CLOEXEC );
+    inotify_add_watch( Watch, ( Root + DEVICE_DIR + "pwm_test_P9_42.12/duty" ).c_str( ), IN_MODIFY );
+    char Events[ 4096 ];
+    vector< uint64_t > Latency;
+    for( int i = 0; i < Samples; i++ ) {
+        uint64_t Start = Bench_Now( );
+        Device.PWM_SetTargetSpeed( i & 1 ? 300000 : 400000 );
+        if( read( Watch, Events, sizeof( Events ) ) <= 0 )
+            break;
+        Latency.push_back( Bench_Now( ) - Start );
+    }
+    close( Watch );
+    Device.PWM_StopThread( );
+    Bench_RecordPercentiles( "wake", "", "set_to_write_ns", Latency );
+}
+
+/**
+ \brief Wake-up latency of a shared writer, default or in real-time mode (SCHED_FIFO, pinned to CPU 0, memory locked),
+ alone or next to one busy-looping thread per CPU : Samples frames 1 ms apart, each timed from just before
+ PWM_SetFrame( ) until the writer issued its writes (PWM_GetFrameCommit( )), so the caller's own delays do not count.
+ */
+static void Bench_WakeUnderLoad( const string& Root, int Samples, bool Realtime, bool Hog ) {
+    const int Channels = 4;
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+    BBBPWMController& Controller = Fixture.Writer( );
+    BBBPWMRealtime Settings = { 50, 0, true, 0, 0 };
+    if( ( Realtime && Controller.PWM_SetRealtime( Settings ) < 0 ) || Fixture.Start( ) < 0 )
+        return;
+
+    atomic< bool > Stop( false );
+    vector< thread > Hogs;
+    for( long h = 0; Hog && h < sysconf( _SC_NPROCESSORS_ONLN ); h++ )
+        Hogs.push_back( thread( [ &Stop ]( ) {
+            volatile uint64_t Spin = 0;
+            while( !Stop.load( memory_order_relaxed ) )
+                Spin++;
+        } ) );
+
+    vector< int > Duties( Channels );
+    vector< uint64_t > Latency;
+    for( int i = 0; i < Samples; i++ ) {
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = i & 1 ? 300000 : 400000;
+        uint64_t Start = Bench_Now( );
+        int64_t Frame = Controller.PWM_SetFrame( Duties.data( ), Channels, NULL, NULL );
+        usleep( 1000 );
+        int64_t Commit = Controller.PWM_GetFrameCommit( Frame );
+        if( Commit > 0 )
+            Latency.push_back( Commit - Start );
+    }
+    Stop.store( true );
+    for( size_t h = 0; h < Hogs.size( ); h++ )
+        Hogs[ h ].join( );
+    string Params = string( "rt=" ) + ( Realtime ? "1" : "0" ) + " hog=" + ( Hog ? "1" : "0" );
+    Bench_Check( Fixture.Settled( ), "wake", Params, "last frame not written" );
+    Fixture.Stop( );
+    // mlockall( ) is process wide, the benches that follow measure the default again.
+    if( Realtime )
+        munlockall( );
+
+    Bench_Record( "wake", Params, "late_frames", Samples - Latency.size( ) );
+    Bench_RecordPercentiles( "wake", Params, "set_to_write_ns", Latency );
+}
+
+/**
+ \brief Hammers every channel for Seconds and reports updates issued per second (in total and per channel), writes
+ committed per second and CPU use (process wide, so it includes the producer loop), either with one shared
+ BBBPWMController or with one writer thread per device (the PWM_Init( ) default).
+ */
+static void Bench_ChannelSweep( const string& Root, int Channels, bool Shared, double Seconds ) {
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels, Shared ? 1 : Channels );
+    vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+    Fixture.Start( );
+    string Params = "channels=" + to_string( Channels ) + " mode=" + ( Shared ? "shared" : "per_device" );
+
+    uint64_t Wall = Bench_Now( ), Cpu = Bench_CpuNow( ), End = Wall + ( uint64_t )( Seconds * 1e9 );
+    uint64_t Rounds = 0, Writes = 0;
+    while( Bench_Now( ) < End ) {
+        for( int c = 0; c < Channels; c++ )
+            Devices[ c ]->PWM_SetTargetSpeed( Rounds & 1 ? 300000 : 400000 );
+        Rounds++;
+    }
+    Bench_Check( Fixture.Settled( ), "sweep", Params, "last targets not written" );
+    Fixture.Stop( );
+    for( size_t i = 0; i < Fixture.Controllers.size( ); i++ )
+        Writes += Fixture.Controllers[ i ]->PWM_GetWriteCount( );
+    Wall = Bench_Now( ) - Wall;
+    Cpu = Bench_CpuNow( ) - Cpu;
+
+    double Secs = Wall / 1e9;
+    Bench_Record( "sweep", Params, "threads", Fixture.Controllers.size( ) );
+    Bench_Record( "sweep", Params, "updates_per_sec", Rounds * Channels / Secs );
+    Bench_Record( "sweep", Params, "updates_per_sec_per_channel", Rounds / Secs );
+    Bench_Record( "sweep", Params, "writes_per_sec", Writes / Secs );
+    Bench_Record( "sweep", Params, "cpu_percent", 100.0 * Cpu / Wall );
+    Bench_Record( "sweep", Params, "cpu_percent_per_channel", 100.0 * Cpu / Wall / Channels );
+}
+
+/**
+ \brief Formatting and reading a value : the old snprintf( ) / fopen( ) + malloc( ) path against BBBPWMCodec.h and pread( ).
+ */
+static void Bench_Codec( const string& Root ) {
+    const int Iterations = 200000;
+    string DutyFile = Root + DEVICE_DIR + "pwm_test_P9_42.12/duty";
+    char Buffer[ MAX_BUF ];
+    volatile int Sink = 0;
+
+    uint64_t Start = Bench_Now( );
+    for( int i = 0; i < Iterations; i++ )
+        Sink += snprintf( Buffer, sizeof( Buffer ), "%d", 150000 + i );
+    uint64_t FormatOld = Bench_Now( ) - Start;
+
+    Start = Bench_Now( );
+    for( int i = 0; i < Iterations; i++ )
+        Sink += PWM_FormatDecimal( 150000 + i, Buffer );
+    uint64_t FormatNew = Bench_Now( ) - Start;
+
+    const int Reads = Iterations / 10;
+    Start = Bench_Now( );
+    for( int i = 0; i < Reads; i++ ) {
+        FILE* f = fopen( DutyFile.c_str( ), "rb" );
+        fseek( f, 0, SEEK_END );
+        long Size = ftell( f );
+        rewind( f );
+        char* Read = ( char* ) malloc( Size + 1 );
+        Read[ fread( Read, 1, Size, f ) ] = 0;
+        fclose( f );
+        Sink += atoi( Read );
+        free( Read );
+    }
+    uint64_t ReadOld = Bench_Now( ) - Start;
+
+    int FD = open( DutyFile.c_str( ), O_RDONLY );
+    Start = Bench_Now( );
+    for( int i = 0; i < Reads; i++ ) {
+        int Value = 0;
+        ssize_t Len = pread( FD, Buffer, 32, 0 );
+        PWM_ParseDecimal( Buffer, ( int ) Len, Value );
+        Sink += Value;
+    }
+    uint64_t ReadNew = Bench_Now( ) - Start;
+    close( FD );
+
+    Bench_Record( "codec", "", "format_ns_snprintf", ( double ) FormatOld / Iterations );
+    Bench_Record( "codec", "", "format_ns_codec", ( double ) FormatNew / Iterations );
+    Bench_Record( "codec", "", "read_ns_fopen_malloc", ( double ) ReadOld / Reads );
+    Bench_Record( "codec", "", "read_ns_pread_codec", ( double ) ReadNew / Reads );
+}
+
+/**
+ \brief PWM_Init( ) time for a pin whose overlay is not loaded yet, over Runs runs. A helper thread plays the capemgr and
+ publishes the pwm_test_ folder DelayUs after start (filled in under a temporary name and renamed into place, like the
+ kernel would). DelayUs < 0 leaves the folder in place, which measures a warm PWM_Init( ).
+ */
+static void Bench_ColdStart( const string& Root, int Pin, int DelayUs, int Runs ) {
+    char Dir[ MAX_BUF ], Tmp[ MAX_BUF ];
+    snprintf( Dir, sizeof( Dir ), "%s%spwm_test_P9_%d.12", Root.c_str( ), DEVICE_DIR, Pin );
+    snprintf( Tmp, sizeof( Tmp ), "%s/devices/.pwm_test_P9_%d", Root.c_str( ), Pin );
+    vector< uint64_t > Elapsed;
+
+    for( int r = 0; r < Runs; r++ ) {
+        if( DelayUs >= 0 ) {
+            string Cmd = "rm -rf '" + string( Dir ) + "' '" + Tmp + "'";
+            if( system( Cmd.c_str( ) ) != 0 )
+                return;
+            mkdir( Tmp, 0755 );
+            Bench_WriteFile( string( Tmp ) + "/duty", "500000\n" );
+            Bench_WriteFile( string( Tmp ) + "/period", "1900000\n" );
+            Bench_WriteFile( string( Tmp ) + "/run", "1\n" );
+        }
+
+        uint64_t Start = Bench_Now( );
+        thread CapeMgr( [ & ]( ) {
+            if( DelayUs < 0 )
+                return;
+            usleep( DelayUs );
+            rename( Tmp, Dir );
+        } );
+        BBBPWMDevice Device;
+        Bench_SetupDevice( Device, Root, Pin );
+        Device.PWM_Init( );
+        Elapsed.push_back( Bench_Now( ) - Start );
+        CapeMgr.join( );
+        Device.PWM_StopThread( );
+    }
+
+    Bench_RecordPercentiles( "init", DelayUs < 0 ? "overlay=loaded" : "overlay_delay_us=" + to_string( DelayUs ), "init_ns", Elapsed );
+}
+
+/**
+ \brief Four motors from cold, the way the capemgr does it : each pin's pwm_test_ folder only appears DelayUs after its
+ overlay name is written to SLOTS (SLOTS is swapped for a FIFO read by a helper thread that plays the capemgr). PWM_Init( ) on one device after
+ the other waits out every overlay in turn, BBBPWMController::PWM_InitDevices( ) writes them all and waits once.
+ */
+static void Bench_BulkInit( const string& Root, bool Bulk, int DelayUs, int Runs ) {
+    const int Pins[ 4 ] = { 14, 16, 21, 22 };
+    string Slots = Root + SLOTS_DIR;
+    vector< uint64_t > Elapsed;
+    int Ready = 0;
+
+    for( int r = 0; r < Runs; r++ ) {
+        string Dirs[ 4 ], Tmps[ 4 ];
+        for( int p = 0; p < 4; p++ ) {
+            char Dir[ MAX_BUF ];
+            snprintf( Dir, sizeof( Dir ), "%s%spwm_test_P9_%d.12", Root.c_str( ), DEVICE_DIR, Pins[ p ] );
+            Dirs[ p ] = Dir;
+            Tmps[ p ] = Root + "/devices/.pwm_test_P9_" + to_string( Pins[ p ] );
+            string Cmd = "rm -rf '" + Dirs[ p ] + "' '" + Tmps[ p ] + "'";
+            if( system( Cmd.c_str( ) ) != 0 )
+                return;
+            mkdir( Tmps[ p ].c_str( ), 0755 );
+            Bench_WriteFile( Tmps[ p ] + "/duty", "500000\n" );
+            Bench_WriteFile( Tmps[ p ] + "/period", "1900000\n" );
+            Bench_WriteFile( Tmps[ p ] + "/run", "1\n" );
+        }
+        // Each SLOTS write is read from the FIFO and the matching folder renamed into place DelayUs later.
+        unlink( Slots.c_str( ) );
+        mkfifo( Slots.c_str( ), 0644 );
+        int Fifo = open( Slots.c_str( ), O_RDONLY | O_NONBLOCK | O_CLOEXEC );
+        atomic< bool > Done( false );
+        thread CapeMgr( [ & ]( ) {
+            uint64_t Due[ 4 ] = { 0, 0, 0, 0 };
+            int Moved = 0;
+            while( Moved < 4 && !Done.load( ) ) {
+                char Names[ 256 ];
+                struct pollfd Wait = { Fifo, POLLIN, 0 };
+                ssize_t Len;
+                if( poll( &Wait, 1, 1 ) > 0 && ( Len = read( Fifo, Names, sizeof( Names ) - 1 ) ) > 0 ) {
+                    Names[ Len ] = '\0';
+                    for( int p = 0; p < 4; p++ )
+                        if( Due[ p ] == 0 && strstr( Names, ( "P9_" + to_string( Pins[ p ] ) ).c_str( ) ) != NULL )
+                            Due[ p ] = Bench_Now( ) + ( uint64_t ) DelayUs * 1000;
+                }
+                for( int p = 0; p < 4; p++ )
+                    if( Due[ p ] != 0 && Due[ p ] != UINT64_MAX && Bench_Now( ) >= Due[ p ] ) {
+                        rename( Tmps[ p ].c_str( ), Dirs[ p ].c_str( ) );
+                        Due[ p ] = UINT64_MAX;
+                        Moved++;
+                    }
+            }
+        } );
+
+        uint64_t Start = Bench_Now( );
+        BBBPWMController Controller;
+        BBBPWMDevice Devices[ 4 ];
+        for( int p = 0; p < 4; p++ ) {
+            Bench_SetupDevice( Devices[ p ], Root, Pins[ p ] );
+            Controller.PWM_AddDevice( &Devices[ p ] );
+        }
+        if( Bulk ) {
+            vector< int > Status;
+            Ready += Controller.PWM_InitDevices( Status );
+        }
+        else
+            for( int p = 0; p < 4; p++ )
+                Ready += Devices[ p ].PWM_Init( );
+        Controller.PWM_Start( );
+        Elapsed.push_back( Bench_Now( ) - Start );
+        Controller.PWM_Stop( );
+        Done.store( true );
+        CapeMgr.join( );
+        close( Fifo );
+        unlink( Slots.c_str( ) );
+        Bench_WriteFile( Slots, "" );
+    }
+
+    string Params = string( "mode=" ) + ( Bulk ? "bulk" : "serial" ) + " channels=4 overlay_delay_us=" + to_string( DelayUs );
+    Bench_Record( "init", Params, "ready", ( double ) Ready / Runs );
+    Bench_RecordPercentiles( "init", Params, "init_ns", Elapsed );
+}
+
+/**
+ \brief PWM_Init( ) of four channels on /sys/class/pwm, from freshly exported channels (period 0) and nothing known
+ about the pwmchips, up to a running shared writer. No overlay and no sleep, against the pwm_test_ cold start above.
+ */
+static void Bench_ClassInit( const string& Root, int Runs ) {
+    const int Pins[ 4 ][ 2 ] = { { 9, 14 }, { 9, 16 }, { 9, 21 }, { 9, 22 } };
+    vector< uint64_t > Elapsed;
+    for( int r = 0; r < Runs; r++ ) {
+        for( int p = 0; p < 4; p++ ) {
+            const BBBPWMPinInfo* Pin = BBBPWMPins::PWM_Find( Pins[ p ][ 0 ], Pins[ p ][ 1 ] );
+            char Dir[ MAX_BUF ];
+            snprintf( Dir, sizeof( Dir ), "%s%s" PWM_CLASS_CHIP "%d/pwm%d", Root.c_str( ), PWM_CLASS_DIR, 2 * Pin->PWM_Module, Pin->PWM_Channel );
+            Bench_WriteFile( string( Dir ) + "/duty_cycle", "0\n" );
+            Bench_WriteFile( string( Dir ) + "/period", "0\n" );
+            Bench_WriteFile( string( Dir ) + "/enable", "0\n" );
+        }
+        BBBPWMClassBackend::PWM_ForgetChips( );
+
+        uint64_t Start = Bench_Now( );
+        BBBPWMClassController Controller;
+        BBBPWMClassDevice Devices[ 4 ];
+        for( int p = 0; p < 4; p++ ) {
+            Devices[ p ].PWM_SetSysfsRoot( Root );
+            Devices[ p ].PWM_SetBlockNum( ( BBBPWMDevice::PWM_BlockNum ) Pins[ p ][ 0 ] );
+            Devices[ p ].PWM_SetPinNum( ( BBBPWMDevice::PWM_PinNum ) Pins[ p ][ 1 ] );
+            Controller.PWM_AddDevice( &Devices[ p ] );
+            Devices[ p ].PWM_Init( );
+        }
+        Controller.PWM_Start( );
+        Elapsed.push_back( Bench_Now( ) - Start );
+        Controller.PWM_Stop( );
+    }
+
+    Bench_RecordPercentiles( "init", "backend=class channels=4", "init_ns", Elapsed );
+}
+
+/**
+ \brief Cost of the per-device metrics : without a writer thread PWM_SetRunVal( ) writes synchronously in the caller,
+ so alternating it times PWM_WriteValue( ) directly, with latency timing off and on. Also reports what the histogram itself saw and how long a
+ PWM_GetMetrics( ) snapshot takes.
+ */
+static void Bench_Metrics( const string& Root ) {
+    const int Writes = 50000;
+    BBBPWMDevice Device;
+    Bench_SetupDevice( Device, Root, BBBPWMDevice::PWM42 );
+    Device.PWM_Init( );
+    Device.PWM_StopThread( );
+
+    uint64_t Ns[ 2 ];
+    for( int Timing = 0; Timing < 2; Timing++ ) {
+        Device.PWM_SetLatencyTiming( Timing == 1 );
+        uint64_t Start = Bench_Now( );
+        for( int i = 0; i < Writes; i++ )
+            Device.PWM_SetRunVal( i & 1 ? BBBPWMDevice::ON : BBBPWMDevice::OFF );
+        Ns[ Timing ] = Bench_Now( ) - Start;
+    }
+
+    BBBPWMMetrics Metrics;
+    const int Snapshots = 10000;
+    uint64_t Start = Bench_Now( );
+    for( int i = 0; i < Snapshots; i++ )
+        Device.PWM_GetMetrics( Metrics );
+    uint64_t SnapshotNs = Bench_Now( ) - Start;
+
+    Bench_Record( "metrics", "", "write_ns_untimed", ( double ) Ns[ 0 ] / Writes );
+    Bench_Record( "metrics", "", "write_ns_timed", ( double ) Ns[ 1 ] / Writes );
+    Bench_Record( "metrics", "", "timing_overhead_ns", ( ( double ) Ns[ 1 ] - Ns[ 0 ] ) / Writes );
+    Bench_Record( "metrics", "", "histogram_write_ns_p50", PWM_LatencyPercentile( Metrics, 0.50 ) );
+    Bench_Record( "metrics", "", "histogram_write_ns_p99", PWM_LatencyPercentile( Metrics, 0.99 ) );
+    Bench_Record( "metrics", "", "writes", Metrics.PWM_Writes );
+    Bench_Record( "metrics", "", "write_failures", Metrics.PWM_WriteFailures );
+    Bench_Record( "metrics", "", "snapshot_ns", ( double ) SnapshotNs / Snapshots );
+}
+
+/**
+ \brief Timing error of profile playback : Records records IntervalUs apart round-robin over Channels channels of one
+ shared controller, played by PWM_Play( ), against the same schedule driven by a usleep( ) loop around
+ PWM_SetTargetSpeed( ) (the only option before playback existed).
+ */
+static void Bench_Playback( const string& Root, int Channels, int Records, int IntervalUs ) {
+    vector< BBBPWMProfileRecord > Profile( Records );
+    for( int i = 0; i < Records; i++ ) {
+        Profile[ i ].PWM_TimeNs = ( uint64_t ) i * IntervalUs * 1000;
+        Profile[ i ].PWM_Channel = i % Channels;
+        Profile[ i ].PWM_Duty = 200000 + ( i * 1000 ) % 400000;
+        Profile[ i ].PWM_Period = PWM_PROFILE_KEEP;
+        Profile[ i ].PWM_Reserved = 0;
+    }
+    string ProfileFile = Root + "/profile.bin";
+    BBBPWMProfile Player;
+    if( BBBPWMProfile::PWM_Save( ProfileFile.c_str( ), &Profile[ 0 ], Records ) < 0 || Player.PWM_Open( ProfileFile.c_str( ) ) < 0 )
+        return;
+
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+    BBBPWMController& Controller = Fixture.Writer( );
+    vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+    Fixture.Start( );
+
+    Controller.PWM_Play( &Player, 1000000 );
+    while( Controller.PWM_IsPlaying( ) )
+        usleep( 10000 );
+    BBBPWMPlaybackStats Stats;
+    Controller.PWM_GetPlaybackStats( Stats );
+
+    // The old way : sleep for the interval, set, repeat. Error is taken when the target is handed over, before it is even written.
+    vector< uint64_t > LoopError;
+    uint64_t Start = Bench_Now( );
+    for( int i = 0; i < Records; i++ ) {
+        Devices[ i % Channels ]->PWM_SetTargetSpeed( Profile[ i ].PWM_Duty );
+        LoopError.push_back( Bench_Now( ) - Start - Profile[ i ].PWM_TimeNs );
+        usleep( IntervalUs );
+    }
+    string Params = "channels=" + to_string( Channels ) + " records=" + to_string( Records ) + " interval_us=" + to_string( IntervalUs );
+    Bench_Check( Stats.PWM_Played == ( uint64_t ) Records, "playback", Params, "records not all played" );
+    Bench_Check( Fixture.Settled( ), "playback", Params, "last targets not written" );
+    Fixture.Stop( );
+    Bench_Record( "playback", Params, "played", Stats.PWM_Played );
+    Bench_Record( "playback", Params, "error_ns_mean", Stats.PWM_Played ? ( double ) Stats.PWM_TotalErrorNs / Stats.PWM_Played : 0 );
+    Bench_Record( "playback", Params, "error_ns_p50", PWM_BucketPercentile( Stats.PWM_Error, 0.50 ) );
+    Bench_Record( "playback", Params, "error_ns_p99", PWM_BucketPercentile( Stats.PWM_Error, 0.99 ) );
+    Bench_Record( "playback", Params, "error_ns_max", Stats.PWM_MaxErrorNs );
+    Bench_RecordPercentiles( "playback", Params, "sleep_loop_error_ns", LoopError );
+}
+
+/**
+ \brief One channel's control loop for Bench_Control( ) : a new duty each tick, and a check that the previous
+ tick's duty had been written by the time this one ran.
+ */
+struct Bench_Loop {
+    BBBPWMDevice* Device;
+    int Last;
+    uint64_t Stale;
+};
+
+static int Bench_ControlStep( void* Arg, uint64_t Tick ) {
+    Bench_Loop* Loop = ( Bench_Loop* ) Arg;
+    if( Loop->Last > 0 && Loop->Device->PWM_GetDutyVal( ) != Loop->Last )
+        Loop->Stale++;
+    Loop->Last = 200000 + ( int )( Tick * 7919 % 400000 );
+    return Loop->Last;
+}
+
+/**
+ \brief Control loops on Channels channels every PeriodUs for Seconds, run by the controller's control tick, against
+ the same loops driven by a usleep( ) loop around PWM_SetTargetSpeed( ) (what a PID on top of the device did before).
+ Jitter is each tick's start against its ideal time, stale counts ticks that ran before the previous tick's write.
+ */
+static void Bench_Control( const string& Root, int Channels, int PeriodUs, double Seconds ) {
+    for( int Scheduled = 0; Scheduled < 2; Scheduled++ ) {
+        Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+        BBBPWMController& Controller = Fixture.Writer( );
+        vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+        vector< Bench_Loop > Loops( Channels );
+        for( int c = 0; c < Channels; c++ ) {
+            Loops[ c ].Device = Devices[ c ];
+            Loops[ c ].Last = 0;
+            Loops[ c ].Stale = 0;
+            if( Scheduled )
+                Controller.PWM_AddControl( c, Bench_ControlStep, &Loops[ c ] );
+        }
+        Controller.PWM_SetControlPeriod( PeriodUs * 1000L );
+        Fixture.Start( );
+
+        string Params = "channels=" + to_string( Channels ) + " period_us=" + to_string( PeriodUs ) + " mode=" + ( Scheduled ? "control_tick" : "sleep_loop" );
+        uint64_t Ticks = 0, Stale = 0, Overruns = 0;
+        if( Scheduled ) {
+            usleep( ( useconds_t )( Seconds * 1e6 ) );
+            Fixture.Stop( );
+            BBBPWMControlStats Stats;
+            Controller.PWM_GetControlStats( Stats );
+            Ticks = Stats.PWM_Ticks;
+            Overruns = Stats.PWM_Overruns + Stats.PWM_Missed;
+            Bench_Record( "control", Params, "jitter_ns_p50", PWM_BucketPercentile( Stats.PWM_Jitter, 0.50 ) );
+            Bench_Record( "control", Params, "jitter_ns_p99", PWM_BucketPercentile( Stats.PWM_Jitter, 0.99 ) );
+            Bench_Record( "control", Params, "jitter_ns_max", Stats.PWM_MaxJitterNs );
+            Bench_Record( "control", Params, "callback_ns_p50", PWM_BucketPercentile( Stats.PWM_Callback, 0.50 ) );
+            Bench_Record( "control", Params, "tick_to_write_ns_max", Stats.PWM_MaxWriteNs );
+        } else {
+            // The old way : sleep for the period, run the loops, repeat. Drift accumulates, so the error keeps growing.
+            vector< uint64_t > Jitter;
+            uint64_t Start = Bench_Now( ), Period = PeriodUs * 1000ULL;
+            while( Bench_Now( ) - Start < ( uint64_t )( Seconds * 1e9 ) ) {
+                usleep( PeriodUs );
+                uint64_t Late = Bench_Now( ) - Start - ( Ticks + 1 ) * Period;
+                Jitter.push_back( ( int64_t ) Late > 0 ? Late : 0 );
+                for( int c = 0; c < Channels; c++ )
+                    Devices[ c ]->PWM_SetTargetSpeed( Bench_ControlStep( &Loops[ c ], Ticks ) );
+                Ticks++;
+            }
+            Bench_Check( Fixture.Settled( ), "control", Params, "last outputs not written" );
+            Fixture.Stop( );
+            Bench_RecordPercentiles( "control", Params, "jitter_ns", Jitter );
+        }
+        for( int c = 0; c < Channels; c++ )
+            Stale += Loops[ c ].Stale;
+        Bench_Check( Ticks > 0, "control", Params, "no ticks ran" );
+        Bench_Record( "control", Params, "ticks", Ticks );
+        Bench_Record( "control", Params, "overruns", Overruns );
+        Bench_Record( "control", Params, "stale", Stale );
+    }
+}
+
+/**
+ \brief Cost of the tracer : one PWM_Record( ) with tracing off and on (bursts the drain keeps up with, so nothing is
+ dropped), then Channels channels of one shared controller hammered for Seconds with and without a trace running.
+ */
+static void Bench_Trace( const string& Root, int Channels, double Seconds ) {
+    const int Burst = PWM_TRACE_RING / 2, Bursts = 64;
+    string TraceFile = Root + "/bench.trace";
+    for( int On = 0; On < 2; On++ ) {
+        if( On )
+            BBBPWMTrace::PWM_Start( TraceFile.c_str( ) );
+        uint64_t Ns = 0;
+        for( int b = 0; b < Bursts; b++ ) {
+            uint64_t Start = Bench_Now( );
+            for( int i = 0; i < Burst; i++ )
+                BBBPWMTrace::PWM_Record( PWM_TRACE_REQUEST, PWM_ATTR_DUTY, 9, 42, i, 0 );
+            Ns += Bench_Now( ) - Start;
+            usleep( 2 * PWM_TRACE_DRAIN_NS / 1000 );
+        }
+        BBBPWMTrace::PWM_Stop( );
+        string Params = string( "tracing=" ) + ( On ? "on" : "off" );
+        Bench_Record( "trace", Params, "record_ns", ( double ) Ns / ( Burst * Bursts ) );
+        if( On )
+            Bench_Record( "trace", Params, "record_lost", BBBPWMTrace::PWM_GetLost( ) );
+    }
+
+    for( int On = 0; On < 2; On++ ) {
+        Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+        BBBPWMController& Controller = Fixture.Writer( );
+        vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+        Fixture.Start( );
+        string Params = "channels=" + to_string( Channels ) + " tracing=" + ( On ? "on" : "off" );
+        if( On )
+            BBBPWMTrace::PWM_Start( TraceFile.c_str( ) );
+        uint64_t Wall = Bench_Now( ), End = Wall + ( uint64_t )( Seconds * 1e9 ), Rounds = 0;
+        while( Bench_Now( ) < End ) {
+            for( int c = 0; c < Channels; c++ )
+                Devices[ c ]->PWM_SetTargetSpeed( Rounds & 1 ? 300000 : 400000 );
+            Rounds++;
+        }
+        Bench_Check( Fixture.Settled( ), "trace", Params, "last targets not written" );
+        Fixture.Stop( );
+        BBBPWMTrace::PWM_Stop( );
+        double Secs = ( Bench_Now( ) - Wall ) / 1e9;
+
+        Bench_Record( "trace", Params, "updates_per_sec", Rounds * Channels / Secs );
+        Bench_Record( "trace", Params, "writes_per_sec", Controller.PWM_GetWriteCount( ) / Secs );
+        if( On ) {
+            Bench_Record( "trace", Params, "events_written", BBBPWMTrace::PWM_GetWritten( ) );
+            Bench_Record( "trace", Params, "events_lost", BBBPWMTrace::PWM_GetLost( ) );
+        }
+    }
+    unlink( TraceFile.c_str( ) );
+}
+
+/**
+ \brief Throttle calibration : a frame of Channels throttles through PWM_Convert( ) (vector path) and PWM_ConvertScalar( ),
+ how far the two ever disagree, then the same conversions from a second thread while curves are swapped in, timing
+ each swap and the slowest conversion that overlapped one.
+ */
+static void Bench_Calibration( const string& Root, int Channels, double Seconds ) {
+    string Params = "channels=" + to_string( Channels );
+    BBBPWMCalibration Calibration;
+    if( Calibration.PWM_Reset( Channels, 0 ) < 0 )
+        return;
+    // A bent curve per channel, so every segment has its own slope.
+    vector< int > Points( PWM_CAL_POINTS );
+    for( int c = 0; c < Channels; c++ ) {
+        for( int p = 0; p < PWM_CAL_POINTS; p++ )
+            Points[ p ] = PWM_DUTY_HIGH - 100 * c - ( PWM_DUTY_HIGH - PWM_DUTY_LOW - 100 * c ) * p * p / ( ( PWM_CAL_POINTS - 1 ) * ( PWM_CAL_POINTS - 1 ) );
+        Calibration.PWM_SetCurve( c, &Points[ 0 ], PWM_DUTY_LOW + 10000, PWM_DUTY_HIGH - 10000 );
+    }
+    string CalFile = Root + "/escs.cal";
+    BBBPWMCalibration Loaded;
+    if( Calibration.PWM_Save( CalFile.c_str( ) ) < 0 || Loaded.PWM_Load( CalFile.c_str( ) ) < 0 )
+        return;
+
+    const int Frames = 4096;
+    vector< float > Throttles( ( size_t ) Frames * Channels );
+    for( size_t i = 0; i < Throttles.size( ); i++ )
+        Throttles[ i ] = ( float )( ( i * 2654435761u ) % 10007 ) / 10000.0f - 0.0002f;
+    vector< int > Vector( Throttles.size( ) ), Scalar( Throttles.size( ) );
+    const int Rounds = 20;
+    uint64_t Ns[ 2 ] = { 0, 0 };
+    for( int r = 0; r < Rounds; r++ ) {
+        uint64_t Start = Bench_Now( );
+        for( int f = 0; f < Frames; f++ )
+            Loaded.PWM_Convert( &Throttles[ ( size_t ) f * Channels ], &Vector[ ( size_t ) f * Channels ], Channels );
+        Ns[ 0 ] += Bench_Now( ) - Start;
+        Start = Bench_Now( );
+        for( int f = 0; f < Frames; f++ )
+            Loaded.PWM_ConvertScalar( &Throttles[ ( size_t ) f * Channels ], &Scalar[ ( size_t ) f * Channels ], Channels );
+        Ns[ 1 ] += Bench_Now( ) - Start;
+    }
+    int MaxDiff = 0;
+    for( size_t i = 0; i < Vector.size( ); i++ )
+        MaxDiff = max( MaxDiff, abs( Vector[ i ] - Scalar[ i ] ) );
+    Bench_Record( "calibration", Params, "frame_ns_vector", ( double ) Ns[ 0 ] / ( ( double ) Rounds * Frames ) );
+    Bench_Record( "calibration", Params, "frame_ns_scalar", ( double ) Ns[ 1 ] / ( ( double ) Rounds * Frames ) );
+    Bench_Record( "calibration", Params, "vector_scalar_max_diff_ns", MaxDiff );
+
+    atomic< bool > Stop( false );
+    atomic< uint64_t > Converted( 0 ), MaxConvert( 0 );
+    thread Converter( [ & ]( ) {
+        vector< int > Duties( Channels );
+        uint64_t Count = 0, Max = 0;
+        while( !Stop.load( memory_order_relaxed ) ) {
+            uint64_t Start = Bench_Now( );
+            Loaded.PWM_Convert( &Throttles[ ( Count % Frames ) * Channels ], &Duties[ 0 ], Channels );
+            Max = max( Max, Bench_Now( ) - Start );
+            Count++;
+        }
+        Converted.store( Count );
+        MaxConvert.store( Max );
+    } );
+    vector< uint64_t > Swap;
+    uint64_t End = Bench_Now( ) + ( uint64_t )( Seconds * 1e9 );
+    while( Bench_Now( ) < End ) {
+        uint64_t Start = Bench_Now( );
+        Loaded.PWM_SetCurve( ( int )( Swap.size( ) % Channels ), &Points[ 0 ], PWM_DUTY_LOW, PWM_DUTY_HIGH );
+        Swap.push_back( Bench_Now( ) - Start );
+        usleep( 200 );
+    }
+    Stop.store( true );
+    Converter.join( );
+    unlink( CalFile.c_str( ) );
+    Bench_RecordPercentiles( "calibration", Params, "swap_ns", Swap );
+    Bench_Record( "calibration", Params, "conversions_during_swaps", Converted.load( ) );
+    Bench_Record( "calibration", Params, "max_convert_ns_during_swaps", MaxConvert.load( ) );
+}
+
+/**
+ \brief Failsafe watchdog : the update path with and without channels watched, then Samples times feeding every
+ channel and going silent, timing from the last target until the first channel shows its safe duty.
+ */
+static void Bench_Failsafe( const string& Root, int Channels, int TimeoutMs, int Samples ) {
+    for( int Watched = 0; Watched < 2; Watched++ ) {
+        Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+        BBBPWMController& Controller = Fixture.Writer( );
+        vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+        for( int c = 0; Watched && c < Channels; c++ )
+            Controller.PWM_SetFailsafe( c, TimeoutMs, 160000 );
+        Fixture.Start( );
+        string Params = "channels=" + to_string( Channels ) + " timeout_ms=" + to_string( TimeoutMs ) + " watched=" + ( Watched ? "yes" : "no" );
+
+        const int Calls = 200000;
+        uint64_t Start = Bench_Now( );
+        for( int i = 0; i < Calls; i++ )
+            Devices[ i % Channels ]->PWM_SetTargetSpeed( 300000 + ( i & 0xff ) * 100 );
+        Bench_Record( "failsafe", Params, "set_target_ns", ( double )( Bench_Now( ) - Start ) / Calls );
+
+        vector< uint64_t > Reaction;
+        for( int s = 0; Watched && s < Samples; s++ ) {
+            for( int c = 0; c < Channels; c++ )
+                Devices[ c ]->PWM_SetTargetSpeed( 300000 + s * 100 );
+            while( Devices[ 0 ]->PWM_GetDutyVal( ) != 300000 + s * 100 )
+                usleep( 20 );
+            // Otherwise the feed lands just after the check that tripped the last sample, at the same place on the grid every time.
+            usleep( ( s * 397 ) % ( TimeoutMs * 1000 / PWM_FAILSAFE_CHECKS ) );
+            for( int c = 0; c < Channels; c++ )
+                Devices[ c ]->PWM_SetTargetSpeed( 300000 + s * 100 + 50 );
+            uint64_t Last = Bench_Now( );
+            while( Devices[ 0 ]->PWM_GetDutyVal( ) != 160000 && Bench_Now( ) - Last < 10ull * TimeoutMs * 1000000 )
+                usleep( 20 );
+            Reaction.push_back( Bench_Now( ) - Last );
+        }
+        if( !Watched )
+            Bench_Check( Fixture.Settled( ), "failsafe", Params, "last targets not written" );
+        Fixture.Stop( );
+        if( Watched ) {
+            BBBPWMFailsafeStats Stats;
+            Controller.PWM_GetFailsafeStats( Stats );
+            Bench_RecordPercentiles( "failsafe", Params, "reaction_ns", Reaction );
+            Bench_Record( "failsafe", Params, "bound_ns", TimeoutMs * 1000000.0 + Stats.PWM_CheckNs );
+            Bench_Record( "failsafe", Params, "trips", Stats.PWM_Trips );
+            Bench_Record( "failsafe", Params, "late_ns_p99", PWM_BucketPercentile( Stats.PWM_Late, 0.99 ) );
+            Bench_Record( "failsafe", Params, "late_ns_max", Stats.PWM_MaxLateNs );
+            Bench_Check( Stats.PWM_Trips >= ( uint64_t ) Samples, "failsafe", Params, "silent channels did not trip" );
+        }
+    }
+}
+
+/**
+ \brief Frames against separate targets : what publishing Channels duties costs either way, then frames published
+ every IntervalUs (0 = flat out) and how long they take to be committed, and how many are superseded before.
+ */
+static void Bench_Frame( const string& Root, int Channels, int IntervalUs, double Seconds ) {
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+    BBBPWMController& Controller = Fixture.Writer( );
+    vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+    Fixture.Start( );
+    string Params = "channels=" + to_string( Channels ) + " interval_us=" + to_string( IntervalUs );
+
+    vector< int > Duties( Channels );
+    uint64_t Wall = Bench_Now( ), End = Wall + ( uint64_t )( Seconds * 1e9 ), Frames = 0, FrameNs = 0;
+    while( Bench_Now( ) < End ) {
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = 300000 + ( Frames & 0xff ) * 100 + c;
+        uint64_t Start = Bench_Now( );
+        Controller.PWM_SetFrame( Duties.data( ), Channels, NULL, NULL );
+        FrameNs += Bench_Now( ) - Start;
+        Frames++;
+        if( IntervalUs > 0 )
+            usleep( IntervalUs );
+    }
+    usleep( 10000 );
+    BBBPWMFrameStats Stats;
+    Controller.PWM_GetFrameStats( Stats );
+    Bench_Record( "frame", Params, "set_frame_ns", ( double ) FrameNs / Frames );
+    Bench_Record( "frame", Params, "published", Stats.PWM_Published );
+    Bench_Record( "frame", Params, "committed", Stats.PWM_Committed );
+    Bench_Record( "frame", Params, "dropped", Stats.PWM_Dropped );
+    Bench_Record( "frame", Params, "commit_ns_p50", PWM_BucketPercentile( Stats.PWM_Commit, 0.50 ) );
+    Bench_Record( "frame", Params, "commit_ns_p99", PWM_BucketPercentile( Stats.PWM_Commit, 0.99 ) );
+    Bench_Record( "frame", Params, "commit_ns_max", Stats.PWM_MaxCommitNs );
+    Bench_Check( Stats.PWM_Committed + Stats.PWM_Dropped == Stats.PWM_Published, "frame", Params, "frames neither committed nor dropped" );
+
+    // The same duties through one PWM_SetTargetSpeed( ) per channel, which a pass may catch half done.
+    uint64_t Sets = 0, SetNs = 0;
+    End = Bench_Now( ) + ( uint64_t )( Seconds * 1e9 );
+    while( Bench_Now( ) < End ) {
+        uint64_t Start = Bench_Now( );
+        for( int c = 0; c < Channels; c++ )
+            Devices[ c ]->PWM_SetTargetSpeed( 300000 + ( Sets & 0xff ) * 100 + c );
+        SetNs += Bench_Now( ) - Start;
+        Sets++;
+        if( IntervalUs > 0 )
+            usleep( IntervalUs );
+    }
+    Bench_Record( "frame", Params, "set_targets_ns", ( double ) SetNs / Sets );
+    Bench_Check( Fixture.Settled( ), "frame", Params, "last targets not written" );
+}
+
+/**
+ \brief Many channels on null devices, so only the controller's own bookkeeping is timed : a frame over all Channels
+ from publication to commit, a single channel's target through a dirty scan of all of them, and reading every
+ committed duty back from the channel table against one device at a time.
+ */
+static void Bench_Channels( int Channels, double Seconds ) {
+    Bench_Fixture< BBBPWMNullBackend > Fixture( "", Channels );
+    BBBPWMNullController& Controller = Fixture.Writer( );
+    vector< BBBPWMNullDevice* >& Devices = Fixture.Devices;
+    Fixture.Start( );
+    string Params = "channels=" + to_string( Channels );
+
+    vector< int > Duties( Channels );
+    vector< uint64_t > FrameNs;
+    uint64_t End = Bench_Now( ) + ( uint64_t )( Seconds * 1e9 );
+    while( Bench_Now( ) < End ) {
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = 300000 + ( FrameNs.size( ) & 0xff ) * 100 + c;
+        uint64_t Start = Bench_Now( );
+        int64_t Frame = Controller.PWM_SetFrame( Duties.data( ), Channels, NULL, NULL );
+        while( Controller.PWM_GetFrameCommit( Frame ) == 0 )
+            sched_yield( );
+        FrameNs.push_back( Bench_Now( ) - Start );
+    }
+    Bench_Check( Fixture.Settled( ), "channels", Params, "last frame not written" );
+    Bench_RecordPercentiles( "channels", Params, "frame_commit_ns", FrameNs );
+
+    // The last channel, so the writer looks at every dirty word before finding it.
+    vector< uint64_t > SingleNs;
+    BBBPWMNullDevice* Last = Devices[ Channels - 1 ];
+    End = Bench_Now( ) + ( uint64_t )( Seconds * 1e9 );
+    while( Bench_Now( ) < End ) {
+        int Duty = 300000 + ( SingleNs.size( ) & 0xff ) * 100;
+        if( Duty == Last->PWM_GetDutyVal( ) )
+            Duty += 50;
+        uint64_t Start = Bench_Now( );
+        Last->PWM_SetTargetSpeed( Duty );
+        while( Last->PWM_GetDutyVal( ) != Duty )
+            sched_yield( );
+        SingleNs.push_back( Bench_Now( ) - Start );
+    }
+    Bench_RecordPercentiles( "channels", Params, "single_commit_ns", SingleNs );
+
+    const int Rounds = 2000;
+    volatile int Sink = 0;
+    uint64_t Start = Bench_Now( );
+    for( int r = 0; r < Rounds; r++ ) {
+        Controller.PWM_GetChannelTable( ).PWM_GetDuties( Duties.data( ), Channels );
+        Sink += Duties[ r % Channels ];
+    }
+    uint64_t TableNs = Bench_Now( ) - Start;
+    Start = Bench_Now( );
+    for( int r = 0; r < Rounds; r++ ) {
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = Devices[ c ]->PWM_GetDutyVal( );
+        Sink += Duties[ r % Channels ];
+    }
+    uint64_t DeviceNs = Bench_Now( ) - Start;
+    Controller.PWM_GetChannelTable( ).PWM_GetDuties( Duties.data( ), Channels );
+    for( int c = 0; c < Channels; c++ )
+        Bench_Check( Duties[ c ] == Devices[ c ]->PWM_GetDutyVal( ), "channels", Params, "table and device disagree" );
+    Bench_Record( "channels", Params, "read_duties_ns_table", ( double ) TableNs / Rounds );
+    Bench_Record( "channels", Params, "read_duties_ns_devices", ( double ) DeviceNs / Rounds );
+    Bench_Record( "channels", Params, "table_bytes", 3 * Channels * sizeof( int ) + ( Channels + 31 ) / 32 * sizeof( uint32_t ) );
+}
+
+/**
+ \brief Whether the descriptors left in the backends are cold : one channel's target through a writer of Channels
+ sysfs devices, timed against the same with one device. The writer only opens the backend of a dirty channel, so the
+ commit should cost the same however many devices sit next to it, and no other backend may have written.
+ */
+static void Bench_Descriptors( const string& Root, int Channels, double Seconds ) {
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+    vector< BBBPWMDevice* >& Devices = Fixture.Devices;
+    Fixture.Start( );
+    string Params = "channels=" + to_string( Channels );
+
+    vector< BBBPWMMetrics > Before( Channels ), After( Channels );
+    for( int c = 0; c < Channels; c++ )
+        Devices[ c ]->PWM_GetMetrics( Before[ c ] );
+    vector< uint64_t > CommitNs;
+    BBBPWMDevice* Last = Devices[ Channels - 1 ];
+    uint64_t End = Bench_Now( ) + ( uint64_t )( Seconds * 1e9 );
+    while( Bench_Now( ) < End ) {
+        int Duty = 300000 + ( CommitNs.size( ) & 0xff ) * 100;
+        if( Duty == Last->PWM_GetDutyVal( ) )
+            Duty += 50;
+        uint64_t Start = Bench_Now( );
+        Last->PWM_SetTargetSpeed( Duty );
+        while( Last->PWM_GetDutyVal( ) != Duty )
+            sched_yield( );
+        CommitNs.push_back( Bench_Now( ) - Start );
+    }
+    int Touched = 0;
+    for( int c = 0; c < Channels - 1; c++ ) {
+        Devices[ c ]->PWM_GetMetrics( After[ c ] );
+        Touched += After[ c ].PWM_Writes != Before[ c ].PWM_Writes;
+    }
+    Bench_Check( Touched == 0, "descriptors", Params, "a clean channel's backend was written" );
+    Bench_RecordPercentiles( "descriptors", Params, "single_commit_ns", CommitNs );
+    Bench_Record( "descriptors", Params, "clean_backends_written", Touched );
+}
+
+/**
+ \brief Out-of-process control through BBBPWMShm : what a client pays to set Channels duties (stores only) against one
+ datagram on a socketpair, and how long a command takes to reach the kernel and come back in the status region with
+ the controller polling every PollUs.
+ */
+static void Bench_Shm( const string& Root, int Channels, int PollUs, int Samples ) {
+    const char* Name = "/bbbpwm_bench";
+    BBBPWMShm Server, Client;
+    if( Server.PWM_Create( Name, Channels ) < 0 || Client.PWM_Open( Name ) < 0 )
+        return;
+    Bench_Fixture< BBBPWMSysfsBackend > Fixture( Root, Channels );
+    BBBPWMController& Controller = Fixture.Writer( );
+    Controller.PWM_Serve( &Server, PollUs * 1000L );
+    Fixture.Start( );
+    string Params = "channels=" + to_string( Channels ) + " poll_us=" + to_string( PollUs );
+
+    // Client cost, the writer takes what it finds on its next poll.
+    const int Calls = 100000;
+    vector< int > Duties( Channels );
+    uint64_t Start = Bench_Now( );
+    for( int i = 0; i < Calls; i++ ) {
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = 300000 + ( i & 0xff ) * 100;
+        Client.PWM_SetDuties( Duties.data( ), Channels );
+    }
+    Bench_Record( "shm", Params, "set_duties_ns", ( double )( Bench_Now( ) - Start ) / Calls );
+
+    int Pair[ 2 ];
+    if( socketpair( AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, Pair ) == 0 ) {
+        atomic< bool > Done( false );
+        thread Drain( [ & ]( ) {
+            vector< int > Got( Channels );
+            while( !Done.load( ) )
+                if( recv( Pair[ 1 ], Got.data( ), Got.size( ) * sizeof( int ), MSG_DONTWAIT ) < 0 )
+                    usleep( 100 );
+        } );
+        Start = Bench_Now( );
+        for( int i = 0; i < Calls; i++ ) {
+            for( int c = 0; c < Channels; c++ )
+                Duties[ c ] = 300000 + ( i & 0xff ) * 100;
+            while( send( Pair[ 0 ], Duties.data( ), Duties.size( ) * sizeof( int ), 0 ) < 0 && errno == EINTR )
+                ;
+        }
+        Bench_Record( "shm", Params, "socket_send_ns", ( double )( Bench_Now( ) - Start ) / Calls );
+        Done.store( true );
+        Drain.join( );
+        close( Pair[ 0 ] );
+        close( Pair[ 1 ] );
+    }
+
+    // Command to write : from the client's stores to the writer's write of the last channel, as stamped in its status.
+    vector< uint64_t > ToWrite, ToStatus;
+    BBBPWMShmStatusRecord Status;
+    for( int i = 0; i < Samples; i++ ) {
+        int Duty = i & 1 ? 300000 : 400000;
+        for( int c = 0; c < Channels; c++ )
+            Duties[ c ] = Duty;
+        uint64_t Sent = Bench_Now( ), Seen = 0;
+        Client.PWM_SetDuties( Duties.data( ), Channels );
+        while( Bench_Now( ) - Sent < 1000000000ull ) {
+            Client.PWM_GetStatus( Channels - 1, Status );
+            if( Status.PWM_Duty == Duty && ( uint64_t ) Status.PWM_LastWriteNs >= Sent ) {
+                Seen = Bench_Now( );
+                break;
+            }
+            sched_yield( );
+        }
+        if( Seen ) {
+            ToWrite.push_back( Status.PWM_LastWriteNs - Sent );
+            ToStatus.push_back( Seen - Sent );
+        }
+    }
+    Bench_Check( Fixture.Settled( ), "shm", Params, "last commands not written" );
+    Fixture.Stop( );
+    Bench_RecordPercentiles( "shm", Params, "command_to_write_ns", ToWrite );
+    Bench_RecordPercentiles( "shm", Params, "command_to_status_ns", ToStatus );
+    Bench_Record( "shm", Params, "lost", Samples - ( double ) ToWrite.size( ) );
+    Bench_Check( ToWrite.size( ) == ( size_t ) Samples, "shm", Params, "commands lost" );
+    Client.PWM_Close( );
+    Server.PWM_Close( );
+    BBBPWMShm::PWM_Unlink( Name );
+}
+
+/**
+ \brief Nothing to prepare for backends that work on the fake tree.
+ */
+template< class Backend >
+static void Bench_PrepareBackend( Backend& Output ) {
+    ( void ) Output;
+}
+
+/**
+ \brief Points an eHRPWM backend at a memfd standing in for the three PWM subsystems instead of /dev/mem.
+ */
+static void Bench_PrepareBackend( BBBPWMEhrpwmBackend& Output ) {
+    static int Registers = -1;
+    if( Registers < 0 ) {
+        Registers = memfd_create( "bbbpwm_bench_epwm", MFD_CLOEXEC );
+        if( Registers < 0 || ftruncate( Registers, PWM_EHRPWM_MODULES * PWM_EHRPWM_STRIDE ) != 0 ) {
+            cerr << "Unable to create the ePWM register file : " << strerror( errno ) << endl;
+            exit( 1 );
+        }
+    }
+    Output.PWM_SetMemory( Registers, 0 );
+}
+
+/**
+ \brief The same device and writer over each output backend : PWM_Init( ) time, updates through the writer thread
+ (PWM_SetTargetSpeed( )) and, once it is stopped, synchronous writes from the caller (PWM_SetRunVal( )) for Seconds each. The null backend
+ is the cost of the device and controller alone, the sysfs backend adds the kernel, the sim backend its log, the
+ eHRPWM backend register stores (to a memfd here, uncached device memory on a board).
+ */
+template< class Backend >
+static void Bench_Backend( const string& Root, const string& Name, int Pin, double Seconds ) {
+    BBBPWMBasicDevice< Backend > Device;
+    Bench_SetupDevice( Device, Root, Pin );
+    Bench_PrepareBackend( Device.PWM_GetBackend( ) );
+    uint64_t Start = Bench_Now( );
+    Device.PWM_Init( );
+    uint64_t InitNs = Bench_Now( ) - Start;
+    Device.PWM_SetLatencyTiming( false );
+
+    uint64_t Sync = 0, Updates = 0, End;
+    BBBPWMMetrics Before, After;
+    Device.PWM_GetMetrics( Before );
+    Start = Bench_Now( );
+    for( End = Start + ( uint64_t )( Seconds * 1e9 ); ( Updates & 1023 ) != 0 || Bench_Now( ) < End; Updates++ )
+        Device.PWM_SetTargetSpeed( Updates & 1 ? 300000 : 400000 );
+    Device.PWM_StopThread( );
+    double AsyncSecs = ( Bench_Now( ) - Start ) / 1e9;
+    Device.PWM_GetMetrics( After );
+
+    // Without its writer the device writes run itself, in the caller.
+    Start = Bench_Now( );
+    for( End = Start + ( uint64_t )( Seconds * 1e9 ); ( Sync & 1023 ) != 0 || Bench_Now( ) < End; Sync++ )
+        Device.PWM_SetRunVal( Sync & 1 ? BBBPWMDevice::ON : BBBPWMDevice::OFF );
+    double SyncSecs = ( Bench_Now( ) - Start ) / 1e9;
+
+    string Params = "backend=" + Name;
+    Bench_Record( "backend", Params, "init_ns", InitNs );
+    Bench_Record( "backend", Params, "sync_writes_per_sec", Sync / SyncSecs );
+    Bench_Record( "backend", Params, "updates_per_sec", Updates / AsyncSecs );
+    Bench_Record( "backend", Params, "writes_per_sec", ( After.PWM_Writes - Before.PWM_Writes ) / AsyncSecs );
+}
+
+/**
+ \brief One control tick the way the controller's writer runs it : PWM_BatchBegin( ), a duty write per channel,
+ PWM_BatchEnd( ), back to back for Seconds over Channels pins of the fake tree (ordinary tmpfs files). Reports the tick
+ time and the write syscalls per tick : one pwrite( ) per channel for the sysfs backend, io_uring_enter( ) calls for the
+ io_uring one (including any made to wait for the previous tick's write to a channel to complete).
+ */
+template< class Backend >
+static void Bench_Batch( const string& Root, const string& Name, int Channels, double Seconds ) {
+    vector< Backend* > Pins;
+    for( int c = 0; c < Channels; c++ ) {
+        Pins.push_back( new Backend( ) );
+        Pins[ c ]->PWM_SetRoot( Root );
+        if( !Pins[ c ]->PWM_Attach( BBBPWMDevice::P9, c + 1 ) )
+            exit( 1 );
+    }
+
+    vector< uint64_t > TickNs;
+    uint64_t Enters = BBBPWMUringBackend::PWM_GetEnterCount( ), Ticks = 0, Failed = 0;
+    uint64_t Start = Bench_Now( ), End = Start + ( uint64_t )( Seconds * 1e9 );
+    for( uint64_t Now = Start; Now < End; Ticks++ ) {
+        Failed += Backend::PWM_BatchBegin( );
+        for( int c = 0; c < Channels; c++ )
+            Pins[ c ]->PWM_Write( PWM_ATTR_DUTY, 200000 + ( int )( Ticks & 1023 ) * 100 );
+        Failed += Backend::PWM_BatchEnd( );
+        uint64_t Then = Bench_Now( );
+        TickNs.push_back( Then - Now );
+        Now = Then;
+    }
+    Enters = BBBPWMUringBackend::PWM_GetEnterCount( ) - Enters;
+    for( int c = 0; c < Channels; c++ )
+        delete Pins[ c ];
+
+    string Params = "backend=" + Name + " channels=" + to_string( Channels );
+    bool Uring = Enters > 0;
+    Bench_Record( "batch", Params, "ticks_per_sec", Ticks / ( ( Bench_Now( ) - Start ) / 1e9 ) );
+    Bench_Record( "batch", Params, "write_syscalls_per_tick", Uring ? ( double ) Enters / Ticks : Channels );
+    Bench_Record( "batch", Params, "failed_writes", Failed );
+    Bench_RecordPercentiles( "batch", Params, "tick_ns", TickNs );
+}
+
+/**
+ \brief Prints every result as aligned text, CSV (with a header row) or a JSON document.
+ */
+static void Bench_Print( const string& Format, const string& Tag ) {
+    cout.precision( 15 );
+    if( Format == "csv" ) {
+        cout << "tag,bench,params,metric,value" << endl;
+        for( size_t i = 0; i < Bench_Results.size( ); i++ )
+            cout << Tag << "," << Bench_Results[ i ].Bench << ",\"" << Bench_Results[ i ].Params << "\","
+                 << Bench_Results[ i ].Metric << "," << Bench_Results[ i ].Value << endl;
+    }
+    else if( Format == "json" ) {
+        cout << "{\"tag\":\"" << Tag << "\",\"results\":[" << endl;
+        for( size_t i = 0; i < Bench_Results.size( ); i++ )
+            cout << "  {\"bench\":\"" << Bench_Results[ i ].Bench << "\",\"params\":\"" << Bench_Results[ i ].Params
+                 << "\",\"metric\":\"" << Bench_Results[ i ].Metric << "\",\"value\":" << Bench_Results[ i ].Value << "}"
+                 << ( i + 1 < Bench_Results.size( ) ? "," : "" ) << endl;
+        cout << "]}" << endl;
+    }
+    else {
+        for( size_t i = 0; i < Bench_Results.size( ); i++ )
+            cout << Bench_Results[ i ].Bench << " " << ( Bench_Results[ i ].Params.empty( ) ? "-" : Bench_Results[ i ].Params )
+                 << " " << Bench_Results[ i ].Metric << " " << Bench_Results[ i ].Value << endl;
+    }
+}
+
+int main( int argc, char** argv ) {
+    // /dev/shm is tmpfs on every Linux system, the closest thing to sysfs available without a board.
+    string Root = "/dev/shm/bbbpwm_bench", Format = "text", Tag = "";
+    double Seconds = 0.5;
+    int MaxChannels = 32;
+    for( int i = 1; i < argc; i++ ) {
+        string Arg = argv[ i ];
+        string Value = Arg.find( '=' ) == string::npos ? "" : Arg.substr( Arg.find( '=' ) + 1 );
+        if( Arg.compare( 0, 7, "--root=" ) == 0 )
+            Root = Value;
+        else if( Arg.compare( 0, 9, "--format=" ) == 0 )
+            Format = Value;
+        else if( Arg.compare( 0, 6, "--tag=" ) == 0 )
+            Tag = Value;
+        else if( Arg.compare( 0, 10, "--seconds=" ) == 0 )
+            Seconds = atof( Value.c_str( ) );
+        else if( Arg.compare( 0, 11, "--channels=" ) == 0 )
+            MaxChannels = std::max( 1, std::min( 32, atoi( Value.c_str( ) ) ) );
+        else if( Arg.compare( 0, 7, "--only=" ) == 0 )
+            Bench_Only = Value;
+        else {
+            cerr << "Unknown option : " << Arg << endl;
+            return 1;
+        }
+    }
+
+    vector< int > Pins;
+    for( int Pin = 1; Pin <= 32; Pin++ )
+        Pins.push_back( Pin );
+    Pins.push_back( BBBPWMDevice::PWM42 );
+    Bench_MakeFakeTree( Root, Pins );
+    Bench_MakeClassTree( Root );
+
+    if( Bench_Selected( "wake" ) ) {
+        Bench_WakeLatency( Root, 10000 );
+        for( int Hog = 0; Hog < 2; Hog++ ) {
+            Bench_WakeUnderLoad( Root, 2000, false, Hog == 1 );
+            Bench_WakeUnderLoad( Root, 2000, true, Hog == 1 );
+        }
+    }
+    if( Bench_Selected( "codec" ) )
+        Bench_Codec( Root );
+    if( Bench_Selected( "metrics" ) )
+        Bench_Metrics( Root );
+    if( Bench_Selected( "init" ) ) {
+        Bench_ColdStart( Root, BBBPWMDevice::PWM42, -1, 50 );
+        Bench_ColdStart( Root, BBBPWMDevice::PWM42, 0, 50 );
+        Bench_ColdStart( Root, BBBPWMDevice::PWM42, 50000, 5 );
+        Bench_BulkInit( Root, false, 50000, 5 );
+        Bench_BulkInit( Root, true, 50000, 5 );
+        Bench_ClassInit( Root, 50 );
+    }
+    if( Bench_Selected( "playback" ) )
+        Bench_Playback( Root, 4, 2000, 500 );
+    if( Bench_Selected( "trace" ) )
+        Bench_Trace( Root, 4, Seconds );
+    if( Bench_Selected( "calibration" ) ) {
+        Bench_Calibration( Root, 4, Seconds );
+        Bench_Calibration( Root, 32, Seconds );
+    }
+    if( Bench_Selected( "failsafe" ) ) {
+        Bench_Failsafe( Root, 4, 10, 50 );
+        Bench_Failsafe( Root, 4, 50, 10 );
+    }
+    if( Bench_Selected( "frame" ) ) {
+        Bench_Frame( Root, 4, 0, Seconds );
+        Bench_Frame( Root, 4, 1000, Seconds );
+    }
+    if( Bench_Selected( "channels" ) ) {
+        Bench_Channels( 64, Seconds );
+        Bench_Channels( 1024, Seconds );
+    }
+    if( Bench_Selected( "descriptors" ) ) {
+        Bench_Descriptors( Root, 1, Seconds );
+        Bench_Descriptors( Root, MaxChannels, Seconds );
+    }
+    if( Bench_Selected( "shm" ) ) {
+        Bench_Shm( Root, 4, 1000, 500 );
+        Bench_Shm( Root, 4, 250, 500 );
+    }
+    if( Bench_Selected( "control" ) ) {
+        Bench_Control( Root, 4, 2500, Seconds );
+        Bench_Control( Root, 4, 500, Seconds );
+    }
+    if( Bench_Selected( "backend" ) ) {
+        Bench_Backend< BBBPWMSysfsBackend >( Root, "sysfs", BBBPWMDevice::PWM42, Seconds );
+        Bench_Backend< BBBPWMSimBackend >( Root, "sim", BBBPWMDevice::PWM42, Seconds );
+        Bench_Backend< BBBPWMNullBackend >( Root, "null", BBBPWMDevice::PWM42, Seconds );
+        // P9_42 is eCAP0, P9_14 is ePWM1A.
+        Bench_Backend< BBBPWMEhrpwmBackend >( Root, "ehrpwm", BBBPWMDevice::PWM14, Seconds );
+        Bench_Backend< BBBPWMClassBackend >( Root, "class", BBBPWMDevice::PWM14, Seconds );
+    }
+    if( Bench_Selected( "batch" ) ) {
+        if( !BBBPWMUringBackend::PWM_IsAvailable( ) )
+            cerr << "Warning : io_uring unavailable, the uring backend falls back to pwrite( )." << endl;
+        for( int Channels = 1; Channels <= MaxChannels; Channels *= 4 ) {
+            Bench_Batch< BBBPWMSysfsBackend >( Root, "sysfs", Channels, Seconds );
+            Bench_Batch< BBBPWMUringBackend >( Root, "uring", Channels, Seconds );
+        }
+    }
+    if( Bench_Selected( "sweep" ) ) {
+        for( int Channels = 1; Channels <= MaxChannels; Channels *= 2 ) {
+            Bench_ChannelSweep( Root, Channels, false, Seconds );
+            Bench_ChannelSweep( Root, Channels, true, Seconds );
+        }
+    }
+
+    Bench_Print( Format, Tag );
+    return Bench_Failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+//
+//  BBBPWMEhrpwmTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  Maps a memfd in place of /dev/mem through PWM_SetMemory( ), drives duty, period and run on both outputs of ePWM1
+//  (P9_14 on A, P9_16 on B) and checks the registers they land in : TBPRD, CMPA / CMPB, the TBCTL clock divider, the
+//  action qualifiers and AQCSFRC, including the compare rescale when a period change moves the divider.
+//
+
+#include <sys/mman.h>
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+#define PWM_TEST_MODULE        1 //!< ePWM1, outputs A and B on P9_14 and P9_16.
+
+static int PWM_TestFD = -1; //!< The memfd standing in for /dev/mem, all three subsystems from offset 0.
+
+/**
+ \fn static function int PWM_TestReg( int Offset )
+ \brief Reads a 16 bit ePWM register of PWM_TEST_MODULE out of the memfd.
+ \param <int> Offset (PWM_EHRPWM_TBCTL ...)
+ \return <int> register value
+ */
+static int PWM_TestReg( int Offset ) {
+    uint16_t PWM_Value = 0;
+    if( pread( PWM_TestFD, &PWM_Value, sizeof( PWM_Value ), PWM_TEST_MODULE * PWM_EHRPWM_STRIDE + PWM_EHRPWM_EPWM + Offset ) != sizeof( PWM_Value ) )
+        cerr << "Unable to read register " << Offset << " : " << strerror( errno ) << endl;
+    return PWM_Value;
+}
+
+/**
+ \fn static function int PWM_TestDivider( void )
+ \brief CLKDIV of PWM_TEST_MODULE, the time base tick is PWM_EHRPWM_CLOCK_NS << CLKDIV.
+ \param <void>
+ \return <int> 0 - 7
+ */
+static int PWM_TestDivider( void ) {
+    return ( PWM_TestReg( PWM_EHRPWM_TBCTL ) >> 10 ) & 7;
+}
+
+int main( ) {
+    PWM_TestFD = memfd_create( "BBBPWMEhrpwmTest", MFD_CLOEXEC );
+    if( PWM_TestFD < 0 || ftruncate( PWM_TestFD, PWM_EHRPWM_MODULES * PWM_EHRPWM_STRIDE ) < 0 ) {
+        cerr << "Unable to create the register memfd : " << strerror( errno ) << endl;
+        return 1;
+    }
+
+    BBBPWMEhrpwmDevice A, B;
+    A.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    A.PWM_SetPinNum( BBBPWMDevice::PWM14 );
+    A.PWM_GetBackend( ).PWM_SetMemory( PWM_TestFD, 0 );
+    B.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    B.PWM_SetPinNum( BBBPWMDevice::PWM16 );
+    B.PWM_GetBackend( ).PWM_SetMemory( PWM_TestFD, 0 );
+    PWM_CHECK_EQ( A.PWM_Init( ), 1 );
+    PWM_CHECK_EQ( B.PWM_Init( ), 1 );
+
+    // Attach : clock gated on, module stopped at the 1.2ms start period, which needs CLKDIV 1 (20ns) to fit TBPRD.
+    uint32_t PWM_ClkConfig = 0;
+    PWM_CHECK_EQ( pread( PWM_TestFD, &PWM_ClkConfig, sizeof( PWM_ClkConfig ), PWM_TEST_MODULE * PWM_EHRPWM_STRIDE + PWM_EHRPWM_CLKCONFIG ), ( ssize_t ) sizeof( PWM_ClkConfig ) );
+    PWM_CHECK( PWM_ClkConfig & 0x100 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBCTL ) & 3, 3 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBCTL ) & 0x8, 0 );
+    PWM_CHECK_EQ( PWM_TestDivider( ), 1 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBPRD ), PWM_EHRPWM_PERIOD / 20 - 1 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPA ), PWM_EHRPWM_DUTY / 20 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPB ), PWM_EHRPWM_DUTY / 20 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPCTL ) & 0x5F, 0 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_AQCTLA ), 0x0012 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_AQCTLB ), 0x0102 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_AQCSFRC ), 0x5 );
+    PWM_CHECK_EQ( A.PWM_GetPeriodVal( ), PWM_EHRPWM_PERIOD );
+    PWM_CHECK_EQ( A.PWM_GetDutyVal( ), PWM_EHRPWM_DUTY );
+    PWM_CHECK_EQ( A.PWM_GetRunVal( ), 0 );
+
+    // Run : only A's force is lifted, and the counter starts. Written by A's writer thread.
+    PWM_CHECK_EQ( A.PWM_SetRunVal( BBBPWMDevice::ON ), 1 );
+    for( int w = 0; w < 1000 && A.PWM_GetRunVal( ) != BBBPWMDevice::ON; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_AQCSFRC ), 0x4 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBCTL ) & 3, 0 );
+
+    // 1.9ms needs CLKDIV 2 (40ns) : both compares are rescaled so the duties stay the same in ns.
+    PWM_CHECK_EQ( A.PWM_SetPeriodVal( BBBPWMDevice::ACTIVE ), 1 );
+    for( int w = 0; w < 1000 && A.PWM_GetPeriodVal( ) != BBBPWMDevice::ACTIVE; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( PWM_TestDivider( ), 2 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBPRD ), BBBPWMDevice::ACTIVE / 40 - 1 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPA ), PWM_EHRPWM_DUTY / 40 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPB ), PWM_EHRPWM_DUTY / 40 );
+
+    // Duty through the writer thread lands in A's compare only.
+    A.PWM_SetTargetSpeed( 400000 );
+    for( int w = 0; w < 1000 && A.PWM_GetDutyVal( ) != 400000; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPA ), 400000 / 40 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPB ), PWM_EHRPWM_DUTY / 40 );
+
+    // Back down to CLKDIV 1 from B's side : the module is shared, A's compare is rescaled as well.
+    PWM_CHECK_EQ( B.PWM_SetPeriodVal( ( BBBPWMDevice::PWM_PeriodValues ) 1000000 ), 1 );
+    for( int w = 0; w < 1000 && B.PWM_GetPeriodVal( ) != 1000000; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( PWM_TestDivider( ), 1 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_TBPRD ), 1000000 / 20 - 1 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPA ), 400000 / 20 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPB ), PWM_EHRPWM_DUTY / 20 );
+    int PWM_Duty = 0;
+    PWM_CHECK_EQ( A.PWM_GetBackend( ).PWM_Read( PWM_ATTR_DUTY, PWM_Duty ), 1 );
+    PWM_CHECK_EQ( PWM_Duty, 400000 );
+
+    // A duty past the period is refused and leaves the compare alone, like the pwm_test driver.
+    errno = 0;
+    PWM_CHECK_EQ( B.PWM_GetBackend( ).PWM_Write( PWM_ATTR_DUTY, 2000000 ), 0 );
+    PWM_CHECK_EQ( errno, EINVAL );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_CMPB ), PWM_EHRPWM_DUTY / 20 );
+
+    // Stop : A forced low again, B untouched.
+    PWM_CHECK_EQ( A.PWM_SetRunVal( BBBPWMDevice::OFF ), 1 );
+    for( int w = 0; w < 1000 && A.PWM_GetRunVal( ) != BBBPWMDevice::OFF; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( PWM_TestReg( PWM_EHRPWM_AQCSFRC ), 0x5 );
+
+    A.PWM_StopThread( );
+    B.PWM_StopThread( );
+    close( PWM_TestFD );
+    return PWM_TestResult( "BBBPWMEhrpwmTest" );
+}
@@ -0,0 +1,80 @@
+//
+//  BBBPWMFailsafeTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  Only new duty targets feed the failsafe watchdog : a channel kept busy with ramp cancels and period changes still
+//  trips, a channel given targets does not, and the next target clears a trip. A restart clears the trips under a
+//  thread still reading them.
+//
+
+#include <thread>
+#include <atomic>
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+#define PWM_TEST_TIMEOUT_MS    30 //!< Failsafe timeout of both channels.
+
+int main( ) {
+    BBBPWMSimController Controller;
+    BBBPWMSimDevice Devices[ 2 ];
+    BBBPWMDevice::PWM_PinNum Pins[ 2 ] = { BBBPWMDevice::PWM14, BBBPWMDevice::PWM16 };
+    for( int c = 0; c < 2; c++ ) {
+        Devices[ c ].PWM_SetBlockNum( BBBPWMDevice::P9 );
+        Devices[ c ].PWM_SetPinNum( Pins[ c ] );
+        Controller.PWM_AddDevice( &Devices[ c ] );
+    }
+    vector< int > Status;
+    PWM_CHECK_EQ( Controller.PWM_InitDevices( Status ), 2 );
+    PWM_CHECK_EQ( Devices[ 1 ].PWM_SetRunVal( BBBPWMDevice::ON ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_SetFailsafe( 0, PWM_TEST_TIMEOUT_MS, 160000 ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_SetFailsafe( 1, PWM_TEST_TIMEOUT_MS, PWM_FAILSAFE_DISABLE ), 1 );
+    Devices[ 0 ].PWM_SetPeriodSlew( 1000 );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+
+    // Three timeouts : channel 0 only sees updates that are not targets, channel 1 a new target every 2ms.
+    for( int i = 0; i < 3 * PWM_TEST_TIMEOUT_MS / 2; i++ ) {
+        Devices[ 0 ].PWM_CancelRamp( );
+        Devices[ 0 ].PWM_SetPeriodVal( i % 2 ? BBBPWMDevice::ACTIVE : BBBPWMDevice::STARTUP );
+        Devices[ 1 ].PWM_SetTargetSpeed( 300000 + i * 1000 );
+        usleep( 2000 );
+    }
+    PWM_CHECK( Controller.PWM_IsFailsafe( 0 ) );
+    PWM_CHECK( !Controller.PWM_IsFailsafe( 1 ) );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetDutyVal( ), 160000 );
+    PWM_CHECK_EQ( Devices[ 1 ].PWM_GetRunVal( ), ( int ) BBBPWMDevice::ON );
+
+    // Targets clear the trip, silence trips channel 1 through its run value.
+    for( int w = 0; w < 1000 && ( Controller.PWM_IsFailsafe( 0 ) || Devices[ 1 ].PWM_GetRunVal( ) != BBBPWMDevice::OFF ); w++ ) {
+        Devices[ 0 ].PWM_SetTargetSpeed( 400000 );
+        usleep( 1000 );
+    }
+    PWM_CHECK( !Controller.PWM_IsFailsafe( 0 ) );
+    PWM_CHECK( Controller.PWM_IsFailsafe( 1 ) );
+    PWM_CHECK_EQ( Devices[ 1 ].PWM_GetRunVal( ), ( int ) BBBPWMDevice::OFF );
+    PWM_CHECK_EQ( Devices[ 1 ].PWM_GetBackend( ).PWM_GetValue( PWM_ATTR_RUN ), ( int ) BBBPWMDevice::OFF );
+    Controller.PWM_Stop( );
+
+    BBBPWMFailsafeStats Stats;
+    Controller.PWM_GetFailsafeStats( Stats );
+    PWM_CHECK( Stats.PWM_Trips >= 2 );
+    PWM_CHECK( Stats.PWM_Recoveries >= 1 );
+
+    // Re-armed with a long timeout while another thread keeps asking : channel 1 is no longer held.
+    PWM_CHECK( Controller.PWM_IsFailsafe( 1 ) );
+    PWM_CHECK_EQ( Controller.PWM_SetFailsafe( 1, 100 * PWM_TEST_TIMEOUT_MS, PWM_FAILSAFE_DISABLE ), 1 );
+    atomic< bool > Reading( true );
+    thread Reader( [ & ]( ) {
+        while( Reading.load( memory_order_relaxed ) )
+            Controller.PWM_IsFailsafe( 1 );
+    } );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+    PWM_CHECK( !Controller.PWM_IsFailsafe( 1 ) );
+    Controller.PWM_Stop( );
+    Reading.store( false, memory_order_relaxed );
+    Reader.join( );
+    return PWM_TestResult( "BBBPWMFailsafeTest" );
+}
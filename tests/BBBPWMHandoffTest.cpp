@@ -0,0 +1,192 @@
+//
+//  BBBPWMHandoffTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  Hammers PWM_SetTargetSpeed( ) from one thread per channel while the writer thread drains the targets and another
+//  thread reads them back, then keeps storing targets while the controller is stopped and restarted under them. Run by
+//  make test, and by make tsan where ThreadSanitizer must not report a race.
+//
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+#define PWM_TEST_TARGETS       100000 //!< Targets each producer stores.
+
+/**
+ \fn static function int PWM_TestTarget( int Index )
+ \brief The Index'th target a producer stores, rising through PWM_DUTY_LOW - PWM_DUTY_HIGH so that the writer can never go back.
+ \param <int> Index
+ \return <int> duty in ns
+ */
+static int PWM_TestTarget( int Index ) {
+    return PWM_DUTY_LOW + ( int )( ( int64_t ) Index * ( PWM_DUTY_HIGH - PWM_DUTY_LOW ) / ( PWM_TEST_TARGETS - 1 ) );
+}
+
+/**
+ \fn static function void PWM_TestProduce( BBBPWMSimDevice* Device )
+ \brief Stores every target as fast as it can.
+ \param <BBBPWMSimDevice*> Device
+ \return <void>
+ */
+static void PWM_TestProduce( BBBPWMSimDevice* Device ) {
+    for( int i = 0; i < PWM_TEST_TARGETS; i++ )
+        Device->PWM_SetTargetSpeed( PWM_TestTarget( i ) );
+}
+
+/**
+ \fn static function void PWM_TestCheckDrained( BBBPWMSimDevice& Device )
+ \brief The writer must have caught up with the last target, and written only targets a producer stored, in order.
+ \param <BBBPWMSimDevice&> Device
+ \return <void>
+ */
+static void PWM_TestCheckDrained( BBBPWMSimDevice& Device ) {
+    int Last = PWM_TestTarget( PWM_TEST_TARGETS - 1 );
+    for( int w = 0; w < 1000 && Device.PWM_GetDutyVal( ) != Last; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( Device.PWM_GetTargetSpeed( ), Last );
+    PWM_CHECK_EQ( Device.PWM_GetDutyVal( ), Last );
+    PWM_CHECK_EQ( Device.PWM_GetBackend( ).PWM_GetValue( PWM_ATTR_DUTY ), Last );
+
+    vector< BBBPWMSimWrite > Writes;
+    Device.PWM_GetBackend( ).PWM_GetWrites( Writes );
+    int Previous = 0, Duties = 0, Backwards = 0;
+    for( size_t i = 0; i < Writes.size( ); i++ ) {
+        if( Writes[ i ].PWM_Attr != PWM_ATTR_DUTY )
+            continue;
+        Duties++;
+        if( Writes[ i ].PWM_Value < Previous )
+            Backwards++;
+        Previous = Writes[ i ].PWM_Value;
+    }
+    PWM_CHECK( Duties > 0 );
+    PWM_CHECK( Duties <= PWM_TEST_TARGETS );
+    PWM_CHECK_EQ( Backwards, 0 );
+}
+
+/**
+ \fn static function void PWM_TestPrivateWriter( void )
+ \brief One device on its own writer thread, one producer and one reader.
+ \param <void>
+ \return <void>
+ */
+static void PWM_TestPrivateWriter( void ) {
+    BBBPWMSimDevice Device;
+    Device.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    Device.PWM_SetPinNum( BBBPWMDevice::PWM14 );
+    PWM_CHECK_EQ( Device.PWM_Init( ), 1 );
+    Device.PWM_GetBackend( ).PWM_ClearWrites( );
+
+    atomic< bool > Done( false );
+    int Reads = 0, OutOfRange = 0;
+    thread Reader( [ & ]( ) {
+        while( !Done.load( ) ) {
+            int Duty = Device.PWM_GetDutyVal( );
+            if( Duty < PWM_DUTY_LOW || Duty > PWM_DUTY_HIGH )
+                OutOfRange++;
+            Reads++;
+        }
+    } );
+    thread Producer( PWM_TestProduce, &Device );
+    Producer.join( );
+    PWM_TestCheckDrained( Device );
+    Done.store( true );
+    Reader.join( );
+    PWM_CHECK( Reads > 0 );
+    PWM_CHECK_EQ( OutOfRange, 0 );
+
+    BBBPWMMetrics Metrics;
+    Device.PWM_GetMetrics( Metrics );
+    PWM_CHECK_EQ( Metrics.PWM_WriteFailures, 0u );
+    Device.PWM_StopThread( );
+}
+
+/**
+ \fn static function void PWM_TestSharedWriter( void )
+ \brief Four devices on one controller, one producer each, so the dirty bits of a word are set from several threads.
+ \param <void>
+ \return <void>
+ */
+static void PWM_TestSharedWriter( void ) {
+    const int Channels = 4;
+    BBBPWMSimController Controller;
+    BBBPWMSimDevice Devices[ Channels ], Extra;
+    BBBPWMDevice::PWM_PinNum Pins[ Channels ] = { BBBPWMDevice::PWM14, BBBPWMDevice::PWM16, BBBPWMDevice::PWM21, BBBPWMDevice::PWM22 };
+    // Sized once : the arrays the producers store into never move.
+    PWM_CHECK_EQ( Controller.PWM_Reserve( Channels ), 1 );
+    for( int c = 0; c < Channels; c++ ) {
+        Devices[ c ].PWM_SetBlockNum( BBBPWMDevice::P9 );
+        Devices[ c ].PWM_SetPinNum( Pins[ c ] );
+        PWM_CHECK_EQ( Controller.PWM_AddDevice( &Devices[ c ] ), c );
+    }
+    PWM_CHECK_EQ( Controller.PWM_AddDevice( &Extra ), -1 );
+    PWM_CHECK_EQ( Controller.PWM_GetChannelTable( ).PWM_GetCapacity( ), Channels );
+    vector< int > Status;
+    PWM_CHECK_EQ( Controller.PWM_InitDevices( Status ), Channels );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+    for( int c = 0; c < Channels; c++ )
+        Devices[ c ].PWM_GetBackend( ).PWM_ClearWrites( );
+
+    vector< thread > Producers;
+    for( int c = 0; c < Channels; c++ )
+        Producers.push_back( thread( PWM_TestProduce, &Devices[ c ] ) );
+    for( int c = 0; c < Channels; c++ )
+        Producers[ c ].join( );
+    for( int c = 0; c < Channels; c++ )
+        PWM_TestCheckDrained( Devices[ c ] );
+
+    int Duties[ Channels ];
+    PWM_CHECK_EQ( Controller.PWM_GetChannelTable( ).PWM_GetDuties( Duties, Channels ), 1 );
+    for( int c = 0; c < Channels; c++ )
+        PWM_CHECK_EQ( Duties[ c ], PWM_TestTarget( PWM_TEST_TARGETS - 1 ) );
+    Controller.PWM_Stop( );
+}
+
+/**
+ \fn static function void PWM_TestRestart( void )
+ \brief A producer that never stops while the controller is stopped and started again : its last target still lands.
+ \param <void>
+ \return <void>
+ */
+static void PWM_TestRestart( void ) {
+    BBBPWMSimController Controller;
+    BBBPWMSimDevice Device;
+    Device.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    Device.PWM_SetPinNum( BBBPWMDevice::PWM14 );
+    Controller.PWM_AddDevice( &Device );
+    vector< int > Status;
+    PWM_CHECK_EQ( Controller.PWM_InitDevices( Status ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+    // Away from the last target, which is the pin's starting duty, so that it has to be written again.
+    Device.PWM_SetTargetSpeed( PWM_DUTY_LOW );
+    for( int w = 0; w < 1000 && Device.PWM_GetDutyVal( ) != PWM_DUTY_LOW; w++ )
+        usleep( 1000 );
+    Device.PWM_GetBackend( ).PWM_ClearWrites( );
+
+    atomic< bool > Stopping( false );
+    thread Producer( PWM_TestProduce, &Device );
+    thread Restarter( [ & ]( ) {
+        while( !Stopping.load( ) ) {
+            Controller.PWM_Stop( );
+            PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+        }
+    } );
+    Producer.join( );
+    Stopping.store( true );
+    Restarter.join( );
+    PWM_TestCheckDrained( Device );
+    Controller.PWM_Stop( );
+}
+
+int main( ) {
+    PWM_TestPrivateWriter( );
+    PWM_TestSharedWriter( );
+    PWM_TestRestart( );
+    return PWM_TestResult( "BBBPWMHandoffTest" );
+}
@@ -0,0 +1,74 @@
+//
+//  BBBPWMReconcileTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  A run value the writer thread batches through io_uring and the kernel then refuses must come back to the device :
+//  PWM_GetRunVal( ) reports what the pin still holds and the writer keeps retrying it on the tick. The pin is a fake
+//  sysfs tree in /dev/shm whose run attribute points at /dev/full, so every run write fails with ENOSPC, while the
+//  duty written in the same passes still lands.
+//
+
+#include <stdlib.h>
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+#define PWM_TEST_ROOT          "/dev/shm/BBBPWMReconcileTest"
+#define PWM_TEST_PIN           PWM_TEST_ROOT "/devices/ocp.3/pwm_test_P9_14.3"
+
+int main( ) {
+    if( system( "rm -rf " PWM_TEST_ROOT " && mkdir -p " PWM_TEST_ROOT "/devices/bone_capemgr.9 " PWM_TEST_ROOT "/devices/ocp.3/48300000.epwmss "
+                PWM_TEST_PIN " && touch " PWM_TEST_ROOT "/devices/bone_capemgr.9/slots && echo x > " PWM_TEST_ROOT "/devices/ocp.3/48300000.epwmss/modalias"
+                " && echo 500000 > " PWM_TEST_PIN "/duty && echo 1900000 > " PWM_TEST_PIN "/period && echo 0 > " PWM_TEST_PIN "/run" ) != 0 ) {
+        cerr << "Unable to create " << PWM_TEST_ROOT << endl;
+        return 1;
+    }
+
+    BBBPWMUringController Controller;
+    BBBPWMUringDevice Device;
+    Device.PWM_SetSysfsRoot( PWM_TEST_ROOT );
+    Device.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    Device.PWM_SetPinNum( BBBPWMDevice::PWM14 );
+    Controller.PWM_AddDevice( &Device );
+    vector< int > Status;
+    PWM_CHECK_EQ( Controller.PWM_InitDevices( Status ), 1 );
+    PWM_CHECK_EQ( Device.PWM_GetRunVal( ), 0 );
+
+    // Run now fails, reopened through the new link on the next write.
+    PWM_CHECK_EQ( system( "rm " PWM_TEST_PIN "/run && ln -s /dev/full " PWM_TEST_PIN "/run" ), 0 );
+    Device.PWM_GetBackend( ).PWM_Close( );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+
+    // A frame's run is written by the writer thread, inside its batch when io_uring is available.
+    int Duty = 400000, Run = BBBPWMDevice::ON;
+    PWM_CHECK( Controller.PWM_SetFrame( &Duty, 1, NULL, &Run ) > 0 );
+    usleep( 100000 );
+
+    BBBPWMMetrics Before, After;
+    Device.PWM_GetMetrics( Before );
+    PWM_CHECK( Before.PWM_FailuresByErrno[ ENOSPC ] >= 1 );
+    if( BBBPWMUringBackend::PWM_IsAvailable( ) ) {
+        // Rolled back and retried on the tick, not forgotten.
+        usleep( 50000 );
+        Device.PWM_GetMetrics( After );
+        PWM_CHECK( After.PWM_FailuresByErrno[ ENOSPC ] > Before.PWM_FailuresByErrno[ ENOSPC ] );
+    }
+    else
+        cout << "io_uring unavailable, only the unbatched write was checked" << endl;
+    // Meanwhile each retry reads as written until its completion is reaped, once stopped the pin's value is back.
+    Controller.PWM_Stop( );
+    PWM_CHECK_EQ( Device.PWM_GetRunVal( ), 0 );
+    // The run failing cancels nothing else : the frame's duty reached the pin.
+    PWM_CHECK_EQ( Device.PWM_GetDutyVal( ), Duty );
+    int Written = 0;
+    PWM_CHECK_EQ( Device.PWM_GetBackend( ).PWM_Read( PWM_ATTR_DUTY, Written ), 1 );
+    PWM_CHECK_EQ( Written, Duty );
+    Device.PWM_GetMetrics( After );
+    PWM_CHECK_EQ( After.PWM_WriteFailures, After.PWM_FailuresByErrno[ ENOSPC ] );
+
+    system( "rm -rf " PWM_TEST_ROOT );
+    return PWM_TestResult( "BBBPWMReconcileTest" );
+}
@@ -0,0 +1,66 @@
+//
+//  BBBPWMShmTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  A client stopping a channel through shared memory and then setting every duty before the controller's next poll :
+//  the duties must not undo the stop, both reach the pins.
+//
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+#define PWM_TEST_SEGMENT       "/BBBPWMShmTest"
+#define PWM_TEST_POLL_NS       200000000 //!< Slow poll, so both commands land between two polls.
+
+int main( ) {
+    BBBPWMSimController Controller;
+    BBBPWMSimDevice Devices[ 2 ];
+    BBBPWMDevice::PWM_PinNum Pins[ 2 ] = { BBBPWMDevice::PWM14, BBBPWMDevice::PWM16 };
+    for( int c = 0; c < 2; c++ ) {
+        Devices[ c ].PWM_SetBlockNum( BBBPWMDevice::P9 );
+        Devices[ c ].PWM_SetPinNum( Pins[ c ] );
+        Controller.PWM_AddDevice( &Devices[ c ] );
+    }
+    vector< int > Status;
+    PWM_CHECK_EQ( Controller.PWM_InitDevices( Status ), 2 );
+
+    BBBPWMShm Shm;
+    PWM_CHECK_EQ( Shm.PWM_Create( PWM_TEST_SEGMENT, 2 ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_Serve( &Shm, PWM_TEST_POLL_NS ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+    BBBPWMShm Client;
+    PWM_CHECK_EQ( Client.PWM_Open( PWM_TEST_SEGMENT ), 1 );
+
+    // Running first.
+    PWM_CHECK_EQ( Client.PWM_SetTarget( 0, PWM_SHM_KEEP, PWM_SHM_KEEP, BBBPWMDevice::ON ), 1 );
+    for( int w = 0; w < 1000 && Devices[ 0 ].PWM_GetRunVal( ) != BBBPWMDevice::ON; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetRunVal( ), ( int ) BBBPWMDevice::ON );
+
+    // Stop, then the duties of both channels straight after : one poll takes both.
+    int Duties[ 2 ] = { 400000, 300000 };
+    PWM_CHECK_EQ( Client.PWM_SetTarget( 0, PWM_SHM_KEEP, PWM_SHM_KEEP, BBBPWMDevice::OFF ), 1 );
+    PWM_CHECK_EQ( Client.PWM_SetDuties( Duties, 2 ), 1 );
+    for( int w = 0; w < 1000 && ( Devices[ 0 ].PWM_GetDutyVal( ) != Duties[ 0 ] || Devices[ 1 ].PWM_GetDutyVal( ) != Duties[ 1 ] ); w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetDutyVal( ), Duties[ 0 ] );
+    PWM_CHECK_EQ( Devices[ 1 ].PWM_GetDutyVal( ), Duties[ 1 ] );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetRunVal( ), ( int ) BBBPWMDevice::OFF );
+    Controller.PWM_Stop( );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetBackend( ).PWM_GetValue( PWM_ATTR_RUN ), ( int ) BBBPWMDevice::OFF );
+    PWM_CHECK_EQ( Devices[ 0 ].PWM_GetBackend( ).PWM_GetValue( PWM_ATTR_DUTY ), Duties[ 0 ] );
+
+    // The status slot agrees.
+    BBBPWMShmStatusRecord Record;
+    PWM_CHECK_EQ( Client.PWM_GetStatus( 0, Record ), 1 );
+    PWM_CHECK_EQ( Record.PWM_Run, ( int ) BBBPWMDevice::OFF );
+    PWM_CHECK_EQ( Record.PWM_Duty, Duties[ 0 ] );
+
+    Client.PWM_Close( );
+    Shm.PWM_Close( );
+    BBBPWMShm::PWM_Unlink( PWM_TEST_SEGMENT );
+    return PWM_TestResult( "BBBPWMShmTest" );
+}
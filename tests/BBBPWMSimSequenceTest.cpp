@@ -0,0 +1,123 @@
+//
+//  BBBPWMSimSequenceTest.cpp
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  Runs init, a ramp and plain updates on a BBBPWMSimDevice and compares what reached the simulated pin, write by
+//  write, with the sequence expected.
+//
+
+#include <sstream>
+
+#include "BBBPWMController.h"
+#include "BBBPWMTest.h"
+
+struct PWM_TestWrite {
+    PWM_Attribute PWM_Attr;
+    int PWM_Value;
+};
+
+/**
+ \fn static function void PWM_TestWaitDuty( BBBPWMSimDevice& Device, int Duty )
+ \brief Waits up to a second for the writer thread to reach Duty.
+ \param <BBBPWMSimDevice&> Device
+ \param <int> Duty
+ \return <void>
+ */
+static void PWM_TestWaitDuty( BBBPWMSimDevice& Device, int Duty ) {
+    for( int w = 0; w < 1000 && ( Device.PWM_GetDutyVal( ) != Duty || Device.PWM_IsRamping( ) ); w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( Device.PWM_GetDutyVal( ), Duty );
+}
+
+int main( ) {
+    // A slow tick : a ramp step only goes missing if the writer is more than a whole tick late and catches up.
+    BBBPWMSimController Controller;
+    Controller.PWM_SetTickPeriod( 20000000 );
+    BBBPWMSimDevice Device;
+    Device.PWM_SetBlockNum( BBBPWMDevice::P9 );
+    Device.PWM_SetPinNum( BBBPWMDevice::PWM42 );
+    Controller.PWM_AddDevice( &Device );
+    PWM_CHECK_EQ( Device.PWM_Init( ), 1 );
+    PWM_CHECK_EQ( Controller.PWM_Start( ), 1 );
+
+    // Init only reads the pin, and seeding the values read is not a suppressed update.
+    PWM_CHECK_EQ( Device.PWM_GetDutyVal( ), PWM_SIM_DUTY );
+    PWM_CHECK_EQ( Device.PWM_GetPeriodVal( ), PWM_SIM_PERIOD );
+    PWM_CHECK_EQ( Device.PWM_GetRunVal( ), PWM_SIM_RUN );
+    PWM_CHECK_EQ( Device.PWM_GetBackend( ).PWM_GetWriteCount( ), 0u );
+    PWM_CHECK_EQ( Device.PWM_GetSuppressedCount( ), 0u );
+
+    // Period and run go through the writer too, let them land before the ramp so the order below is fixed.
+    PWM_CHECK_EQ( Device.PWM_SetPeriodVal( BBBPWMDevice::ACTIVE ), 1 );
+    PWM_CHECK_EQ( Device.PWM_SetRunVal( BBBPWMDevice::ON ), 1 );
+    for( int w = 0; w < 1000 && Device.PWM_GetRunVal( ) != BBBPWMDevice::ON; w++ )
+        usleep( 1000 );
+    PWM_CHECK_EQ( Device.PWM_GetPeriodVal( ), ( int ) BBBPWMDevice::ACTIVE );
+    PWM_CHECK_EQ( Device.PWM_GetRunVal( ), ( int ) BBBPWMDevice::ON );
+
+    // Ramp : 100us per tick from 700us down to 400us.
+    Device.PWM_SetDutySlew( 100000 );
+    Device.PWM_SetTargetSpeed( 400000 );
+    PWM_TestWaitDuty( Device, 400000 );
+
+    // Updates : a jump, a repeat that must not be written, a target below the range that is clamped.
+    Device.PWM_SetDutySlew( 0 );
+    Device.PWM_SetTargetSpeed( 450000 );
+    PWM_TestWaitDuty( Device, 450000 );
+    Device.PWM_SetTargetSpeed( 450000 );
+    usleep( 10000 );
+    Device.PWM_SetTargetSpeed( 100000 );
+    PWM_TestWaitDuty( Device, PWM_DUTY_LOW );
+    Device.PWM_SetPeriodVal( BBBPWMDevice::ACTIVE );
+    usleep( 10000 );
+
+    // Two failed run writes, retried by the writer on the tick : the first is printed, the second only counted, neither
+    // reaches the pin, the third does. cerr is only restored once the writer has been joined.
+    stringstream Errors;
+    streambuf* Cerr = cerr.rdbuf( Errors.rdbuf( ) );
+    Device.PWM_GetBackend( ).PWM_FailWrites( EIO, 2 );
+    PWM_CHECK_EQ( Device.PWM_SetRunVal( BBBPWMDevice::OFF ), 1 );
+    for( int w = 0; w < 1000 && Device.PWM_GetRunVal( ) != BBBPWMDevice::OFF; w++ )
+        usleep( 1000 );
+    Controller.PWM_Stop( );
+    cerr.rdbuf( Cerr );
+    PWM_CHECK_EQ( Device.PWM_GetRunVal( ), ( int ) BBBPWMDevice::OFF );
+    string Line;
+    int Lines = 0;
+    while( getline( Errors, Line ) )
+        Lines++;
+    PWM_CHECK_EQ( Lines, 1 );
+
+    const PWM_TestWrite Expected[ ] = {
+        { PWM_ATTR_PERIOD, BBBPWMDevice::ACTIVE },
+        { PWM_ATTR_RUN, BBBPWMDevice::ON },
+        { PWM_ATTR_DUTY, 600000 },
+        { PWM_ATTR_DUTY, 500000 },
+        { PWM_ATTR_DUTY, 400000 },
+        { PWM_ATTR_DUTY, 450000 },
+        { PWM_ATTR_DUTY, PWM_DUTY_LOW },
+        { PWM_ATTR_RUN, BBBPWMDevice::OFF },
+    };
+    const size_t Count = sizeof( Expected ) / sizeof( Expected[ 0 ] );
+    vector< BBBPWMSimWrite > Writes;
+    Device.PWM_GetBackend( ).PWM_GetWrites( Writes );
+    PWM_CHECK_EQ( Writes.size( ), Count );
+    for( size_t i = 0; i < Count && i < Writes.size( ); i++ ) {
+        PWM_CHECK_EQ( Writes[ i ].PWM_Attr, Expected[ i ].PWM_Attr );
+        PWM_CHECK_EQ( Writes[ i ].PWM_Value, Expected[ i ].PWM_Value );
+        if( i > 0 )
+            PWM_CHECK( Writes[ i ].PWM_TimeNs >= Writes[ i - 1 ].PWM_TimeNs );
+    }
+
+    BBBPWMMetrics Metrics;
+    Device.PWM_GetMetrics( Metrics );
+    PWM_CHECK_EQ( Metrics.PWM_WriteFailures, 2u );
+    PWM_CHECK_EQ( Metrics.PWM_FailuresByErrno[ EIO ], 2u );
+    PWM_CHECK_EQ( Metrics.PWM_Writes, Count + 2 );
+    // The repeated target and period at least, wake-ups that found nothing to write count as well.
+    PWM_CHECK( Device.PWM_GetSuppressedCount( ) >= 2u );
+    return PWM_TestResult( "BBBPWMSimSequenceTest" );
+}
@@ -0,0 +1,59 @@
+//
+//  BBBPWMTest.h
+//  BBBPWMDevice
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+//  Shared by the programs in tests/, each built and run by make test ( and by make tsan under ThreadSanitizer ).
+//  A test calls PWM_CHECK( ) for every expectation and returns PWM_TestResult( ) from main( ).
+//
+
+#ifndef BBBPWMTest_h
+#define BBBPWMTest_h
+
+#include <iostream>
+
+using namespace std;
+
+static int PWM_TestFailures = 0; //!< Failed PWM_CHECK( )s in this program.
+
+/**
+ \brief PWM_CHECK - reports a failed expectation with its file and line, counts it and carries on.
+ */
+#define PWM_CHECK( Expr ) \
+    do { \
+        if( !( Expr ) ) { \
+            cerr << __FILE__ << ":" << __LINE__ << " : Check failed : " << #Expr << endl; \
+            PWM_TestFailures++; \
+        } \
+    } while( 0 )
+
+/**
+ \brief PWM_CHECK_EQ - as PWM_CHECK( ), printing both values when they differ.
+ */
+#define PWM_CHECK_EQ( Actual, Expected ) \
+    do { \
+        if( !( ( Actual ) == ( Expected ) ) ) { \
+            cerr << __FILE__ << ":" << __LINE__ << " : Check failed : " << #Actual << " == " << #Expected \
+                 << " ( " << ( Actual ) << " != " << ( Expected ) << " )" << endl; \
+            PWM_TestFailures++; \
+        } \
+    } while( 0 )
+
+/**
+ \fn static function int PWM_TestResult( const char* Name )
+ \brief Prints the outcome of the test program.
+ \param <const char*> Name
+ \return <int> exit code, 1 if any check failed.
+ */
+static inline int PWM_TestResult( const char* Name ) {
+    if( PWM_TestFailures ) {
+        cerr << Name << " : " << PWM_TestFailures << " check(s) failed" << endl;
+        return 1;
+    }
+    cout << Name << " : ok" << endl;
+    return 0;
+}
+
+#endif /* BBBPWMTest_h */
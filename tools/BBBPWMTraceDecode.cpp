@@ -0,0 +1,157 @@
+//
+//  BBBPWMTraceDecode.cpp
+//  BBBPWMDevice
+//
+//  Turns a BBBPWMTrace file into CSV, or into per channel latency summaries.
+//  Build : make tools ( from the repository root, builds build/BBBPWMTraceDecode ).
+//  Run   : ./BBBPWMTraceDecode [--summary] <trace file>
+//
+//  CSV columns : time_ns (since the trace started), wall_ns (CLOCK_REALTIME), thread, pin, event, attr, value, errno.
+//  The summary gives, per pin and attribute, how many values were requested, clamped, written and failed, and the
+//  request to write latency : from the oldest request still waiting until the write that took it to the kernel.
+//
+//  Created by Michael Brookes on 04/10/2015.
+//  Copyright © 2015 Michael Brookes. All rights reserved.
+//
+
+#include "BBBPWMTrace.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <stdio.h>
+
+using namespace std;
+
+static const char* Decode_Types[ PWM_TRACE_TYPES ] = { "request", "clamp", "write", "fail", "lost" };
+static const char* Decode_Attrs[ PWM_ATTRS ] = { "duty", "period", "run" };
+
+/**
+ \brief Counts and latencies of one pin's attribute.
+ */
+struct Decode_Channel {
+    uint64_t Counts[ PWM_TRACE_TYPES ];
+    int64_t Waiting; //!< Time of the oldest request not yet written, -1 if none.
+    vector< int64_t > Latency;
+};
+
+/**
+ \brief Reads the whole file, checking its header.
+ */
+static int Decode_Read( const char* Path, BBBPWMTraceHeader& Header, vector< BBBPWMTraceEvent >& Events ) {
+    FILE* File = fopen( Path, "rb" );
+    if( File == NULL ) {
+        cerr << "Error - unable to open " << Path << " : " << strerror( errno ) << endl;
+        return -1;
+    }
+    if( fread( &Header, sizeof( Header ), 1, File ) != 1 || memcmp( Header.PWM_Magic, PWM_TRACE_MAGIC, sizeof( Header.PWM_Magic ) ) != 0
+        || Header.PWM_EventSize != sizeof( BBBPWMTraceEvent ) ) {
+        cerr << "Error - " << Path << " is not a trace file this decoder can read" << endl;
+        fclose( File );
+        return -1;
+    }
+    BBBPWMTraceEvent Event;
+    while( fread( &Event, sizeof( Event ), 1, File ) == 1 )
+        Events.push_back( Event );
+    fclose( File );
+    // The drain writes each thread's events in one piece, merge them back into one timeline.
+    stable_sort( Events.begin( ), Events.end( ), []( const BBBPWMTraceEvent& A, const BBBPWMTraceEvent& B ) { return A.PWM_TimeNs < B.PWM_TimeNs; } );
+    return 1;
+}
+
+static int64_t Decode_Percentile( const vector< int64_t >& Sorted, double P ) {
+    if( Sorted.empty( ) )
+        return 0;
+    size_t Index = ( size_t )( P * ( Sorted.size( ) - 1 ) + 0.5 );
+    return Sorted[ Index ];
+}
+
+static void Decode_Csv( const BBBPWMTraceHeader& Header, const vector< BBBPWMTraceEvent >& Events ) {
+    printf( "time_ns,wall_ns,thread,pin,event,attr,value,errno\n" );
+    for( size_t i = 0; i < Events.size( ); i++ ) {
+        const BBBPWMTraceEvent& Event = Events[ i ];
+        int64_t Since = Event.PWM_TimeNs - Header.PWM_MonotonicNs;
+        const char* Type = Event.PWM_Type < PWM_TRACE_TYPES ? Decode_Types[ Event.PWM_Type ] : "unknown";
+        if( Event.PWM_Type == PWM_TRACE_LOST ) {
+            printf( "%lld,%lld,%u,,%s,,%d,\n", ( long long ) Since, ( long long )( Header.PWM_RealtimeNs + Since ), Event.PWM_Thread, Type, Event.PWM_Value );
+            continue;
+        }
+        printf( "%lld,%lld,%u,P%u_%u,%s,%s,%d,%d\n", ( long long ) Since, ( long long )( Header.PWM_RealtimeNs + Since ), Event.PWM_Thread,
+                Event.PWM_Block, Event.PWM_Pin, Type, Event.PWM_Attr < PWM_ATTRS ? Decode_Attrs[ Event.PWM_Attr ] : "unknown",
+                Event.PWM_Value, Event.PWM_Errno );
+    }
+}
+
+static void Decode_Summary( const BBBPWMTraceHeader& Header, const vector< BBBPWMTraceEvent >& Events ) {
+    map< int, Decode_Channel > Channels;
+    uint64_t Lost = 0;
+    for( size_t i = 0; i < Events.size( ); i++ ) {
+        const BBBPWMTraceEvent& Event = Events[ i ];
+        if( Event.PWM_Type >= PWM_TRACE_TYPES || Event.PWM_Attr >= PWM_ATTRS )
+            continue;
+        if( Event.PWM_Type == PWM_TRACE_LOST ) {
+            Lost += Event.PWM_Value;
+            continue;
+        }
+        int Key = ( Event.PWM_Block << 16 ) | ( Event.PWM_Pin << 8 ) | Event.PWM_Attr;
+        if( Channels.find( Key ) == Channels.end( ) ) {
+            Decode_Channel& Fresh = Channels[ Key ];
+            memset( Fresh.Counts, 0, sizeof( Fresh.Counts ) );
+            Fresh.Waiting = -1;
+        }
+        Decode_Channel& Channel = Channels[ Key ];
+        Channel.Counts[ Event.PWM_Type ]++;
+        if( Event.PWM_Type == PWM_TRACE_REQUEST && Channel.Waiting < 0 )
+            Channel.Waiting = Event.PWM_TimeNs;
+        // Requests that arrive while one is waiting are coalesced : the next write answers all of them.
+        else if( Event.PWM_Type == PWM_TRACE_WRITE && Channel.Waiting >= 0 ) {
+            Channel.Latency.push_back( Event.PWM_TimeNs - Channel.Waiting );
+            Channel.Waiting = -1;
+        }
+    }
+
+    int64_t Span = Events.empty( ) ? 0 : Events.back( ).PWM_TimeNs - Header.PWM_MonotonicNs;
+    printf( "events %zu over %.3f s, %llu lost\n", Events.size( ), Span / 1e9, ( unsigned long long ) Lost );
+    printf( "%-8s %-7s %9s %9s %9s %9s %12s %12s %12s\n", "pin", "attr", "requests", "clamped", "writes", "failures",
+            "lat_p50_ns", "lat_p99_ns", "lat_max_ns" );
+    for( map< int, Decode_Channel >::iterator it = Channels.begin( ); it != Channels.end( ); ++it ) {
+        Decode_Channel& Channel = it->second;
+        sort( Channel.Latency.begin( ), Channel.Latency.end( ) );
+        char Pin[ 16 ];
+        snprintf( Pin, sizeof( Pin ), "P%d_%d", it->first >> 16, ( it->first >> 8 ) & 0xff );
+        printf( "%-8s %-7s %9llu %9llu %9llu %9llu %12lld %12lld %12lld\n", Pin, Decode_Attrs[ it->first & 0xff ],
+                ( unsigned long long ) Channel.Counts[ PWM_TRACE_REQUEST ], ( unsigned long long ) Channel.Counts[ PWM_TRACE_CLAMP ],
+                ( unsigned long long ) Channel.Counts[ PWM_TRACE_WRITE ], ( unsigned long long ) Channel.Counts[ PWM_TRACE_FAIL ],
+                ( long long ) Decode_Percentile( Channel.Latency, 0.50 ), ( long long ) Decode_Percentile( Channel.Latency, 0.99 ),
+                ( long long )( Channel.Latency.empty( ) ? 0 : Channel.Latency.back( ) ) );
+    }
+}
+
+int main( int argc, char** argv ) {
+    bool Summary = false;
+    const char* Path = NULL;
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[ i ], "--summary" ) == 0 )
+            Summary = true;
+        else if( Path == NULL && argv[ i ][ 0 ] != '-' )
+            Path = argv[ i ];
+        else {
+            cerr << "Unknown option : " << argv[ i ] << endl;
+            return 1;
+        }
+    }
+    if( Path == NULL ) {
+        cerr << "Usage : " << argv[ 0 ] << " [--summary] <trace file>" << endl;
+        return 1;
+    }
+
+    BBBPWMTraceHeader Header;
+    vector< BBBPWMTraceEvent > Events;
+    if( Decode_Read( Path, Header, Events ) < 0 )
+        return 1;
+    if( Summary )
+        Decode_Summary( Header, Events );
+    else
+        Decode_Csv( Header, Events );
+    return 0;
+}